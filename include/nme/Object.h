@@ -46,6 +46,21 @@ enum NmeObjectType
 
 extern const char *gObjectTypeNames[];
 
+// Define NME_ATOMIC_REFCOUNT to allow objects to be IncRef/DecRef'd from several threads
+#ifdef NME_ATOMIC_REFCOUNT
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    #define NME_REF_INC(x) _InterlockedIncrement((volatile long *)&(x))
+    #define NME_REF_DEC(x) _InterlockedDecrement((volatile long *)&(x))
+  #else
+    #define NME_REF_INC(x) __atomic_add_fetch(&(x),1,__ATOMIC_RELAXED)
+    #define NME_REF_DEC(x) __atomic_sub_fetch(&(x),1,__ATOMIC_ACQ_REL)
+  #endif
+#else
+  #define NME_REF_INC(x) (++(x))
+  #define NME_REF_DEC(x) (--(x))
+#endif
+
 
 class Object
 {
@@ -62,15 +77,22 @@ public:
       sLiveObjectCount++;
       #endif
    }
-   Object *IncRef() { mRefCount++; return this; }
-   #ifdef HXCPP_JS_PRIME
+   Object *IncRef() { NME_REF_INC(mRefCount); return this; }
+   // Deletes now, or queues heavy objects for ProcessDeferredReleases
    void releaseObject();
-   void DecRef() { mRefCount--; if (mRefCount<=0) releaseObject(); }
-   #else
-   void DecRef() { mRefCount--; if (mRefCount<=0) delete this; }
-   #endif
+   void DecRef() { if (NME_REF_DEC(mRefCount)<=0) releaseObject(); }
    virtual int GetRefCount() { return mRefCount; }
 
+   #ifndef HXCPP_JS_PRIME
+   // With a budget, released surfaces, graphics, tilesheets and fonts are destroyed
+   //  from ProcessDeferredReleases, spending at most inMaxSeconds per call.
+   //  Zero destroys them immediately, except when released off the main thread.
+   static void SetDeferredRelease(double inMaxSeconds);
+   static void ProcessDeferredReleases();
+   static void FlushDeferredReleases();
+   static int  GetDeferredReleaseCount();
+   #endif
+
    virtual int getApiVersion() { return NME_API_VERSION; }
 
    #ifdef HXCPP_JS_PRIME
@@ -49,8 +49,8 @@ struct ObjectStreamOut
    {
       data.append((unsigned char *)&inData, sizeof(T));
    }
-   template<typename T,int N>
-   void addVec(const QuickVec<T,N> &inData)
+   template<typename T,int N,typename A>
+   void addVec(const QuickVec<T,N,A> &inData)
    {
       addInt(inData.size());
       append(inData.ByteData(), inData.ByteCount());
@@ -121,8 +121,8 @@ struct ObjectStreamIn
       ptr+=sizeof(T);
       len-=sizeof(T);
    }
-   template<typename T,int N>
-   void getVec(QuickVec<T,N> &outData)
+   template<typename T,int N,typename A>
+   void getVec(QuickVec<T,N,A> &outData)
    {
       int n = getInt();
       outData.resize(n);
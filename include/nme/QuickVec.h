@@ -21,10 +21,19 @@ void DoDelete(T *&item)
 }
 
 
+// Default storage for QuickVec.  Allocators are passed the previous byte size so that
+//  pooled implementations (see BufferPool.h) can find the size class without a header.
+struct QuickVecMalloc
+{
+   static void *Alloc(int inBytes) { return malloc(inBytes); }
+   static void *Realloc(void *inPtr,int inOldBytes,int inBytes) { return realloc(inPtr,inBytes); }
+   static void Free(void *inPtr,int inBytes) { free(inPtr); }
+};
+
 
 // Little vector/set class, optimised for small data and not using many malloc calls.
 // Data are allocated with "malloc", so they should not rely on constructors etc.
-template<typename T_,int QBUF_SIZE_=16>
+template<typename T_,int QBUF_SIZE_=16,typename ALLOC_=QuickVecMalloc>
 class QuickVec
 {
    enum { QBufSize = QBUF_SIZE_ };
@@ -39,7 +48,7 @@ public:
       mAlloc = QBufSize;
       mSize = 0;
    }
-   QuickVec(const QuickVec<T_,QBUF_SIZE_> &inRHS)
+   QuickVec(const QuickVec<T_,QBUF_SIZE_,ALLOC_> &inRHS)
    {
       if (QBUF_SIZE_!=0 && inRHS.mSize<=QBufSize)
       {
@@ -49,7 +58,7 @@ public:
       else
       {
          mAlloc = inRHS.mAlloc;
-         mPtr = (T_ *)malloc(mAlloc * sizeof(T_));
+         mPtr = (T_ *)ALLOC_::Alloc(mAlloc * sizeof(T_));
       }
       mSize = inRHS.mSize;
       memcpy(mPtr,inRHS.mPtr,sizeof(T_)*mSize);
@@ -76,20 +85,20 @@ public:
    {
       if (QBUF_SIZE_==0 || mPtr!=mQBuf)
          if (mPtr)
-            free(mPtr);
+            ALLOC_::Free(mPtr,mAlloc*sizeof(T_));
    }
    void clear()
    {
       if (QBUF_SIZE_==0)
       {
          if (mPtr)
-            free(mPtr);
+            ALLOC_::Free(mPtr,mAlloc*sizeof(T_));
          mPtr = 0;
          mAlloc = 0;
       }
       else if (mPtr!=mQBuf)
       {
-         free(mPtr);
+         ALLOC_::Free(mPtr,mAlloc*sizeof(T_));
          mPtr = mQBuf;
          mAlloc = QBufSize;
       }
@@ -232,17 +241,18 @@ public:
       {
          if (QBUF_SIZE_!=0 && mPtr==mQBuf)
          {
-            mPtr = (T_ *)malloc(sizeof(T_)*(QBufSize*2));
+            mPtr = (T_ *)ALLOC_::Alloc(sizeof(T_)*(QBufSize*2));
             memcpy(mPtr, mQBuf, sizeof(mQBuf));
             mAlloc = QBufSize*2;
          }
          else
          {
+            int oldBytes = sizeof(T_)*mAlloc;
             if (mAlloc)
                mAlloc *= 2;
             else
                mAlloc = 16;
-            mPtr = (T_*)realloc(mPtr, sizeof(T_)*mAlloc);
+            mPtr = (T_*)ALLOC_::Realloc(mPtr, oldBytes, sizeof(T_)*mAlloc);
          }
       }
    }
@@ -250,15 +260,16 @@ public:
    {
       if (mAlloc<inSize && (QBUF_SIZE_==0 || inSize>QBufSize) )
       {
+         int oldBytes = sizeof(T_)*mAlloc;
          mAlloc = inSize;
 
          if (QBUF_SIZE_==0 || mPtr!=mQBuf)
          {
-            mPtr = (T_ *)realloc(mPtr,sizeof(T_)*mAlloc);
+            mPtr = (T_ *)ALLOC_::Realloc(mPtr,oldBytes,sizeof(T_)*mAlloc);
          }
          else
          {
-            T_ *buf = (T_ *)malloc(sizeof(T_)*mAlloc);
+            T_ *buf = (T_ *)ALLOC_::Alloc(sizeof(T_)*mAlloc);
             memcpy(buf,mPtr,mSize*sizeof(T_));
             mPtr = buf;
          }
@@ -271,13 +282,14 @@ public:
          if (QBUF_SIZE_!=0 && mPtr==mQBuf)
          {
             mAlloc = inSize;
-            mPtr = (T_ *)malloc(sizeof(T_)*(mAlloc));
+            mPtr = (T_ *)ALLOC_::Alloc(sizeof(T_)*(mAlloc));
             memcpy(mPtr, mQBuf, sizeof(T_)*mSize);
          }
          else
          {
+            int oldBytes = sizeof(T_)*mAlloc;
             mAlloc = inSize;
-            mPtr = (T_*)realloc(mPtr, sizeof(T_)*mAlloc);
+            mPtr = (T_*)ALLOC_::Realloc(mPtr, oldBytes, sizeof(T_)*mAlloc);
          }
 
       }
@@ -358,8 +370,8 @@ public:
    inline unsigned char *ByteData() { return (unsigned char *)mPtr; }
    inline const unsigned char *ByteData() const { return (const unsigned char *)mPtr; }
    
-   bool operator == (const QuickVec<T_,QBUF_SIZE_> &inRHS) { return (*mPtr == *(inRHS.mPtr)); }
-   bool operator != (const QuickVec<T_,QBUF_SIZE_> &inRHS) { return !(*mPtr == *(inRHS.mPtr)); }
+   bool operator == (const QuickVec<T_,QBUF_SIZE_,ALLOC_> &inRHS) { return (*mPtr == *(inRHS.mPtr)); }
+   bool operator != (const QuickVec<T_,QBUF_SIZE_,ALLOC_> &inRHS) { return !(*mPtr == *(inRHS.mPtr)); }
 
    inline int size() const { return mSize; }
    inline bool empty() const { return mSize==0; }
@@ -372,7 +384,7 @@ public:
    inline const_iterator begin() const { return mPtr; }
    inline const_iterator rbegin() const { return mPtr + mSize - 1; }
    inline const_iterator end() const { return mPtr + mSize; }
-   void swap( QuickVec<T_,QBUF_SIZE_> &inRHS )
+   void swap( QuickVec<T_,QBUF_SIZE_,ALLOC_> &inRHS )
    {
       if (QBUF_SIZE_==0)
       {
@@ -423,10 +435,10 @@ public:
       std::swap(mSize,inRHS.mSize);
    }
 
-   QuickVec<T_,QBUF_SIZE_> &operator=(const QuickVec<T_,QBUF_SIZE_> &inRHS)
+   QuickVec<T_,QBUF_SIZE_,ALLOC_> &operator=(const QuickVec<T_,QBUF_SIZE_,ALLOC_> &inRHS)
    {
       if ( (QBUF_SIZE_==0 || mPtr!=mQBuf) && mPtr )
-         free(mPtr);
+         ALLOC_::Free(mPtr,mAlloc*sizeof(T_));
 
       if (QBUF_SIZE_!=0 && inRHS.mSize<=QBufSize)
       {
@@ -436,7 +448,7 @@ public:
       else
       {
          mAlloc = inRHS.mAlloc;
-         mPtr = (T_ *)(mAlloc ? malloc( mAlloc * sizeof(T_)) : 0);
+         mPtr = (T_ *)(mAlloc ? ALLOC_::Alloc( mAlloc * sizeof(T_)) : 0);
       }
       mSize = inRHS.mSize;
       if (mSize)
@@ -450,7 +462,8 @@ public:
       resize(0);
    }
 
-   void append(const QuickVec<T_> &inOther)
+   template<int N_,typename A_>
+   void append(const QuickVec<T_,N_,A_> &inOther)
    {
       int s = mSize;
       resize(mSize+inOther.mSize);
@@ -0,0 +1,55 @@
+#ifndef NME_BUFFER_POOL_H
+#define NME_BUFFER_POOL_H
+
+#include <nme/QuickVec.h>
+
+namespace nme
+{
+
+// Size-classed pool for the buffers that get thrown away and rebuilt every time a
+//  Graphics is redrawn - path commands/data, jobs and hardware vertex arrays.
+// Blocks are rounded up to a power of 2, so growing within a class does not move the data,
+//  and freed blocks are kept for the next redraw.  TrimBufferPool gives back whatever
+//  has not been needed since the last trim.
+
+void *PoolAlloc(int inBytes);
+void *PoolRealloc(void *inPtr, int inOldBytes, int inBytes);
+void  PoolFree(void *inPtr, int inBytes);
+void  TrimBufferPool(bool inAll=false);
+
+struct BufferPoolStats
+{
+   int    allocs;
+   int    reused;
+   int    frees;
+   int    trimmed;
+   double bytesInUse;
+   double bytesPooled;
+   double highWater;
+};
+
+void GetBufferPoolStats(BufferPoolStats &outStats, bool inReset=false);
+
+
+// Empty a vector ready to be refilled.  The capacity is kept for the next redraw, unless
+//  it is well past what was used this time, in which case it goes back to the pool.
+template<typename VEC_>
+inline void RecycleBuffer(VEC_ &ioVec)
+{
+   if (ioVec.mAlloc > ioVec.size()*4 + 256)
+      ioVec.clear();
+   else
+      ioVec.resize(0);
+}
+
+
+struct PoolAllocator
+{
+   static void *Alloc(int inBytes) { return PoolAlloc(inBytes); }
+   static void *Realloc(void *inPtr,int inOldBytes,int inBytes) { return PoolRealloc(inPtr,inOldBytes,inBytes); }
+   static void Free(void *inPtr,int inBytes) { PoolFree(inPtr,inBytes); }
+};
+
+} // end namespace nme
+
+#endif
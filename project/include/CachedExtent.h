@@ -8,6 +8,9 @@ namespace nme
 {
 
 extern int gCachedExtentID;
+
+enum { CACHED_EXTENT_SLOTS = 6 };
+
 struct CachedExtent
 {
    CachedExtent() : mID(0), mIncludeStroke(false), mIsSet(false), mForScreen(false) {}
@@ -25,6 +28,25 @@ struct CachedExtent
 };
 
 
+// Local-space outline of a renderer's geometry, built once per renderer (ie, per Graphics
+//  version).  The extent under any matrix comes from the convex hull of the end points,
+//  plus the exact extremes of those curves that bulge outside it.
+struct ExtentHull
+{
+   enum State { hullUnknown, hullReady, hullNone };
+
+   ExtentHull() : mState(hullUnknown) { }
+
+   void AddPoint(const UserPoint &inP) { mPoints.push_back(inP); }
+   void AddCurve(const UserPoint &inP0, const UserPoint &inP1, const UserPoint &inP2);
+   void Build();
+   void GetExtent(const Matrix &inMatrix, Extent2DF &ioExtent) const;
+
+   QuickVec<UserPoint> mPoints;
+   QuickVec<UserPoint> mCurves;
+   State               mState;
+};
+
 
 class CachedExtentRenderer : public Renderer
 {
@@ -36,8 +58,12 @@ public:
    // Implement this one instead...
    virtual void GetExtent(CachedExtent &ioCache) = 0;
 
+   // ... and this one too if the extent depends only on the matrix (eg, no line widths)
+   virtual bool GetExtentHull(ExtentHull &outHull) { return false; }
+
 private:
-   CachedExtent mExtentCache[3];
+   CachedExtent mExtentCache[CACHED_EXTENT_SLOTS];
+   ExtentHull   mHull;
 };
 
 } // end namespace NME
@@ -42,6 +42,22 @@ enum
    dirtAll         = 0x000f,
 };
 
+// Fields for DisplayObject::SetTransforms.  Each field present is a block of one
+//  value per object, in bit order - trMatrix is six blocks (a,b,c,d,tx,ty).
+enum
+{
+   trX        = 0x0001,
+   trY        = 0x0002,
+   trScaleX   = 0x0004,
+   trScaleY   = 0x0008,
+   trScale    = 0x0010,
+   trRotation = 0x0020,
+   trAlpha    = 0x0040,
+   trMatrix   = 0x0080,
+};
+
+int TransformFieldCount(int inFields);
+
 enum StageScaleMode
 {
     ssmShowAll,
@@ -81,40 +97,60 @@ extern const char *sHandCursorData[];
 
 extern bool gMouseShowCursor;
 
+// Rarely set DisplayObject state, allocated on first write so plain nodes
+//  only pay for a pointer.
+struct DisplayObjectExtra
+{
+   DisplayObjectExtra() : softKeyboard(0), needsSoftKeyboard(false), movesForSoftKeyboard(false),
+                          bitmapCacheTolerance(0), bitmapCacheResolution(1) { }
+
+   WString    name;
+   FilterList filters;
+   DRect      scale9Grid;
+   DRect      scrollRect;
+   int        softKeyboard;
+   bool       needsSoftKeyboard;
+   bool       movesForSoftKeyboard;
+   // cacheAsBitmap may be redrawn under other transforms, while the scale is within this factor
+   double     bitmapCacheTolerance;
+   double     bitmapCacheResolution;
+};
+
+struct DisplayMemoryReport
+{
+   int objects;
+   int extras;
+   int objectBytes;
+   int extraBytes;
+};
+
 class DisplayObject : public Object
 {
 public:
+   // Touched on every traversal - kept together at the front
+   uint32         mDirtyFlags;
    int            id;
-   WString        name;
    BlendMode      blendMode;
+   uint32         opaqueBackground;
+   bool           visible;
+   bool           mouseEnabled;
+   bool           hitEnabled;
    bool           cacheAsBitmap;
    bool           pedanticBitmapCaching;
    unsigned char  pixelSnapping;
-   ColorTransform colorTransform;
-   FilterList     filters;
-
-   uint32 opaqueBackground;
-   DRect  scale9Grid;
-   DRect  scrollRect;
-   bool   visible;
-   bool   mouseEnabled;
-   bool   hitEnabled;
-   bool   needsSoftKeyboard;
-   int    softKeyboard;
-   bool   movesForSoftKeyboard;
-   uint32 mDirtyFlags;
 
 protected:
    DisplayObjectContainer *mParent;
    Graphics               *mGfx;
    BitmapCache            *mBitmapCache;
-   int                     mBitmapGfx;
-
-   // Masking...
    DisplayObject          *mMask;
-   int                    mIsMaskCount;
+   int                     mBitmapGfx;
+   int                     mIsMaskCount;
 
-   // Matrix stuff
+   // Kept in double rather than packed as floats: Transform::mMatrix points straight at
+   //  mLocalMatrix, the decomposition is read back through getX/getScaleX/getRotation and
+   //  must return what was set, and translations of large scrolling worlds need more
+   //  than the 24 bits a float gives.
    Matrix mLocalMatrix;
    // Decomp
    double x;
@@ -123,6 +159,19 @@ protected:
    double scaleY;
    double rotation;
 
+public:
+   ColorTransform colorTransform;
+
+protected:
+   DisplayObjectExtra *mExtra;
+
+   static const DisplayObjectExtra sNoExtra;
+   const DisplayObjectExtra &getExtra() const { return mExtra ? *mExtra : sNoExtra; }
+   DisplayObjectExtra &editExtra();
+
+   template<typename T>
+   static void TSetTransforms(DisplayObject *const *inObjects, int inCount, int inFields, const T *inData);
+
 
 
 
@@ -131,6 +180,12 @@ public:
 
    NmeObjectType getObjectType() { return notDisplayObject; }
 
+   // Apply packed transforms to many objects in one pass - null objects are skipped
+   static void SetTransforms(DisplayObject *const *inObjects, int inCount, int inFields, const float *inData);
+   static void SetTransforms(DisplayObject *const *inObjects, int inCount, int inFields, const double *inData);
+
+   static void GetMemoryReport(DisplayMemoryReport &outReport);
+
    double getX();
    void   setX(double inValue);
    double getY();
@@ -157,22 +212,28 @@ public:
    void setMouseEnabled(bool inVal) { mouseEnabled = inVal; }
    bool getHitEnabled() { return hitEnabled; }
    void setHitEnabled(bool inVal) { hitEnabled = inVal; }
-   bool getNeedsSoftKeyboard() { return needsSoftKeyboard; }
-   void setNeedsSoftKeyboard(bool inVal) { needsSoftKeyboard = inVal; }
-   int getSoftKeyboard() { return softKeyboard; }
-   void setSoftKeyboard(int inType) { softKeyboard = inType; }
-   bool getMovesForSoftKeyboard() { return movesForSoftKeyboard; }
-   void setMovesForSoftKeyboard(bool inVal) { movesForSoftKeyboard = inVal; }
+   bool getNeedsSoftKeyboard() { return getExtra().needsSoftKeyboard; }
+   void setNeedsSoftKeyboard(bool inVal) { if (inVal!=getExtra().needsSoftKeyboard) editExtra().needsSoftKeyboard = inVal; }
+   int getSoftKeyboard() { return getExtra().softKeyboard; }
+   void setSoftKeyboard(int inType) { if (inType!=getExtra().softKeyboard) editExtra().softKeyboard = inType; }
+   bool getMovesForSoftKeyboard() { return getExtra().movesForSoftKeyboard; }
+   void setMovesForSoftKeyboard(bool inVal) { if (inVal!=getExtra().movesForSoftKeyboard) editExtra().movesForSoftKeyboard = inVal; }
    bool getCacheAsBitmap() { return cacheAsBitmap; }
    void setCacheAsBitmap(bool inVal);
+   double getBitmapCacheTolerance() { return getExtra().bitmapCacheTolerance; }
+   void setBitmapCacheTolerance(double inVal);
+   double getBitmapCacheResolution() { return getExtra().bitmapCacheResolution; }
+   void setBitmapCacheResolution(double inVal);
    bool getPedanticBitmapCaching() { return pedanticBitmapCaching; }
    void setPedanticBitmapCaching(bool inVal) { pedanticBitmapCaching=inVal; }
    int getPixelSnapping() { return pixelSnapping; }
    void setPixelSnapping(int inVal);
    bool getVisible() { return visible; }
    void setVisible(bool inVal);
-   const wchar_t *getName() { return name.c_str(); }
-   void setName(const WString &inName) { name = inName; }
+   const wchar_t *getName() { return getExtra().name.c_str(); }
+   void setName(const WString &inName);
+   const DRect &getScale9Grid() const { return getExtra().scale9Grid; }
+   const DRect &getScrollRect() const { return getExtra().scrollRect; }
    void setMatrix(const Matrix &inMatrix);
    void setColorTransform(const ColorTransform &inTransform);
 
@@ -198,12 +259,17 @@ public:
 
    virtual void Render( const RenderTarget &inTarget, const RenderState &inState );
 
+   virtual void CollectDirtyGraphics(const Matrix &inMatrix, HardwareRenderer *inHardware, GraphicsPrepassJobs &ioJobs);
+
    void RenderBitmap( const RenderTarget &inTarget, const RenderState &inState );
    bool CreateMask( const Rect &inClipRect,int inAA);
+   bool GetMaskClipRect(Rect &outRect);
    bool HitBitmap( const RenderTarget &inTarget, const RenderState &inState );
    void DebugRenderMask( const RenderTarget &inTarget, const RenderState &inState );
 
    virtual void DirtyCache(bool inParentOnly = false);
+   // A tolerant cache decides for itself whether it can be redrawn at the new transform
+   void DirtyTransformCache() { DirtyCache(getBitmapCacheTolerance()>0); }
    virtual void DirtyExtent();
    virtual void ClearExtentDirty();
    virtual bool NonNormalBlendChild() { return false; }
@@ -230,15 +296,15 @@ public:
    virtual void modifyLocalMatrix(Matrix &ioMatrix) { }
    ColorTransform   &GetLocalColorTransform() { return colorTransform; }
    ColorTransform   GetFullColorTransform();
-   const FilterList &getFilters() { return filters; }
+   const FilterList &getFilters() { return getExtra().filters; }
    // Takes ownership of filters...
    void     setFilters(FilterList &inFilters);
 
    virtual bool IsCacheDirty();
    virtual void ClearCacheDirty();
 
-   void CheckCacheDirty(bool inForHardware);
-   bool IsBitmapRender(bool inForHardware);
+   void CheckCacheDirty(HardwareRenderer *inHardware);
+   bool IsBitmapRender(HardwareRenderer *inHardware);
    void SetBitmapCache(BitmapCache *inCache);
    BitmapCache *GetBitmapCache() { return mBitmapCache; }
 
@@ -271,7 +337,7 @@ class DisplayObjectContainer : public DisplayObject
 {
 public:
    bool mouseChildren;
-   CachedExtent mExtentCache[3];
+   CachedExtent mExtentCache[CACHED_EXTENT_SLOTS];
 protected:
    QuickVec<DisplayObject *> mChildren;
 
@@ -294,6 +360,7 @@ public:
    void RemoveChildFromList(DisplayObject *inChild);
 
    void Render( const RenderTarget &inTarget, const RenderState &inState );
+   void CollectDirtyGraphics(const Matrix &inMatrix, HardwareRenderer *inHardware, GraphicsPrepassJobs &ioJobs);
    bool IsCacheDirty();
    void ClearCacheDirty();
    bool NonNormalBlendChild();
@@ -350,6 +417,7 @@ public:
 
    void setMouseState(int inState);
    void Render( const RenderTarget &inTarget, const RenderState &inState );
+   void CollectDirtyGraphics(const Matrix &inMatrix, HardwareRenderer *inHardware, GraphicsPrepassJobs &ioJobs);
    void GetExtent(const Transform &inTrans, Extent2DF &outExt,bool inForScreen,bool inIncludeStroke);
    bool IsCacheDirty();
    void ClearCacheDirty();
@@ -393,6 +461,7 @@ public:
 
    virtual void BeginRenderStage(bool inDoClear);
    virtual void RenderStage();
+   void TessellateDirtyGraphics();
    virtual void EndRenderStage();
    virtual void ResizeWindow(int inWidth, int inHeight) {};
 
@@ -3,6 +3,7 @@
 
 #include <nme/Object.h>
 #include <nme/QuickVec.h>
+#include <BufferPool.h>
 #include <Matrix.h>
 #include <Scale9.h>
 #include <nme/Pixel.h>
@@ -70,7 +71,7 @@ public:
 
    NmeObjectType getObjectType() { return notIGraphicsData; }
 
-   IGraphicsData *IncRef() { mRefCount++; return this; }
+   IGraphicsData *IncRef() { Object::IncRef(); return this; }
 
    virtual GraphicsDataType GetType() { return gdtUnknown; }
    virtual GraphicsAPIType  GetAPI() { return gatBase; }
@@ -273,6 +274,10 @@ extern int gCommandDataSize[256];
 enum WindingRule { wrOddEven, wrNonZero };
 
 
+// Path buffers are refilled on every redraw, so they come from the buffer pool
+typedef QuickVec<uint8,16,PoolAllocator> PathCommands;
+typedef QuickVec<float,16,PoolAllocator> PathData;
+
 class GraphicsPath : public IGraphicsPath
 {
 public:
@@ -280,8 +285,8 @@ public:
    bool empty() const { return commands.empty() && data.empty(); }
 
    GraphicsPath();
-   QuickVec<uint8> commands;
-   QuickVec<float> data;
+   PathCommands    commands;
+   PathData        data;
    WindingRule     winding;
 
    void clear();
@@ -295,7 +300,7 @@ public:
    void wideMoveTo(float x, float y);
    void tile(float x, float y, const Rect &inTileRect, float *inTrans,float *inColour);
    void elementBlendMode(int inMode);
-   void drawPoints(QuickVec<float> inXYs, QuickVec<int> inRGBAs);
+   void drawPoints(const QuickVec<float> &inXYs, const QuickVec<int> &inRGBAs);
    void closeLine(int inCommand0, int inData0);
 
    void reserveTiles(int inN, bool inFullImage, bool inTrans2x2, bool inHasColour);
@@ -429,6 +434,7 @@ public:
    inline bool IsIdentity() const { return IsIdentityAlpha() && IsIdentityColour(); }
 
    static void TidyCache();
+   static void BuildLUT(uint8 *outLUT, double inMultiplier, double inOffset);
 
 
    const uint8 *GetAlphaLUT() const;
@@ -474,6 +480,12 @@ public:
 					 BitmapCache *inMask);
    ~BitmapCache();
 
+   // Matrix to rasterize an object at, so that it can be redrawn under transforms near inMatrix
+   static Matrix GetRasterMatrix(const Matrix &inMatrix, double inResolution);
+   // The cached pixels were rendered with GetRasterMatrix and hold the whole object - they may be
+   //  drawn under any matrix whose scale is within a factor of (1+inTolerance) of inMatrix
+   void SetTransformTolerant(const Matrix &inMatrix, double inTolerance);
+
    bool StillGood(const Transform &inTransform, const Rect &inVisiblePixels,BitmapCache *inMask);
 
    void Render(const struct RenderTarget &inTarget,const Rect &inClipRect,const BitmapCache *inMask,BlendMode inBlend);
@@ -505,9 +517,25 @@ public:
 
 	ImagePoint mMaskOffset;
 	int        mMaskVersion;
+
+   // Transform-tolerant caches: mMatrix is the raster matrix, and mDrawMatrix
+   //  (raster pixels -> target pixels) is set in StillGood
+   double     mTolerance;
+   double     mBuiltScaleX;
+   double     mBuiltScaleY;
+   Matrix     mDrawMatrix;
 };
 
 
+// Per-channel lookup tables, owned by the renderer that applies them
+struct ColourLUTs
+{
+   uint8 mAlpha[256];
+   uint8 mR[256];
+   uint8 mG[256];
+   uint8 mB[256];
+};
+
 enum RenderPhase { rpBitmap, rpRender, rpHitTest, rpCreateMask };
 
 
@@ -515,9 +543,12 @@ struct RenderState
 {
    RenderState(Surface *inSurface=0,int inAA=1);
 
+   // If inLUTs is provided, the lookup tables are built there, otherwise they
+   //  come from the shared cache
    void CombineColourTransform(const RenderState &inState,
                            const ColorTransform *inObjTrans,
-                           ColorTransform *inBuf);
+                           ColorTransform *inBuf,
+                           ColourLUTs *inLUTs = 0);
 
    // Spatial Transform
    Transform      mTransform;
@@ -630,7 +661,21 @@ struct GraphicsJob
 
 
 
-typedef QuickVec<GraphicsJob> GraphicsJobs;
+typedef QuickVec<GraphicsJob,16,PoolAllocator> GraphicsJobs;
+
+
+class Graphics;
+
+// Graphics found by the stage pre-pass, along with the matrix they will be rendered with
+struct GraphicsPrepassJob
+{
+   Graphics *mGfx;
+   Matrix   mMatrix;
+};
+
+typedef QuickVec<GraphicsPrepassJob> GraphicsPrepassJobs;
+
+void TessellatePrepassJobs(GraphicsPrepassJobs &ioJobs, HardwareRenderer &inHardware);
 
 
 class Graphics : public Object
@@ -671,6 +716,11 @@ public:
 
    bool Render( const RenderTarget &inTarget, const RenderState &inState );
 
+   // Pre-pass: PrepareHardwarePrepass runs on the main thread, and returns true if there
+   //  are texture-free jobs that BuildHardwarePrepass may then tessellate on a worker.
+   bool PrepareHardwarePrepass(const RenderState &inState);
+   void BuildHardwarePrepass(HardwareRenderer &inHardware, const RenderState &inState);
+
    void drawGraphicsDatum(IGraphicsData *inData);
    void drawGraphicsData(IGraphicsData **graphicsData,int inN);
    void beginFill(unsigned int color, float alpha = 1.0);
@@ -687,7 +737,7 @@ public:
    void moveTo(float x, float y);
    void curveTo(float cx,float cy,float x, float y);
    void arcTo(float cx,float cy,float x, float y);
-   void drawPath(const QuickVec<uint8> &inCommands, const QuickVec<float> &inData,
+   void drawPath(const PathCommands &inCommands, const PathData &inData,
            WindingRule inWinding );
 
    void drawEllipse(float x,float  y,float  width,float  height);
@@ -708,7 +758,8 @@ public:
               int inTileFlags = pcTile | pcTile_Trans_Bit | pcTile_Col_Bit, int inCount=0 );
    void endTiles();
    void tile(float x, float y, const Rect &inTileRect, float *inTrans,float *inColour);
-   void drawPoints(QuickVec<float> inXYs, QuickVec<int> inRGBAs, unsigned int inDefaultRGBA=0xffffffff, double inSize=-1.0 );
+   void drawPoints(const QuickVec<float> &inXYs, const QuickVec<int> &inRGBAs, unsigned int inDefaultRGBA=0xffffffff, double inSize=-1.0 );
+   void updatePoints(int inFirst, const QuickVec<float> &inXYs, const QuickVec<int> &inRGBAs);
    void drawTriangles(const QuickVec<float> &inXYs, const QuickVec<int> &inIndixes,
             const QuickVec<float> &inUVT, int inCull, const QuickVec<int> &inColours,
             int blendMode );
@@ -716,6 +767,7 @@ public:
 
    const Extent2DF &GetExtent0(double inRotation);
    bool  HitTest(const UserPoint &inPoint);
+   bool  GetRectangle(DRect &outRect);
 
    bool empty() const { return !mPathData || mPathData->empty(); }
    void removeOwner(DisplayObject *inOwner) { if (mOwner==inOwner) mOwner = 0; }
@@ -51,7 +51,8 @@ struct DrawElement
 
 };
 
-typedef QuickVec<DrawElement> DrawElements;
+typedef QuickVec<DrawElement,16,PoolAllocator> DrawElements;
+typedef QuickVec<uint8,16,PoolAllocator> DrawArray;
 
 class HardwareData
 {
@@ -65,7 +66,7 @@ public:
    void            clear();
 
    DrawElements    mElements;
-   QuickVec<uint8> mArray;
+   DrawArray       mArray;
    float           mMinScale;
    float           mMaxScale;
 
@@ -73,9 +74,18 @@ public:
    mutable int             mRendersWithoutVbo;
    mutable unsigned int    mVertexBo;
    mutable int             mContextId;
+   // Bytes of mArray changed since the vbo was filled
+   mutable int             mDirtyBegin;
+   mutable int             mDirtyEnd;
+   // Updated in place, rather than rebuilt
+   bool                    mDynamic;
 };
 
 
+// Rewrite points [inFirst,inFirst+inCount) of an already-built point job in place
+bool UpdateHardwarePoints(const GraphicsJob &inJob, const GraphicsPath &inPath, HardwareData &ioData,
+                          int inPointJob, int inFirst, int inCount);
+
 void NmeClipOutline(Vertices &ioOutline,QuickVec<int> &ioSubPolys, WindingRule inWinding);
 void ConvertOutlineToTriangles(Vertices &ioOutline,const QuickVec<int> &inSubPolys,WindingRule inWinding);
 
@@ -122,6 +132,12 @@ public:
    virtual void BeginDirectRender()=0;
    virtual void EndDirectRender()=0;
 
+   // Stencil masking - geometry rendered between Begin/EndStencilMask is added to (inPush)
+   //  or removed from the current mask, and masks may be nested up to the stencil depth.
+   virtual bool CanStencilMask() const { return false; }
+   virtual void BeginStencilMask(bool inPush) { }
+   virtual void EndStencilMask(bool inPush) { }
+
 
    virtual void DestroyNativeTexture(void *inNativeTexture)=0;
    virtual void DestroyTexture(unsigned int inTex)=0;
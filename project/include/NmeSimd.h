@@ -0,0 +1,15 @@
+#ifndef NME_SIMD_H
+#define NME_SIMD_H
+
+// Vector instructions for the software pixel paths: SSE2 on x86 (always there on x64),
+//  NEON on ARM.  At most one of NME_SSE2 and NME_NEON is defined, and the code using them
+//  keeps a plain C++ path for when neither is.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <emmintrin.h>
+#define NME_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NME_NEON
+#endif
+
+#endif
@@ -21,6 +21,212 @@ void HintColourOrder(bool inRedFirst);
 
 extern int gTextureContextVersion;
 
+class SimpleSurface;
+
+// --- Resampling ----------------------------------------------
+
+enum ResampleFilter
+{
+   rfBox,
+   rfBilinear,
+   rfLanczos,
+};
+
+// Filter used by smooth StretchTo when minifying (or always, for rfLanczos)
+void SetResampleFilter(ResampleFilter inFilter);
+ResampleFilter GetResampleFilter();
+
+bool CanResample(PixelFormat inFormat);
+
+// Called with each resampled destination row, in the source pixel format.
+//  May be called from worker threads, but never twice for the same row.
+typedef void (*ResampleRowFunc)(int inDestY, const uint8 *inRow, void *inUser);
+
+// Maps inSrcRect onto inDestRect with separable weight tables, and produces the
+//  rows/columns of inOut (which should lie inside the destination rect)
+void Resample(const SimpleSurface *inSrc, const Rect &inSrcRect, const DRect &inDestRect,
+              const Rect &inOut, ResampleFilter inFilter, ResampleRowFunc inFunc, void *inUser);
+
+
+// --- Scratch surfaces ----------------------------------------------
+//
+// Bitmap caches, masks and filter passes take their surfaces from a pool, so the pixels
+//  (and any texture) are reused across frames rather than reallocated.  The surface comes
+//  with one reference - once that is released it is available again.  Main thread only.
+SimpleSurface *AcquireScratchSurface(int inWidth, int inHeight, PixelFormat inFormat, bool inClear=false);
+// Once a frame: drop surfaces that have been idle for a while, or that take the pool over budget
+void TrimSurfacePool(bool inAll=false);
+void SetSurfacePoolBudget(int inBytes);
+
+struct SurfacePoolStats
+{
+   int    acquires;
+   int    reused;
+   int    created;
+   int    trimmed;
+   int    surfaces;
+   double bytesInUse;
+   double bytesPooled;
+};
+
+void GetSurfacePoolStats(SurfacePoolStats &outStats, bool inReset=false);
+
+
+// --- Row bands ----------------------------------------------
+//
+// Work over a tall rect is split into bands of rows, which are shared out between the workers.
+//  Each band is handled by exactly one thread, so it may write its rows without locking.
+
+typedef void (*RowBandFunc)(int inThreadId, int inBand, void *inData);
+
+// Calls inFunc for each band - on the workers if inThreaded and there is more than one band
+void RunRowBands(int inBands, RowBandFunc inFunc, void *inData, bool inThreaded=true);
+
+// Items (tiles, points, triangles...) sorted by the bands their rows touch, keeping their order
+//  within each band.  Count every item's rows, call EndCount, then Place the same items in
+//  the same order.  Keeping the bins between frames keeps their storage.
+template<typename ITEM>
+class BandBins
+{
+public:
+   BandBins() : mY0(0), mRows(0), mBandHeight(1), mBands(0) { }
+
+   // inRows rows from inY0, in bands of inBandHeight
+   void Reset(int inY0, int inRows, int inBandHeight)
+   {
+      mY0 = inY0;
+      mRows = inRows;
+      mBandHeight = inBandHeight;
+      mBands = (inRows + inBandHeight-1)/inBandHeight;
+      mStart.assign(mBands+1, 0);
+      mItems.resize(0);
+   }
+
+   int Bands() const { return mBands; }
+   int BandY0(int inBand) const { return mY0 + inBand*mBandHeight; }
+   int BandY1(int inBand) const { int y1 = (inBand+1)*mBandHeight; return mY0 + (y1<mRows ? y1 : mRows); }
+
+   // The item covers rows [inY0,inY1) - rows outside the bins are ignored
+   void Count(int inY0, int inY1)
+   {
+      int b0, b1;
+      if (BandRange(inY0, inY1, b0, b1))
+         for(int b=b0;b<=b1;b++)
+            mStart[b+1]++;
+   }
+
+   void EndCount()
+   {
+      for(int b=0;b<mBands;b++)
+         mStart[b+1] += mStart[b];
+      mItems.resize(mStart[mBands]);
+      mCursor.assign(mStart.begin(), mStart.end()-1);
+   }
+
+   void Place(int inY0, int inY1, const ITEM &inItem)
+   {
+      int b0, b1;
+      if (BandRange(inY0, inY1, b0, b1))
+         for(int b=b0;b<=b1;b++)
+            mItems[ mCursor[b]++ ] = inItem;
+   }
+
+   // Items in the band are [Begin(band),End(band))
+   const ITEM *Begin(int inBand) const { return mItems.empty() ? 0 : &mItems[0] + mStart[inBand]; }
+   const ITEM *End(int inBand) const { return mItems.empty() ? 0 : &mItems[0] + mStart[inBand+1]; }
+
+private:
+   bool BandRange(int inY0, int inY1, int &outB0, int &outB1) const
+   {
+      int y0 = inY0-mY0;
+      int y1 = inY1-mY0;
+      if (y0<0) y0 = 0;
+      if (y1>mRows) y1 = mRows;
+      if (y1<=y0)
+         return false;
+      outB0 = y0/mBandHeight;
+      outB1 = (y1-1)/mBandHeight;
+      return true;
+   }
+
+   int mY0;
+   int mRows;
+   int mBandHeight;
+   int mBands;
+   std::vector<int>  mStart;
+   std::vector<int>  mCursor;
+   std::vector<ITEM> mItems;
+};
+
+
+// --- Affine spans ----------------------------------------------
+
+// Narrow [ioX0,ioX1) to the steps x for which inStart + x*inStep lies in [inLo,inHi)
+void ClipAffineSpan(double inStart, double inStep, double inLo, double inHi, int &ioX0, int &ioX1);
+
+// Samples an inSrcW x inSrcH source through inInverse (target pixels -> source pixels) for the
+//  target rows [inY0,inY1) and columns [inX,inX+inW), and calls ioOutput(dest,sample) for each
+//  target pixel that lands on the source.  SOURCE::Row(y) gives the bytes of source row y.
+//  Bilinear samples are centred on the texels, and clamped at the edges.
+template<typename DEST, typename SRC, typename SOURCE, typename OUTPUT>
+void TAffineRows(const RenderTarget &outTarget, const SOURCE &inSource, int inSrcW, int inSrcH,
+                 const Matrix &inInverse, int inX, int inW, int inY0, int inY1, bool inSmooth,
+                 OUTPUT &ioOutput)
+{
+   const Matrix &inv = inInverse;
+   double bias = inSmooth ? 0.5 : 0.0;
+   int dsx = (int)(inv.m00*65536.0);
+   int dsy = (int)(inv.m10*65536.0);
+
+   for(int y=inY0; y<inY1; y++)
+   {
+      double px = inX + 0.5;
+      double py = y + 0.5;
+      double sx = inv.m00*px + inv.m01*py + inv.mtx - bias;
+      double sy = inv.m10*px + inv.m11*py + inv.mty - bias;
+
+      int x0 = 0;
+      int x1 = inW;
+      ClipAffineSpan(sx, inv.m00, -bias, inSrcW-bias, x0, x1);
+      ClipAffineSpan(sy, inv.m10, -bias, inSrcH-bias, x0, x1);
+      if (x0>=x1)
+         continue;
+
+      DEST *dest = (DEST *)outTarget.Row(y) + inX + x0;
+      int fx = (int)((sx + x0*inv.m00)*65536.0);
+      int fy = (int)((sy + x0*inv.m10)*65536.0);
+
+      if (!inSmooth)
+      {
+         for(int x=x0;x<x1;x++)
+         {
+            int ix = fx>>16;
+            int iy = fy>>16;
+            ix = ix<0 ? 0 : ix>=inSrcW ? inSrcW-1 : ix;
+            iy = iy<0 ? 0 : iy>=inSrcH ? inSrcH-1 : iy;
+            ioOutput(*dest++, ((const SRC *)inSource.Row(iy))[ix]);
+            fx += dsx;
+            fy += dsy;
+         }
+      }
+      else
+      {
+         for(int x=x0;x<x1;x++)
+         {
+            int ix = fx>>16;
+            int iy = fy>>16;
+            int ix0 = ix<0 ? 0 : ix;
+            int ix1 = ix+1<inSrcW ? ix+1 : inSrcW-1;
+            const SRC *src0 = (const SRC *)inSource.Row(iy<0 ? 0 : iy);
+            const SRC *src1 = (const SRC *)inSource.Row(iy+1<inSrcH ? iy+1 : inSrcH-1);
+            ioOutput(*dest++, BilinearInterp( src0[ix0], src0[ix1], src1[ix0], src1[ix1], fx & 0xffff, fy & 0xffff));
+            fx += dsx;
+            fy += dsy;
+         }
+      }
+   }
+}
+
 
 
 
@@ -35,7 +241,7 @@ public:
    static Surface *LoadFromBytes(const uint8 *inBytes,int inLen);
    bool Encode( nme::ByteArray *outBytes,bool inPNG,double inQuality);
 
-   Surface *IncRef() { mRefCount++; return this; }
+   Surface *IncRef() { Object::IncRef(); return this; }
 
    virtual unsigned int GetFlags() const { return mFlags; }
    virtual void SetFlags(unsigned int inFlags) { mFlags = inFlags; }
@@ -58,6 +264,9 @@ public:
                        uint32 inTint=0xffffff ) const = 0;
    virtual void StretchTo(const RenderTarget &outTarget,
                           const Rect &inSrcRect, const DRect &inDestRect,unsigned int inFlags) const = 0;
+   // Draw the whole surface through an affine matrix (surface pixels -> target pixels), clipped to inClipRect
+   virtual void TransformTo(const RenderTarget &outTarget, const Rect &inClipRect,
+                            const Matrix &inMatrix, bool inSmooth) const { }
    virtual void BlitChannel(const RenderTarget &outTarget, const Rect &inSrcRect,
                             int inPosX, int inPosY,
                             int inSrcChannel, int inDestChannel ) const = 0;
@@ -82,12 +291,17 @@ public:
    virtual void applyFilter(Surface *inSrc, const Rect &inRect, ImagePoint inOffset, Filter *inFilter) { }
 
    virtual void noise(unsigned int randomSeed, unsigned int low, unsigned int high, int channelOptions, bool grayScale) { }
+   virtual void perlinNoise(double baseX, double baseY, int numOctaves, int randomSeed, bool stitch, bool fractalNoise,
+                            int channelOptions, bool grayScale, const QuickVec<float> &offsets) { }
 
    virtual void getFloats32(float *outData, int inStride, PixelFormat pixelFormat, int inTransform, int inSubsample, const Rect &bounds) { }
    virtual void setFloats32(const float *inData, int inStride, PixelFormat pixelFormat, int inTransform, int inExpand, const Rect &bounds) { }
    virtual void getUInts8(uint8 *outData, int inStride, PixelFormat pixelFormat, int inSubsample) { }
    virtual void setUInts8(const uint8 *inData, int inStride, PixelFormat pixelFormat, int inExpand) { }
 
+   // Level 0 is the surface itself, level n is 2^n times smaller - null if unavailable
+   virtual Surface *GetMip(int inLevel) { return inLevel==0 ? this : 0; }
+
    void OnChanged() { mVersion++; }
 
    int Version() const  { return mVersion; }
@@ -134,6 +348,8 @@ public:
 
    void Clear(uint32 inColour,const Rect *inRect);
    void Zero();
+   // All the pixels have changed - invalidates the mips and the whole texture
+   void DirtyAll();
 
    static SimpleSurface *fromStream(ObjectStreamIn &inStream);
    void encodeStream(ObjectStreamOut &stream);
@@ -153,6 +369,9 @@ public:
    virtual void StretchTo(const RenderTarget &outTarget,
                           const Rect &inSrcRect, const DRect &inDestRect,unsigned int inFlags) const;
 
+   virtual void TransformTo(const RenderTarget &outTarget, const Rect &inClipRect,
+                            const Matrix &inMatrix, bool inSmooth) const;
+
    virtual void BlitChannel(const RenderTarget &outTarget, const Rect &inSrcRect,
                             int inPosX, int inPosY,
                             int inSrcChannel, int inDestChannel ) const;
@@ -168,6 +387,8 @@ public:
    void scroll(int inDX,int inDY);
    void applyFilter(Surface *inSrc, const Rect &inRect, ImagePoint inOffset, Filter *inFilter);
    void noise(unsigned int randomSeed, unsigned int low, unsigned int high, int channelOptions, bool grayScale);
+   void perlinNoise(double baseX, double baseY, int numOctaves, int randomSeed, bool stitch, bool fractalNoise,
+                    int channelOptions, bool grayScale, const QuickVec<float> &offsets);
    void getFloats32(float *outData, int inStride, PixelFormat pixelFormat, int inTransform, int inSubsample,const Rect &bounds);
    void setFloats32(const float *inData, int inStride, PixelFormat pixelFormat, int inTransform, int inExpand,const Rect &bounds);
    void getUInts8(uint8 *outData, int inStride, PixelFormat pixelFormat, int inSubsample);
@@ -179,6 +400,8 @@ public:
    
    void MakeTextureOnly();
 
+   Surface *GetMip(int inLevel);
+
 
 protected:
    int           mWidth;
@@ -186,8 +409,12 @@ protected:
    PixelFormat   mPixelFormat;
    int           mStride;
    uint8         *mBase;
+   SimpleSurface *mMip;
+   int           mMipVersion;
    ~SimpleSurface();
 
+   void ReleaseMips();
+
 private:
    SimpleSurface(const SimpleSurface &inRHS);
    void operator=(const SimpleSurface &inRHS);
@@ -6,12 +6,19 @@
 #include <nme/QuickVec.h>
 #include "Font.h"
 #include "Display.h"
-
-class TiXmlNode;
+#include <vector>
 
 namespace nme
 {
 
+// A format setHTMLText derived from 'base' for a tag with the exact text 'key'
+struct HtmlFormat
+{
+   TextFormat *base;
+   WString    key;
+   TextFormat *format;
+};
+
 class TextField : public DisplayObject
 {
 private:
@@ -180,6 +187,8 @@ public:
 
 
    void Render( const RenderTarget &inTarget, const RenderState &inState );
+   // Text graphics are rebuilt inside Render, so there is nothing to pre-build
+   void CollectDirtyGraphics(const Matrix &inMatrix, HardwareRenderer *inHardware, GraphicsPrepassJobs &ioJobs) { }
 
    void GetExtent(const Transform &inTrans, Extent2DF &outExt,bool inForBitmap,bool inIncludeStroke);
    Cursor GetCursor();
@@ -221,7 +230,10 @@ private:
    void Layout() { Layout(GetFullMatrix(true)); }
 
    void Clear();
-   void AddNode(const TiXmlNode *inNode, TextFormat *inFormat, int &ioCharCount);
+   void ClearHtmlFormats();
+
+   // Kept between setHTMLText calls, so text that is set repeatedly shares its formats
+   std::vector<HtmlFormat> mHtmlFormats;
 
    enum StringState { ssNone, ssText, ssHTML };
    StringState mStringState;
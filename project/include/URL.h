@@ -48,6 +48,8 @@ class URLLoader : public Object
 
       static bool processAll();
       static void initialize(const char *inCACertFilePath);
+      // Empty dir disables the on-disk HTTP cache
+      static void setCacheDir(const char *inDir, int inMaxBytes);
 
       virtual ~URLLoader() { };
       virtual URLState getState()=0;
@@ -56,6 +58,8 @@ class URLLoader : public Object
       virtual int      getHttpCode()=0;
       virtual const char *getErrorMessage()=0;
       virtual ByteArray releaseData()=0;
+      // Returns the bytes received since the last call, and stops buffering the whole body
+      virtual ByteArray takeChunk()=0;
       virtual void     getCookies( std::vector<std::string> &outCookies )=0;
       virtual void getResponseHeaders( std::vector<std::string> &outHeaders )=0;
 };
@@ -266,6 +266,41 @@ WString UTF8ToWide(const std::string &inWideString);
 
 double GetTimeStamp();
 
+// Inclusive time spent in each phase, gathered on the main thread while
+//  gNmeProfilePhases is set - used by the benchmark runner
+enum ProfilePhase
+{
+   ppBitmap,
+   ppRender,
+   ppTessellate,
+   ppFilter,
+   ppBlit,
+   ppSIZE,
+};
+
+extern bool gNmeProfilePhases;
+void AddPhaseTime(ProfilePhase inPhase, double inSeconds);
+void GetPhaseTimes(double *outSeconds, int *outCounts);
+void ResetPhaseTimes();
+
+struct AutoPhaseTimer
+{
+   AutoPhaseTimer(ProfilePhase inPhase) : mPhase(inPhase), mActive(gNmeProfilePhases)
+   {
+      if (mActive)
+         mT0 = GetTimeStamp();
+   }
+   ~AutoPhaseTimer()
+   {
+      if (mActive)
+         AddPhaseTime(mPhase, GetTimeStamp()-mT0);
+   }
+
+   ProfilePhase mPhase;
+   bool         mActive;
+   double       mT0;
+};
+
 struct VolumeInfo
 {
    std::string path;
@@ -484,9 +484,9 @@ public:
       int sk;
       DisplayObject *fobj = GetFocusObject();
       if(fobj)
-          sk = fobj->softKeyboard;
+          sk = fobj->getSoftKeyboard();
       else
-          sk = softKeyboard;
+          sk = getSoftKeyboard();
       jmethodID mid = env->GetStaticMethodID(cls, "popupKeyboard", "(ILjava/lang/String;I)V");
       if (mid == 0)
         return;
@@ -28,6 +28,8 @@ BitmapCache::BitmapCache(Surface *inSurface,const Transform &inTrans,
    mMaskOffset = inMask ? ImagePoint(inMask->mTX,inMask->mTY) : ImagePoint(0,0);
    mTX = mTY = 0;
    mHardwareBuffer = 0;
+   mTolerance = 0;
+   mBuiltScaleX = mBuiltScaleY = 1;
 }
 
 BitmapCache::~BitmapCache()
@@ -37,8 +39,47 @@ BitmapCache::~BitmapCache()
 }
 
 
+// Length of the image of a unit vector along the local x or y axis
+static inline double AxisScale(double inA, double inB) { return sqrt(inA*inA + inB*inB); }
+
+static inline bool WithinScale(double inScale, double inBuilt, double inLimit)
+{
+   return inScale*inLimit>=inBuilt && inScale<=inBuilt*inLimit;
+}
+
+Matrix BitmapCache::GetRasterMatrix(const Matrix &inMatrix, double inResolution)
+{
+   double sx = AxisScale(inMatrix.m00,inMatrix.m10)*inResolution;
+   double sy = AxisScale(inMatrix.m01,inMatrix.m11)*inResolution;
+   // Rotation and skew are left to the draw matrix
+   return Matrix( sx>0.001 ? sx : 0.001, sy>0.001 ? sy : 0.001 );
+}
+
+void BitmapCache::SetTransformTolerant(const Matrix &inMatrix, double inTolerance)
+{
+   mTolerance = inTolerance;
+   mBuiltScaleX = AxisScale(inMatrix.m00,inMatrix.m10);
+   mBuiltScaleY = AxisScale(inMatrix.m01,inMatrix.m11);
+   mDrawMatrix = inMatrix.Mult(mMatrix.Inverse());
+}
+
+
 bool BitmapCache::StillGood(const Transform &inTransform, const Rect &inVisiblePixels, BitmapCache *inMask)
 {
+   if (mTolerance>0)
+   {
+      // The whole object is cached, so only the scale matters
+      if (inMask || mScale9!=*inTransform.mScale9)
+         return false;
+      const Matrix &m = *inTransform.mMatrix;
+      double limit = 1.0 + mTolerance;
+      if (!WithinScale(AxisScale(m.m00,m.m10),mBuiltScaleX,limit) ||
+          !WithinScale(AxisScale(m.m01,m.m11),mBuiltScaleY,limit) )
+         return false;
+      mDrawMatrix = m.Mult(mMatrix.Inverse());
+      return true;
+   }
+
    if  (!mMatrix.IsIntTranslation(*inTransform.mMatrix,mTX,mTY) || mScale9!=*inTransform.mScale9)
       return false;
 
@@ -61,8 +102,94 @@ bool BitmapCache::StillGood(const Transform &inTransform, const Rect &inVisibleP
 }
 
 
+static HardwareData *CreateQuadBuffer(Surface *inBitmap, int inTint)
+{
+   HardwareData *result = new HardwareData();
+   result->mElements.resize(1);
+   DrawElement &e = result->mElements[0];
+   memset(&e,0,sizeof(DrawElement));
+   e.mCount = 4;
+   e.mFlags = DRAW_HAS_TEX;
+   e.mPrimType = ptTriangleStrip;
+   e.mVertexOffset = 0;
+   e.mColour = inTint;
+   e.mTexOffset = sizeof(float)*2;
+   e.mStride = sizeof(float)*4;
+
+   e.mSurface = inBitmap;
+   e.mSurface->IncRef();
+   e.mBlendMode = bmNormal;
+
+   // for off-pixel caches?
+   e.mFlags |= DRAW_BMP_SMOOTH;
+
+   result->mArray.resize( e.mCount * e.mStride );
+   return result;
+}
+
+// Pixel co-ordinates within the viewport
+static void SetViewportTransform(Trans4x4 &outTrans, const Rect &inViewport, int inDestX, int inDestY)
+{
+   memset(&outTrans,0,sizeof(outTrans));
+
+   // double, so viewports away from the origin do not truncate the offsets
+   double x0 = inViewport.x;
+   double x1 = inViewport.x1();
+   // upside-down
+   double y0 = inViewport.y1();
+   double y1 = inViewport.y;
+   double mScaleX = 2.0/(x1-x0);
+   double mScaleY = 2.0/(y1-y0);
+   double mOffsetX = (x0+x1)/(x0-x1);
+   double mOffsetY = (y0+y1)/(y0-y1);
+
+   outTrans[0][0] = mScaleX;
+   outTrans[0][3] = mOffsetX + inDestX*mScaleX;
+   outTrans[1][1] = mScaleY;
+   outTrans[1][3] = mOffsetY + inDestY*mScaleY;
+   outTrans[2][2] = 1;
+   outTrans[3][3] = 1;
+}
+
+
 void BitmapCache::Render(const RenderTarget &inTarget,const Rect &inClipRect, const BitmapCache *inMask,BlendMode inBlend)
 {
+   if (mBitmap && mTolerance>0)
+   {
+      // Cached pixels -> target pixels
+      Matrix draw = mDrawMatrix.Mult( Matrix(1,1,mRect.x,mRect.y) );
+
+      if (inTarget.IsHardware())
+      {
+         if (!mHardwareBuffer)
+            mHardwareBuffer = CreateQuadBuffer(mBitmap,0xffffffff);
+
+         UserPoint *p = (UserPoint *)&mHardwareBuffer->mArray[0];
+         Texture *tex = mBitmap->GetTexture(inTarget.mHardware);
+         for(int i=0;i<4;i++)
+         {
+            UserPoint pixel( (i&1) ? mRect.w : 0, (i>1) ? mRect.h : 0 );
+            p[0] = draw.Apply(pixel.x,pixel.y);
+            p[1] = tex->PixelToTex(pixel);
+            p+=2;
+         }
+         mHardwareBuffer->releaseVbo();
+         mLastHardwareSrc = Rect(-1,-1,-1,-1);
+
+         // The viewport does the clipping, as it does for the other hardware draws
+         const Rect vp = inClipRect;
+         if (!vp.HasPixels())
+            return;
+         inTarget.mHardware->SetViewport(vp);
+         Trans4x4 trans;
+         SetViewportTransform(trans,vp,0,0);
+         inTarget.mHardware->RenderData(*mHardwareBuffer,0,trans);
+      }
+      else
+         mBitmap->TransformTo(inTarget, inClipRect, draw, true);
+      return;
+   }
+
    if (mBitmap)
    {
       int tint = 0xffffffff;
@@ -89,28 +216,7 @@ void BitmapCache::Render(const RenderTarget &inTarget,const Rect &inClipRect, co
       if (inTarget.IsHardware())
       {
          if (!mHardwareBuffer)
-         {
-            mHardwareBuffer = new HardwareData();
-            mHardwareBuffer->mElements.resize(1);
-            DrawElement &e = mHardwareBuffer->mElements[0];
-            memset(&e,0,sizeof(DrawElement));
-            e.mCount = 4;
-            e.mFlags = DRAW_HAS_TEX;
-            e.mPrimType = ptTriangleStrip;
-            e.mVertexOffset = 0;
-            e.mColour = tint;
-            e.mTexOffset = sizeof(float)*2;
-            e.mStride = sizeof(float)*4;
-
-            e.mSurface = mBitmap;
-            e.mSurface->IncRef();
-            e.mBlendMode = bmNormal;
-
-            // for off-pixel caches?
-            e.mFlags |= DRAW_BMP_SMOOTH;
-
-            mHardwareBuffer->mArray.resize( e.mCount * e.mStride );
-         }
+            mHardwareBuffer = CreateQuadBuffer(mBitmap,tint);
 
          if (src!=mLastHardwareSrc)
          {
@@ -134,25 +240,7 @@ void BitmapCache::Render(const RenderTarget &inTarget,const Rect &inClipRect, co
          inTarget.mHardware->SetViewport(vp);
          // Pixel co-ordinates...
          Trans4x4 trans;
-         memset(&trans,0,sizeof(trans));
-
-
-         int x0 = vp.x;
-         int x1 = vp.x1();
-         // upside-down
-         int y0 = vp.y1();
-         int y1 = vp.y;
-         double mScaleX = 2.0/(x1-x0);
-         double mScaleY = 2.0/(y1-y0);
-         double mOffsetX = (x0+x1)/(x0-x1);
-         double mOffsetY = (y0+y1)/(y0-y1);
-
-         trans[0][0] = mScaleX;
-         trans[0][3] = mOffsetX + destX*mScaleX;
-         trans[1][1] = mScaleY;
-         trans[1][3] = mOffsetY + destY*mScaleY;
-         trans[2][2] = 1;
-         trans[3][3] = 1;
+         SetViewportTransform(trans,vp,destX,destY);
 
          inTarget.mHardware->RenderData(*mHardwareBuffer,0,trans);
       }
@@ -180,6 +268,14 @@ void BitmapCache::PopTargetOffset(ImagePoint &inBuffer)
 
 bool BitmapCache::HitTest(double inX, double inY)
 {
+   if (mTolerance>0)
+   {
+      UserPoint p = mDrawMatrix.ApplyInverse( UserPoint(inX,inY) );
+      p.x -= mRect.x;
+      p.y -= mRect.y;
+      return p.x>=0 && p.y>=0 && p.x<=mRect.w && p.y<=mRect.h;
+   }
+
    double x0 = mRect.x+mTX;
    double y0 = mRect.y+mTY;
    //printf("BMP hit %f,%f    %f,%f ... %d,%d\n", inX, inY, x0,y0, mRect.w, mRect.h );
@@ -0,0 +1,179 @@
+#include <BufferPool.h>
+#include <NMEThread.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace nme
+{
+
+// 64 bytes to 16Mb - anything bigger goes straight to the system
+enum { MIN_SHIFT = 6, CLASS_COUNT = 19, TRIM_INTERVAL = 120 };
+
+struct PoolClass
+{
+   void *freeList;
+   int  pooled;
+   int  inUse;
+   int  peakInUse;
+};
+
+static PoolClass sClasses[CLASS_COUNT];
+static BufferPoolStats sStats;
+static int sTrimCountdown = TRIM_INTERVAL;
+
+#ifndef HXCPP_JS_PRIME
+// Hardware tessellation runs on the worker threads
+static NmeMutex sPoolLock;
+#define POOL_LOCK NmeAutoMutex poolLock(sPoolLock);
+#else
+#define POOL_LOCK
+#endif
+
+
+static inline int ClassOf(int inBytes)
+{
+   int size = 1<<MIN_SHIFT;
+   for(int c=0;c<CLASS_COUNT;c++)
+   {
+      if (size>=inBytes)
+         return c;
+      size<<=1;
+   }
+   return -1;
+}
+
+static inline int ClassBytes(int inClass) { return 1<<(inClass+MIN_SHIFT); }
+
+
+static void NoteInUse(double inDelta)
+{
+   sStats.bytesInUse += inDelta;
+   if (sStats.bytesInUse>sStats.highWater)
+      sStats.highWater = sStats.bytesInUse;
+}
+
+
+void *PoolAlloc(int inBytes)
+{
+   int c = ClassOf(inBytes);
+
+   POOL_LOCK
+   sStats.allocs++;
+   if (c<0)
+   {
+      NoteInUse(inBytes);
+      return malloc(inBytes);
+   }
+
+   PoolClass &pool = sClasses[c];
+   void *result = pool.freeList;
+   if (result)
+   {
+      pool.freeList = *(void **)result;
+      pool.pooled--;
+      sStats.bytesPooled -= ClassBytes(c);
+      sStats.reused++;
+   }
+   else
+      result = malloc(ClassBytes(c));
+
+   pool.inUse++;
+   if (pool.inUse>pool.peakInUse)
+      pool.peakInUse = pool.inUse;
+   NoteInUse(ClassBytes(c));
+   return result;
+}
+
+
+void PoolFree(void *inPtr, int inBytes)
+{
+   if (!inPtr)
+      return;
+
+   int c = ClassOf(inBytes);
+
+   POOL_LOCK
+   sStats.frees++;
+   if (c<0)
+   {
+      NoteInUse(-inBytes);
+      free(inPtr);
+      return;
+   }
+
+   PoolClass &pool = sClasses[c];
+   *(void **)inPtr = pool.freeList;
+   pool.freeList = inPtr;
+   pool.pooled++;
+   pool.inUse--;
+   sStats.bytesPooled += ClassBytes(c);
+   NoteInUse(-ClassBytes(c));
+}
+
+
+void *PoolRealloc(void *inPtr, int inOldBytes, int inBytes)
+{
+   if (!inPtr)
+      return PoolAlloc(inBytes);
+
+   int oldClass = ClassOf(inOldBytes);
+   int newClass = ClassOf(inBytes);
+   // The common case - a vector being built up one item at a time
+   if (oldClass>=0 && oldClass==newClass)
+      return inPtr;
+
+   if (oldClass<0 && newClass<0)
+   {
+      {
+      POOL_LOCK
+      NoteInUse(inBytes-inOldBytes);
+      }
+      return realloc(inPtr,inBytes);
+   }
+
+   void *result = PoolAlloc(inBytes);
+   memcpy(result, inPtr, inOldBytes<inBytes ? inOldBytes : inBytes);
+   PoolFree(inPtr,inOldBytes);
+   return result;
+}
+
+
+// Keep enough free blocks in each class to get back to the peak usage seen since the
+//  last trim, and release the rest.
+void TrimBufferPool(bool inAll)
+{
+   if (!inAll && --sTrimCountdown>0)
+      return;
+   sTrimCountdown = TRIM_INTERVAL;
+
+   POOL_LOCK
+   for(int c=0;c<CLASS_COUNT;c++)
+   {
+      PoolClass &pool = sClasses[c];
+      int keep = inAll ? 0 : pool.peakInUse - pool.inUse;
+      while(pool.pooled>keep)
+      {
+         void *block = pool.freeList;
+         pool.freeList = *(void **)block;
+         pool.pooled--;
+         sStats.bytesPooled -= ClassBytes(c);
+         sStats.trimmed++;
+         free(block);
+      }
+      pool.peakInUse = pool.inUse;
+   }
+}
+
+
+void GetBufferPoolStats(BufferPoolStats &outStats, bool inReset)
+{
+   POOL_LOCK
+   outStats = sStats;
+   if (inReset)
+   {
+      sStats.allocs = sStats.reused = sStats.frees = sStats.trimmed = 0;
+      sStats.highWater = sStats.bytesInUse;
+   }
+}
+
+} // end namespace nme
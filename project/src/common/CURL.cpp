@@ -1,15 +1,29 @@
+
+
 #define CURL_STATICLIB 1
 #include <URL.h>
 #include <curl/curl.h>
 #include <Utils.h>
+#include <NMEThread.h>
 #include <map>
 #include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <algorithm>
 
 #ifdef HX_WINDOWS
-#include <stdio.h>
 #define snprintf _snprintf
 #endif
 
+// Transfers are driven from a dedicated network thread that sleeps in
+//  curl_multi_poll, so data arrives while the main thread is busy rendering.
+//  Older curl builds (no curl_multi_poll/curl_multi_wakeup) fall back to
+//  polling from URLLoader::processAll.
+#if (LIBCURL_VERSION_NUM >= 0x074400) && !defined(EMSCRIPTEN) && !defined(NME_CURL_NO_THREAD)
+#define NME_CURL_THREAD
+#endif
+
 
 namespace nme
 {
@@ -20,26 +34,283 @@ static CURLM *sCurlM = 0;
 static int sRunning = 0;
 static int sLoaders = 0;
 
-typedef std::map<CURL *,class CURLLoader *> CurlMap;
-typedef std::vector<class CURLLoader *> CurlList;
+// Guards the pending list and the transfer state shared with the main thread
+static NmeMutex sCurlLock;
+
+struct CurlTransfer;
+typedef std::map<CURL *,CurlTransfer *> CurlMap;
+typedef std::vector<CurlTransfer *> CurlList;
 void processMultiMessages();
 
+// Transfers owned by sCurlM - network side only
 CurlMap *sCurlMap = 0;
+// Transfers waiting for a slot - guarded by sCurlLock
 CurlList *sCurlList = 0;
+static int sActive = 0;
 
 enum { MAX_ACTIVE = 64 };
 
-class CURLLoader : public URLLoader
+#ifdef NME_CURL_THREAD
+static bool sCurlThreadStarted = false;
+#endif
+
+
+
+// --- Disk cache -------------------------------------------------------
+//
+// GET responses carrying an ETag or Last-Modified are written to
+//  <dir>/<hash>.body + <hash>.meta, and revalidated with If-None-Match /
+//  If-Modified-Since on the next request.  A 304 is served from disk.
+//  The cache is only touched from the network side.
+
+struct CacheEntry
+{
+   int size;
+   int lastUsed;
+};
+typedef std::map<std::string,CacheEntry> CacheIndex;
+
+static std::string sCacheDir;
+static int         sCacheMaxBytes = 0;
+static int         sCacheBytes = 0;
+static int         sCacheClock = 0;
+static CacheIndex  *sCacheIndex = 0;
+
+// Set from the main thread, picked up by the network side - guarded by sCurlLock
+static std::string sNewCacheDir;
+static int         sNewCacheMaxBytes = 0;
+static bool        sCacheConfigChanged = false;
+
+
+static std::string CacheKey(const std::string &inUrl)
+{
+   unsigned int h0 = 2166136261U;
+   unsigned int h1 = 0x811c9dc5U ^ 0x5bd1e995U;
+   for(int i=0;i<inUrl.size();i++)
+   {
+      unsigned char c = inUrl[i];
+      h0 = (h0 ^ c) * 16777619U;
+      h1 = (h1 ^ c) * 16777619U;
+   }
+   char buf[20];
+   snprintf(buf,sizeof(buf),"%08x%08x",h0,h1);
+   return buf;
+}
+
+static std::string CachePath(const std::string &inKey, const char *inExt)
+{
+   return sCacheDir + "/" + inKey + inExt;
+}
+
+static void SaveCacheIndex()
+{
+   std::string path = sCacheDir + "/nmecache.idx";
+   FILE *f = fopen(path.c_str(),"wb");
+   if (!f)
+      return;
+   for(CacheIndex::iterator i=sCacheIndex->begin();i!=sCacheIndex->end();++i)
+      fprintf(f,"%s %d %d\n", i->first.c_str(), i->second.size, i->second.lastUsed);
+   fclose(f);
+}
+
+static void LoadCacheIndex()
+{
+   if (!sCacheIndex)
+      sCacheIndex = new CacheIndex;
+   sCacheIndex->clear();
+   sCacheBytes = 0;
+   sCacheClock = 0;
+
+   std::string path = sCacheDir + "/nmecache.idx";
+   FILE *f = fopen(path.c_str(),"rb");
+   if (!f)
+      return;
+   char key[64];
+   CacheEntry entry;
+   while(fscanf(f,"%32s %d %d",key,&entry.size,&entry.lastUsed)==3)
+   {
+      (*sCacheIndex)[key] = entry;
+      sCacheBytes += entry.size;
+      if (entry.lastUsed>sCacheClock)
+         sCacheClock = entry.lastUsed;
+   }
+   fclose(f);
+}
+
+static void CacheRemove(const std::string &inKey)
+{
+   CacheIndex::iterator i = sCacheIndex->find(inKey);
+   if (i!=sCacheIndex->end())
+   {
+      sCacheBytes -= i->second.size;
+      sCacheIndex->erase(i);
+   }
+   remove(CachePath(inKey,".body").c_str());
+   remove(CachePath(inKey,".meta").c_str());
+}
+
+// Evict least-recently-used entries until inExtra more bytes fit
+static void TrimCache(int inExtra)
+{
+   while(sCacheBytes+inExtra>sCacheMaxBytes && !sCacheIndex->empty())
+   {
+      CacheIndex::iterator oldest = sCacheIndex->begin();
+      for(CacheIndex::iterator i=sCacheIndex->begin();i!=sCacheIndex->end();++i)
+         if (i->second.lastUsed<oldest->second.lastUsed)
+            oldest = i;
+      std::string key = oldest->first;
+      CacheRemove(key);
+   }
+}
+
+static void ApplyCacheConfig()
+{
+   {
+      NmeAutoMutex lock(sCurlLock);
+      if (!sCacheConfigChanged)
+         return;
+      sCacheConfigChanged = false;
+      sCacheDir = sNewCacheDir;
+      sCacheMaxBytes = sNewCacheMaxBytes;
+   }
+   if (sCacheDir.empty())
+   {
+      delete sCacheIndex;
+      sCacheIndex = 0;
+   }
+   else
+   {
+      LoadCacheIndex();
+      TrimCache(0);
+   }
+}
+
+static bool CacheLookup(const std::string &inKey, std::string &outETag, std::string &outLastModified)
+{
+   if (!sCacheIndex || sCacheIndex->find(inKey)==sCacheIndex->end())
+      return false;
+   FILE *f = fopen(CachePath(inKey,".meta").c_str(),"rb");
+   if (!f)
+      return false;
+   char line[1024];
+   if (fgets(line,sizeof(line),f))
+      outETag = std::string(line,strcspn(line,"\r\n"));
+   if (fgets(line,sizeof(line),f))
+      outLastModified = std::string(line,strcspn(line,"\r\n"));
+   fclose(f);
+   return !outETag.empty() || !outLastModified.empty();
+}
+
+static bool CacheLoad(const std::string &inKey, QuickVec<unsigned char> &outBytes)
+{
+   FILE *f = fopen(CachePath(inKey,".body").c_str(),"rb");
+   if (!f)
+      return false;
+   fseek(f,0,SEEK_END);
+   int len = ftell(f);
+   fseek(f,0,SEEK_SET);
+   outBytes.resize(len);
+   bool ok = len==0 || fread(&outBytes[0],1,len,f)==len;
+   fclose(f);
+
+   CacheIndex::iterator i = sCacheIndex->find(inKey);
+   if (ok && i!=sCacheIndex->end())
+      i->second.lastUsed = ++sCacheClock;
+   return ok;
+}
+
+static void CacheStore(const std::string &inKey, const std::string &inTmpFile, int inSize,
+                       const std::string &inETag, const std::string &inLastModified)
+{
+   CacheRemove(inKey);
+   if (inSize>sCacheMaxBytes)
+   {
+      remove(inTmpFile.c_str());
+      return;
+   }
+   TrimCache(inSize);
+
+   FILE *f = fopen(CachePath(inKey,".meta").c_str(),"wb");
+   if (!f || rename(inTmpFile.c_str(),CachePath(inKey,".body").c_str())!=0)
+   {
+      if (f)
+         fclose(f);
+      remove(inTmpFile.c_str());
+      remove(CachePath(inKey,".meta").c_str());
+      return;
+   }
+   fprintf(f,"%s\n%s\n",inETag.c_str(),inLastModified.c_str());
+   fclose(f);
+
+   CacheEntry entry;
+   entry.size = inSize;
+   entry.lastUsed = ++sCacheClock;
+   (*sCacheIndex)[inKey] = entry;
+   sCacheBytes += inSize;
+   SaveCacheIndex();
+}
+
+
+static bool HeaderIs(const char *inLine, int inLen, const char *inName)
+{
+   int n = strlen(inName);
+   if (inLen<=n || inLine[n]!=':')
+      return false;
+   for(int i=0;i<n;i++)
+      if (tolower(inLine[i])!=inName[i])
+         return false;
+   return true;
+}
+
+static std::string HeaderValue(const char *inLine, int inLen)
+{
+   const char *colon = (const char *)memchr(inLine,':',inLen);
+   if (!colon)
+      return "";
+   const char *start = colon+1;
+   const char *end = inLine+inLen;
+   while(start<end && (*start==' ' || *start=='\t'))
+      start++;
+   while(end>start && (end[-1]=='\r' || end[-1]=='\n' || end[-1]==' '))
+      end--;
+   return std::string(start,end-start);
+}
+
+
+
+// --- CurlTransfer -----------------------------------------------------
+//
+// The curl side of a load.  It is separate from the CURLLoader object so the
+//  network thread can keep running callbacks after the loader has been
+//  collected - an orphaned transfer is cleaned up by the network side.
+
+struct CurlTransfer
 {
-public:
    CURL *mHandle;
+
+   // Shared with the main thread - guarded by sCurlLock
    int mBytesLoaded;
    int mBytesTotal;
    URLState mState;
    int mHttpCode;
-   char mErrorBuf[CURL_ERROR_SIZE];
+   bool mOrphaned;
+   bool mStreaming;
+   bool mActive;
    QuickVec<unsigned char> mBytes;
    std::vector<std::string> mResponseHeaders;
+   std::vector<std::string> mCookies;
+   char mErrorBuf[CURL_ERROR_SIZE];
+
+   // Network side only
+   std::string mUrl;
+   bool        mCacheable;
+   bool        mRevalidating;
+   std::string mCacheKey;
+   std::string mCacheTmp;
+   FILE        *mCacheFile;
+   int         mCacheFileSize;
+   std::string mETag;
+   std::string mLastModified;
 
    size_t         mBufferRemaining;
    unsigned char *mBufferPos;
@@ -47,18 +318,22 @@ public:
 
    struct curl_slist *headerlist;
 
-   CURLLoader(URLRequest &r)
+   CurlTransfer(URLRequest &r)
    {
       mState = urlInit;
-      if (!sCurlM)
-         sCurlM = curl_multi_init();
       mBytesTotal = -1;
       mBytesLoaded = 0;
       mHttpCode = 0;
-      sLoaders++;
+      mOrphaned = false;
+      mStreaming = false;
+      mActive = false;
       mHandle = curl_easy_init();
-      if (!sCurlMap)
-         sCurlMap = new CurlMap;
+
+      mUrl = r.url;
+      mCacheable = false;
+      mRevalidating = false;
+      mCacheFile = 0;
+      mCacheFileSize = 0;
 
       mBufferRemaining = 0;
       mPutBuffer = 0;
@@ -67,7 +342,7 @@ public:
 
       curl_easy_setopt(mHandle, CURLOPT_URL, r.url);
 
-      /* send all data to this function  */ 
+      /* send all data to this function  */
       curl_easy_setopt(mHandle, CURLOPT_WRITEFUNCTION, staticOnData);
       curl_easy_setopt(mHandle, CURLOPT_WRITEDATA, (void *)this);
 
@@ -75,36 +350,36 @@ public:
       curl_easy_setopt(mHandle, CURLOPT_HEADERDATA, (void *)this);
 
       curl_easy_setopt(mHandle, CURLOPT_NOPROGRESS, 0);
-      
+
       if (r.followRedirects)
          curl_easy_setopt(mHandle, CURLOPT_FOLLOWLOCATION, 1);
-      
+
       if (r.authType!=0)
       {
          curl_easy_setopt(mHandle, CURLOPT_HTTPAUTH, r.authType);
          if (r.credentials && r.credentials[0])
             curl_easy_setopt(mHandle, CURLOPT_USERPWD, r.credentials);
-      } 
-      
+      }
+
       curl_easy_setopt(mHandle, CURLOPT_PROGRESSFUNCTION, staticOnProgress);
       curl_easy_setopt(mHandle, CURLOPT_PROGRESSDATA, (void *)this);
       curl_easy_setopt(mHandle, CURLOPT_ERRORBUFFER, mErrorBuf );
-      
+
       if (r.debug)
          curl_easy_setopt(mHandle, CURLOPT_VERBOSE, 1);
-      
+
       curl_easy_setopt( mHandle, CURLOPT_COOKIEFILE, "" );
-      
+
       if (r.cookies && r.cookies[0])
          curl_easy_setopt( mHandle, CURLOPT_COOKIE, r.cookies );
-      
+
       if (sCACertFile.empty())
          curl_easy_setopt(mHandle, CURLOPT_SSL_VERIFYPEER, false);
       else
          curl_easy_setopt(mHandle, CURLOPT_CAINFO, sCACertFile.c_str());
 
       if (r.method)
-      { 
+      {
          if (!strcmp(r.method,"POST"))
          {
             curl_easy_setopt(mHandle, CURLOPT_POST, true);
@@ -123,11 +398,12 @@ public:
             curl_easy_setopt(mHandle, CURLOPT_UPLOAD, 1);
             if (r.postData.Ok())
                SetPutBuffer(r.postData.Bytes(),r.postData.Size());
-         } 
+         }
          else if (!strcmp(r.method,"GET"))
          {
             // GET is the default, so this is not necessary but here for completeness.
             curl_easy_setopt(mHandle, CURLOPT_HTTPGET, true);
+            mCacheable = !r.postData.Ok() || r.postData.Size()==0;
          }
          else if (!strcmp(r.method,"DELETE"))
          {
@@ -138,6 +414,8 @@ public:
            // unsupported method !!
          }
       }
+      else
+         mCacheable = !r.postData.Ok() || r.postData.Size()==0;
 
       if (r.contentType)
       {
@@ -171,17 +449,19 @@ public:
       curl_easy_setopt(mHandle, CURLOPT_USERAGENT, userAgent);
 
       mState = urlLoading;
+   }
 
-      if (sCurlMap->size()<MAX_ACTIVE)
-      {
-         StartProcessing();
-      }
-      else
+   ~CurlTransfer()
+   {
+      if (mCacheFile)
       {
-         if (sCurlList==0)
-            sCurlList = new CurlList;
-         sCurlList->push_back(this);
+         fclose(mCacheFile);
+         remove(mCacheTmp.c_str());
       }
+      delete [] mPutBuffer;
+      curl_easy_cleanup(mHandle);
+      if (headerlist)
+         curl_slist_free_all(headerlist);
    }
 
    size_t ReadFunc( void *ptr, size_t size, size_t nmemb)
@@ -199,7 +479,7 @@ public:
 
    static size_t SReadFunc( void *ptr, size_t size, size_t nmemb, void *userdata)
    {
-      return ((CURLLoader *)userdata)->ReadFunc(ptr,size,nmemb);
+      return ((CurlTransfer *)userdata)->ReadFunc(ptr,size,nmemb);
    }
 
    void SetPutBuffer(const unsigned char *inBuffer, size_t inLen)
@@ -213,26 +493,26 @@ public:
       curl_easy_setopt(mHandle, CURLOPT_INFILESIZE, inLen);
    }
 
+   // Network side: attach cache validators and hand the handle to sCurlM
    void StartProcessing()
    {
-      (*sCurlMap)[mHandle] = this;
-      //int c1 = curl_multi_add_handle(sCurlM,mHandle);
-      curl_multi_add_handle(sCurlM,mHandle);
-      //int result = curl_multi_perform(sCurlM, &sRunning);
-      curl_multi_perform(sCurlM, &sRunning);
-      processMultiMessages();
-   }
-
-   ~CURLLoader()
-   {
-      delete [] mPutBuffer;
-      curl_easy_cleanup(mHandle);
-      sLoaders--;
-      if (sLoaders==0)
+      if (mCacheable && sCacheIndex)
       {
-         curl_multi_cleanup(sCurlM);
-         sCurlM = 0;
+         mCacheKey = CacheKey(mUrl);
+         std::string etag, lastModified;
+         if (CacheLookup(mCacheKey,etag,lastModified))
+         {
+            if (!etag.empty())
+               headerlist = curl_slist_append(headerlist, ("If-None-Match: " + etag).c_str());
+            if (!lastModified.empty())
+               headerlist = curl_slist_append(headerlist, ("If-Modified-Since: " + lastModified).c_str());
+            curl_easy_setopt(mHandle, CURLOPT_HTTPHEADER, headerlist);
+            mRevalidating = true;
+         }
       }
+
+      (*sCurlMap)[mHandle] = this;
+      curl_multi_add_handle(sCurlM,mHandle);
    }
 
    size_t onData( void *inBuffer, size_t inItemSize, size_t inItems)
@@ -240,133 +520,410 @@ public:
       size_t size = inItemSize*inItems;
       if (size>0)
       {
+         if (mCacheFile)
+         {
+            if (fwrite(inBuffer,1,size,mCacheFile)==size)
+               mCacheFileSize += size;
+            else
+            {
+               fclose(mCacheFile);
+               mCacheFile = 0;
+               remove(mCacheTmp.c_str());
+            }
+         }
+
+         NmeAutoMutex lock(sCurlLock);
          int s = mBytes.size();
+         // Grow geometrically - resize alone reallocates to the exact size every packet
+         if (s+size > mBytes.Mem())
+            mBytes.reserve( std::max( (int)(s+size), mBytes.Mem()*2 ) );
          mBytes.resize(s+size);
          memcpy(&mBytes[s],inBuffer,size);
       }
-      return inItems;
+      return size;
    }
-   
+
    size_t onHeader( void *inBuffer, size_t inItemSize, size_t inItems )
    {
       size_t size = inItemSize*inItems;
       if (size>0)
       {
+         const char *line = (const char *)inBuffer;
          std::string s = "";
-         s.append((char *)inBuffer, size);
+         s.append(line, size);
+
+         NmeAutoMutex lock(sCurlLock);
+         if (size>5 && !strncmp(line,"HTTP/",5))
+         {
+            // New response (redirects produce several) - forget the previous validators
+            mETag = "";
+            mLastModified = "";
+            const char *code = strchr(line,' ');
+            if (code)
+               mHttpCode = atoi(code+1);
+         }
+         else if (HeaderIs(line,size,"etag"))
+            mETag = HeaderValue(line,size);
+         else if (HeaderIs(line,size,"last-modified"))
+            mLastModified = HeaderValue(line,size);
+         else if (HeaderIs(line,size,"content-length") && !mStreaming)
+         {
+            int len = atoi(HeaderValue(line,size).c_str());
+            if (len>0 && len<(1<<28))
+               mBytes.reserve(len);
+         }
+         else if (size<=2 && mHttpCode==200 && mCacheable && sCacheIndex && !mCacheFile &&
+                   (!mETag.empty() || !mLastModified.empty()) )
+         {
+            // End of headers for a cacheable response - mirror the body to disk
+            mCacheTmp = CachePath(mCacheKey.empty() ? (mCacheKey=CacheKey(mUrl)) : mCacheKey,".tmp");
+            mCacheFile = fopen(mCacheTmp.c_str(),"wb");
+            mCacheFileSize = 0;
+         }
          mResponseHeaders.push_back(s);
       }
       return size;
    }
 
-   int onProgress( double inBytesTotal, double inBytesDownloaded, 
+   int onProgress( double inBytesTotal, double inBytesDownloaded,
                     double inUploadTotal, double inBytesUploaded )
    {
+      NmeAutoMutex lock(sCurlLock);
       mBytesTotal = inBytesTotal;
       mBytesLoaded = inBytesDownloaded;
       return 0;
    }
 
-   void setResult(CURLcode inResult)
+   // Network side - returns true if the loader has gone and the transfer should be deleted
+   bool setResult(CURLcode inResult)
    {
       sCurlMap->erase(mHandle);
       curl_multi_remove_handle(sCurlM,mHandle);
+
+      long http_code = 0;
+      curl_easy_getinfo(mHandle,CURLINFO_RESPONSE_CODE,&http_code);
+
+      std::vector<std::string> cookies;
+      curl_slist *list = 0;
+      if (CURLE_OK == curl_easy_getinfo(mHandle,CURLINFO_COOKIELIST,&list) && list)
+      {
+         curl_slist *item = list;
+         while(item)
+         {
+            cookies.push_back(item->data);
+            item = item->next;
+         }
+         curl_slist_free_all(list);
+      }
+
+      QuickVec<unsigned char> cached;
+      bool fromCache = false;
+      if (mCacheFile)
+      {
+         fclose(mCacheFile);
+         mCacheFile = 0;
+         if (inResult==0 && http_code==200)
+            CacheStore(mCacheKey,mCacheTmp,mCacheFileSize,mETag,mLastModified);
+         else
+            remove(mCacheTmp.c_str());
+      }
+      else if (inResult==0 && http_code==304 && mRevalidating && sCacheIndex)
+      {
+         fromCache = CacheLoad(mCacheKey,cached);
+         if (fromCache)
+            SaveCacheIndex();
+      }
+
+      NmeAutoMutex lock(sCurlLock);
+      mActive = false;
+      sActive--;
+      mCookies.swap(cookies);
+      // XXX : A HTTP code >= 400 should be an error. Handle this in URLLoader.hx for now.
+      if (http_code>0)
+         mHttpCode = http_code;
+      if (fromCache)
+      {
+         mBytes.swap(cached);
+         mBytesLoaded = mBytesTotal = mBytes.size();
+         mHttpCode = 200;
+      }
       mState = inResult==0 ? urlComplete : urlError;
+      return mOrphaned;
    }
 
 
    static size_t staticOnData( void *inBuffer, size_t size, size_t inItems, void *userdata)
    {
-      return ((CURLLoader *)userdata)->onData(inBuffer,size,inItems);
+      return ((CurlTransfer *)userdata)->onData(inBuffer,size,inItems);
    }
-   
+
    static size_t staticOnHeader( void *inBuffer, size_t size, size_t inItems, void *userdata)
    {
-      return ((CURLLoader *)userdata)->onHeader(inBuffer,size,inItems);
+      return ((CurlTransfer *)userdata)->onHeader(inBuffer,size,inItems);
    }
 
-   static size_t staticOnProgress(void* inCookie, double inBytesTotal, double inBytesDownloaded, 
+   static size_t staticOnProgress(void* inCookie, double inBytesTotal, double inBytesDownloaded,
                     double inUploadTotal, double inBytesUploaded)
 
    {
-      return ((CURLLoader *)inCookie)->onProgress(
+      return ((CurlTransfer *)inCookie)->onProgress(
          inBytesTotal,inBytesDownloaded,inUploadTotal,inBytesUploaded);
    }
+};
 
-   void getCookies( std::vector<std::string> &outCookies )
+
+
+// Network side: drop transfers whose loader has gone
+static void RemoveOrphans()
+{
+   if (!sCurlMap)
+      return;
+   std::vector<CurlTransfer *> dead;
    {
-      curl_slist *list = 0;
-      if (CURLE_OK == curl_easy_getinfo(mHandle,CURLINFO_COOKIELIST,&list) && list)
+      NmeAutoMutex lock(sCurlLock);
+      for(CurlMap::iterator i=sCurlMap->begin();i!=sCurlMap->end();++i)
+         if (i->second->mOrphaned)
+            dead.push_back(i->second);
+      sActive -= dead.size();
+   }
+   for(int i=0;i<dead.size();i++)
+   {
+      sCurlMap->erase(dead[i]->mHandle);
+      curl_multi_remove_handle(sCurlM,dead[i]->mHandle);
+      delete dead[i];
+   }
+}
+
+// Network side: move queued transfers into free slots
+static bool StartPending()
+{
+   bool added = false;
+   while(true)
+   {
+      CurlTransfer *transfer = 0;
       {
-         curl_slist *item = list;
-         while(item)
+         NmeAutoMutex lock(sCurlLock);
+         if (!sCurlList || sCurlList->empty() || sCurlMap->size()>=MAX_ACTIVE)
+            break;
+         transfer = (*sCurlList)[0];
+         sCurlList->erase(sCurlList->begin());
+         if (transfer->mOrphaned)
          {
-            outCookies.push_back(item->data);
-            item = item->next;
+            delete transfer;
+            continue;
          }
-         curl_slist_free_all(list);
+         transfer->mActive = true;
+         sActive++;
+      }
+      transfer->StartProcessing();
+      added = true;
+   }
+   return added;
+}
+
+void processMultiMessages()
+{
+   int remaining;
+   CURLMsg *msg;
+   while( (msg=curl_multi_info_read(sCurlM,&remaining) ) )
+   {
+      if (msg->msg==CURLMSG_DONE)
+      {
+         CurlMap::iterator i = sCurlMap->find(msg->easy_handle);
+         if (i!=sCurlMap->end())
+         {
+            CurlTransfer *transfer = i->second;
+            if (transfer->setResult( msg->data.result ))
+               delete transfer;
+         }
+      }
+   }
+}
+
+
+#ifdef NME_CURL_THREAD
+static THREAD_FUNC_TYPE SCurlThreadLoop( void * )
+{
+   while(true)
+   {
+      ApplyCacheConfig();
+      RemoveOrphans();
+      StartPending();
+      curl_multi_perform(sCurlM,&sRunning);
+      processMultiMessages();
+      // Sleeps until there is socket activity or curl_multi_wakeup is called
+      curl_multi_poll(sCurlM,0,0,1000,0);
+   }
+   THREAD_FUNC_RET;
+}
+
+static void StartCurlThread()
+{
+   if (sCurlThreadStarted)
+      return;
+   sCurlThreadStarted = true;
+   sCurlM = curl_multi_init();
+   sCurlMap = new CurlMap;
+   #ifdef NME_PTHREADS
+   pthread_t result = 0;
+   pthread_create(&result,0,SCurlThreadLoop,0);
+   pthread_detach(result);
+   #else
+   HxCreateDetachedThread(SCurlThreadLoop,0);
+   #endif
+}
+#endif
+
+
+
+// --- CURLLoader -------------------------------------------------------
+
+class CURLLoader : public URLLoader
+{
+public:
+   CurlTransfer *mTransfer;
+
+   CURLLoader(URLRequest &r)
+   {
+      #ifdef NME_CURL_THREAD
+      StartCurlThread();
+      #else
+      if (!sCurlM)
+         sCurlM = curl_multi_init();
+      if (!sCurlMap)
+         sCurlMap = new CurlMap;
+      #endif
+      sLoaders++;
+
+      mTransfer = new CurlTransfer(r);
+
+      {
+         NmeAutoMutex lock(sCurlLock);
+         if (sCurlList==0)
+            sCurlList = new CurlList;
+         sCurlList->push_back(mTransfer);
+      }
+
+      #ifdef NME_CURL_THREAD
+      curl_multi_wakeup(sCurlM);
+      #else
+      ApplyCacheConfig();
+      if (StartPending())
+      {
+         curl_multi_perform(sCurlM, &sRunning);
+         processMultiMessages();
+      }
+      #endif
+   }
+
+   ~CURLLoader()
+   {
+      bool owned;
+      {
+         NmeAutoMutex lock(sCurlLock);
+         mTransfer->mOrphaned = true;
+         owned = !mTransfer->mActive;
+         if (owned && sCurlList)
+            for(int i=0;i<sCurlList->size();i++)
+               if ( (*sCurlList)[i]==mTransfer )
+               {
+                  sCurlList->erase(sCurlList->begin()+i);
+                  break;
+               }
+      }
+
+      #ifdef NME_CURL_THREAD
+      if (owned)
+         delete mTransfer;
+      else
+         curl_multi_wakeup(sCurlM);
+      sLoaders--;
+      #else
+      if (!owned)
+         RemoveOrphans();
+      else
+         delete mTransfer;
+      sLoaders--;
+      if (sLoaders==0)
+      {
+         curl_multi_cleanup(sCurlM);
+         sCurlM = 0;
       }
+      #endif
+   }
+
+   void getCookies( std::vector<std::string> &outCookies )
+   {
+      NmeAutoMutex lock(sCurlLock);
+      outCookies.insert(outCookies.end(), mTransfer->mCookies.begin(), mTransfer->mCookies.end());
    }
-   
+
    void getResponseHeaders( std::vector<std::string> &outHeaders )
    {
-      for(std::vector<int>::size_type i = 0; i != mResponseHeaders.size(); i++)
+      NmeAutoMutex lock(sCurlLock);
+      for(std::vector<int>::size_type i = 0; i != mTransfer->mResponseHeaders.size(); i++)
       {
-         std::string value = mResponseHeaders[i];
+         std::string value = mTransfer->mResponseHeaders[i];
          outHeaders.push_back(value);
       }
    }
-      
+
 
    URLState getState()
    {
-      long http_code = 0;
-      int curl_code = curl_easy_getinfo(mHandle,CURLINFO_RESPONSE_CODE,&http_code);
-      if (curl_code != CURLE_OK)
-         mState = urlError;
-      else if (http_code>0)
-      {
-         // XXX : A HTTP code >= 400 should be an error. Handle this in URLLoader.hx for now.
-         mHttpCode = http_code;
-      }
-      return mState;
+      NmeAutoMutex lock(sCurlLock);
+      return mTransfer->mState;
    }
 
-   int bytesLoaded() { return mBytesLoaded; }
-   int bytesTotal() { return mBytesTotal; }
+   int bytesLoaded() { NmeAutoMutex lock(sCurlLock); return mTransfer->mBytesLoaded; }
+   int bytesTotal() { NmeAutoMutex lock(sCurlLock); return mTransfer->mBytesTotal; }
+
+   virtual int getHttpCode() { NmeAutoMutex lock(sCurlLock); return mTransfer->mHttpCode; }
 
-   virtual int getHttpCode() { return mHttpCode; }
+   virtual const char *getErrorMessage() { return mTransfer->mErrorBuf; }
 
-   virtual const char *getErrorMessage() { return mErrorBuf; }
    virtual ByteArray releaseData()
    {
-      if (mBytes.size())
+      NmeAutoMutex lock(sCurlLock);
+      if (mTransfer->mBytes.size())
       {
-         return ByteArray(mBytes);
+         ByteArray result(mTransfer->mBytes);
+         mTransfer->mBytes.clear();
+         return result;
       }
       return ByteArray();
    }
 
-
-};
-
-void processMultiMessages()
-{
-   int remaining;
-   CURLMsg *msg;
-   while( (msg=curl_multi_info_read(sCurlM,&remaining) ) )
+   virtual ByteArray takeChunk()
    {
-      if (msg->msg==CURLMSG_DONE)
+      NmeAutoMutex lock(sCurlLock);
+      mTransfer->mStreaming = true;
+      QuickVec<unsigned char> &bytes = mTransfer->mBytes;
+      if (bytes.size())
       {
-         CurlMap::iterator i = sCurlMap->find(msg->easy_handle);
-         if (i!=sCurlMap->end())
-            i->second->setResult( msg->data.result );
+         ByteArray result(bytes);
+         // Drop any Content-Length preallocation - chunks stay small from here on
+         if (bytes.Mem()>(1<<20))
+            bytes.clear();
+         else
+            bytes.resize(0);
+         return result;
       }
+      return ByteArray();
    }
-}
+};
+
+
 
 bool URLLoader::processAll()
 {
+   #ifdef NME_CURL_THREAD
+   NmeAutoMutex lock(sCurlLock);
+   return sActive || (sCurlList && sCurlList->size());
+   #else
+   if (!sCurlM)
+      return false;
+   ApplyCacheConfig();
    bool added = false;
    do {
       added = false;
@@ -380,17 +937,17 @@ bool URLLoader::processAll()
       if (check) {
          processMultiMessages();
       }
-      while(sCurlMap && sCurlList && !sCurlList->empty() && sCurlMap->size()<MAX_ACTIVE )
+      if (StartPending())
       {
-         CURLLoader *curl = (*sCurlList)[0];
-         sCurlList->erase(sCurlList->begin());
          added = true;
-         curl->StartProcessing();
+         curl_multi_perform(sCurlM, &sRunning);
+         processMultiMessages();
       }
 
    } while(added);
-   
+
    return sRunning || (sCurlList && sCurlList->size());
+   #endif
 }
 
 URLLoader *URLLoader::create(URLRequest &r)
@@ -398,6 +955,14 @@ URLLoader *URLLoader::create(URLRequest &r)
    return new CURLLoader(r);
 }
 
+void URLLoader::setCacheDir(const char *inDir, int inMaxBytes)
+{
+   NmeAutoMutex lock(sCurlLock);
+   sNewCacheDir = inDir ? inDir : "";
+   sNewCacheMaxBytes = inMaxBytes;
+   sCacheConfigChanged = true;
+}
+
 typedef int (*get_file_callback_func)(const char *filename, unsigned char **buf);
 extern "C"
 {
@@ -416,7 +981,7 @@ static int sGetFile(const char *inFilename, unsigned char **outBuf)
    #else
    ByteArray bytes = ByteArray::FromFile(inFilename);
    #endif
-   
+
    ELOG("Loaded cert %s %d bytes.", inFilename, bytes.Size());
    if (bytes.Size()>0)
    {
@@ -1,4 +1,5 @@
 #include <CachedExtent.h>
+#include <algorithm>
 
 namespace nme
 {
@@ -23,10 +24,153 @@ Extent2DF CachedExtent::Get(const Transform &inTransform)
    return result;
 }
 
+// --- ExtentHull --------------------------------------
+
+static bool HullPointLess(const UserPoint &inA, const UserPoint &inB)
+{
+   return inA.x<inB.x || (inA.x==inB.x && inA.y<inB.y);
+}
+
+static inline double HullCross(const UserPoint &inO, const UserPoint &inA, const UserPoint &inB)
+{
+   return (double)(inA.x-inO.x)*(inB.y-inO.y) - (double)(inA.y-inO.y)*(inB.x-inO.x);
+}
+
+// Same as PolygonRender::CurveExtent, on points that have already been transformed
+static void AddCurveExtent(Extent2DF &ioExtent, const UserPoint &p0, const UserPoint &p1, const UserPoint &p2)
+{
+   double denom = p2.x + p0.x - 2 * p1.x;
+   if (denom != 0)
+   {
+      double t = (p0.x - p1.x) / denom;
+      if (t > 0 && t < 1)
+         ioExtent.AddX((1 - t) * (1 - t) * p0.x + (2 * t * (1 - t) * p1.x) + (t * t * p2.x));
+   }
+
+   denom = p2.y + p0.y - 2 * p1.y;
+   if (denom != 0)
+   {
+      double t = (p0.y - p1.y) / denom;
+      if (t > 0 && t < 1)
+         ioExtent.AddY((1 - t) * (1 - t) * p0.y + (2 * t * (1 - t) * p1.y) + t * t * p2.y);
+   }
+}
+
+void ExtentHull::AddCurve(const UserPoint &inP0, const UserPoint &inP1, const UserPoint &inP2)
+{
+   mPoints.push_back(inP0);
+   mPoints.push_back(inP2);
+   mCurves.push_back(inP0);
+   mCurves.push_back(inP1);
+   mCurves.push_back(inP2);
+}
+
+void ExtentHull::Build()
+{
+   mState = hullReady;
+   int n = mPoints.size();
+   if (n>2)
+   {
+      // Monotone chain, counter-clockwise
+      std::sort(mPoints.begin(), mPoints.end(), HullPointLess);
+      QuickVec<UserPoint> hull;
+      hull.resize(n*2);
+      int k = 0;
+      for(int i=0;i<n;i++)
+      {
+         while(k>=2 && HullCross(hull[k-2],hull[k-1],mPoints[i])<=0)
+            k--;
+         hull[k++] = mPoints[i];
+      }
+      for(int i=n-2, lower=k+1; i>=0; i--)
+      {
+         while(k>=lower && HullCross(hull[k-2],hull[k-1],mPoints[i])<=0)
+            k--;
+         hull[k++] = mPoints[i];
+      }
+      hull.resize(k-1);
+      mPoints.swap(hull);
+   }
+
+   // A curve lies inside the triangle of its control points, so if the middle one is
+   //  inside the hull, the curve can not affect the extent
+   int hullSize = mPoints.size();
+   if (hullSize>2)
+   {
+      int kept = 0;
+      for(int c=0;c<mCurves.size();c+=3)
+      {
+         const UserPoint &control = mCurves[c+1];
+         bool inside = true;
+         for(int i=0;i<hullSize && inside;i++)
+            if (HullCross(mPoints[i], mPoints[(i+1)%hullSize], control)<0)
+               inside = false;
+         if (!inside)
+         {
+            for(int i=0;i<3;i++)
+               mCurves[kept++] = mCurves[c+i];
+         }
+      }
+      mCurves.resize(kept);
+   }
+}
+
+void ExtentHull::GetExtent(const Matrix &inMatrix, Extent2DF &ioExtent) const
+{
+   int n = mPoints.size();
+   if (n==0)
+      return;
+
+   // Plain loops over the hull so the compiler can keep everything in registers
+   const UserPoint *p = &mPoints[0];
+   double m00 = inMatrix.m00, m01 = inMatrix.m01, m10 = inMatrix.m10, m11 = inMatrix.m11;
+   double minX = m00*p[0].x + m01*p[0].y;
+   double maxX = minX;
+   double minY = m10*p[0].x + m11*p[0].y;
+   double maxY = minY;
+   for(int i=1;i<n;i++)
+   {
+      double x = m00*p[i].x + m01*p[i].y;
+      double y = m10*p[i].x + m11*p[i].y;
+      minX = x<minX ? x : minX;
+      maxX = x>maxX ? x : maxX;
+      minY = y<minY ? y : minY;
+      maxY = y>maxY ? y : maxY;
+   }
+
+   Extent2DF result;
+   result.Add(minX + inMatrix.mtx, minY + inMatrix.mty);
+   result.Add(maxX + inMatrix.mtx, maxY + inMatrix.mty);
+
+   for(int c=0;c<mCurves.size();c+=3)
+      AddCurveExtent(result, inMatrix.Apply(mCurves[c].x, mCurves[c].y),
+                             inMatrix.Apply(mCurves[c+1].x, mCurves[c+1].y),
+                             inMatrix.Apply(mCurves[c+2].x, mCurves[c+2].y) );
+
+   ioExtent.Add(result);
+}
+
+
 // --- CachedExtentRenderer --------------------------------------
 
 bool CachedExtentRenderer::GetExtent(const Transform &inTransform,Extent2DF &ioExtent,bool inIncludeStroke)
 {
+   if (!inTransform.mScale9->Active())
+   {
+      if (mHull.mState==ExtentHull::hullUnknown)
+      {
+         if (GetExtentHull(mHull))
+            mHull.Build();
+         else
+            mHull.mState = ExtentHull::hullNone;
+      }
+      if (mHull.mState==ExtentHull::hullReady)
+      {
+         mHull.GetExtent(*inTransform.mMatrix, ioExtent);
+         return true;
+      }
+   }
+
    Matrix test = *inTransform.mMatrix;
    /*
    Do not normalize for scale ...
@@ -45,7 +189,7 @@ bool CachedExtentRenderer::GetExtent(const Transform &inTransform,Extent2DF &ioE
 
    int smallest = mExtentCache[0].mID;
    int slot = 0;
-   for(int i=0;i<3;i++)
+   for(int i=0;i<CACHED_EXTENT_SLOTS;i++)
    {
       CachedExtent &cache = mExtentCache[i];
       if (cache.mIsSet && test==cache.mTestMatrix &&
@@ -1,5 +1,4 @@
 #include <Graphics.h>
-#include <map>
 
 namespace nme
 {
@@ -44,77 +43,97 @@ uint32 ColorTransform::Transform(uint32 inVal) const
 }
 
 
+void ColorTransform::BuildLUT(uint8 *outLUT, double inMultiplier, double inOffset)
+{
+   // Same arithmetic as ByteTrans, so the tables match the per-pixel results exactly
+   for(int i=0;i<256;i++)
+   {
+      double val = i*inMultiplier + inOffset;
+      outLUT[i] = val<0 ? 0 : val>255 ? 255 : (int)val;
+   }
+}
+
+
 static uint8 *sgIdentityLUT = 0;
 
-typedef std::pair<int,int> Trans;
+// Shared cache for transforms that are not given their own LUTs.
+// It is 4-way set associative, so any 4 consecutive lookups (eg, r,g,b,a for one
+//  transform) can not evict each other, and eviction is O(1).
+enum { LUT_WAYS = 4, LUT_SETS = 64 };
 
 struct LUT
 {
-	int mLastUsed;
-	uint8 mLUT[256];
+   int   mMult;
+   int   mOffset;
+   int   mLastUsed;
+   uint8 mLUT[256];
 };
-static int sgLUTID = 0;
-typedef std::map<Trans,LUT> LUTMap;
-static LUTMap sgLUTs;
 
-enum { LUT_CACHE = 256 };
+static LUT sgLUTs[LUT_SETS][LUT_WAYS];
+static bool sgLUTsInit = false;
+static int sgLUTID = 0;
 
 void ColorTransform::TidyCache()
 {
-	if (sgLUTID>(1<<30))
-	{
-		sgLUTID = 1;
-		sgLUTs.clear();
-	}
+   if (sgLUTID>(1<<30))
+   {
+      sgLUTID = 1;
+      for(int s=0;s<LUT_SETS;s++)
+         for(int w=0;w<LUT_WAYS;w++)
+            sgLUTs[s][w].mLastUsed = 0;
+   }
 }
 
 
 const uint8 *GetLUT(double inMultiplier, double inOffset)
 {
-	if (inMultiplier==1 && inOffset==0)
-	{
-		if (sgIdentityLUT==0)
-		{
-			sgIdentityLUT = new uint8[256];
-			for(int i=0;i<256;i++)
-				sgIdentityLUT[i] = i;
-		}
-		return sgIdentityLUT;
-	}
-
-	sgLUTID++;
-
-   Trans t((int)(inMultiplier*128),(int)(inOffset/2));
-	LUTMap::iterator it = sgLUTs.find(t);
-	if (it!=sgLUTs.end())
-	{
-       it->second.mLastUsed = sgLUTID;
-		 return it->second.mLUT;
-	}
-
-	if (sgLUTs.size()>LUT_CACHE)
-	{
-		LUTMap::iterator where = sgLUTs.begin();
-		int oldest = where->second.mLastUsed;
-		for(LUTMap::iterator i=sgLUTs.begin(); i!=sgLUTs.end();++i)
-		{
-			if (i->second.mLastUsed < oldest)
-			{
-			   oldest = i->second.mLastUsed;
-				where = i;
-			}
-		}
-		sgLUTs.erase(where);
-	}
-
-	LUT &lut = sgLUTs[t];
-	lut.mLastUsed = sgLUTID;
-	for(int i=0;i<256;i++)
-	{
-		double ival = i*inMultiplier + inOffset;
-		lut.mLUT[i] = ival < 0 ? 0 : ival>255 ? 255 : (int)ival;
-	}
-	return lut.mLUT;
+   if (inMultiplier==1 && inOffset==0)
+   {
+      if (sgIdentityLUT==0)
+      {
+         sgIdentityLUT = new uint8[256];
+         for(int i=0;i<256;i++)
+            sgIdentityLUT[i] = i;
+      }
+      return sgIdentityLUT;
+   }
+
+   if (!sgLUTsInit)
+   {
+      sgLUTsInit = true;
+      for(int s=0;s<LUT_SETS;s++)
+         for(int w=0;w<LUT_WAYS;w++)
+         {
+            sgLUTs[s][w].mMult = 0x7fffffff;
+            sgLUTs[s][w].mLastUsed = 0;
+         }
+   }
+
+   sgLUTID++;
+
+   int mult = (int)(inMultiplier*128);
+   int offset = (int)(inOffset/2);
+   unsigned int hash = (unsigned int)(mult*31 + offset) * 2654435761U;
+   LUT *set = sgLUTs[hash>>26];
+
+   LUT *oldest = set;
+   for(int w=0;w<LUT_WAYS;w++)
+   {
+      LUT &lut = set[w];
+      if (lut.mMult==mult && lut.mOffset==offset)
+      {
+         lut.mLastUsed = sgLUTID;
+         return lut.mLUT;
+      }
+      if (lut.mLastUsed < oldest->mLastUsed)
+         oldest = &lut;
+   }
+
+   oldest->mMult = mult;
+   oldest->mOffset = offset;
+   oldest->mLastUsed = sgLUTID;
+   ColorTransform::BuildLUT(oldest->mLUT, inMultiplier, inOffset);
+   return oldest->mLUT;
 }
 
 
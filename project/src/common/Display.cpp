@@ -19,6 +19,13 @@ bool gNmeRenderGcFree = false;
 
 unsigned int gDisplayRefCounting = drDisplayChildRefs;
 static int sgDisplayObjID = 0;
+static int sgDisplayObjCount = 0;
+static int sgDisplayExtraCount = 0;
+
+// Largest side of a transform-tolerant cache - bigger objects are cached in screen space
+enum { MAX_TOLERANT_CACHE_SIZE = 2048 };
+
+const DisplayObjectExtra DisplayObject::sNoExtra;
 
 bool gMouseShowCursor = true;
 
@@ -28,6 +35,7 @@ DisplayObject::DisplayObject(bool inInitRef) : Object(inInitRef)
 {
    mParent = 0;
    mGfx = 0;
+   mExtra = 0;
    mDirtyFlags = 0;
    x = y = 0;
    #ifdef NME_S3D
@@ -44,13 +52,13 @@ DisplayObject::DisplayObject(bool inInitRef) : Object(inInitRef)
    opaqueBackground = 0;
    mouseEnabled = true;
    hitEnabled = true;
-   needsSoftKeyboard = false;
    mMask = 0;
    mIsMaskCount = 0;
    mBitmapGfx = 0;
    id = sgDisplayObjID++ & 0x7fffffff;
    if (id==0)
       id = sgDisplayObjID++;
+   sgDisplayObjCount++;
 }
 
 DisplayObject::~DisplayObject()
@@ -63,7 +71,37 @@ DisplayObject::~DisplayObject()
    delete mBitmapCache;
    if (mMask)
       setMask(0);
-   ClearFilters();
+   if (mExtra)
+   {
+      ClearFilters();
+      delete mExtra;
+      sgDisplayExtraCount--;
+   }
+   sgDisplayObjCount--;
+}
+
+DisplayObjectExtra &DisplayObject::editExtra()
+{
+   if (!mExtra)
+   {
+      mExtra = new DisplayObjectExtra();
+      sgDisplayExtraCount++;
+   }
+   return *mExtra;
+}
+
+void DisplayObject::GetMemoryReport(DisplayMemoryReport &outReport)
+{
+   outReport.objects = sgDisplayObjCount;
+   outReport.extras = sgDisplayExtraCount;
+   outReport.objectBytes = sizeof(DisplayObject);
+   outReport.extraBytes = sizeof(DisplayObjectExtra);
+}
+
+void DisplayObject::setName(const WString &inName)
+{
+   if (mExtra || !inName.empty())
+      editExtra().name = inName;
 }
 
 Graphics &DisplayObject::GetGraphics()
@@ -146,6 +184,28 @@ void DisplayObject::setCacheAsBitmap(bool inVal)
    cacheAsBitmap = inVal;
 }
 
+void DisplayObject::setBitmapCacheTolerance(double inVal)
+{
+   if (inVal<0)
+      inVal = 0;
+   if (inVal!=getExtra().bitmapCacheTolerance)
+   {
+      editExtra().bitmapCacheTolerance = inVal;
+      DirtyCache();
+   }
+}
+
+void DisplayObject::setBitmapCacheResolution(double inVal)
+{
+   if (inVal<=0)
+      inVal = 1;
+   if (inVal!=getExtra().bitmapCacheResolution)
+   {
+      editExtra().bitmapCacheResolution = inVal;
+      DirtyCache();
+   }
+}
+
 
 void DisplayObject::setPixelSnapping(int inVal)
 {
@@ -169,7 +229,7 @@ void DisplayObject::setVisible(bool inVal)
 
 
 
-void DisplayObject::CheckCacheDirty(bool inForHardware)
+void DisplayObject::CheckCacheDirty(HardwareRenderer *inHardware)
 {
    if (mBitmapCache && IsCacheDirty())
    {
@@ -177,17 +237,18 @@ void DisplayObject::CheckCacheDirty(bool inForHardware)
       mBitmapCache = 0;
    }
 
-   if (!IsBitmapRender(inForHardware) && !IsMask() && mBitmapCache)
+   if (!IsBitmapRender(inHardware) && !IsMask() && mBitmapCache)
    {
       delete mBitmapCache;
       mBitmapCache = 0;
    }
 }
 
-bool DisplayObject::IsBitmapRender(bool inHardware)
+// Software targets have no renderer, and always draw masks as bitmaps
+bool DisplayObject::IsBitmapRender(HardwareRenderer *inHardware)
 {
-   return cacheAsBitmap || blendMode!=bmNormal || NonNormalBlendChild() || filters.size() ||
-                                      (inHardware && mMask);
+   return cacheAsBitmap || blendMode!=bmNormal || NonNormalBlendChild() || (mExtra && mExtra->filters.size()) ||
+                                      (inHardware && mMask && !inHardware->CanStencilMask());
 }
 
 void DisplayObject::SetBitmapCache(BitmapCache *inCache)
@@ -207,13 +268,13 @@ void DisplayObject::Render( const RenderTarget &inTarget, const RenderState &inS
    if (mGfx && inState.mPhase!=rpBitmap)
    {
       bool hit = false;
-      if (scale9Grid.HasPixels())
+      if (mExtra && mExtra->scale9Grid.HasPixels())
       {
          RenderState state(inState);
 
          const Extent2DF &ext0 = mGfx->GetExtent0(0);
          Scale9 s9;
-         s9.Activate(scale9Grid,ext0,scaleX,scaleY);
+         s9.Activate(mExtra->scale9Grid,ext0,scaleX,scaleY);
          state.mTransform.mScale9 = &s9;
 
          Matrix unscaled = state.mTransform.mMatrix->Mult( Matrix(1.0/scaleX,1.0/scaleY) );
@@ -236,6 +297,19 @@ void DisplayObject::Render( const RenderTarget &inTarget, const RenderState &inS
 }
 
 
+void DisplayObject::CollectDirtyGraphics(const Matrix &inMatrix, HardwareRenderer *inHardware, GraphicsPrepassJobs &ioJobs)
+{
+   // Scale9 objects are rendered with a modified matrix - leave them for Render
+   if (mGfx && !getScale9Grid().HasPixels())
+   {
+      GraphicsPrepassJob job;
+      job.mGfx = mGfx;
+      job.mMatrix = inMatrix;
+      ioJobs.push_back(job);
+   }
+}
+
+
 bool DisplayObject::HitBitmap( const RenderTarget &inTarget, const RenderState &inState )
 {
    if (!mBitmapCache)
@@ -285,6 +359,7 @@ void DisplayObject::DirtyCache(bool inParentOnly)
 
 Matrix DisplayObject::GetFullMatrix(bool inStageScaling)
 {
+   const DRect &scrollRect = getScrollRect();
    if (mParent)
      return mParent->GetFullMatrix(inStageScaling).Mult(GetLocalMatrix().
                 Translated(-scrollRect.x,-scrollRect.y));
@@ -294,7 +369,7 @@ Matrix DisplayObject::GetFullMatrix(bool inStageScaling)
 void DisplayObject::setMatrix(const Matrix &inMatrix)
 {
    mLocalMatrix = inMatrix;
-   DirtyCache();
+   DirtyTransformCache();
    mDirtyFlags |= dirtDecomp;
    mDirtyFlags &= ~dirtLocalMatrix;
 }
@@ -429,7 +504,7 @@ void DisplayObject::setScaleX(double inValue)
    {
       mDirtyFlags |= dirtLocalMatrix;
       scaleX = inValue;
-      DirtyCache();
+      DirtyTransformCache();
    }
 }
 
@@ -541,7 +616,7 @@ void DisplayObject::setScaleY(double inValue)
    {
       mDirtyFlags |= dirtLocalMatrix;
       scaleY = inValue;
-      DirtyCache();
+      DirtyTransformCache();
    }
 }
 
@@ -568,13 +643,17 @@ void DisplayObject::setZ(double inValue)
 
 void DisplayObject::setScale9Grid(const DRect &inRect)
 {
-   scale9Grid = inRect;
+   if (!mExtra && inRect==DRect())
+      return;
+   editExtra().scale9Grid = inRect;
    DirtyCache();
 }
 
 void DisplayObject::setScrollRect(const DRect &inRect)
 {
-   scrollRect = inRect;
+   if (!mExtra && inRect==DRect())
+      return;
+   editExtra().scrollRect = inRect;
    UpdateDecomp();
    mDirtyFlags |= dirtLocalMatrix;
    DirtyCache();
@@ -595,10 +674,129 @@ void DisplayObject::setRotation(double inValue)
    {
       mDirtyFlags |= dirtLocalMatrix;
       rotation = inValue;
-      DirtyCache();
+      DirtyTransformCache();
+   }
+}
+
+
+int TransformFieldCount(int inFields)
+{
+   int count = 0;
+   for(int bit=trX; bit<trMatrix; bit<<=1)
+      if (inFields & bit)
+         count++;
+   if (inFields & trMatrix)
+      count+=6;
+   return count;
+}
+
+template<typename T>
+void DisplayObject::TSetTransforms(DisplayObject *const *inObjects, int inCount, int inFields, const T *inData)
+{
+   // Field blocks, in bit order
+   const T *block[trMatrix+6];
+   const T *data = inData;
+   for(int bit=trX; bit<trMatrix; bit<<=1)
+      if (inFields & bit)
+      {
+         block[bit] = data;
+         data += inCount;
+      }
+   const T *matrix[6];
+   if (inFields & trMatrix)
+      for(int m=0;m<6;m++)
+      {
+         matrix[m] = data;
+         data += inCount;
+      }
+
+   DisplayObject *lastParent = 0;
+   for(int i=0;i<inCount;i++)
+   {
+      DisplayObject *obj = inObjects[i];
+      if (!obj)
+         continue;
+
+      bool moved = false;
+      bool transformed = false;
+      bool changed = false;
+      if (inFields & trMatrix)
+      {
+         Matrix m;
+         m.m00 = matrix[0][i];
+         m.m10 = matrix[1][i];
+         m.m01 = matrix[2][i];
+         m.m11 = matrix[3][i];
+         m.mtx = matrix[4][i];
+         m.mty = matrix[5][i];
+         Matrix &local = obj->GetLocalMatrix();
+         if (m.m00!=local.m00 || m.m01!=local.m01 || m.m10!=local.m10 || m.m11!=local.m11)
+            transformed = true;
+         else if (m.mtx!=local.mtx || m.mty!=local.mty)
+            moved = true;
+         if (transformed || moved)
+         {
+            local = m;
+            obj->mDirtyFlags |= dirtDecomp;
+         }
+      }
+      else if (inFields & (trX|trY|trScaleX|trScaleY|trScale|trRotation))
+      {
+         obj->UpdateDecomp();
+         #define SET_FIELD(bit,member,flag) \
+            if (inFields & bit) \
+            { \
+               double v = block[bit][i]; \
+               if (obj->member!=v) { obj->member = v; flag = true; } \
+            }
+         SET_FIELD(trX,x,moved)
+         SET_FIELD(trY,y,moved)
+         SET_FIELD(trScale,scaleX,transformed)
+         SET_FIELD(trScale,scaleY,transformed)
+         SET_FIELD(trScaleX,scaleX,transformed)
+         SET_FIELD(trScaleY,scaleY,transformed)
+         SET_FIELD(trRotation,rotation,transformed)
+         #undef SET_FIELD
+         if (transformed || moved)
+            obj->mDirtyFlags |= dirtLocalMatrix;
+      }
+
+      if (inFields & trAlpha)
+      {
+         double alpha = block[trAlpha][i];
+         if (obj->colorTransform.alphaMultiplier!=alpha || obj->colorTransform.alphaOffset!=0)
+         {
+            obj->colorTransform.alphaMultiplier = alpha;
+            obj->colorTransform.alphaOffset = 0;
+            obj->ChildrenDirty();
+            changed = true;
+         }
+      }
+
+      // A move only dirties the parent, so siblings sharing a parent are dirtied once
+      if (changed)
+         obj->DirtyCache();
+      else if (transformed)
+         obj->DirtyTransformCache();
+      else if (moved && obj->mParent!=lastParent)
+      {
+         lastParent = obj->mParent;
+         if (lastParent)
+            lastParent->DirtyCache(false);
+      }
    }
 }
 
+void DisplayObject::SetTransforms(DisplayObject *const *inObjects, int inCount, int inFields, const float *inData)
+{
+   TSetTransforms(inObjects, inCount, inFields, inData);
+}
+
+void DisplayObject::SetTransforms(DisplayObject *const *inObjects, int inCount, int inFields, const double *inData)
+{
+   TSetTransforms(inObjects, inCount, inFields, inData);
+}
+
 
 void DisplayObject::ChangeIsMaskCount(int inDelta)
 {
@@ -649,8 +847,10 @@ void DisplayObject::setBlendMode(int inMode)
 
 void DisplayObject::setFilters(FilterList &inFilters)
 {
+   if (!mExtra && inFilters.empty())
+      return;
    ClearFilters();
-   filters = inFilters;
+   editExtra().filters.swap(inFilters);
    DirtyCache();
 }
 
@@ -663,6 +863,9 @@ void DisplayObject::setOpaqueBackground(uint32 inBG)
 
 void DisplayObject::ClearFilters()
 {
+   if (!mExtra)
+      return;
+   FilterList &filters = mExtra->filters;
    for(int i=0;i<filters.size();i++)
       delete filters[i];
    filters.resize(0);
@@ -673,7 +876,7 @@ void DisplayObject::ClearFilters()
 void DisplayObject::Focus()
 {
 #if defined(IPHONE) || defined (ANDROID) || defined(WEBOS) || defined(BLACKBERRY) || defined(TIZEN)
-  if (needsSoftKeyboard)
+  if (getNeedsSoftKeyboard())
   {
      Stage *stage = getStage();
      if (stage)
@@ -685,7 +888,7 @@ void DisplayObject::Focus()
 void DisplayObject::Unfocus()
 {
 #if defined(IPHONE) || defined (ANDROID) || defined(WEBOS) || defined(BLACKBERRY) || defined(TIZEN)
-  if (needsSoftKeyboard)
+  if (getNeedsSoftKeyboard())
   {
      Stage *stage = getStage();
      if (stage)
@@ -704,7 +907,8 @@ void DisplayObject::encodeStream(ObjectStreamOut &stream)
 
    stream.add(id);
    STREAM_ADD_SYNC(100);
-   stream.add(name);
+   const DisplayObjectExtra &extra = getExtra();
+   stream.add(extra.name);
    stream.add(blendMode);
    stream.add(cacheAsBitmap);
    stream.add(pedanticBitmapCaching);
@@ -712,14 +916,14 @@ void DisplayObject::encodeStream(ObjectStreamOut &stream)
    stream.add(colorTransform);
    //TODO - FilterList     filters;
    stream.add(opaqueBackground);
-   stream.add(scale9Grid);
-   stream.add(scrollRect);
+   stream.add(extra.scale9Grid);
+   stream.add(extra.scrollRect);
    stream.add(visible);
    stream.add(mouseEnabled);
    stream.add(hitEnabled);
-   stream.add(needsSoftKeyboard);
-   stream.add(softKeyboard);
-   stream.add(movesForSoftKeyboard);
+   stream.add(extra.needsSoftKeyboard);
+   stream.add(extra.softKeyboard);
+   stream.add(extra.movesForSoftKeyboard);
    //uint32 mDirtyFlags;
 
    stream.addObject(stream.parentToo ? mParent : 0);
@@ -758,7 +962,8 @@ void DisplayObject::decodeStream(ObjectStreamIn &stream)
       if (id==0)
          id = sgDisplayObjID++;
    }
-   stream.get(name);
+   DisplayObjectExtra extra;
+   stream.get(extra.name);
    stream.get(blendMode);
    stream.get(cacheAsBitmap);
    stream.get(pedanticBitmapCaching);
@@ -766,15 +971,26 @@ void DisplayObject::decodeStream(ObjectStreamIn &stream)
    stream.get(colorTransform);
    //TODO - FilterList     filters;
    stream.get(opaqueBackground);
-   stream.get(scale9Grid);
-   stream.get(scrollRect);
+   stream.get(extra.scale9Grid);
+   stream.get(extra.scrollRect);
 
    stream.get(visible);
    stream.get(mouseEnabled);
    stream.get(hitEnabled);
-   stream.get(needsSoftKeyboard);
-   stream.get(softKeyboard);
-   stream.get(movesForSoftKeyboard);
+   stream.get(extra.needsSoftKeyboard);
+   stream.get(extra.softKeyboard);
+   stream.get(extra.movesForSoftKeyboard);
+   if (mExtra || !extra.name.empty() || extra.scale9Grid!=DRect() || extra.scrollRect!=DRect() ||
+         extra.needsSoftKeyboard || extra.softKeyboard || extra.movesForSoftKeyboard)
+   {
+      DisplayObjectExtra &dest = editExtra();
+      dest.name = extra.name;
+      dest.scale9Grid = extra.scale9Grid;
+      dest.scrollRect = extra.scrollRect;
+      dest.needsSoftKeyboard = extra.needsSoftKeyboard;
+      dest.softKeyboard = extra.softKeyboard;
+      dest.movesForSoftKeyboard = extra.movesForSoftKeyboard;
+   }
    //uint32 mDirtyFlags;
 
 
@@ -985,6 +1201,13 @@ void SimpleButton::Render( const RenderTarget &inTarget, const RenderState &inSt
    }
 }
 
+void SimpleButton::CollectDirtyGraphics(const Matrix &inMatrix, HardwareRenderer *inHardware, GraphicsPrepassJobs &ioJobs)
+{
+   DisplayObject *obj = mState[mMouseState];
+   if (obj)
+      obj->CollectDirtyGraphics(inMatrix,inHardware,ioJobs);
+}
+
 void SimpleButton::setMouseState(int inState)
 {
    if (mState[inState]!=mState[mMouseState])
@@ -1009,12 +1232,12 @@ void SimpleButton::GetExtent(const Transform &inTrans, Extent2DF &outExt,bool in
          continue;
 
       full = inTrans.mMatrix->Mult( obj->GetLocalMatrix() );
-      if (inForScreen && obj->scrollRect.HasPixels())
+      if (inForScreen && obj->getScrollRect().HasPixels())
       {
          for(int corner=0;corner<4;corner++)
          {
-            double x = (corner & 1) ? obj->scrollRect.w : 0;
-            double y = (corner & 2) ? obj->scrollRect.h : 0;
+            double x = (corner & 1) ? obj->getScrollRect().w : 0;
+            double y = (corner & 2) ? obj->getScrollRect().h : 0;
             outExt.Add( full.Apply(x,y) );
          }
       }
@@ -1167,9 +1390,8 @@ void DisplayObjectContainer::DirtyExtent()
    if (!(mDirtyFlags & dirtExtent))
    {
       mDirtyFlags |= dirtExtent;
-      mExtentCache[0].mIsSet = 
-       mExtentCache[1].mIsSet = 
-        mExtentCache[2].mIsSet = false;
+      for(int i=0;i<CACHED_EXTENT_SLOTS;i++)
+         mExtentCache[i].mIsSet = false;
       if (mParent)
          mParent->DirtyExtent();
    }
@@ -1199,6 +1421,55 @@ void DisplayObjectContainer::ClearExtentDirty()
 
 
 
+// Simple, axis-aligned rectangular masks can be done with the clip rect
+bool DisplayObject::GetMaskClipRect(Rect &outRect)
+{
+   if (getObjectType()==notDisplayObjectContainer)
+   {
+      if (((DisplayObjectContainer *)this)->getChildAt(0))
+         return false;
+   }
+   else if (getObjectType()!=notDisplayObject)
+      return false;
+
+   if (!mGfx || getScale9Grid().HasPixels())
+      return false;
+
+   Matrix m = GetFullMatrix(true);
+   if (m.m01!=0 || m.m10!=0)
+      return false;
+
+   DRect r;
+   if (!mGfx->GetRectangle(r))
+      return false;
+
+   UserPoint p0 = m.Apply(r.x,r.y);
+   UserPoint p1 = m.Apply(r.x+r.w,r.y+r.h);
+   int x0 = floor( std::min(p0.x,p1.x) + 0.5 );
+   int y0 = floor( std::min(p0.y,p1.y) + 0.5 );
+   int x1 = floor( std::max(p0.x,p1.x) + 0.5 );
+   int y1 = floor( std::max(p0.y,p1.y) + 0.5 );
+   outRect = Rect(x0,y0,x1,y1,true);
+   return true;
+}
+
+// Add (or remove) the mask shape to the hardware stencil
+static void RenderStencilMask(DisplayObject *inMask, const RenderTarget &inTarget,
+                              const RenderState &inState, bool inPush)
+{
+   Matrix m = inMask->GetFullMatrix(true);
+   RenderState state(0, inState.mTransform.mAAFactor);
+   state.mTransform.mMatrix = &m;
+   state.mClipRect = inState.mClipRect;
+   state.mTargetOffset = inState.mTargetOffset;
+   state.mPhase = rpCreateMask;
+
+   inTarget.mHardware->BeginStencilMask(inPush);
+   inMask->Render(inTarget, state);
+   inTarget.mHardware->EndStencilMask(inPush);
+}
+
+
 bool DisplayObject::CreateMask(const Rect &inClipRect,int inAA)
 {
    Transform trans;
@@ -1206,10 +1477,10 @@ bool DisplayObject::CreateMask(const Rect &inClipRect,int inAA)
    Matrix m = GetFullMatrix(true);
    trans.mMatrix = &m;
    Scale9 s9;
-   if ( scale9Grid.HasPixels() )
+   if ( getScale9Grid().HasPixels() )
    {
       const Extent2DF &ext0 = mGfx->GetExtent0(0);
-      s9.Activate(scale9Grid,ext0,scaleX,scaleY);
+      s9.Activate(getScale9Grid(),ext0,scaleX,scaleY);
       trans.mScale9 = &s9;
 
       m = m.Mult( Matrix(1.0/scaleX,1.0/scaleY) );
@@ -1248,10 +1519,9 @@ bool DisplayObject::CreateMask(const Rect &inClipRect,int inAA)
    int h = rect.h;
    //w = UpToPower2(w); h = UpToPower2(h);
 
-   Surface *bitmap = new SimpleSurface(w, h, pfAlpha);
+   Surface *bitmap = AcquireScratchSurface(w, h, pfAlpha);
    RenderState state(bitmap,inAA);
 
-   bitmap->IncRef();
    if (opaqueBackground)
       bitmap->Clear(0xffffffff);
    else
@@ -1309,6 +1579,7 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
    // Render children/build child bitmaps ...
    Matrix full;
    ColorTransform col_trans;
+   ColourLUTs col_luts;
    RenderState state(inState);
    state.mTransform.mMatrix = &full;
    RenderState clip_state(state);
@@ -1346,20 +1617,20 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
       RenderState *obj_state = &state;
       full = inState.mTransform.mMatrix->Mult( obj->GetLocalMatrix() );
 
-      if (obj->scrollRect.HasPixels())
+      if (obj->getScrollRect().HasPixels())
       {
          Extent2DF extent;
  
-         DRect rect = obj->scrollRect;
+         DRect rect = obj->getScrollRect();
          for(int c=0;c<4;c++)
             extent.Add( full.Apply( (((c&1)>0) ? rect.w :0), (((c&2)>0) ? rect.h :0) ) );
 
 
          Rect screen_rect(extent.minX,extent.minY, extent.maxX, extent.maxY, true );
 
-         full.TranslateData(-obj->scrollRect.x, -obj->scrollRect.y );
+         full.TranslateData(-obj->getScrollRect().x, -obj->getScrollRect().y );
 
-         ImagePoint scroll(obj->scrollRect.x, obj->scrollRect.y);
+         ImagePoint scroll(obj->getScrollRect().x, obj->getScrollRect().y);
 
          clip_state.mClipRect = inState.mClipRect.Intersect(screen_rect);
 
@@ -1385,7 +1656,33 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
       obj_state->mMask = orig_mask;
 
       DisplayObject *mask = obj->getMask();
-      if (mask)
+      bool stencilMask = false;
+      if (mask && inTarget.IsHardware() && inState.mPhase!=rpHitTest && inTarget.mHardware->CanStencilMask())
+      {
+         // Use the clip rect, or the stencil buffer, rather than a mask bitmap
+         if (inState.mPhase==rpRender)
+         {
+            Rect maskRect;
+            if (mask->GetMaskClipRect(maskRect))
+            {
+               if (obj_state!=&clip_state)
+               {
+                  clip_state.mClipRect = obj_state->mClipRect;
+                  clip_state.mMask = orig_mask;
+                  obj_state = &clip_state;
+               }
+               clip_state.mClipRect = clip_state.mClipRect.Intersect(maskRect);
+               if (!clip_state.mClipRect.HasPixels())
+                  continue;
+            }
+            else
+            {
+               RenderStencilMask(mask, inTarget, *obj_state, true);
+               stencilMask = true;
+            }
+         }
+      }
+      else if (mask)
       {
          if (!mask->CreateMask(inTarget.mRect.Translated(obj_state->mTargetOffset),
                                obj_state->mTransform.mAAFactor))
@@ -1399,9 +1696,9 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
       if (inState.mPhase==rpBitmap)
       {
          //printf("Bitmap phase %d\n", obj->id);
-         if (obj->IsBitmapRender(inTarget.IsHardware()) )
+         if (obj->IsBitmapRender(inTarget.mHardware) )
          {
-            obj->CheckCacheDirty(inTarget.IsHardware());
+            obj->CheckCacheDirty(inTarget.mHardware);
 
             Extent2DF screen_extent;
             obj->GetExtent(obj_state->mTransform,screen_extent,true,true);
@@ -1452,6 +1749,33 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
                if (state.mWasDirtyPtr)
                   *state.mWasDirtyPtr = true;
 
+               // Transform-tolerant: render the whole object without its rotation, so the
+               //  pixels can be reused under nearby transforms.  The transformed draw has no
+               //  blend or mask support, and filters would be applied before the rotation
+               //  (turning drop shadows and bevels with the object), so those objects keep
+               //  screen-space caches.
+               Matrix screen_matrix = full;
+               double tolerance = obj->getBitmapCacheTolerance();
+               bool tolerant = false;
+               if (tolerance>0 && !mask && obj->getBlendMode()==bmNormal && filters.size()==0 &&
+                     !obj->getScale9Grid().HasPixels())
+               {
+                  full = BitmapCache::GetRasterMatrix(screen_matrix,obj->getBitmapCacheResolution());
+                  Extent2DF raster_extent;
+                  obj->GetExtent(obj_state->mTransform,raster_extent,true,true);
+                  Rect raster_rect = obj_state->mTransform.GetTargetRect(raster_extent);
+                  Rect raster_filtered = GetFilteredObjectRect(filters,raster_rect);
+                  if (raster_filtered.HasPixels() && raster_filtered.w<=MAX_TOLERANT_CACHE_SIZE &&
+                        raster_filtered.h<=MAX_TOLERANT_CACHE_SIZE)
+                  {
+                     tolerant = true;
+                     render_to = raster_rect;
+                     visible_bitmap = raster_filtered;
+                  }
+                  else
+                     full = screen_matrix;
+               }
+
                /*
                printf("object rect %d,%d %dx%d\n", rect.x, rect.y, rect.w, rect.h);
                printf("filtered rect %d,%d %dx%d\n", filtered.x, filtered.y, filtered.w, filtered.h);
@@ -1463,7 +1787,8 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
 
                int w = render_to.w;
                int h = render_to.h;
-               if (inState.mRoundSizeToPOW2 && filters.size()==0)
+               // Tolerant caches are drawn whole, so must not have padding
+               if (inState.mRoundSizeToPOW2 && filters.size()==0 && !tolerant)
                {
                   w = UpToPower2(w);
                   h = UpToPower2(h);
@@ -1472,11 +1797,10 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
                uint32 bg = obj->opaqueBackground;
                if (bg && filters.size())
                    bg = 0;
-               Surface *bitmap = new SimpleSurface(w, h, obj->IsBitmapRender(inTarget.IsHardware()) ?
+               Surface *bitmap = AcquireScratchSurface(w, h, obj->IsBitmapRender(inTarget.mHardware) ?
                          (bg ? pfRGB : pfBGRPremA) : pfAlpha );
-               bitmap->IncRef();
 
-               if (bg && obj->IsBitmapRender(inTarget.IsHardware()))
+               if (bg && obj->IsBitmapRender(inTarget.mHardware))
                   bitmap->Clear(obj->opaqueBackground | 0xff000000,0);
                else
                   bitmap->Zero();
@@ -1497,7 +1821,7 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
 
                obj_state->mTargetOffset += ImagePoint(render_to.x,render_to.y);
 
-               obj_state->CombineColourTransform(inState,&obj->colorTransform,&col_trans);
+               obj_state->CombineColourTransform(inState,&obj->colorTransform,&col_trans,&col_luts);
 
                obj_state->mPhase = rpBitmap;
                obj->Render(render.Target(), *obj_state);
@@ -1520,8 +1844,13 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
                bitmap = FilterBitmap(filters,bitmap,render_to,visible_bitmap,false/*old_pow2*/,true);
 
                full = orig;
-               obj->SetBitmapCache(
-                      new BitmapCache(bitmap, obj_state->mTransform, visible_bitmap, false, mask));
+               BitmapCache *cache = new BitmapCache(bitmap, obj_state->mTransform, visible_bitmap, false, mask);
+               if (tolerant)
+               {
+                  cache->SetTransformTolerant(screen_matrix,tolerance);
+                  full = screen_matrix;
+               }
+               obj->SetBitmapCache(cache);
                obj_state->mRoundSizeToPOW2 = old_pow2;
                bitmap->DecRef();
             }
@@ -1534,23 +1863,24 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
          {
             if (!obj->IsMask())
                obj->SetBitmapCache(0);
-            obj_state->CombineColourTransform(inState,&obj->colorTransform,&col_trans);
+            obj_state->CombineColourTransform(inState,&obj->colorTransform,&col_trans,
+                                       inTarget.IsHardware() ? 0 : &col_luts);
             obj->Render(inTarget,*obj_state);
          }
       }
       // Not rpBitmap ...
       else
       {
-         if ( (obj->IsBitmapRender(inTarget.IsHardware()) && inState.mPhase!=rpHitTest) )
+         if ( (obj->IsBitmapRender(inTarget.mHardware) && inState.mPhase!=rpHitTest) )
          {
             if (inState.mPhase==rpRender)
                obj->RenderBitmap(inTarget,*obj_state);
          }
          // Can just test the rect?
-         else if (obj->opaqueBackground && inState.mPhase==rpHitTest && !obj->scrollRect.HasPixels())
+         else if (obj->opaqueBackground && inState.mPhase==rpHitTest && !obj->getScrollRect().HasPixels())
          {
             Rect rect = clip_state.mClipRect;
-            if ( !obj->scrollRect.HasPixels() )
+            if ( !obj->getScrollRect().HasPixels() )
             {
                // TODO: this should actually be a rectangle rotated like the object?
                Extent2DF screen_extent;
@@ -1568,11 +1898,15 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
          else
          {
             if (inState.mPhase==rpRender)
-               obj_state->CombineColourTransform(inState,&obj->colorTransform,&col_trans);
+               obj_state->CombineColourTransform(inState,&obj->colorTransform,&col_trans,
+                                       inTarget.IsHardware() ? 0 : &col_luts);
 
             obj->Render(inTarget,*obj_state);
          }
 
+         if (stencilMask)
+            RenderStencilMask(mask, inTarget, *obj_state, false);
+
          if (obj_state->mHitResult && inState.mPhase==rpHitTest)
          {
             if (!obj_state->mHitResult->mouseEnabled)
@@ -1607,21 +1941,41 @@ void DisplayObjectContainer::Render( const RenderTarget &inTarget, const RenderS
 
 }
 
+void DisplayObjectContainer::CollectDirtyGraphics(const Matrix &inMatrix, HardwareRenderer *inHardware, GraphicsPrepassJobs &ioJobs)
+{
+   DisplayObject::CollectDirtyGraphics(inMatrix,inHardware,ioJobs);
+
+   for(int i=0;i<mChildren.size();i++)
+   {
+      DisplayObject *obj = mChildren[i];
+      // Bitmap renders and masks are drawn in software, so do not need tessellating
+      if (!obj->visible || obj->IsMask() || obj->IsBitmapRender(inHardware))
+         continue;
+
+      obj->CollectDirtyGraphics( inMatrix.Mult( obj->GetLocalMatrix() ), inHardware, ioJobs );
+   }
+}
+
 void DisplayObjectContainer::GetExtent(const Transform &inTrans, Extent2DF &outExt,bool inForScreen,bool inIncludeStroke)
 {
+   // The extent just moves with the translation, so match on the rest of the matrix
+   Matrix test = *inTrans.mMatrix;
+   test.mtx = 0;
+   test.mty = 0;
+
    int smallest = mExtentCache[0].mID;
    int slot = 0;
    ClearExtentDirty();
-   for(int i=0;i<3;i++)
+   for(int i=0;i<CACHED_EXTENT_SLOTS;i++)
    {
       CachedExtent &cache = mExtentCache[i];
-      if (cache.mIsSet && *inTrans.mMatrix==cache.mMatrix &&
+      if (cache.mIsSet && test==cache.mTestMatrix &&
             *inTrans.mScale9==cache.mScale9 && cache.mIncludeStroke==inIncludeStroke &&
                cache.mForScreen==inForScreen)
          {
             // Maybe set but not valid - ie, 0 size
             if (cache.mExtent.Valid())
-               outExt.Add(cache.mExtent);
+               outExt.Add(cache.Get(inTrans));
             return;
          }
       if (cache.mID<gCachedExtentID)
@@ -1639,6 +1993,7 @@ void DisplayObjectContainer::GetExtent(const Transform &inTrans, Extent2DF &outE
    cache.mExtent = Extent2DF();
    cache.mIsSet = true;
    cache.mMatrix = *inTrans.mMatrix;
+   cache.mTestMatrix = test;
    cache.mScale9 = *inTrans.mScale9;
    // todo:Matrix3d?
    cache.mForScreen = inForScreen;
@@ -1646,7 +2001,6 @@ void DisplayObjectContainer::GetExtent(const Transform &inTrans, Extent2DF &outE
 
    DisplayObject::GetExtent(inTrans,cache.mExtent,inForScreen,inIncludeStroke);
 
-   // TODO - allow translations without clearing cache
    Matrix full;
    Transform trans(inTrans);
    trans.mMatrix = &full;
@@ -1656,12 +2010,12 @@ void DisplayObjectContainer::GetExtent(const Transform &inTrans, Extent2DF &outE
       DisplayObject *obj = mChildren[i];
 
       full = inTrans.mMatrix->Mult( obj->GetLocalMatrix() );
-      if (inForScreen && obj->scrollRect.HasPixels())
+      if (inForScreen && obj->getScrollRect().HasPixels())
       {
          for(int corner=0;corner<4;corner++)
          {
-            double x = (corner & 1) ? obj->scrollRect.w : 0;
-            double y = (corner & 2) ? obj->scrollRect.h : 0;
+            double x = (corner & 1) ? obj->getScrollRect().w : 0;
+            double y = (corner & 2) ? obj->getScrollRect().h : 0;
             cache.mExtent.Add( full.Apply(x,y) );
          }
       }
@@ -54,6 +54,9 @@ namespace nme
 {
 void InitCamera();
 void GetGLStats(int *statsArray, int n);
+void SetPrecompilePrograms(const int *inIds, int inCount);
+void SetProgramCacheDir(const std::string &inDir);
+void GetProgramStats(int *outStats, int n);
 
 // Not static
 int _id_id=0;
@@ -279,8 +282,8 @@ DEFINE_ENTRY_POINT(InitIDs)
 
 
 
-template<typename T>
-void FillArrayInt(QuickVec<T> &outArray,value inVal)
+template<typename T,int N,typename A>
+void FillArrayInt(QuickVec<T,N,A> &outArray,value inVal)
 {
    if (val_is_null(inVal))
       return;
@@ -311,8 +314,8 @@ void FillArrayInt(QuickVec<T> &outArray,value inVal)
 
 }
 
-template<typename T>
-void FillArrayInt(value outVal, const QuickVec<T> &inArray)
+template<typename T,int N,typename A>
+void FillArrayInt(value outVal, const QuickVec<T,N,A> &inArray)
 {
    int n = inArray.size();
    if (n <= 0)
@@ -336,8 +339,8 @@ void FillArrayInt(value outVal, const QuickVec<T> &inArray)
    }
 }
 
-template<typename T>
-void FillArrayDouble(value outVal, const QuickVec<T> &inArray)
+template<typename T,int N,typename A>
+void FillArrayDouble(value outVal, const QuickVec<T,N,A> &inArray)
 {
    int n = inArray.size();
    if (n <= 0)
@@ -373,8 +376,8 @@ void FillArrayDouble(value outVal, const QuickVec<T> &inArray)
 
 
 
-template<typename T,int N>
-void FillArrayDoubleN(QuickVec<T,N> &outArray,value inVal)
+template<typename T,int N,typename A>
+void FillArrayDoubleN(QuickVec<T,N,A> &outArray,value inVal)
 {
    if (val_is_null(inVal))
       return;
@@ -410,10 +413,10 @@ void FillArrayDoubleN(QuickVec<T,N> &outArray,value inVal)
 }
 
 
-template<typename T>
-void FillArrayDouble(QuickVec<T> &outArray,value inVal)
+template<typename T,int N,typename A>
+void FillArrayDouble(QuickVec<T,N,A> &outArray,value inVal)
 {
-   FillArrayDoubleN<T,16>(outArray,inVal);
+   FillArrayDoubleN(outArray,inVal);
 }
 
 
@@ -2047,11 +2050,12 @@ void nme_display_object_draw_to_surface(value aObject, value aSurface, value aMa
       state.mTransform.mMatrix = &matrix;
 
       ColorTransform col_trans;
+      ColourLUTs col_luts;
       if (!val_is_null(aColourTransform))
       {
          ColorTransform t;
          FromValue(t,aColourTransform);
-         state.CombineColourTransform(state,&t,&col_trans);
+         state.CombineColourTransform(state,&t,&col_trans,&col_luts);
       }
 
       // TODO: Blend mode
@@ -2082,10 +2086,16 @@ void nme_display_object_draw_to_surface(value aObject, value aSurface, value aMa
 
       DisplayObjectContainer *dummy = new DisplayObjectContainer(true);
       dummy->hackAddChild(obj);
-      dummy->Render(render.Target(), state);
+      {
+         AutoPhaseTimer timer(ppBitmap);
+         dummy->Render(render.Target(), state);
+      }
 
       state.mPhase = rpRender;
-      dummy->Render(render.Target(), state);
+      {
+         AutoPhaseTimer timer(ppRender);
+         dummy->Render(render.Target(), state);
+      }
       dummy->hackRemoveChildren();
       dummy->DecRef();
 
@@ -2320,6 +2330,70 @@ void nme_display_object_get_matrix(value inObj,value outMatrix, bool inFull)
 DEFINE_PRIME3v(nme_display_object_get_matrix);
 
 
+// inData is field-major: one block of inHandles.length values for each field in inFields
+void nme_display_object_set_transforms(value inHandles, int inFields, value inData)
+{
+   int n = val_array_size(inHandles);
+   int fields = TransformFieldCount(inFields);
+   if (n<=0 || fields==0)
+      return;
+
+   QuickVec<DisplayObject *> objects;
+   objects.resize(n);
+   for(int i=0;i<n;i++)
+      if (!AbstractToObject(val_array_i(inHandles,i),objects[i]))
+         objects[i] = 0;
+
+   double *d = val_array_double(inData);
+   if (d)
+   {
+      if (val_array_size(inData)>=n*fields)
+         DisplayObject::SetTransforms(&objects[0], n, inFields, d);
+      return;
+   }
+
+   float *f = val_array_float(inData);
+   int size = f ? val_array_size(inData) : 0;
+   if (!f)
+   {
+      buffer buf = val_to_buffer(inData);
+      if (buf)
+      {
+         f = (float *)buffer_data(buf);
+         size = buffer_size(buf)/sizeof(float);
+      }
+   }
+   if (f)
+   {
+      if (size>=n*fields)
+         DisplayObject::SetTransforms(&objects[0], n, inFields, f);
+      return;
+   }
+
+   QuickVec<double> values;
+   FillArrayDouble(values,inData);
+   if (values.size()>=n*fields)
+      DisplayObject::SetTransforms(&objects[0], n, inFields, &values[0]);
+}
+DEFINE_PRIME3v(nme_display_object_set_transforms);
+
+
+// [live objects, objects with extra state, bytes per object, bytes per extra]
+value nme_display_object_get_memory_report()
+{
+   DisplayMemoryReport report;
+   DisplayObject::GetMemoryReport(report);
+
+   value result = alloc_array(4);
+   val_array_set_i(result,0,alloc_int(report.objects));
+   val_array_set_i(result,1,alloc_int(report.extras));
+   val_array_set_i(result,2,alloc_int(report.objectBytes));
+   val_array_set_i(result,3,alloc_int(report.extraBytes));
+   return result;
+}
+DEFINE_PRIME0(nme_display_object_get_memory_report);
+
+
 void nme_display_object_set_color_transform(value inObj,value inTrans)
 {
    DisplayObject *obj;
@@ -2430,6 +2504,8 @@ DO_DISPLAY_PROP_PRIME(bg,OpaqueBackground,int)
 DO_DISPLAY_PROP_PRIME(mouse_enabled,MouseEnabled,bool)
 DO_DISPLAY_PROP_PRIME(cache_as_bitmap,CacheAsBitmap,bool)
 DO_DISPLAY_PROP_PRIME(pedantic_bitmap_caching,PedanticBitmapCaching,bool)
+DO_DISPLAY_PROP_PRIME(bitmap_cache_tolerance,BitmapCacheTolerance,double)
+DO_DISPLAY_PROP_PRIME(bitmap_cache_resolution,BitmapCacheResolution,double)
 DO_DISPLAY_PROP_PRIME(pixel_snapping,PixelSnapping,int)
 DO_DISPLAY_PROP_PRIME(visible,Visible,bool)
 #if 1
@@ -2870,8 +2946,8 @@ void nme_gfx_draw_path(value inGfx, value inCommands, value inData, bool inWindi
    if (AbstractToObject(inGfx,gfx))
    {
       CHECK_ACCESS("nme_gfx_draw_path");
-      QuickVec<uint8> commands;
-      QuickVec<float> data;
+      PathCommands commands;
+      PathData data;
       
       FillArrayInt(commands, inCommands);
       FillArrayDouble(data, inData);
@@ -3337,6 +3413,18 @@ DEFINE_PRIME5v(nme_gfx_draw_tiles);
 static bool sNekoLutInit = false;
 static int sNekoLut[256];
 
+// Neko ints are 31 bits, so alpha is passed in 6 bits
+static int ExpandNekoAlpha(int inRGBA)
+{
+   if (!sNekoLutInit)
+   {
+      sNekoLutInit = true;
+      for(int i=0;i<64;i++)
+         sNekoLut[i] = ((int)(i*255.0/63.0 + 0.5)) << 24;
+   }
+   return (inRGBA & 0xffffff) | sNekoLut[(inRGBA>>24) & 63];
+}
+
 void nme_gfx_draw_points(value aGfx, value aXYs, value aRGBAs, int aDefaultRGBA, bool aIs31Bits, double aPointSize)
 {
    Graphics *gfx;
@@ -3351,18 +3439,9 @@ void nme_gfx_draw_points(value aGfx, value aXYs, value aRGBAs, int aDefaultRGBA,
       int def_rgba = aDefaultRGBA;
       if (aIs31Bits)
       {
-         if (!sNekoLutInit)
-         {
-            sNekoLutInit = true;
-            for(int i=0;i<64;i++)
-               sNekoLut[i] = ((int)(i*255.0/63.0 + 0.5)) << 24;
-         }
          for(int i=0;i<RGBAs.size();i++)
-         {
-            int &rgba = RGBAs[i];
-            rgba = (rgba & 0xffffff) | sNekoLut[(rgba>>24) & 63];
-         }
-         def_rgba = (def_rgba & 0xffffff) | sNekoLut[(def_rgba>>24) & 63];
+            RGBAs[i] = ExpandNekoAlpha(RGBAs[i]);
+         def_rgba = ExpandNekoAlpha(def_rgba);
       }
 
       gfx->drawPoints(xys,RGBAs,def_rgba,aPointSize);
@@ -3371,6 +3450,27 @@ void nme_gfx_draw_points(value aGfx, value aXYs, value aRGBAs, int aDefaultRGBA,
 DEFINE_PRIME6v(nme_gfx_draw_points);
 
 
+void nme_gfx_update_points(value aGfx, int aFirst, value aXYs, value aRGBAs, bool aIs31Bits)
+{
+   Graphics *gfx;
+   if (AbstractToObject(aGfx,gfx))
+   {
+      QuickVec<float> xys;
+      FillArrayDouble(xys,aXYs);
+
+      QuickVec<int> RGBAs;
+      FillArrayInt(RGBAs,aRGBAs);
+
+      if (aIs31Bits)
+         for(int i=0;i<RGBAs.size();i++)
+            RGBAs[i] = ExpandNekoAlpha(RGBAs[i]);
+
+      gfx->updatePoints(aFirst,xys,RGBAs);
+   }
+}
+DEFINE_PRIME5v(nme_gfx_update_points);
+
+
 
 
 // --- IGraphicsData -----------------------------------------------------
@@ -3987,6 +4087,13 @@ int nme_bitmap_data_get_flags(value inHandle)
 DEFINE_PRIME1(nme_bitmap_data_get_flags);
 
 
+void nme_bitmap_data_set_resample_filter(int inFilter)
+{
+   SetResampleFilter( (ResampleFilter)inFilter );
+}
+DEFINE_PRIME1v(nme_bitmap_data_set_resample_filter);
+
+
 void nme_bitmap_data_fill(value inHandle, value inRect, int inRGB, int inA)
 {
    Surface *surface;
@@ -4408,6 +4515,21 @@ void nme_bitmap_data_noise(value inSurface, int inRandomSeed, int inLow, int inH
 DEFINE_PRIME6v(nme_bitmap_data_noise);
 
 
+void nme_bitmap_data_perlin_noise(value inSurface, double inBaseX, double inBaseY, int inNumOctaves, int inRandomSeed,
+       bool inStitch, bool inFractalNoise, int inChannelOptions, bool inGrayScale, value inOffsets)
+{
+   Surface *surf;
+   if (AbstractToObject(inSurface,surf))
+   {
+      QuickVec<float> offsets;
+      FillArrayDouble(offsets,inOffsets);
+      surf->perlinNoise(inBaseX, inBaseY, inNumOctaves, inRandomSeed, inStitch, inFractalNoise,
+                        inChannelOptions, inGrayScale, offsets);
+   }
+}
+DEFINE_PRIME10v(nme_bitmap_data_perlin_noise);
+
+
 void nme_bitmap_data_get_floats32(value inSurface, value inData, int inOffset, int inStride,
        int inPixelFormat, int inTransform, int inSubsample, value subrect)
 {
@@ -4559,11 +4681,12 @@ void nme_render_surface_to_surface(value aTarget,value aSurface,value aMatrix,va
       state.mTransform.mMatrix = &matrix;
 
       ColorTransform col_trans;
+      ColourLUTs col_luts;
       if (!val_is_null(aColourTransform))
       {
          ColorTransform t;
          FromValue(t,aColourTransform);
-         state.CombineColourTransform(state,&t,&col_trans);
+         state.CombineColourTransform(state,&t,&col_trans,&col_luts);
       }
 
       // TODO: Blend mode
@@ -5156,6 +5279,32 @@ value nme_curl_get_data(value inLoader)
 DEFINE_PRIM(nme_curl_get_data,1);
 
 
+value nme_curl_take_chunk(value inLoader)
+{
+   #ifndef NME_NO_CURL
+   URLLoader *loader;
+   if (AbstractToObject(inLoader,loader))
+   {
+      ByteArray b = loader->takeChunk();
+      if (b.mValue)
+         return b.mValue;
+   }
+   #endif
+   return alloc_null();
+}
+DEFINE_PRIM(nme_curl_take_chunk,1);
+
+
+value nme_curl_set_cache(value inDir, value inMaxBytes)
+{
+   #ifndef NME_NO_CURL
+   URLLoader::setCacheDir(val_is_null(inDir) ? "" : val_string(inDir), val_int(inMaxBytes));
+   #endif
+   return alloc_null();
+}
+DEFINE_PRIM(nme_curl_set_cache,2);
+
+
 value nme_curl_get_cookies(value inLoader)
 {
    #ifndef NME_NO_CURL
@@ -5410,11 +5559,124 @@ void nme_get_glstats(value aStatsArray)
   {
     //0 Verts, 1 Calls, 2 Element Verts, 3 Element Calls
     //4 - 7 GLView stats
+    //8 Batched Verts, 9 Batch Calls, 10 Batched Elements, 11 Batched Objects
     GetGLStats(statsArray, n);
   }
 }
 DEFINE_PRIME1v(nme_get_glstats)
 
+void nme_set_precompile_shaders(value inIds)
+{
+   int n = val_array_size(inIds);
+   std::vector<int> ids(n);
+   for(int i=0;i<n;i++)
+      ids[i] = val_int(val_array_i(inIds,i));
+   SetPrecompilePrograms(n ? &ids[0] : 0, n);
+}
+DEFINE_PRIME1v(nme_set_precompile_shaders)
+
+void nme_set_shader_cache_dir(HxString inDir)
+{
+   SetProgramCacheDir(inDir.c_str() ? inDir.c_str() : "");
+}
+DEFINE_PRIME1v(nme_set_shader_cache_dir)
+
+void nme_get_shader_stats(value outStats)
+{
+   int n = val_array_size(outStats);
+   int *stats = val_array_int(outStats);
+   if (stats)
+   {
+      //0 Compiled, 1 Loaded from cache, 2 Total ms, 3 Slowest ms
+      GetProgramStats(stats, n);
+   }
+}
+DEFINE_PRIME1v(nme_get_shader_stats)
+
+void nme_set_profile_phases(bool inProfile)
+{
+   gNmeProfilePhases = inProfile;
+   ResetPhaseTimes();
+}
+DEFINE_PRIME1v(nme_set_profile_phases)
+
+// [seconds, count] for each ProfilePhase
+value nme_get_phase_times(bool inReset)
+{
+   double seconds[ppSIZE];
+   int counts[ppSIZE];
+   GetPhaseTimes(seconds,counts);
+   if (inReset)
+      ResetPhaseTimes();
+
+   value result = alloc_array(ppSIZE*2);
+   for(int i=0;i<ppSIZE;i++)
+   {
+      val_array_set_i(result,i*2,alloc_float(seconds[i]));
+      val_array_set_i(result,i*2+1,alloc_int(counts[i]));
+   }
+   return result;
+}
+DEFINE_PRIME1(nme_get_phase_times)
+
+void nme_set_deferred_release(double inMaxMs)
+{
+   #ifndef HXCPP_JS_PRIME
+   Object::SetDeferredRelease(inMaxMs*0.001);
+   #endif
+}
+DEFINE_PRIME1v(nme_set_deferred_release)
+
+int nme_get_deferred_release_count()
+{
+   #ifndef HXCPP_JS_PRIME
+   return Object::GetDeferredReleaseCount();
+   #else
+   return 0;
+   #endif
+}
+DEFINE_PRIME0(nme_get_deferred_release_count)
+
+value nme_get_buffer_pool_stats(bool inReset)
+{
+   BufferPoolStats stats;
+   GetBufferPoolStats(stats,inReset);
+
+   value result = alloc_array(7);
+   val_array_set_i(result,0,alloc_int(stats.allocs));
+   val_array_set_i(result,1,alloc_int(stats.reused));
+   val_array_set_i(result,2,alloc_int(stats.frees));
+   val_array_set_i(result,3,alloc_int(stats.trimmed));
+   val_array_set_i(result,4,alloc_float(stats.bytesInUse));
+   val_array_set_i(result,5,alloc_float(stats.bytesPooled));
+   val_array_set_i(result,6,alloc_float(stats.highWater));
+   return result;
+}
+DEFINE_PRIME1(nme_get_buffer_pool_stats)
+
+void nme_set_surface_pool_budget(int inBytes)
+{
+   SetSurfacePoolBudget(inBytes);
+}
+DEFINE_PRIME1v(nme_set_surface_pool_budget)
+
+value nme_get_surface_pool_stats(bool inReset)
+{
+   SurfacePoolStats stats;
+   GetSurfacePoolStats(stats,inReset);
+
+   value result = alloc_array(7);
+   val_array_set_i(result,0,alloc_int(stats.acquires));
+   val_array_set_i(result,1,alloc_int(stats.reused));
+   val_array_set_i(result,2,alloc_int(stats.created));
+   val_array_set_i(result,3,alloc_int(stats.trimmed));
+   val_array_set_i(result,4,alloc_int(stats.surfaces));
+   val_array_set_i(result,5,alloc_float(stats.bytesInUse));
+   val_array_set_i(result,6,alloc_float(stats.bytesPooled));
+   return result;
+}
+DEFINE_PRIME1(nme_get_surface_pool_stats)
+
 // Reference this to bring in all the symbols for the static library
 #ifdef STATIC_LINK
 extern "C" int nme_oglexport_register_prims();
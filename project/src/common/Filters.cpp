@@ -11,8 +11,7 @@ Surface *ExtractAlpha(const Surface *inSurface)
 {
    int w =  inSurface->Width();
    int h = inSurface->Height();
-   Surface *result = new SimpleSurface(w,h,pfAlpha);
-   result->IncRef();
+   Surface *result = AcquireScratchSurface(w,h,pfAlpha);
 
    AutoSurfaceRender render(result);
    inSurface->BlitChannel(render.Target(), Rect(0,0,w,h), 0, 0, CHAN_ALPHA, CHAN_ALPHA );
@@ -239,8 +238,7 @@ void BlurFilter::DoApply(const Surface *inSrc,Surface *outDest,ImagePoint inSrc0
    int blurred_w = std::min(sw+mBlurX,w);
    int blurred_h = std::min(sh+mBlurY,h);
    // TODO: tmp height is potentially less (h+mBlurY) than sh ...
-   SimpleSurface *tmp = new SimpleSurface(blurred_w,sh,outDest->Format());
-   tmp->IncRef();
+   SimpleSurface *tmp = AcquireScratchSurface(blurred_w,sh,outDest->Format());
 
    int ox = mBlurX/2;
    int oy = mBlurY/2;
@@ -467,8 +465,7 @@ void DropShadowFilter::Apply(const Surface *inSrc,Surface *outDest,ImagePoint in
    {
       Rect src_rect(alpha->Width(),alpha->Height());
       BlurFilter::GetFilteredObjectRect(src_rect,q);
-      Surface *blur = new SimpleSurface(src_rect.w, src_rect.h, pfAlpha);
-      blur->IncRef();
+      Surface *blur = AcquireScratchSurface(src_rect.w, src_rect.h, pfAlpha);
 
       ImagePoint diff(src_rect.x, src_rect.y);
 
@@ -661,6 +658,7 @@ Surface *FilterBitmap( const FilterList &inFilters, Surface *inBitmap,
                        bool inMakePOW2, bool inRecycle,
                        ImagePoint inSrc0)
 {
+   AutoPhaseTimer timer(ppFilter);
    int n = inFilters.size();
    PixelFormat fmt = inBitmap->Format();
    if (n==0 || (fmt!=pfBGRPremA && fmt!=pfBGRA) )
@@ -678,8 +676,7 @@ Surface *FilterBitmap( const FilterList &inFilters, Surface *inBitmap,
       {
          int w = bmp->Width();
          int h = bmp->Height();
-         Surface *converted = new SimpleSurface(w,h,pfBGRA);
-         converted->IncRef();
+         Surface *converted = AcquireScratchSurface(w,h,pfBGRA);
          PixelConvert(w,h, bmp->Format(), bmp->Row(0), bmp->GetStride(), 0,
                            pfBGRA, converted->EditRect(0,0,w,h), converted->GetStride(), 0 );
          bmp->DecRef();
@@ -711,11 +708,7 @@ Surface *FilterBitmap( const FilterList &inFilters, Surface *inBitmap,
             f->GetFilteredObjectRect(dest_rect, q);
          }
 
-         Surface *filtered = new SimpleSurface(dest_rect.w,dest_rect.h,bmp->Format());
-         filtered->IncRef();
-
-         if (do_clear)
-            filtered->Zero();
+         Surface *filtered = AcquireScratchSurface(dest_rect.w,dest_rect.h,bmp->Format(),do_clear);
 
          f->Apply(bmp,filtered, inSrc0, ImagePoint(dest_rect.x-src_rect.x, dest_rect.y-src_rect.y), q );
          inSrc0 = ImagePoint(0,0);
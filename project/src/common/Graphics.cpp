@@ -1,6 +1,7 @@
 #include <Graphics.h>
 #include <Surface.h>
 #include <Display.h>
+#include <NMEThread.h>
 
 namespace nme
 {
@@ -53,7 +54,7 @@ void Graphics::clear(bool inForceFreeHardware)
    // clear jobs
    for(int i=0;i<mJobs.size();i++)
       mJobs[i].clear();
-   mJobs.resize(0);
+   RecycleBuffer(mJobs);
 
    if (mHardwareData)
    {
@@ -178,7 +179,7 @@ void Graphics::close()
 }
 
 
-void Graphics::drawPath(const QuickVec<uint8> &inCommands, const QuickVec<float> &inData,
+void Graphics::drawPath(const PathCommands &inCommands, const PathData &inData,
            WindingRule inWinding )
 {
    int n = inCommands.size();
@@ -436,7 +437,7 @@ void Graphics::tile(float x, float y, const Rect &inTileRect,float *inTrans,floa
 }
 
 
-void Graphics::drawPoints(QuickVec<float> inXYs, QuickVec<int> inRGBAs, unsigned int inDefaultRGBA,
+void Graphics::drawPoints(const QuickVec<float> &inXYs, const QuickVec<int> &inRGBAs, unsigned int inDefaultRGBA,
 								  double inSize)
 {
    endFill();
@@ -464,6 +465,57 @@ void Graphics::drawPoints(QuickVec<float> inXYs, QuickVec<int> inRGBAs, unsigned
    mJobs.push_back(job);
 }
 
+// Overwrite the points of the last drawPoints from inFirst on, keeping the job - the software
+//  renderer reads the path data directly, and the hardware vertices are patched in place.
+void Graphics::updatePoints(int inFirst, const QuickVec<float> &inXYs, const QuickVec<int> &inRGBAs)
+{
+   Flush();
+
+   int jobId = mJobs.size()-1;
+   while(jobId>=0 && !mJobs[jobId].mIsPointJob)
+      jobId--;
+   if (jobId<0 || inFirst<0)
+      return;
+
+   GraphicsJob &job = mJobs[jobId];
+   bool hasColours = mPathData->commands[job.mCommand0]==pcPointsXYRGBA;
+   int count = job.mDataCount/(hasColours ? 3 : 2);
+   int n = std::min(inXYs.size()/2, count-inFirst);
+   if (n<=0)
+      return;
+
+   memcpy(&mPathData->data[job.mData0 + inFirst*2], &inXYs[0], n*2*sizeof(float));
+   if (hasColours)
+   {
+      int colours = std::min(inRGBAs.size(), n);
+      if (colours>0)
+         memcpy(&mPathData->data[job.mData0 + count*2 + inFirst], &inRGBAs[0], colours*sizeof(int));
+   }
+
+   // The extents have moved
+   if (job.mSoftwareRenderer)
+   {
+      job.mSoftwareRenderer->Destroy();
+      job.mSoftwareRenderer = 0;
+   }
+   mMeasuredJobs = 0;
+
+   if (mHardwareData && jobId<mBuiltHardware)
+   {
+      int pointJob = 0;
+      for(int j=0;j<jobId;j++)
+         if (mJobs[j].mIsPointJob)
+            pointJob++;
+      if (!UpdateHardwarePoints(job, *mPathData, *mHardwareData, pointJob, inFirst, n))
+      {
+         mHardwareData->clear();
+         mBuiltHardware = 0;
+      }
+   }
+
+   OnChanged();
+}
+
 void Graphics::drawTriangles(const QuickVec<float> &inXYs,
             const QuickVec<int> &inIndices,
             const QuickVec<float> &inUVT, int inCull,
@@ -624,6 +676,56 @@ const Extent2DF &Graphics::GetExtent0(double inRotation)
 }
 
 
+// Is this a single filled, axis-aligned rectangle?  (eg, a typical mask)
+bool Graphics::GetRectangle(DRect &outRect)
+{
+   Flush();
+
+   if (mJobs.size()!=1)
+      return false;
+
+   const GraphicsJob &job = mJobs[0];
+   if (!job.mFill || !job.mFill->AsSolidFill() || job.mStroke || job.mTriangles ||
+         job.mIsTileJob || job.mIsPointJob )
+      return false;
+
+   int n = job.mCommandCount;
+   if (n<4 || n>5)
+      return false;
+
+   const uint8 *command = &mPathData->commands[job.mCommand0];
+   const UserPoint *point = (const UserPoint *)&mPathData->data[job.mData0];
+
+   if (command[0]!=pcMoveTo && command[0]!=pcBeginAt)
+      return false;
+   for(int i=1;i<n;i++)
+      if (command[i]!=pcLineTo)
+         return false;
+   if (n==5 && (point[4].x!=point[0].x || point[4].y!=point[0].y))
+      return false;
+
+   // Edges must alternate between horizontal and vertical
+   bool wasHorizontal = false;
+   for(int i=0;i<4;i++)
+   {
+      const UserPoint &p0 = point[i];
+      const UserPoint &p1 = point[(i+1)&3];
+      bool horizontal = p0.y==p1.y;
+      if (horizontal == (p0.x==p1.x))
+         return false;
+      if (i>0 && horizontal==wasHorizontal)
+         return false;
+      wasHorizontal = horizontal;
+   }
+
+   Extent2DF extent;
+   for(int i=0;i<4;i++)
+      extent.Add(point[i]);
+   outRect = DRect(extent.minX, extent.minY, extent.Width(), extent.Height());
+   return true;
+}
+
+
 bool Graphics::Render( const RenderTarget &inTarget, const RenderState &inState )
 {
    Flush();
@@ -638,9 +740,11 @@ bool Graphics::Render( const RenderTarget &inTarget, const RenderState &inState
          mBuiltHardware = 0;
       }
       
-      while(mBuiltHardware<mJobs.size())
+      if (mBuiltHardware<mJobs.size())
       {
-         BuildHardwareJob(mJobs[mBuiltHardware++],*mPathData,*mHardwareData,*inTarget.mHardware,inState);
+         AutoPhaseTimer timer(ppTessellate);
+         while(mBuiltHardware<mJobs.size())
+            BuildHardwareJob(mJobs[mBuiltHardware++],*mPathData,*mHardwareData,*inTarget.mHardware,inState);
       }
       
       if (mHardwareData && !mHardwareData->mElements.empty())
@@ -657,7 +761,10 @@ bool Graphics::Render( const RenderTarget &inTarget, const RenderState &inState
       {
          GraphicsJob &job = mJobs[i];
          if (!job.mSoftwareRenderer)
+         {
+            AutoPhaseTimer timer(ppTessellate);
             job.mSoftwareRenderer = Renderer::CreateSoftware(job,*mPathData);
+         }
 
          if (inState.mPhase==rpHitTest)
          {
@@ -673,6 +780,98 @@ bool Graphics::Render( const RenderTarget &inTarget, const RenderState &inState
 }
 
 
+// --- Tessellation pre-pass ----------------------------------------------------
+
+// Jobs that do not need a texture (or a new surface) can be built without touching
+//  the GL context or any shared state, so they are safe to build on a worker.
+static bool CanBuildOnWorker(const GraphicsJob &inJob)
+{
+   if (inJob.mIsTileJob)
+      return false;
+
+   if (inJob.mFill && !inJob.mFill->AsSolidFill())
+      return false;
+
+   if (inJob.mStroke && inJob.mStroke->fill && !inJob.mStroke->fill->AsSolidFill())
+      return false;
+
+   return true;
+}
+
+bool Graphics::PrepareHardwarePrepass(const RenderState &inState)
+{
+   Flush();
+
+   if (!mHardwareData)
+      mHardwareData = new HardwareData();
+   else if (!mHardwareData->isScaleOk(inState))
+   {
+      mHardwareData->clear();
+      mBuiltHardware = 0;
+   }
+
+   if (mBuiltHardware>=mJobs.size() || !CanBuildOnWorker(mJobs[mBuiltHardware]))
+      return false;
+
+   // Release here, so BuildHardwareJob does not make gl calls from the worker
+   mHardwareData->releaseVbo();
+   return true;
+}
+
+void Graphics::BuildHardwarePrepass(HardwareRenderer &inHardware, const RenderState &inState)
+{
+   while(mBuiltHardware<mJobs.size() && CanBuildOnWorker(mJobs[mBuiltHardware]))
+      BuildHardwareJob(mJobs[mBuiltHardware++],*mPathData,*mHardwareData,inHardware,inState);
+}
+
+
+struct PrepassTask
+{
+   PrepassTask(GraphicsPrepassJobs &inJobs, HardwareRenderer &inHardware) :
+      jobs(inJobs), hardware(inHardware) { }
+
+   GraphicsPrepassJobs &jobs;
+   HardwareRenderer    &hardware;
+};
+
+static void SBuildPrepassJobs(int, void *inTask)
+{
+   PrepassTask *task = (PrepassTask *)inTask;
+   RenderState state;
+
+   while(true)
+   {
+      int id = GetNextTask();
+      if (id>=task->jobs.size())
+         break;
+
+      GraphicsPrepassJob &job = task->jobs[id];
+      state.mTransform.mMatrix = &job.mMatrix;
+      job.mGfx->BuildHardwarePrepass(task->hardware,state);
+   }
+}
+
+void TessellatePrepassJobs(GraphicsPrepassJobs &ioJobs, HardwareRenderer &inHardware)
+{
+   // Keep the graphics that actually need work - the rest is left to Render
+   int n = 0;
+   RenderState state;
+   for(int i=0;i<ioJobs.size();i++)
+   {
+      state.mTransform.mMatrix = &ioJobs[i].mMatrix;
+      if (ioJobs[i].mGfx->PrepareHardwarePrepass(state))
+         ioJobs[n++] = ioJobs[i];
+   }
+   ioJobs.resize(n);
+
+   if (n>1 && GetWorkerCount()>1)
+   {
+      PrepassTask task(ioJobs,inHardware);
+      RunWorkerTask(SBuildPrepassJobs,&task);
+   }
+}
+
+
 
 
 void encodeGraphicsData(ObjectStreamOut &stream, IGraphicsData *data)
@@ -1001,9 +1200,9 @@ RenderState::RenderState(Surface *inSurface,int inAA)
 
 void RenderState::CombineColourTransform(const RenderState &inState,
                                          const ColorTransform *inObjTrans,
-                                         ColorTransform *inBuf)
+                                         ColorTransform *inBuf,
+                                         ColourLUTs *inLUTs)
 {
-   mAlpha_LUT = mColourTransform->IsIdentityAlpha() ? 0 : mColourTransform->GetAlphaLUT();
    if (inObjTrans->IsIdentity())
    {
       mColourTransform = inState.mColourTransform;
@@ -1023,6 +1222,15 @@ void RenderState::CombineColourTransform(const RenderState &inState,
       mG_LUT = 0;
       mB_LUT = 0;
    }
+   else if (inLUTs)
+   {
+      ColorTransform::BuildLUT(inLUTs->mR, mColourTransform->redMultiplier, mColourTransform->redOffset);
+      ColorTransform::BuildLUT(inLUTs->mG, mColourTransform->greenMultiplier, mColourTransform->greenOffset);
+      ColorTransform::BuildLUT(inLUTs->mB, mColourTransform->blueMultiplier, mColourTransform->blueOffset);
+      mR_LUT = inLUTs->mR;
+      mG_LUT = inLUTs->mG;
+      mB_LUT = inLUTs->mB;
+   }
    else
    {
       mR_LUT = mColourTransform->GetRLUT();
@@ -1032,6 +1240,11 @@ void RenderState::CombineColourTransform(const RenderState &inState,
 
    if (mColourTransform->IsIdentityAlpha())
       mAlpha_LUT = 0;
+   else if (inLUTs)
+   {
+      ColorTransform::BuildLUT(inLUTs->mAlpha, mColourTransform->alphaMultiplier, mColourTransform->alphaOffset);
+      mAlpha_LUT = inLUTs->mAlpha;
+   }
    else
       mAlpha_LUT = mColourTransform->GetAlphaLUT();
 }
@@ -42,8 +42,8 @@ void GraphicsPath::initPosition(const UserPoint &inPoint)
 
 void GraphicsPath::clear()
 {
-   commands.resize(0);
-   data.resize(0);
+   RecycleBuffer(commands);
+   RecycleBuffer(data);
 }
 
 
@@ -183,7 +183,7 @@ void GraphicsPath::closeLine(int inCommand0, int inData0)
 }
 
 
-void GraphicsPath::drawPoints(QuickVec<float> inXYs, QuickVec<int> inRGBAs)
+void GraphicsPath::drawPoints(const QuickVec<float> &inXYs, const QuickVec<int> &inRGBAs)
 {
    int n = inXYs.size()/2;
    int d0 = data.size();
@@ -200,7 +200,7 @@ void GraphicsPath::drawPoints(QuickVec<float> inXYs, QuickVec<int> inRGBAs)
    {
        commands.push_back(pcPointsXY);
        data.resize(d0 + n*2);
-       memcpy(&data[d0], &inXYs[0], n*sizeof(float));
+       memcpy(&data[d0], &inXYs[0], n*2*sizeof(float));
    }
 }
 
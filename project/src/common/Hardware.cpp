@@ -2155,6 +2155,31 @@ public:
    WindingRule  mWinding;
 };
 
+// Interleave points [inFirst,inFirst+inCount) from the path data into the element's vertices
+static void CopyPointData(const DrawElement &inElem, const GraphicsJob &inJob, const GraphicsPath &inPath,
+                          DrawArray &ioArray, int inFirst, int inCount)
+{
+   const UserPoint *srcV = (const UserPoint *)&inPath.data[ inJob.mData0 ] + inFirst;
+   uint8 *v = &ioArray[ inElem.mVertexOffset + inElem.mStride*inFirst ];
+   for(int i=0;i<inCount;i++)
+   {
+      *(UserPoint *)v = *srcV++;
+      v += inElem.mStride;
+   }
+
+   if (inElem.mFlags & DRAW_HAS_COLOUR)
+   {
+      const int *src = (const int *)(&inPath.data[ inJob.mData0 + inElem.mCount*2]) + inFirst;
+      uint8 *dest = &ioArray[ inElem.mColourOffset + inElem.mStride*inFirst ];
+      for(int i=0;i<inCount;i++)
+      {
+         int s = src[i];
+         *(int *)dest = (s & 0xff00ff00) | ((s>>16)&0xff) | ((s<<16) & 0xff0000);
+         dest += inElem.mStride;
+      }
+   }
+}
+
 void CreatePointJob(const GraphicsJob &inJob,const GraphicsPath &inPath,HardwareData &ioData,
                    HardwareRenderer &inHardware)
 {
@@ -2191,28 +2216,45 @@ void CreatePointJob(const GraphicsJob &inJob,const GraphicsPath &inPath,Hardware
    elem.mCount = inJob.mDataCount / (fill ? 2 : 3);
    ioData.mArray.resize( elem.mVertexOffset + elem.mStride*elem.mCount );
 
-   UserPoint *srcV =  (UserPoint *)&inPath.data[ inJob.mData0 ];
-   UserPoint *v = (UserPoint *)&ioData.mArray[ elem.mVertexOffset ];
-   
-   for(int i=0;i<elem.mCount;i++)
-   {
-      *v = *srcV++;
-      v = (UserPoint *)( (char *)v + elem.mStride );
-   }
+   CopyPointData(elem, inJob, inPath, ioData.mArray, 0, elem.mCount);
 
-   if (!fill)
+   ioData.mElements.push_back(elem);
+}
+
+
+bool UpdateHardwarePoints(const GraphicsJob &inJob, const GraphicsPath &inPath, HardwareData &ioData,
+                          int inPointJob, int inFirst, int inCount)
+{
+   // Each point job builds exactly one ptPoints element, in job order
+   for(int e=0;e<ioData.mElements.size();e++)
    {
-      const int * src = (const int *)(&inPath.data[ inJob.mData0 + elem.mCount*2]);
-      int * dest =  (int *)&ioData.mArray[ elem.mColourOffset ];
-      for(int i=0;i<elem.mCount;i++)
+      const DrawElement &elem = ioData.mElements[e];
+      if (elem.mPrimType!=ptPoints)
+         continue;
+      if (inPointJob--)
+         continue;
+
+      if (inFirst<0 || inFirst+inCount>elem.mCount)
+         return false;
+
+      CopyPointData(elem, inJob, inPath, ioData.mArray, inFirst, inCount);
+
+      int begin = elem.mVertexOffset + elem.mStride*inFirst;
+      int end = elem.mVertexOffset + elem.mStride*(inFirst+inCount);
+      if (ioData.mDirtyEnd>ioData.mDirtyBegin)
       {
-         int s = src[i];
-         *dest = (s & 0xff00ff00) | ((s>>16)&0xff) | ((s<<16) & 0xff0000);
-         dest = (int *)( (char *)dest + elem.mStride );
+         ioData.mDirtyBegin = std::min(ioData.mDirtyBegin, begin);
+         ioData.mDirtyEnd = std::max(ioData.mDirtyEnd, end);
+      }
+      else
+      {
+         ioData.mDirtyBegin = begin;
+         ioData.mDirtyEnd = end;
       }
+      ioData.mDynamic = true;
+      return true;
    }
-
-   ioData.mElements.push_back(elem);
+   return false;
 }
 
 void BuildHardwareJob(const GraphicsJob &inJob,const GraphicsPath &inPath,HardwareData &ioData,
@@ -2236,6 +2278,8 @@ HardwareData::HardwareData()
    mVertexBo = 0;
    mContextId = 0;
    mVboOwner = 0;
+   mDirtyBegin = mDirtyEnd = 0;
+   mDynamic = false;
    mMinScale = mMaxScale = 0.0;
 }
 
@@ -2251,6 +2295,7 @@ void HardwareData::releaseVbo()
    mContextId = 0;
    mVertexBo = 0;
    mRendersWithoutVbo = 0;
+   mDirtyBegin = mDirtyEnd = 0;
 }
 
 float HardwareData::scaleOf(const RenderState &inState) const
@@ -2286,8 +2331,9 @@ void HardwareData::clear()
       if (mElements[i].mSurface)
          mElements[i].mSurface->DecRef();
 
-   mArray.resize(0);
-   mElements.resize(0);
+   RecycleBuffer(mArray);
+   RecycleBuffer(mElements);
+   mDynamic = false;
    mMinScale = mMaxScale = 0.0;
 }
 
@@ -0,0 +1,89 @@
+#include <nme/Object.h>
+#include <NMEThread.h>
+#include <Utils.h>
+#include <vector>
+
+namespace nme
+{
+
+#ifndef HXCPP_JS_PRIME
+
+// Objects whose destructors free pixels, vertex data or textures
+static bool IsHeavyType(NmeObjectType inType)
+{
+   return inType==notSurface || inType==notGraphics || inType==notTilesheet || inType==notFont;
+}
+
+static NmeMutex sReleaseLock;
+static std::vector<Object *> sReleaseQueue;
+static double sReleaseBudget = 0;
+
+void Object::releaseObject()
+{
+   bool defer = sReleaseBudget>0;
+   #ifdef NME_ATOMIC_REFCOUNT
+   // Textures may only be freed on the thread that owns the context
+   defer = defer || !IsMainThread();
+   #endif
+
+   if (defer && IsHeavyType(getObjectType()))
+   {
+      NmeAutoMutex lock(sReleaseLock);
+      sReleaseQueue.push_back(this);
+   }
+   else
+      delete this;
+}
+
+void Object::SetDeferredRelease(double inMaxSeconds)
+{
+   sReleaseBudget = inMaxSeconds;
+   if (sReleaseBudget<=0)
+      FlushDeferredReleases();
+}
+
+// Destroying an object may release more objects, which are added to the same queue
+static Object *PopRelease()
+{
+   NmeAutoMutex lock(sReleaseLock);
+   if (sReleaseQueue.empty())
+      return 0;
+   Object *result = sReleaseQueue.back();
+   sReleaseQueue.pop_back();
+   return result;
+}
+
+void Object::ProcessDeferredReleases()
+{
+   if (sReleaseBudget<=0)
+   {
+      FlushDeferredReleases();
+      return;
+   }
+
+   double end = GetTimeStamp() + sReleaseBudget;
+   int count = 0;
+   while(Object *obj = PopRelease())
+   {
+      delete obj;
+      // Check the clock every few objects - most destructors are quick
+      if ( ((++count)&7)==0 && GetTimeStamp()>end )
+         break;
+   }
+}
+
+void Object::FlushDeferredReleases()
+{
+   while(Object *obj = PopRelease())
+      delete obj;
+}
+
+int Object::GetDeferredReleaseCount()
+{
+   NmeAutoMutex lock(sReleaseLock);
+   return sReleaseQueue.size();
+}
+
+#endif
+
+} // end namespace nme
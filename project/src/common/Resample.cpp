@@ -0,0 +1,363 @@
+#include <Surface.h>
+#include <NMEThread.h>
+#include <nme/Pixel.h>
+#include <math.h>
+#include <vector>
+
+#include <NmeSimd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace nme
+{
+
+// Weights are 2.14 fixed point, and the horizontal pass keeps 6 fractional bits
+//  in 16-bit intermediates, leaving headroom for the negative Lanczos lobes.
+enum { WEIGHT_BITS = 14, INTER_BITS = 6 };
+
+enum { BAND_HEIGHT = 32 };
+enum { PARALLEL_MIN_PIXELS = 256*256 };
+
+static ResampleFilter sResampleFilter = rfBox;
+
+void SetResampleFilter(ResampleFilter inFilter) { sResampleFilter = inFilter; }
+ResampleFilter GetResampleFilter() { return sResampleFilter; }
+
+bool CanResample(PixelFormat inFormat)
+{
+   return inFormat==pfRGB || inFormat==pfBGRA || inFormat==pfBGRPremA ||
+          inFormat==pfAlpha || inFormat==pfLuma;
+}
+
+
+// --- Weight tables ---------------------------------------------------
+
+static double FilterRadius(ResampleFilter inFilter)
+{
+   switch(inFilter)
+   {
+      case rfBox: return 0.5;
+      case rfBilinear: return 1.0;
+      default: return 3.0;
+   }
+}
+
+static double FilterWeight(ResampleFilter inFilter, double inX)
+{
+   double x = fabs(inX);
+   if (inFilter==rfBilinear)
+      return x<1.0 ? 1.0-x : 0.0;
+
+   // Lanczos-3
+   if (x<1e-6)
+      return 1.0;
+   if (x>=3.0)
+      return 0.0;
+   double px = M_PI*x;
+   return 3.0*sin(px)*sin(px/3.0)/(px*px);
+}
+
+// One set of taps per output column (or row), all the same length so the inner
+//  loops have a fixed trip count.  Source indices are clamped at the edges by
+//  folding the outside weights onto the edge pixel.
+struct ResampleTaps
+{
+   int             taps;
+   QuickVec<int>   start;
+   QuickVec<short> weights;
+
+   void Build(ResampleFilter inFilter, int inSrc0, int inSrcLen,
+              double inDest0, double inDestLen, int inOut0, int inOutLen)
+   {
+      double scale = inSrcLen/inDestLen;
+      double fs = scale>1.0 ? scale : 1.0;
+      double radius = FilterRadius(inFilter)*fs;
+      int src1 = inSrc0 + inSrcLen;
+
+      taps = (int)ceil(radius*2.0) + 2;
+      if (taps>inSrcLen)
+         taps = inSrcLen;
+
+      start.resize(inOutLen);
+      weights.resize(inOutLen*taps);
+      std::vector<double> acc(taps);
+
+      for(int o=0;o<inOutLen;o++)
+      {
+         // Centre of the output pixel, in source coordinates
+         double s = (inOut0 + o + 0.5 - inDest0)*scale + inSrc0;
+         int lo = (int)floor(s-radius);
+         int hi = (int)ceil(s+radius);
+
+         int first = lo<inSrc0 ? inSrc0 : lo;
+         if (first>src1-taps)
+            first = src1-taps;
+
+         for(int t=0;t<taps;t++)
+            acc[t] = 0;
+         double total = 0;
+         for(int i=lo;i<=hi;i++)
+         {
+            double w;
+            if (inFilter==rfBox)
+            {
+               // Area coverage of source pixel [i,i+1]
+               double x0 = s-radius > i ? s-radius : i;
+               double x1 = s+radius < i+1 ? s+radius : i+1;
+               w = x1>x0 ? x1-x0 : 0.0;
+            }
+            else
+               w = FilterWeight(inFilter, (i+0.5-s)/fs);
+            if (w==0)
+               continue;
+
+            int idx = i<inSrc0 ? inSrc0 : i>=src1 ? src1-1 : i;
+            int slot = idx-first;
+            if (slot<0) slot = 0;
+            else if (slot>=taps) slot = taps-1;
+            acc[slot] += w;
+            total += w;
+         }
+         if (total==0)
+         {
+            int slot = (int)s - first;
+            acc[ slot<0 ? 0 : slot>=taps ? taps-1 : slot ] = 1.0;
+            total = 1.0;
+         }
+
+         short *dest = &weights[o*taps];
+         int sum = 0;
+         int biggest = 0;
+         for(int t=0;t<taps;t++)
+         {
+            int w = (int)floor(acc[t]/total*(1<<WEIGHT_BITS) + 0.5);
+            dest[t] = w;
+            sum += w;
+            if (acc[t]>acc[biggest])
+               biggest = t;
+         }
+         // Make the weights sum to exactly one so flat areas stay flat
+         dest[biggest] += (1<<WEIGHT_BITS) - sum;
+         start[o] = first;
+      }
+   }
+};
+
+
+// --- Passes ----------------------------------------------------------
+
+static void HorizontalPass(const uint8 *inRow, int inPw, const ResampleTaps &inTaps, int inOutW, short *outRow)
+{
+   const int taps = inTaps.taps;
+   const int shift = WEIGHT_BITS-INTER_BITS;
+
+   #ifdef NME_SSE2
+   if (inPw==4)
+   {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i round = _mm_set1_epi32(1<<(shift-1));
+      for(int o=0;o<inOutW;o++)
+      {
+         const uint8 *s = inRow + inTaps.start[o]*4;
+         const short *w = &inTaps.weights[o*taps];
+         __m128i acc = round;
+         for(int t=0;t<taps;t++)
+         {
+            // [c0,0,c1,0,c2,0,c3,0] x [w,0,w,0...] -> 4 x int32
+            __m128i p = _mm_cvtsi32_si128( *(const int *)(s+t*4) );
+            p = _mm_unpacklo_epi16( _mm_unpacklo_epi8(p,zero), zero );
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32( (unsigned short)w[t] ) ) );
+         }
+         acc = _mm_srai_epi32(acc, shift);
+         _mm_storel_epi64( (__m128i *)(outRow + o*4), _mm_packs_epi32(acc,acc) );
+      }
+      return;
+   }
+   #endif
+
+   for(int o=0;o<inOutW;o++)
+   {
+      const uint8 *s = inRow + inTaps.start[o]*inPw;
+      const short *w = &inTaps.weights[o*taps];
+      for(int c=0;c<inPw;c++)
+      {
+         int acc = 1<<(shift-1);
+         for(int t=0;t<taps;t++)
+            acc += s[t*inPw+c] * w[t];
+         outRow[o*inPw+c] = acc>>shift;
+      }
+   }
+}
+
+static void VerticalPass(const short *const *inRows, const short *inWeights, int inTaps, int inCount, uint8 *outRow)
+{
+   const int shift = WEIGHT_BITS+INTER_BITS;
+   int i = 0;
+
+   #ifdef NME_SSE2
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i round = _mm_set1_epi32(1<<(shift-1));
+   for(;i+8<=inCount;i+=8)
+   {
+      __m128i lo = round;
+      __m128i hi = round;
+      // Rows are taken in pairs, so one madd applies two weights
+      for(int t=0;t<inTaps;t+=2)
+      {
+         __m128i a = _mm_loadu_si128( (const __m128i *)(inRows[t]+i) );
+         __m128i b = t+1<inTaps ? _mm_loadu_si128( (const __m128i *)(inRows[t+1]+i) ) : zero;
+         int wb = t+1<inTaps ? (unsigned short)inWeights[t+1] : 0;
+         __m128i w = _mm_set1_epi32( (int)( (unsigned short)inWeights[t] | ((unsigned int)wb<<16) ) );
+         lo = _mm_add_epi32(lo, _mm_madd_epi16( _mm_unpacklo_epi16(a,b), w ) );
+         hi = _mm_add_epi32(hi, _mm_madd_epi16( _mm_unpackhi_epi16(a,b), w ) );
+      }
+      lo = _mm_srai_epi32(lo, shift);
+      hi = _mm_srai_epi32(hi, shift);
+      __m128i result = _mm_packus_epi16( _mm_packs_epi32(lo,hi), zero );
+      _mm_storel_epi64( (__m128i *)(outRow+i), result );
+   }
+   #endif
+
+   for(;i<inCount;i++)
+   {
+      int acc = 1<<(shift-1);
+      for(int t=0;t<inTaps;t++)
+         acc += inRows[t][i] * inWeights[t];
+      acc >>= shift;
+      outRow[i] = acc<0 ? 0 : acc>255 ? 255 : acc;
+   }
+}
+
+
+// --- Driver ----------------------------------------------------------
+
+struct ResampleJob
+{
+   const SimpleSurface *src;
+   Rect                srcRect;
+   Rect                out;
+   PixelFormat         format;
+   int                 pw;
+   ResampleTaps        xTaps;
+   ResampleTaps        yTaps;
+   ResampleRowFunc     func;
+   void                *user;
+   int                 bands;
+};
+
+static void ResampleBand(const ResampleJob &job, int inBand)
+{
+   int y0 = inBand*BAND_HEIGHT;
+   int y1 = std::min(y0+BAND_HEIGHT, job.out.h);
+   int taps = job.yTaps.taps;
+   int sy0 = job.yTaps.start[y0];
+   int sy1 = job.yTaps.start[y1-1] + taps;
+   int rowLen = job.out.w*job.pw;
+   bool premultiply = job.format==pfBGRA;
+
+   QuickVec<short> inter;
+   inter.resize( (sy1-sy0)*rowLen );
+   QuickVec<uint8> prem;
+   if (premultiply)
+      prem.resize( job.src->Width()*4 );
+
+   // Filter straight alpha as premultiplied, so transparent pixels do not bleed their colour
+   for(int sy=sy0;sy<sy1;sy++)
+   {
+      const uint8 *row = job.src->Row(sy);
+      if (premultiply)
+      {
+         const uint8 *s = row + job.srcRect.x*4;
+         uint8 *d = &prem[0] + job.srcRect.x*4;
+         for(int x=0;x<job.srcRect.w;x++)
+         {
+            const uint8 *lut = gPremAlphaLut[s[3]];
+            d[0] = lut[s[0]];
+            d[1] = lut[s[1]];
+            d[2] = lut[s[2]];
+            d[3] = s[3];
+            s+=4;
+            d+=4;
+         }
+         row = &prem[0];
+      }
+      HorizontalPass(row, job.pw, job.xTaps, job.out.w, &inter[(sy-sy0)*rowLen]);
+   }
+
+   QuickVec<uint8> outRow;
+   outRow.resize(rowLen);
+   std::vector<const short *> rows(taps);
+   for(int y=y0;y<y1;y++)
+   {
+      int first = job.yTaps.start[y];
+      for(int t=0;t<taps;t++)
+         rows[t] = &inter[(first+t-sy0)*rowLen];
+      VerticalPass(&rows[0], &job.yTaps.weights[y*taps], taps, rowLen, &outRow[0]);
+
+      if (job.pw==4 && (job.format==pfBGRA || job.format==pfBGRPremA))
+      {
+         uint8 *p = &outRow[0];
+         for(int x=0;x<job.out.w;x++)
+         {
+            // Ringing can push colour past alpha - keep premultiplied values legal
+            int a = p[3];
+            if (p[0]>a) p[0] = a;
+            if (p[1]>a) p[1] = a;
+            if (p[2]>a) p[2] = a;
+            if (premultiply && a<255)
+            {
+               const uint8 *lut = gUnPremAlphaLut[a];
+               p[0] = lut[p[0]];
+               p[1] = lut[p[1]];
+               p[2] = lut[p[2]];
+            }
+            p+=4;
+         }
+      }
+      job.func(job.out.y+y, &outRow[0], job.user);
+   }
+}
+
+static void SResampleBands(int, void *inJob)
+{
+   ResampleJob *job = (ResampleJob *)inJob;
+   while(true)
+   {
+      int band = GetNextTask();
+      if (band>=job->bands)
+         break;
+      ResampleBand(*job, band);
+   }
+}
+
+
+void Resample(const SimpleSurface *inSrc, const Rect &inSrcRect, const DRect &inDestRect,
+              const Rect &inOut, ResampleFilter inFilter, ResampleRowFunc inFunc, void *inUser)
+{
+   Rect srcRect = inSrcRect.Intersect( Rect(0,0,inSrc->Width(),inSrc->Height()) );
+   if (!srcRect.Area() || !inOut.Area() || !inSrc->GetBase() || !CanResample(inSrc->Format()) ||
+         inDestRect.w<=0 || inDestRect.h<=0)
+      return;
+
+   ResampleJob job;
+   job.src = inSrc;
+   job.srcRect = srcRect;
+   job.out = inOut;
+   job.format = inSrc->Format();
+   job.pw = BytesPerPixel(job.format);
+   job.func = inFunc;
+   job.user = inUser;
+   job.xTaps.Build(inFilter, srcRect.x, srcRect.w, inDestRect.x, inDestRect.w, inOut.x, inOut.w);
+   job.yTaps.Build(inFilter, srcRect.y, srcRect.h, inDestRect.y, inDestRect.h, inOut.y, inOut.h);
+   job.bands = (inOut.h + BAND_HEIGHT-1)/BAND_HEIGHT;
+
+   if (job.bands>1 && inOut.Area()>=PARALLEL_MIN_PIXELS && GetWorkerCount()>1)
+      RunWorkerTask(SResampleBands, &job);
+   else
+      for(int b=0;b<job.bands;b++)
+         ResampleBand(job, b);
+}
+
+} // end namespace nme
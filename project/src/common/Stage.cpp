@@ -1,5 +1,6 @@
 #include <Display.h>
 #include <Surface.h>
+#include <NMEThread.h>
 #include <math.h>
 
 #include "TextField.h"
@@ -77,6 +78,9 @@ Stage::~Stage()
       mFocusObject->DecRef();
    if (mMouseDownObject)
       mMouseDownObject->DecRef();
+   #ifndef HXCPP_JS_PRIME
+   Object::FlushDeferredReleases();
+   #endif
 }
 
 void Stage::SetNextWakeDelay(double inNextWake)
@@ -218,7 +222,7 @@ void Stage::HandleEvent(Event &inEvent)
       UserPoint pixels(inEvent.x,inEvent.y);
       hit_obj = HitTest(pixels);
       //if (inEvent.type!=etTouchMove)
-        //ELOG("  type=%d %d,%d obj=%p (%S)", inEvent.type, inEvent.x, inEvent.y, hit_obj, hit_obj?hit_obj->name.c_str():L"(none)");
+        //ELOG("  type=%d %d,%d obj=%p (%S)", inEvent.type, inEvent.x, inEvent.y, hit_obj, hit_obj?hit_obj->getName():L"(none)");
 
       SimpleButton *but = hit_obj ? dynamic_cast<SimpleButton *>(hit_obj) : 0;
       inEvent.id = hit_obj ? hit_obj->id : id;
@@ -526,12 +530,36 @@ void Stage::RenderStage()
       state.mClipRect = Rect(w,h);
    }
 
+   if (currentTarget.IsHardware())
+   {
+      AutoPhaseTimer timer(ppTessellate);
+      TessellateDirtyGraphics();
+   }
+
    state.mPhase = rpBitmap;
    state.mRoundSizeToPOW2 = currentTarget.IsHardware();
-   Render(currentTarget,state);
+   {
+      AutoPhaseTimer timer(ppBitmap);
+      Render(currentTarget,state);
+   }
 
    state.mPhase = rpRender;
-   Render(currentTarget,state);
+   {
+      AutoPhaseTimer timer(ppRender);
+      Render(currentTarget,state);
+   }
+}
+
+// Build the hardware data for changed graphics up front, spread over the worker threads,
+//  rather than one at a time as they are first drawn
+void Stage::TessellateDirtyGraphics()
+{
+   if (GetWorkerCount()<2)
+      return;
+
+   GraphicsPrepassJobs jobs;
+   CollectDirtyGraphics(mStageScale,currentTarget.mHardware,jobs);
+   TessellatePrepassJobs(jobs,*currentTarget.mHardware);
 }
 
 void Stage::EndRenderStage()
@@ -540,6 +568,11 @@ void Stage::EndRenderStage()
    GetPrimarySurface()->EndRender();
    ClearCacheDirty();
    Flip();
+   #ifndef HXCPP_JS_PRIME
+   Object::ProcessDeferredReleases();
+   #endif
+   TrimBufferPool();
+   TrimSurfacePool();
 }
 
 
@@ -1,6 +1,10 @@
 #include <Graphics.h>
 #include <Surface.h>
+#include <NMEThread.h>
 #include <nme/Pixel.h>
+#include <algorithm>
+
+#include <NmeSimd.h>
 
 namespace nme
 {
@@ -54,6 +58,8 @@ SimpleSurface::SimpleSurface(int inWidth,int inHeight,PixelFormat inPixelFormat,
    mHeight = inHeight;
    mTexture = 0;
    mPixelFormat = inPixelFormat;
+   mMip = 0;
+   mMipVersion = 0;
 
    int pix_size = BytesPerPixel(inPixelFormat);
 
@@ -75,6 +81,7 @@ SimpleSurface::SimpleSurface(int inWidth,int inHeight,PixelFormat inPixelFormat,
 
 SimpleSurface::~SimpleSurface()
 {
+   ReleaseMips();
    if (mBase)
    {
       if (mBase[mStride*mHeight]!=69)
@@ -112,6 +119,7 @@ void SimpleSurface::MakeTextureOnly()
 { 
    if(mBase)
    {
+       ReleaseMips();
        createHardwareSurface();
        delete [] mBase;
        mBase = NULL;
@@ -124,6 +132,7 @@ bool SimpleSurface::ReinterpretPixelFormat(PixelFormat inNewFormat)
       return false;
 
    mPixelFormat = inNewFormat;
+   mVersion++;
 
    return true;
 }
@@ -268,6 +277,7 @@ void SimpleSurface::ChangeInternalFormat(PixelFormat inNewFormat, const Rect *in
    mBase = newBuffer;
    mStride = newStride;
    mPixelFormat = newFormat;
+   mVersion++;
    if (mTexture)
       mTexture->Dirty(Rect(0,0,mWidth,mHeight));
 }
@@ -959,6 +969,8 @@ void SimpleSurface::BlitTo(const RenderTarget &outDest,
    if (!mBase)
       return;
 
+   AutoPhaseTimer timer(ppBlit);
+
    // Translate inSrcRect src_rect to dest ...
    Rect src_rect(inPosX,inPosY, inSrcRect.w, inSrcRect.h );
    // clip ...
@@ -1043,33 +1055,196 @@ void SimpleSurface::BlitTo(const RenderTarget &outDest,
    }
 }
 
-void SimpleSurface::colorTransform(const Rect &inRect, ColorTransform &inTransform)
+// --- Bulk pixel operations ------------------------------------------------------
+//
+// Big rects are split into bands of rows, which are shared out between the workers.
+//  Each band writes exactly what the single-threaded loop would have.
+
+enum { BULK_BAND_HEIGHT = 64 };
+enum { BULK_PARALLEL_MIN_PIXELS = 512*512 };
+
+typedef void (*BulkBandFunc)(int inBand, int inY0, int inY1, void *inData);
+
+struct BulkJob
 {
-   if (mPixelFormat==pfAlpha || !mBase)
-      return;
+   BulkBandFunc func;
+   void *data;
+   int  y0;
+   int  y1;
+   int  bands;
+};
 
-   ChangeInternalFormat(pfBGRA);
+static int BulkBandCount(int inRows) { return (inRows + BULK_BAND_HEIGHT-1)/BULK_BAND_HEIGHT; }
+
+struct RowBandJob
+{
+   RowBandFunc func;
+   void *data;
+   int  bands;
+};
+
+static void SRunRowBands(int inThreadId, void *inJob)
+{
+   RowBandJob *job = (RowBandJob *)inJob;
+   while(true)
+   {
+      int band = GetNextTask();
+      if (band>=job->bands)
+         break;
+      job->func(inThreadId, band, job->data);
+   }
+}
+
+void RunRowBands(int inBands, RowBandFunc inFunc, void *inData, bool inThreaded)
+{
+   if (inThreaded && inBands>1 && GetWorkerCount()>1)
+   {
+      RowBandJob job;
+      job.func = inFunc;
+      job.data = inData;
+      job.bands = inBands;
+      RunWorkerTask(SRunRowBands, &job);
+   }
+   else
+      for(int b=0;b<inBands;b++)
+         inFunc(0, b, inData);
+}
+
+static void SRunBulkBand(int, int inBand, void *inJob)
+{
+   BulkJob *job = (BulkJob *)inJob;
+   int y0 = job->y0 + inBand*BULK_BAND_HEIGHT;
+   job->func(inBand, y0, std::min(y0+BULK_BAND_HEIGHT,job->y1), job->data);
+}
+
+static void RunBulkBands(int inY0, int inY1, int inWidth, BulkBandFunc inFunc, void *inData,
+                         bool inAllowThreads=true)
+{
+   BulkJob job;
+   job.func = inFunc;
+   job.data = inData;
+   job.y0 = inY0;
+   job.y1 = inY1;
+   job.bands = BulkBandCount(inY1-inY0);
+
+   RunRowBands(job.bands, SRunBulkBand, &job,
+               inAllowThreads && inWidth*(inY1-inY0)>=BULK_PARALLEL_MIN_PIXELS);
+}
+
+
+// Reverse the bytes in each pixel - converts between ARGB ints and big-endian bytes.
+//  Can be done in place.
+static void SwapPixelOrder(uint32 *outDest, const uint32 *inSrc, int inN)
+{
+   int x = 0;
+   #if defined(NME_SSE2)
+   const __m128i mid0 = _mm_set1_epi32(0x0000ff00);
+   const __m128i mid1 = _mm_set1_epi32(0x00ff0000);
+   for(;x+4<=inN;x+=4)
+   {
+      __m128i v = _mm_loadu_si128( (const __m128i *)(inSrc+x) );
+      __m128i outer = _mm_or_si128( _mm_srli_epi32(v,24), _mm_slli_epi32(v,24) );
+      __m128i inner = _mm_or_si128( _mm_and_si128(_mm_srli_epi32(v,8),mid0),
+                                    _mm_and_si128(_mm_slli_epi32(v,8),mid1) );
+      _mm_storeu_si128( (__m128i *)(outDest+x), _mm_or_si128(outer,inner) );
+   }
+   #elif defined(NME_NEON)
+   for(;x+4<=inN;x+=4)
+      vst1q_u8( (uint8_t *)(outDest+x), vrev32q_u8( vld1q_u8( (const uint8_t *)(inSrc+x) ) ) );
+   #endif
+   for(;x<inN;x++)
+   {
+      uint32 v = inSrc[x];
+      outDest[x] = (v>>24) | ((v>>8)&0x0000ff00) | ((v<<8)&0x00ff0000) | (v<<24);
+   }
+}
+
+
+// First pixel in [inX0,inX1) with ((pixel&inMask)==inCol)==inFind, or -1
+static int FindFirstBoundsPixel(const int *inRow, int inX0, int inX1, int inMask, int inCol, bool inFind)
+{
+   int x = inX0;
+   #ifdef NME_SSE2
+   const __m128i mask = _mm_set1_epi32(inMask);
+   const __m128i col = _mm_set1_epi32(inCol);
+   int noneFound = inFind ? 0 : 0xffff;
+   for(;x+4<=inX1;x+=4)
+   {
+      __m128i v = _mm_and_si128( _mm_loadu_si128( (const __m128i *)(inRow+x) ), mask );
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(v,col))!=noneFound)
+         break;
+   }
+   #endif
+   for(;x<inX1;x++)
+      if ( ((inRow[x]&inMask)==inCol)==inFind )
+         return x;
+   return -1;
+}
+
+// Last pixel in [inX0,inX1) with ((pixel&inMask)==inCol)==inFind, or -1
+static int FindLastBoundsPixel(const int *inRow, int inX0, int inX1, int inMask, int inCol, bool inFind)
+{
+   int x = inX1;
+   #ifdef NME_SSE2
+   const __m128i mask = _mm_set1_epi32(inMask);
+   const __m128i col = _mm_set1_epi32(inCol);
+   int noneFound = inFind ? 0 : 0xffff;
+   for(;x-4>=inX0;x-=4)
+   {
+      __m128i v = _mm_and_si128( _mm_loadu_si128( (const __m128i *)(inRow+x-4) ), mask );
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(v,col))!=noneFound)
+         break;
+   }
+   #endif
+   for(x--;x>=inX0;x--)
+      if ( ((inRow[x]&inMask)==inCol)==inFind )
+         return x;
+   return -1;
+}
 
-   const uint8 *ta = inTransform.GetAlphaLUT();
-   const uint8 *tr = inTransform.GetRLUT();
-   const uint8 *tg = inTransform.GetGLUT();
-   const uint8 *tb = inTransform.GetBLUT();
 
-   RenderTarget target = BeginRender(inRect,false);
+struct ColorTransformJob
+{
+   RenderTarget target;
+   ColourLUTs   luts;
+};
 
-   Rect r = target.mRect;
-   for(int y=0;y<r.h;y++)
+static void SColorTransformBand(int, int inY0, int inY1, void *inJob)
+{
+   ColorTransformJob &job = *(ColorTransformJob *)inJob;
+   const uint8 *ta = job.luts.mAlpha;
+   const uint8 *tr = job.luts.mR;
+   const uint8 *tg = job.luts.mG;
+   const uint8 *tb = job.luts.mB;
+   const Rect &r = job.target.mRect;
+   for(int y=inY0;y<inY1;y++)
    {
-      ARGB *rgb = ((ARGB *)target.Row(y+r.y)) + r.x;
+      uint32 *pixel = ((uint32 *)job.target.Row(y)) + r.x;
       for(int x=0;x<r.w;x++)
       {
-         rgb->r = tr[rgb->r];
-         rgb->g = tg[rgb->g];
-         rgb->b = tb[rgb->b];
-         rgb->a = ta[rgb->a];
-         rgb++;
+         uint32 v = pixel[x];
+         pixel[x] = tb[v&0xff] | (tg[(v>>8)&0xff]<<8) | (tr[(v>>16)&0xff]<<16) | (ta[v>>24]<<24);
       }
    }
+}
+
+void SimpleSurface::colorTransform(const Rect &inRect, ColorTransform &inTransform)
+{
+   if (mPixelFormat==pfAlpha || !mBase)
+      return;
+
+   ChangeInternalFormat(pfBGRA);
+
+   ColorTransformJob job;
+   ColorTransform::BuildLUT(job.luts.mAlpha, inTransform.alphaMultiplier, inTransform.alphaOffset);
+   ColorTransform::BuildLUT(job.luts.mR, inTransform.redMultiplier, inTransform.redOffset);
+   ColorTransform::BuildLUT(job.luts.mG, inTransform.greenMultiplier, inTransform.greenOffset);
+   ColorTransform::BuildLUT(job.luts.mB, inTransform.blueMultiplier, inTransform.blueOffset);
+
+   job.target = BeginRender(inRect,false);
+
+   Rect r = job.target.mRect;
+   RunBulkBands(r.y, r.y1(), r.w, SColorTransformBand, &job);
 
    EndRender();
 }
@@ -1138,6 +1313,23 @@ void SimpleSurface::BlitChannel(const RenderTarget &outTarget, const Rect &inSrc
 }
 
 
+template<typename SRC,typename DEST>
+struct StretchRowBlender
+{
+   const RenderTarget *target;
+   int x0;
+   int w;
+
+   static void BlendRow(int inY, const uint8 *inRow, void *inBlender)
+   {
+      StretchRowBlender *blender = (StretchRowBlender *)inBlender;
+      DEST *dest = (DEST *)blender->target->Row(inY) + blender->x0;
+      const SRC *src = (const SRC *)inRow;
+      for(int x=0;x<blender->w;x++)
+         BlendPixel(*dest++, *src++);
+   }
+};
+
 template<typename SRC,typename DEST>
 void TStretchTo(const SimpleSurface *inSrc,const RenderTarget &outTarget,
                 const Rect &inSrcRect, const DRect &inDestRect, int inFlags)
@@ -1147,6 +1339,24 @@ void TStretchTo(const SimpleSurface *inSrc,const RenderTarget &outTarget,
    if (!out.Area())
       return;
 
+   // Smooth minification point-samples the bilinear filter and shimmers - use the
+   //  separable resampler, which looks at every covered source pixel.
+   if (inFlags && sizeof(SRC)==BytesPerPixel(inSrc->Format()) && CanResample(inSrc->Format()))
+   {
+      ResampleFilter filter = GetResampleFilter();
+      bool minify = inSrcRect.w > inDestRect.w*1.5 || inSrcRect.h > inDestRect.h*1.5;
+      if (minify || filter==rfLanczos)
+      {
+         StretchRowBlender<SRC,DEST> blender;
+         blender.target = &outTarget;
+         blender.x0 = out.x;
+         blender.w = out.w;
+         Resample(inSrc, inSrcRect, inDestRect, out, filter,
+                  StretchRowBlender<SRC,DEST>::BlendRow, &blender);
+         return;
+      }
+   }
+
    int dsx_dx = (inSrcRect.w << 16)/inDestRect.w;
    int dsy_dy = (inSrcRect.h << 16)/inDestRect.h;
 
@@ -1238,9 +1448,48 @@ void TStretchSuraceTo(const SimpleSurface *inSurface, const RenderTarget &outTar
    }
 }
 
+static void SCopyMipRow(int inY, const uint8 *inRow, void *inTarget)
+{
+   const RenderTarget *target = (const RenderTarget *)inTarget;
+   memcpy(target->Row(inY), inRow, target->mRect.w*BytesPerPixel(target->Format()));
+}
+
+void SimpleSurface::ReleaseMips()
+{
+   if (mMip)
+   {
+      mMip->DecRef();
+      mMip = 0;
+   }
+}
+
+Surface *SimpleSurface::GetMip(int inLevel)
+{
+   if (inLevel<=0)
+      return this;
+   if (!mBase || (mWidth<=1 && mHeight<=1) || !CanResample(mPixelFormat))
+      return 0;
+
+   // Built on first use and dropped when the pixels change
+   if (mMip && mMipVersion!=mVersion)
+      ReleaseMips();
+   if (!mMip)
+   {
+      int w = std::max(mWidth>>1,1);
+      int h = std::max(mHeight>>1,1);
+      mMip = new SimpleSurface(w,h,mPixelFormat);
+      mMip->IncRef();
+      RenderTarget target(Rect(w,h), mPixelFormat, mMip->mBase, mMip->mStride);
+      Resample(this, Rect(mWidth,mHeight), DRect(0,0,w,h), Rect(w,h), rfBox, SCopyMipRow, &target);
+      mMipVersion = mVersion;
+   }
+   return mMip->GetMip(inLevel-1);
+}
+
 void SimpleSurface::StretchTo(const RenderTarget &outTarget,
                      const Rect &inSrcRect, const DRect &inDestRect, unsigned int inFlags) const
 {
+   AutoPhaseTimer timer(ppBlit);
    switch(mPixelFormat)
    {
       case pfRGB:
@@ -1260,11 +1509,156 @@ void SimpleSurface::StretchTo(const RenderTarget &outTarget,
 }
 
 
+void ClipAffineSpan(double inStart, double inStep, double inLo, double inHi, int &ioX0, int &ioX1)
+{
+   if (inStep==0)
+   {
+      if (inStart<inLo || inStart>=inHi)
+         ioX1 = ioX0;
+      return;
+   }
+   double t0 = (inLo-inStart)/inStep;
+   double t1 = (inHi-inStart)/inStep;
+   if (t0>t1)
+      std::swap(t0,t1);
+   int x0 = (int)ceil(t0);
+   int x1 = (int)ceil(t1);
+   if (x0>ioX0) ioX0 = x0;
+   if (x1<ioX1) ioX1 = x1;
+}
+
+struct BlendSample
+{
+   template<typename DEST, typename SRC>
+   inline void operator()(DEST &outDest, const SRC &inSrc) const { BlendPixel(outDest, inSrc); }
+};
+
+template<typename SRC,typename DEST>
+void TTransformTo(const SimpleSurface *inSrc,const RenderTarget &outTarget,
+                  const Rect &inClipRect, const Matrix &inMatrix, bool inSmooth)
+{
+   int sw = inSrc->Width();
+   int sh = inSrc->Height();
+   if (inMatrix.m00*inMatrix.m11 == inMatrix.m01*inMatrix.m10)
+      return;
+
+   Extent2DF extent;
+   for(int c=0;c<4;c++)
+      extent.Add( inMatrix.Apply( (c&1) ? sw : 0, (c&2) ? sh : 0 ) );
+   if (!extent.Valid())
+      return;
+   Rect out = Rect(floor(extent.minX), floor(extent.minY), ceil(extent.maxX), ceil(extent.maxY), true)
+                 .Intersect(inClipRect).Intersect(outTarget.mRect);
+   if (!out.HasPixels())
+      return;
+
+   BlendSample blend;
+   TAffineRows<DEST,SRC>(outTarget, *inSrc, sw, sh, inMatrix.Inverse(), out.x, out.w, out.y, out.y1(),
+                         inSmooth, blend);
+}
+
+template<typename PIXEL>
+void TTransformSurfaceTo(const SimpleSurface *inSurface, const RenderTarget &outTarget,
+                         const Rect &inClipRect, const Matrix &inMatrix, bool inSmooth)
+{
+   switch(outTarget.Format())
+   {
+      case pfRGB:
+         TTransformTo<PIXEL,RGB>(inSurface, outTarget, inClipRect, inMatrix, inSmooth);
+         break;
+      case pfBGRA:
+         TTransformTo<PIXEL,ARGB>(inSurface, outTarget, inClipRect, inMatrix, inSmooth);
+         break;
+      case pfBGRPremA:
+         TTransformTo<PIXEL,BGRPremA>(inSurface, outTarget, inClipRect, inMatrix, inSmooth);
+         break;
+      default: ;
+   }
+}
+
+void SimpleSurface::TransformTo(const RenderTarget &outTarget, const Rect &inClipRect,
+                                const Matrix &inMatrix, bool inSmooth) const
+{
+   if (!mBase)
+      return;
+
+   AutoPhaseTimer timer(ppBlit);
+   switch(mPixelFormat)
+   {
+      case pfRGB:
+         TTransformSurfaceTo<RGB>(this, outTarget, inClipRect, inMatrix, inSmooth);
+         break;
+      case pfBGRA:
+         TTransformSurfaceTo<ARGB>(this, outTarget, inClipRect, inMatrix, inSmooth);
+         break;
+      case pfBGRPremA:
+         TTransformSurfaceTo<BGRPremA>(this, outTarget, inClipRect, inMatrix, inSmooth);
+         break;
+      default: ;
+   }
+}
+
+
+
+struct ClearJob
+{
+   uint8       *base;
+   int         stride;
+   PixelFormat format;
+   int  x0;
+   int  x1;
+   ARGB rgb;
+};
+
+// Fill the first row of the band, then copy it down
+static void SClearBand(int, int inY0, int inY1, void *inJob)
+{
+   ClearJob &job = *(ClearJob *)inJob;
+   PixelFormat format = job.format;
+   int pix_size = BytesPerPixel(format);
+   int stride = job.stride;
+   uint8 *first = job.base + inY0*stride + job.x0*pix_size;
+   int w = job.x1-job.x0;
+   const ARGB &rgb = job.rgb;
+
+   if (format==pfLumaAlpha)
+   {
+      int luma = rgb.luma();
+      uint8 *ptr = first;
+      for(int x=0;x<w;x++)
+      {
+         *ptr++ = luma;
+         *ptr++ = rgb.a;
+      }
+   }
+   else if (format==pfRGB)
+   {
+      uint8 *ptr = first;
+      for(int x=0;x<w;x++)
+      {
+         *ptr++ = rgb.r;
+         *ptr++ = rgb.g;
+         *ptr++ = rgb.b;
+      }
+   }
+   else if (pix_size==4)
+   {
+      uint32 *ptr = (uint32 *)first;
+      for(int x=0;x<w;x++)
+         ptr[x] = rgb.ival;
+   }
+   else
+      memset(first, 0, w*pix_size);
+
+   for(int y=inY0+1;y<inY1;y++)
+      memcpy(first + (y-inY0)*stride, first, w*pix_size);
+}
 
 void SimpleSurface::Clear(uint32 inColour,const Rect *inRect)
 {
    if (!mBase)
       return;
+   mVersion++;
    if (mPixelFormat==pfLuma)
    {
       memset(mBase, inColour & 0xff,mStride*mHeight);
@@ -1289,58 +1683,20 @@ void SimpleSurface::Clear(uint32 inColour,const Rect *inRect)
    if (x1<=x0 || y1<=y0)
       return;
 
-   int pix_size = BytesPerPixel(mPixelFormat);
-
-   if (mPixelFormat==pfLumaAlpha)
-   {
-      for(int y=y0;y<y1;y++)
-      {
-         int luma = rgb.luma();
-         uint8 *ptr = (mBase + y*mStride) + x0*2;
-         for(int x=x0;x<x1;x++)
-         {
-            *ptr++ = luma;
-            *ptr++ = rgb.a;
-         }
-      }
-
-   }
-   else if (mPixelFormat==pfRGB)
-   {
-      for(int y=y0;y<y1;y++)
-      {
-         uint8 *ptr = (mBase + y*mStride) + x0*3;
-         for(int x=x0;x<x1;x++)
-         {
-            *ptr++ = rgb.r;
-            *ptr++ = rgb.g;
-            *ptr++ = rgb.b;
-         }
-      }
-   }
-   else if (pix_size==4)
-   {
-      if (mPixelFormat==pfBGRPremA)
-      {
-         BGRPremA prem;
-         SetPixel(prem,rgb);
-         rgb.ival = prem.ival;
-      }
-      for(int y=y0;y<y1;y++)
-      {
-         uint32 *ptr = (uint32 *)(mBase + y*mStride) + x0;
-         for(int x=x0;x<x1;x++)
-            *ptr++ = rgb.ival;
-      }
-   }
-   else
+   ClearJob job;
+   job.base = mBase;
+   job.stride = mStride;
+   job.format = mPixelFormat;
+   job.x0 = x0;
+   job.x1 = x1;
+   job.rgb = rgb;
+   if (mPixelFormat==pfBGRPremA)
    {
-      for(int y=y0;y<y1;y++)
-      {
-         uint8 *ptr = (uint8 *)(mBase + y*mStride) + x0*pix_size;
-         memset(ptr, 0, (x1-x0)*pix_size);
-      }
+      BGRPremA prem;
+      SetPixel(prem,rgb);
+      job.rgb.ival = prem.ival;
    }
+   RunBulkBands(y0, y1, x1-x0, SClearBand, &job);
 
    if (mTexture)
       mTexture->Dirty( Rect(x0,y0,x1-x0,y1-y0) );
@@ -1350,11 +1706,20 @@ void SimpleSurface::Zero()
 {
    if (mBase)
       memset(mBase,0,mStride * mHeight);
+   DirtyAll();
+}
+
+void SimpleSurface::DirtyAll()
+{
+   mVersion++;
+   if (mTexture)
+      mTexture->Dirty(Rect(0,0,mWidth,mHeight));
 }
 
 void SimpleSurface::dispose()
 {
    destroyHardwareSurface();
+   ReleaseMips();
    if (mBase)
    {
       if (mBase[mStride * mHeight] != 69)
@@ -1408,58 +1773,136 @@ Surface *SimpleSurface::clone()
    return copy;
 }
 
-void SimpleSurface::getPixels(const Rect &inRect,uint32 *outPixels,bool inIgnoreOrder, bool inLittleEndian)
+struct PixelsJob
 {
-   if (!mBase)
-      return;
-
-   // PixelConvert
+   uint8         *base;
+   int           stride;
+   PixelFormat   format;
+   Rect          rect;
+   uint32        *outPixels;
+   const uint32  *inPixels;
+   bool          bigEndian;
+};
 
-   Rect r = inRect.Intersect(Rect(0,0,Width(),Height()));
-   if (r.w<1 || r.h<1)
-      return;
+static void SGetPixelsBand(int, int inY0, int inY1, void *inJob)
+{
+   PixelsJob &job = *(PixelsJob *)inJob;
+   const Rect &r = job.rect;
+   PixelFormat format = job.format;
 
-   ARGB *argb = (ARGB *)outPixels;
-   for(int y=0;y<r.h;y++)
+   for(int y=inY0;y<inY1;y++)
    {
-      if (mPixelFormat==pfAlpha)
+      uint32 *out = job.outPixels + (y-r.y)*r.w;
+      ARGB *argb = (ARGB *)out;
+      const uint8 *row = job.base + y*job.stride;
+      if (format==pfAlpha)
       {
-         AlphaPixel *src = (AlphaPixel *)(mBase + (r.y+y)*mStride) + r.x;
-
+         const AlphaPixel *src = (const AlphaPixel *)row + r.x;
          for(int x=0;x<r.w;x++)
             SetPixel(*argb++, *src++);
       }
-      else if (mPixelFormat==pfRGB)
+      else if (format==pfRGB)
       {
-         RGB *src = (RGB *)(mBase + (r.y+y)*mStride) + r.x;
-
+         const RGB *src = (const RGB *)row + r.x;
          for(int x=0;x<r.w;x++)
             SetPixel(*argb++, *src++);
       }
-      else if (mPixelFormat==pfBGRA)
+      else if (format==pfBGRA)
       {
-         ARGB *src = (ARGB *)(mBase + (r.y+y)*mStride) + r.x;
-         memcpy(argb,src,r.w*4);
-         argb+=r.w;
+         const uint32 *src = (const uint32 *)row + r.x;
+         if (job.bigEndian)
+         {
+            SwapPixelOrder(out, src, r.w);
+            continue;
+         }
+         memcpy(out,src,r.w*4);
       }
-      else if (mPixelFormat==pfBGRPremA)
+      else if (format==pfBGRPremA)
       {
-         BGRPremA *src = (BGRPremA *)(mBase + (r.y+y)*mStride) + r.x;
+         const BGRPremA *src = (const BGRPremA *)row + r.x;
          for(int x=0;x<r.w;x++)
             SetPixel(*argb++, *src++);
       }
+
+      // Make big-endian...
+      if (job.bigEndian)
+         SwapPixelOrder(out, out, r.w);
    }
+}
+
+void SimpleSurface::getPixels(const Rect &inRect,uint32 *outPixels,bool inIgnoreOrder, bool inLittleEndian)
+{
+   if (!mBase)
+      return;
+
+   // PixelConvert
+
+   Rect r = inRect.Intersect(Rect(0,0,Width(),Height()));
+   if (r.w<1 || r.h<1)
+      return;
+
+   PixelsJob job;
+   job.base = mBase;
+   job.stride = mStride;
+   job.format = mPixelFormat;
+   job.rect = r;
+   job.outPixels = outPixels;
+   job.bigEndian = !inIgnoreOrder && !inLittleEndian;
+   RunBulkBands(r.y, r.y1(), r.w, SGetPixelsBand, &job);
+}
+
+struct ColorBoundsBand
+{
+   int minX, maxX;
+   int minY, maxY;
+};
+
+struct ColorBoundsJob
+{
+   const uint8 *base;
+   int         stride;
+   int         width;
+   bool        isRgb;
+   int  mask;
+   int  col;
+   bool find;
+   QuickVec<ColorBoundsBand> bands;
+};
+
+// Each row only needs scanning in from the ends until the first match
+static void SColorBoundsBand(int inBand, int inY0, int inY1, void *inJob)
+{
+   ColorBoundsJob &job = *(ColorBoundsJob *)inJob;
+   ColorBoundsBand &band = job.bands[inBand];
+   band.minX = band.minY = 0x7fffffff;
+   band.maxX = band.maxY = -1;
 
-   // Make big-endian...
-   if (!inIgnoreOrder && !inLittleEndian)
+   int w = job.width;
+   QuickVec<int,0> rgbRow;
+   if (job.isRgb)
+      rgbRow.resize(w);
+
+   for(int y=inY0;y<inY1;y++)
    {
-      unsigned int *argb = (unsigned int *)outPixels;
-      int n = r.w*r.h;
-      for(int i=0;i<n;i++)
+      const int *row = (const int *)(job.base + y*job.stride);
+      if (job.isRgb)
       {
-         unsigned int v = argb[i];
-         argb[i] =   (v>>24) | ((v>>8)&0x0000ff00) | ((v<<8)&0x00ff0000) | (v<<24);
+         const RGB *rgb = (const RGB *)row;
+         ARGB *test = (ARGB *)&rgbRow[0];
+         for(int x=0;x<w;x++)
+            SetPixel(test[x],rgb[x]);
+         row = &rgbRow[0];
       }
+
+      int first = FindFirstBoundsPixel(row, 0, w, job.mask, job.col, job.find);
+      if (first<0)
+         continue;
+      int last = FindLastBoundsPixel(row, first, w, job.mask, job.col, job.find);
+
+      if (first<band.minX) band.minX = first;
+      if (last>band.maxX) band.maxX = last;
+      if (y<band.minY) band.minY = y;
+      band.maxY = y;
    }
 }
 
@@ -1478,122 +1921,61 @@ void SimpleSurface::getColorBoundsRect(int inMask, int inCol, bool inFind, Rect
    if (mPixelFormat==pfRGB && (inMask&0xff000000) && (inCol&0xff000000)!=0xff000000)
       return;
 
+   ColorBoundsJob job;
+   job.base = mBase;
+   job.stride = mStride;
+   job.width = w;
+   job.isRgb = mPixelFormat==pfRGB;
+   job.mask = inMask;
+   job.col = inCol;
+   job.find = inFind;
+   job.bands.resize( BulkBandCount(h) );
+   RunBulkBands(0, h, w, SColorBoundsBand, &job);
+
    int min_x = w + 1;
    int max_x = -1;
    int min_y = h + 1;
    int max_y = -1;
-
-   ARGB argb(inCol);
-   if (mPixelFormat==pfBGRPremA)
+   for(int b=0;b<job.bands.size();b++)
    {
-      BGRPremA bgra;
-      SetPixel(bgra, argb);
-      argb.ival = bgra.ival;
+      const ColorBoundsBand &band = job.bands[b];
+      if (band.maxY<0)
+         continue;
+      if (band.minX<min_x) min_x = band.minX;
+      if (band.maxX>max_x) max_x = band.maxX;
+      if (band.minY<min_y) min_y = band.minY;
+      if (band.maxY>max_y) max_y = band.maxY;
    }
-   argb.ival &= inMask;
 
-   for(int y=0;y<h;y++)
+   if (min_x>max_x)
+      outRect = Rect(0,0,0,0);
+   else
+      outRect = Rect(min_x,min_y,max_x-min_x+1,max_y-min_y+1);
+}
+
+
+static void SSetPixelsBand(int, int inY0, int inY1, void *inJob)
+{
+   PixelsJob &job = *(PixelsJob *)inJob;
+   const Rect &r = job.rect;
+   PixelFormat format = job.format;
+   bool bigEndian = job.bigEndian;
+
+   for(int y=inY0;y<inY1;y++)
    {
-      if (mPixelFormat==pfRGB)
+      const ARGB *src = (const ARGB *)(job.inPixels + (y-r.y)*r.w);
+      uint8 *row = job.base + y*job.stride;
+      if (format==pfBGRA)
       {
-         ARGB test;
-         RGB *rgb = (RGB *)( mBase + y*mStride);
-         for(int x=0;x<w;x++)
-         {
-            SetPixel(test,*rgb++);
-            if ( ((test.ival&inMask)==inCol)==inFind )
-            {
-               if (x<min_x) min_x=x;
-               if (x>max_x) max_x=x;
-               if (y<min_y) min_y=y;
-               if (y>max_y) max_y=y;
-            }
-         }
-
-      }
-      else
-      {
-         int *pixel = (int *)( mBase + y*mStride);
-         for(int x=0;x<w;x++)
-         {
-            if ( (((*pixel++)&inMask)==inCol)==inFind )
-            {
-               if (x<min_x) min_x=x;
-               if (x>max_x) max_x=x;
-               if (y<min_y) min_y=y;
-               if (y>max_y) max_y=y;
-            }
-         }
-      }
-   }
-
-   if (min_x>max_x)
-      outRect = Rect(0,0,0,0);
-   else
-      outRect = Rect(min_x,min_y,max_x-min_x+1,max_y-min_y+1);
-}
-
-
-void SimpleSurface::setPixels(const Rect &inRect,const uint32 *inPixels,bool inIgnoreOrder, bool inLittleEndian)
-{
-
-   if (!mBase)
-      return;
-   Rect r = inRect.Intersect(Rect(0,0,Width(),Height()));
-   mVersion++;
-   if (mTexture)
-      mTexture->Dirty(r);
-
-   PixelFormat convert = pfNone;
-   if ( !(mFlags & surfFixedPixelFormat) && !HasAlphaChannel(mPixelFormat))
-   {
-      int n = inRect.w * inRect.h;
-      for(int i=0;i<n;i++)
-         if ((inPixels[i]&0xff000000) != 0xff000000)
-         {
-            convert = pfBGRA;
-            break;
-         }
-      if (convert==pfNone && mPixelFormat>=pfRenderToCount)
-         convert = pfRGB;
-   }
-   else if (mPixelFormat>=pfRenderToCount)
-      convert = pfBGRA;
-
-   if (convert!=pfNone)
-   {
-      ChangeInternalFormat(convert, &r);
-   }
-
-   const ARGB *src = (const ARGB *)inPixels;
-   bool bigEndian = !inIgnoreOrder && !inLittleEndian;
-
-   for(int y=0;y<r.h;y++)
-   {
-      if (mPixelFormat==pfBGRA)
-      {
-         ARGB *dest = (ARGB *)(mBase + (r.y+y)*mStride) + r.x;
+         uint32 *dest = (uint32 *)row + r.x;
          if (bigEndian)
-         {
-            for(int x=0;x<r.w;x++)
-            {
-               dest->a = src->b;
-               dest->r = src->g;
-               dest->g = src->r;
-               dest->b = src->a;
-               dest++;
-               src++;
-            }
-         }
+            SwapPixelOrder(dest, (const uint32 *)src, r.w);
          else
-         {
             memcpy(dest, src, r.w*sizeof(ARGB));
-            src+=r.w;
-         }
       }
-      else if (mPixelFormat==pfAlpha)
+      else if (format==pfAlpha)
       {
-         AlphaPixel *dest = (AlphaPixel *)(mBase + (r.y+y)*mStride) + r.x;
+         AlphaPixel *dest = (AlphaPixel *)row + r.x;
          if (!bigEndian)
             dest += 3;
          for(int x=0;x<r.w;x++)
@@ -1602,9 +1984,9 @@ void SimpleSurface::setPixels(const Rect &inRect,const uint32 *inPixels,bool inI
             dest+=4;
          }
       }
-      else if (mPixelFormat==pfRGB)
+      else if (format==pfRGB)
       {
-         RGB *dest = (RGB *)(mBase + (r.y+y)*mStride) + r.x;
+         RGB *dest = (RGB *)row + r.x;
          if (bigEndian)
          {
             for(int x=0;x<r.w;x++)
@@ -1620,9 +2002,9 @@ void SimpleSurface::setPixels(const Rect &inRect,const uint32 *inPixels,bool inI
             for(int x=0;x<r.w;x++)
                SetPixel(*dest++,*src++);
       }
-      else if (mPixelFormat==pfBGRPremA)
+      else if (format==pfBGRPremA)
       {
-         BGRPremA *dest = (BGRPremA *)(mBase + (r.y+y)*mStride) + r.x;
+         BGRPremA *dest = (BGRPremA *)row + r.x;
          if (bigEndian)
          {
             for(int x=0;x<r.w;x++)
@@ -1642,6 +2024,51 @@ void SimpleSurface::setPixels(const Rect &inRect,const uint32 *inPixels,bool inI
    }
 }
 
+void SimpleSurface::setPixels(const Rect &inRect,const uint32 *inPixels,bool inIgnoreOrder, bool inLittleEndian)
+{
+
+   if (!mBase)
+      return;
+   Rect r = inRect.Intersect(Rect(0,0,Width(),Height()));
+   mVersion++;
+   if (mTexture)
+      mTexture->Dirty(r);
+
+   PixelFormat convert = pfNone;
+   if ( !(mFlags & surfFixedPixelFormat) && !HasAlphaChannel(mPixelFormat))
+   {
+      int n = inRect.w * inRect.h;
+      for(int i=0;i<n;i++)
+         if ((inPixels[i]&0xff000000) != 0xff000000)
+         {
+            convert = pfBGRA;
+            break;
+         }
+      if (convert==pfNone && mPixelFormat>=pfRenderToCount)
+         convert = pfRGB;
+   }
+   else if (mPixelFormat>=pfRenderToCount)
+      convert = pfBGRA;
+
+   if (convert!=pfNone)
+   {
+      ChangeInternalFormat(convert, &r);
+   }
+
+   if (r.w<1 || r.h<1)
+      return;
+
+   PixelsJob job;
+   job.base = mBase;
+   job.stride = mStride;
+   job.format = mPixelFormat;
+   job.rect = r;
+   job.inPixels = inPixels;
+   job.bigEndian = !inIgnoreOrder && !inLittleEndian;
+   // The alpha rows write past the rect, so keep them on one thread
+   RunBulkBands(r.y, r.y1(), r.w, SSetPixelsBand, &job, mPixelFormat!=pfAlpha);
+}
+
 uint32 SimpleSurface::getPixel(int inX,int inY)
 {
    if (inX<0 || inY<0 || inX>=mWidth || inY>=mHeight || !mBase)
@@ -1722,11 +2149,18 @@ void SimpleSurface::scroll(int inDX,int inDY)
    if (!pixels)
       return;
 
-   uint32 *buffer = (uint32 *)malloc( pixels * sizeof(int) );
-   getPixels(src,buffer,true);
+   // Move the rows in place, working away from the direction of travel so that
+   //  overlapping rows are read before they are overwritten
+   int pw = BytesPerPixel(mPixelFormat);
+   if (pw<1)
+      return;
+   int rowBytes = src.w*pw;
+   for(int i=0;i<src.h;i++)
+   {
+      int y = inDY>0 ? src.y1()-1-i : src.y+i;
+      memmove(mBase + (y+inDY)*mStride + (src.x+inDX)*pw, mBase + y*mStride + src.x*pw, rowBytes);
+   }
    src.Translate(inDX,inDY);
-   setPixels(src,buffer,true);
-   free(buffer);
    mVersion++;
    if (mTexture)
       mTexture->Dirty(src);
@@ -1815,60 +2249,381 @@ public:
       return x;
    }
 
+   // Same as calling the generator inN times - so bands of pixels can start part way
+   //  through the sequence.  Not valid if the state is a multiple of m, see CanDiscard.
+   void discard(unsigned long long inN)
+   {
+      const unsigned long long m = (1U << 31) - 1;
+      unsigned long long mult = 1;
+      unsigned long long a = 16807U;
+      for( ; inN; inN>>=1)
+      {
+         if (inN & 1)
+            mult = mult*a % m;
+         a = a*a % m;
+      }
+      x = (unsigned int)(mult * (x % m) % m);
+   }
+
+   bool CanDiscard() const { return x % ((1U << 31) - 1) != 0; }
+
 private:
    unsigned int x;
 };
 
+// Exact "inX % inD" for the generator's 31 bit values, using a multiply instead of a divide
+struct NoiseModulus
+{
+   NoiseModulus(unsigned int inD) : d(inD>0x7fffffffU ? 0 : inD), scale(inD ? 1.0/inD : 0.0) { }
+
+   inline unsigned int operator()(unsigned int inX) const
+   {
+      if (!d)
+         return inX;
+      int q = (int)(inX*scale);
+      int r = (int)(inX - (unsigned int)q*d);
+      if (r<0)
+         r += d;
+      else if (r>=(int)d)
+         r -= d;
+      return r;
+   }
+
+   unsigned int d;
+   double scale;
+};
+
+struct NoiseJob
+{
+   RenderTarget target;
+   unsigned int seed;
+   unsigned int low;
+   NoiseModulus range;
+   // Each value drawn from the generator is written to the channels in its multiplier
+   int          values;
+   unsigned int multiplier[4];
+   unsigned int fill;
+};
+
+static void SNoiseBand(int inBand, int inY0, int inY1, void *inJob)
+{
+   const NoiseJob &job = *(const NoiseJob *)inJob;
+   int w = job.target.mRect.w;
+
+   MinstdGenerator generator(job.seed);
+   generator.discard( (unsigned long long)inY0*w*job.values );
+
+   for(int y=inY0;y<inY1;y++)
+   {
+      unsigned int *pixel = (unsigned int *)job.target.Row(y);
+      for(int x=0;x<w;x++)
+      {
+         unsigned int result = job.fill;
+         for(int v=0;v<job.values;v++)
+            result |= ((job.low + job.range(generator())) & 0xff) * job.multiplier[v];
+         pixel[x] = result;
+      }
+   }
+}
+
 void SimpleSurface::noise(unsigned int randomSeed, unsigned int low, unsigned int high, int channelOptions, bool grayScale)
 {
    if (!mBase)
       return;
 
+   NoiseJob job = { BeginRender(Rect(0,0,mWidth,mHeight),false), randomSeed, low, NoiseModulus(high - low + 1) };
+
+   // Values are drawn in the order red, green, blue, alpha
+   job.values = 0;
+   job.fill = 0;
+   if (grayScale)
+      job.multiplier[job.values++] = 0x010101;
+   else
+   {
+      if (channelOptions & CHAN_RED)
+         job.multiplier[job.values++] = 0x010000;
+      if (channelOptions & CHAN_GREEN)
+         job.multiplier[job.values++] = 0x000100;
+      if (channelOptions & CHAN_BLUE)
+         job.multiplier[job.values++] = 0x000001;
+   }
+   if (channelOptions & CHAN_ALPHA)
+      job.multiplier[job.values++] = 0x01000000;
+   else
+      job.fill = 0xff000000;
+
    MinstdGenerator generator(randomSeed);
+   RunBulkBands(0, mHeight, mWidth*job.values, SNoiseBand, &job, generator.CanDiscard());
+
+   EndRender();
+}
+
+
+// --- Perlin noise ----------------------------------------------------------------
+//
+// The gradients come from a counter-based hash of (seed, channel, octave, cell) rather
+//  than a sequence, so any pixel can be made on its own, and the image does not depend on
+//  the number of workers.  The 4 channels are generated together, one per lane.
+
+// Unit gradients, every 22.5 degrees
+static const float sPerlinGradX[16] = {  1.0f,  0.92387953f,  0.70710678f,  0.38268343f,
+                                         0.0f, -0.38268343f, -0.70710678f, -0.92387953f,
+                                        -1.0f, -0.92387953f, -0.70710678f, -0.38268343f,
+                                         0.0f,  0.38268343f,  0.70710678f,  0.92387953f };
+static const float sPerlinGradY[16] = {  0.0f,  0.38268343f,  0.70710678f,  0.92387953f,
+                                         1.0f,  0.92387953f,  0.70710678f,  0.38268343f,
+                                         0.0f, -0.38268343f, -0.70710678f, -0.92387953f,
+                                        -1.0f, -0.92387953f, -0.70710678f, -0.38268343f };
+
+// Maps the +-1/sqrt(2) range of 2D gradient noise to +-1
+static const float PERLIN_GAIN = 1.41421356f;
+
+static inline uint32 PerlinHash(uint32 inKey, int inX, int inY)
+{
+   uint32 h = inKey ^ ((uint32)inX*0x8da6b343U) ^ ((uint32)inY*0xd8163841U);
+   h ^= h>>16;
+   h *= 0x7feb352dU;
+   h ^= h>>15;
+   h *= 0x846ca68bU;
+   h ^= h>>16;
+   return h;
+}
+
+static inline float PerlinFade(float t) { return t*t*t*(t*(t*6.0f-15.0f)+10.0f); }
+
+static inline int PerlinWrap(int inCell, int inPeriod)
+{
+   if (!inPeriod)
+      return inCell;
+   int c = inCell % inPeriod;
+   return c<0 ? c+inPeriod : c;
+}
+
+#if defined(NME_SSE2)
+typedef __m128 PerlinVec;
+static inline PerlinVec PerlinLoad(const float *inV) { return _mm_loadu_ps(inV); }
+static inline void PerlinStore(float *outV, PerlinVec inV) { _mm_storeu_ps(outV, inV); }
+static inline PerlinVec PerlinSet1(float inV) { return _mm_set1_ps(inV); }
+static inline PerlinVec PerlinAdd(PerlinVec a, PerlinVec b) { return _mm_add_ps(a,b); }
+static inline PerlinVec PerlinSub(PerlinVec a, PerlinVec b) { return _mm_sub_ps(a,b); }
+static inline PerlinVec PerlinMul(PerlinVec a, PerlinVec b) { return _mm_mul_ps(a,b); }
+static inline PerlinVec PerlinAbs(PerlinVec a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f),a); }
+#elif defined(NME_NEON)
+typedef float32x4_t PerlinVec;
+static inline PerlinVec PerlinLoad(const float *inV) { return vld1q_f32(inV); }
+static inline void PerlinStore(float *outV, PerlinVec inV) { vst1q_f32(outV, inV); }
+static inline PerlinVec PerlinSet1(float inV) { return vdupq_n_f32(inV); }
+static inline PerlinVec PerlinAdd(PerlinVec a, PerlinVec b) { return vaddq_f32(a,b); }
+static inline PerlinVec PerlinSub(PerlinVec a, PerlinVec b) { return vsubq_f32(a,b); }
+static inline PerlinVec PerlinMul(PerlinVec a, PerlinVec b) { return vmulq_f32(a,b); }
+static inline PerlinVec PerlinAbs(PerlinVec a) { return vabsq_f32(a); }
+#else
+struct PerlinVec { float v[4]; };
+static inline PerlinVec PerlinLoad(const float *inV) { PerlinVec r; for(int i=0;i<4;i++) r.v[i] = inV[i]; return r; }
+static inline void PerlinStore(float *outV, PerlinVec inV) { for(int i=0;i<4;i++) outV[i] = inV.v[i]; }
+static inline PerlinVec PerlinSet1(float inV) { PerlinVec r; for(int i=0;i<4;i++) r.v[i] = inV; return r; }
+static inline PerlinVec PerlinAdd(PerlinVec a, PerlinVec b) { for(int i=0;i<4;i++) a.v[i] += b.v[i]; return a; }
+static inline PerlinVec PerlinSub(PerlinVec a, PerlinVec b) { for(int i=0;i<4;i++) a.v[i] -= b.v[i]; return a; }
+static inline PerlinVec PerlinMul(PerlinVec a, PerlinVec b) { for(int i=0;i<4;i++) a.v[i] *= b.v[i]; return a; }
+static inline PerlinVec PerlinAbs(PerlinVec a) { for(int i=0;i<4;i++) a.v[i] = fabsf(a.v[i]); return a; }
+#endif
+
+struct PerlinOctave
+{
+   double freqX;
+   double freqY;
+   double offsetX;
+   double offsetY;
+   int    periodX;
+   int    periodY;
+   float  amplitude;
+   // One key per lane, in the memory order of ARGB - b,g,r,a
+   uint32 keys[4];
+};
 
-   RenderTarget target = BeginRender(Rect(0,0,mWidth,mHeight),false);
-   ARGB tmpRgb;
+struct PerlinJob
+{
+   RenderTarget target;
+   std::vector<PerlinOctave> octaves;
+   bool   fractal;
+   uint32 keep;
+   uint32 fill;
+};
 
-   int range = high - low + 1;
+// Adds one octave to a row of 4-channel sums
+static void PerlinOctaveRow(const PerlinOctave &inOct, int inY, bool inFractal, int inWidth, float *ioSum)
+{
+   double fy = (inY + inOct.offsetY)*inOct.freqY;
+   double cellY = floor(fy);
+   float ty = (float)(fy - cellY);
+   float wy = PerlinFade(ty);
+   int iy0 = PerlinWrap((int)cellY, inOct.periodY);
+   int iy1 = PerlinWrap((int)cellY+1, inOct.periodY);
 
-   for (int y=0;y<mHeight;y++)
+   PerlinVec amp = PerlinSet1(inOct.amplitude);
+   PerlinVec a0 = PerlinSet1(0), b0 = a0, a1 = a0, b1 = a0;
+   int prevCell = 0;
+   bool haveCell = false;
+   for(int x=0;x<inWidth;x++)
    {
-      ARGB *rgb = ((ARGB *)target.Row(y));
-      for(int x=0;x<mWidth;x++)
+      double fx = (x + inOct.offsetX)*inOct.freqX;
+      double cellX = floor(fx);
+      int cell = (int)cellX;
+      float tx = (float)(fx - cellX);
+
+      if (!haveCell || cell!=prevCell)
       {
-         if (grayScale)
+         // Along this row, the noise in a cell is a lerp between two lines in tx
+         int ix0 = PerlinWrap(cell, inOct.periodX);
+         int ix1 = PerlinWrap(cell+1, inOct.periodX);
+         float ca0[4], cb0[4], ca1[4], cb1[4];
+         for(int l=0;l<4;l++)
          {
-            tmpRgb.r = tmpRgb.g = tmpRgb.b = low + generator() % (high - low + 1);
+            uint32 key = inOct.keys[l];
+            int g00 = PerlinHash(key,ix0,iy0)>>28;
+            int g01 = PerlinHash(key,ix0,iy1)>>28;
+            int g10 = PerlinHash(key,ix1,iy0)>>28;
+            int g11 = PerlinHash(key,ix1,iy1)>>28;
+
+            ca0[l] = sPerlinGradX[g00] + wy*(sPerlinGradX[g01]-sPerlinGradX[g00]);
+            cb0[l] = sPerlinGradY[g00]*ty + wy*(sPerlinGradY[g01]*(ty-1.0f) - sPerlinGradY[g00]*ty);
+            ca1[l] = sPerlinGradX[g10] + wy*(sPerlinGradX[g11]-sPerlinGradX[g10]);
+            cb1[l] = sPerlinGradY[g10]*ty + wy*(sPerlinGradY[g11]*(ty-1.0f) - sPerlinGradY[g10]*ty) - ca1[l];
          }
-         else
-         {
-            if (channelOptions & CHAN_RED)
-               tmpRgb.r = low + generator() % range;
-            else
-               tmpRgb.r = 0;
+         a0 = PerlinLoad(ca0);
+         b0 = PerlinLoad(cb0);
+         a1 = PerlinLoad(ca1);
+         b1 = PerlinLoad(cb1);
+         prevCell = cell;
+         haveCell = true;
+      }
 
-            if (channelOptions & CHAN_GREEN)
-               tmpRgb.g = low + generator() % range;
-            else
-               tmpRgb.g = 0;
+      PerlinVec t = PerlinSet1(tx);
+      PerlinVec left = PerlinAdd(PerlinMul(a0,t),b0);
+      PerlinVec right = PerlinAdd(PerlinMul(a1,t),b1);
+      PerlinVec n = PerlinAdd(left, PerlinMul(PerlinSet1(PerlinFade(tx)), PerlinSub(right,left)));
+      if (!inFractal)
+         n = PerlinAbs(n);
 
-            if (channelOptions & CHAN_BLUE)
-               tmpRgb.b = low + generator() % range;
-            else
-               tmpRgb.b = 0;
+      float *sum = ioSum + x*4;
+      PerlinStore(sum, PerlinAdd(PerlinLoad(sum), PerlinMul(n,amp)));
+   }
+}
+
+static void SPerlinBand(int inBand, int inY0, int inY1, void *inJob)
+{
+   const PerlinJob &job = *(const PerlinJob *)inJob;
+   int w = job.target.mRect.w;
+   std::vector<float> sums(w*4);
+
+   // Fractal noise is centred on 128, turbulence starts at 0.  The bias includes the
+   //  rounding, and values are truncated the same way on every path.
+   float scale = job.fractal ? 127.5f*PERLIN_GAIN : 255.0f*PERLIN_GAIN;
+   float bias = job.fractal ? 128.0f : 0.5f;
+
+   for(int y=inY0;y<inY1;y++)
+   {
+      std::fill(sums.begin(), sums.end(), 0.0f);
+      for(int o=0;o<job.octaves.size();o++)
+         PerlinOctaveRow(job.octaves[o], y, job.fractal, w, &sums[0]);
+
+      uint32 *pixel = (uint32 *)job.target.Row(y);
+      const float *sum = &sums[0];
+      int x = 0;
+      #if defined(NME_SSE2)
+      __m128 vScale = _mm_set1_ps(scale);
+      __m128 vBias = _mm_set1_ps(bias);
+      for( ; x+1<w; x+=2, sum+=8)
+      {
+         __m128i c0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(sum),vScale),vBias));
+         __m128i c1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(sum+4),vScale),vBias));
+         __m128i rgba = _mm_packus_epi16(_mm_packs_epi32(c0,c1),_mm_setzero_si128());
+         pixel[x] = ((uint32)_mm_cvtsi128_si32(rgba) & job.keep) | job.fill;
+         pixel[x+1] = ((uint32)_mm_cvtsi128_si32(_mm_srli_si128(rgba,4)) & job.keep) | job.fill;
+      }
+      #elif defined(NME_NEON)
+      float32x4_t vScale = vdupq_n_f32(scale);
+      float32x4_t vBias = vdupq_n_f32(bias);
+      for( ; x+1<w; x+=2, sum+=8)
+      {
+         int32x4_t c0 = vcvtq_s32_f32(vaddq_f32(vmulq_f32(vld1q_f32(sum),vScale),vBias));
+         int32x4_t c1 = vcvtq_s32_f32(vaddq_f32(vmulq_f32(vld1q_f32(sum+4),vScale),vBias));
+         uint8x8_t rgba = vqmovun_s16(vcombine_s16(vqmovn_s32(c0),vqmovn_s32(c1)));
+         uint32x2_t both = vreinterpret_u32_u8(rgba);
+         pixel[x] = (vget_lane_u32(both,0) & job.keep) | job.fill;
+         pixel[x+1] = (vget_lane_u32(both,1) & job.keep) | job.fill;
+      }
+      #endif
+      for( ; x<w; x++, sum+=4)
+      {
+         uint32 result = 0;
+         for(int l=0;l<4;l++)
+         {
+            int v = (int)(sum[l]*scale + bias);
+            result |= (uint32)(v<0 ? 0 : v>255 ? 255 : v) << (l*8);
          }
+         pixel[x] = (result & job.keep) | job.fill;
+      }
+   }
+}
 
-         if (channelOptions & CHAN_ALPHA)
-            tmpRgb.a = low + generator() % range;
-         else
-            tmpRgb.a = 255;
+void SimpleSurface::perlinNoise(double baseX, double baseY, int numOctaves, int randomSeed, bool stitch,
+                                bool fractalNoise, int channelOptions, bool grayScale, const QuickVec<float> &offsets)
+{
+   if (mPixelFormat==pfAlpha || !mBase)
+      return;
 
-         *rgb = tmpRgb;
+   ChangeInternalFormat(pfBGRA);
 
-         rgb++;
+   PerlinJob job;
+   job.fractal = fractalNoise;
+
+   // Lanes are b,g,r,a.  Grey uses the red noise for all three.
+   uint32 channelKey[4] = { 3, 2, 1, 4 };
+   if (grayScale)
+   {
+      channelKey[0] = channelKey[1] = channelKey[2];
+      job.keep = (channelOptions & CHAN_ALPHA) ? 0xffffffff : 0x00ffffff;
+   }
+   else
+      job.keep = ( (channelOptions & CHAN_RED)   ? 0x00ff0000 : 0 ) |
+                 ( (channelOptions & CHAN_GREEN) ? 0x0000ff00 : 0 ) |
+                 ( (channelOptions & CHAN_BLUE)  ? 0x000000ff : 0 ) |
+                 ( (channelOptions & CHAN_ALPHA) ? 0xff000000 : 0 );
+   job.fill = (channelOptions & CHAN_ALPHA) ? 0 : 0xff000000;
+
+   double freqX = baseX>0 ? 1.0/baseX : 0.0;
+   double freqY = baseY>0 ? 1.0/baseY : 0.0;
+   float amplitude = 1.0f;
+   for(int o=0;o<numOctaves;o++)
+   {
+      PerlinOctave oct;
+      oct.freqX = freqX;
+      oct.freqY = freqY;
+      oct.periodX = oct.periodY = 0;
+      if (stitch)
+      {
+         // Round the frequency to a whole number of cells, so the edges match up
+         oct.periodX = std::max(1, (int)(mWidth*freqX + 0.5));
+         oct.periodY = std::max(1, (int)(mHeight*freqY + 0.5));
+         oct.freqX = (double)oct.periodX/mWidth;
+         oct.freqY = (double)oct.periodY/mHeight;
       }
+      oct.offsetX = o*2+1<offsets.size() ? offsets[o*2] : 0.0;
+      oct.offsetY = o*2+1<offsets.size() ? offsets[o*2+1] : 0.0;
+      oct.amplitude = amplitude;
+      for(int l=0;l<4;l++)
+         oct.keys[l] = PerlinHash((uint32)randomSeed, channelKey[l], o);
+      job.octaves.push_back(oct);
+
+      freqX *= 2.0;
+      freqY *= 2.0;
+      amplitude *= 0.5f;
    }
-   
+
+   job.target = BeginRender(Rect(0,0,mWidth,mHeight),false);
+   // Each octave of a pixel costs several simple pixel operations, so allow threads sooner
+   RunBulkBands(0, mHeight, mWidth*std::max(numOctaves,1)*8, SPerlinBand, &job);
    EndRender();
 }
 
@@ -1894,6 +2649,13 @@ SimpleSurface *SimpleSurface::fromStream(ObjectStreamIn &inStream)
    return result;
 }
 
+// --- Float tensors ---------------------------------------------------------------
+//
+// Every transform is linear in the byte value, so it is applied as value*scale + offset,
+//  a whole row at a time, straight from the source rows.  Subsampling averages boxes of
+//  pixels, expanding replicates them, and the floats can be interleaved (HWC) or one plane
+//  per channel (CHW).
+
 enum
 {
    FloatZeroMean   = 0x0001,
@@ -1902,63 +2664,297 @@ enum
    FloatStdScale   = 0x0008,
    FloatSwizzeRgb  = 0x0010,
    Float100Scale  = 0x0020,
+   FloatPlanar    = 0x0040,
 };
 
+enum { FLOAT_MAX_CHANNELS = 16 };
+
+
+static void BytesToFloats(float *outDest, const uint8 *inSrc, int inN, float inScale, float inOffset)
+{
+   int x = 0;
+   #if defined(NME_SSE2)
+   const __m128i zero = _mm_setzero_si128();
+   const __m128 scale = _mm_set1_ps(inScale);
+   const __m128 offset = _mm_set1_ps(inOffset);
+   for(;x+16<=inN;x+=16)
+   {
+      __m128i v = _mm_loadu_si128( (const __m128i *)(inSrc+x) );
+      __m128i lo = _mm_unpacklo_epi8(v,zero);
+      __m128i hi = _mm_unpackhi_epi8(v,zero);
+      _mm_storeu_ps(outDest+x,    _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo,zero)), scale), offset) );
+      _mm_storeu_ps(outDest+x+4,  _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo,zero)), scale), offset) );
+      _mm_storeu_ps(outDest+x+8,  _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi,zero)), scale), offset) );
+      _mm_storeu_ps(outDest+x+12, _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi,zero)), scale), offset) );
+   }
+   #elif defined(NME_NEON)
+   const float32x4_t scale = vdupq_n_f32(inScale);
+   const float32x4_t offset = vdupq_n_f32(inOffset);
+   for(;x+16<=inN;x+=16)
+   {
+      uint8x16_t v = vld1q_u8(inSrc+x);
+      uint16x8_t lo = vmovl_u8( vget_low_u8(v) );
+      uint16x8_t hi = vmovl_u8( vget_high_u8(v) );
+      vst1q_f32(outDest+x,    vmlaq_f32(offset, vcvtq_f32_u32( vmovl_u16(vget_low_u16(lo)) ), scale) );
+      vst1q_f32(outDest+x+4,  vmlaq_f32(offset, vcvtq_f32_u32( vmovl_u16(vget_high_u16(lo)) ), scale) );
+      vst1q_f32(outDest+x+8,  vmlaq_f32(offset, vcvtq_f32_u32( vmovl_u16(vget_low_u16(hi)) ), scale) );
+      vst1q_f32(outDest+x+12, vmlaq_f32(offset, vcvtq_f32_u32( vmovl_u16(vget_high_u16(hi)) ), scale) );
+   }
+   #endif
+   for(;x<inN;x++)
+      outDest[x] = inSrc[x]*inScale + inOffset;
+}
+
+static void IntsToFloats(float *outDest, const int *inSrc, int inN, float inScale, float inOffset)
+{
+   int x = 0;
+   #if defined(NME_SSE2)
+   const __m128 scale = _mm_set1_ps(inScale);
+   const __m128 offset = _mm_set1_ps(inOffset);
+   for(;x+4<=inN;x+=4)
+   {
+      __m128 v = _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i *)(inSrc+x) ) );
+      _mm_storeu_ps(outDest+x, _mm_add_ps( _mm_mul_ps(v,scale), offset) );
+   }
+   #elif defined(NME_NEON)
+   const float32x4_t scale = vdupq_n_f32(inScale);
+   const float32x4_t offset = vdupq_n_f32(inOffset);
+   for(;x+4<=inN;x+=4)
+      vst1q_f32(outDest+x, vmlaq_f32(offset, vcvtq_f32_s32( vld1q_s32(inSrc+x) ), scale) );
+   #endif
+   for(;x<inN;x++)
+      outDest[x] = inSrc[x]*inScale + inOffset;
+}
 
-void SimpleSurface::getFloats32(float *outData, int inStride, PixelFormat inFormat, int inTransform, int inSubsample,const Rect &bounds)
+// Clamps to [0,255] and truncates, like the scalar loop
+static void FloatsToBytes(uint8 *outDest, const float *inSrc, int inN, float inScale, float inOffset)
 {
-   int pixelSize = BytesPerPixel(inFormat);
+   int x = 0;
+   #if defined(NME_SSE2)
+   const __m128 scale = _mm_set1_ps(inScale);
+   const __m128 offset = _mm_set1_ps(inOffset);
+   const __m128 max = _mm_set1_ps(255.0f);
+   for(;x+8<=inN;x+=8)
+   {
+      __m128 a = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps(inSrc+x), scale), offset);
+      __m128 b = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps(inSrc+x+4), scale), offset);
+      __m128i words = _mm_packs_epi32( _mm_cvttps_epi32(_mm_min_ps(a,max)), _mm_cvttps_epi32(_mm_min_ps(b,max)) );
+      _mm_storel_epi64( (__m128i *)(outDest+x), _mm_packus_epi16(words,words) );
+   }
+   #elif defined(NME_NEON)
+   const float32x4_t scale = vdupq_n_f32(inScale);
+   const float32x4_t offset = vdupq_n_f32(inOffset);
+   for(;x+8<=inN;x+=8)
+   {
+      uint32x4_t a = vcvtq_u32_f32( vmlaq_f32(offset, vld1q_f32(inSrc+x), scale) );
+      uint32x4_t b = vcvtq_u32_f32( vmlaq_f32(offset, vld1q_f32(inSrc+x+4), scale) );
+      vst1_u8(outDest+x, vqmovn_u16( vcombine_u16( vqmovn_u32(a), vqmovn_u32(b) ) ) );
+   }
+   #endif
+   for(;x<inN;x++)
+   {
+      float fval = inSrc[x]*inScale + inOffset;
+      outDest[x] = fval < 0.0f ? 0 : fval>=255.0f ? 255 : (int)fval;
+   }
+}
 
-   std::vector<unsigned char> buffer;
-   const unsigned char *ptr = mBase + mStride*bounds.y + bounds.x*BytesPerPixel(mPixelFormat);
-   int w = bounds.w;
-   int h = bounds.h;
-   // TODO - inSubsample
-   int stride = mStride;
-   if (inFormat!=mPixelFormat)
+
+// Float channel c comes from byte c of the pixel, or from byte 2-c when swizzling RGB
+static bool BuildFloatChannelMap(int *outMap, int inChannels, PixelFormat inFormat, int inTransform)
+{
+   for(int c=0;c<inChannels;c++)
+      outMap[c] = c;
+   bool swizzle = (inTransform & FloatSwizzeRgb) &&
+                  (inFormat==pfRGB || inFormat==pfBGRA || inFormat==pfRGBA ||
+                   inFormat==pfBGRPremA || inFormat==pfRGBPremA);
+   if (swizzle)
+   {
+      outMap[0] = 2;
+      outMap[2] = 0;
+   }
+   return !swizzle;
+}
+
+
+struct GetFloatsJob
+{
+   const uint8 *src;
+   int          srcStride;
+   PixelFormat  srcFormat;
+   PixelFormat  format;
+   // Source pixels used from each row
+   int          width;
+   int          channels;
+   int          sub;
+   int          outWidth;
+   char        *out;
+   int          outStride;
+   int          planeStride;
+   bool         planar;
+   bool         identity;
+   int          channelMap[FLOAT_MAX_CHANNELS];
+   float        scale;
+   float        offset;
+   std::vector<int> histo;
+};
+
+static const uint8 *FloatsSourceRow(const GetFloatsJob &job, int inY, std::vector<uint8> &ioBuffer)
+{
+   const uint8 *row = job.src + job.srcStride*inY;
+   if (job.srcFormat==job.format)
+      return row;
+   int bytes = job.width*job.channels;
+   ioBuffer.resize(bytes);
+   PixelConvert(job.width, 1,
+       job.srcFormat, row, job.srcStride, 0,
+       job.format, &ioBuffer[0], bytes, 0 );
+   return &ioBuffer[0];
+}
+
+static void SFloatsHistogramBand(int inBand, int inY0, int inY1, void *inJob)
+{
+   GetFloatsJob &job = *(GetFloatsJob *)inJob;
+   int *histo = &job.histo[inBand*256];
+   int n = job.width*job.channels;
+   std::vector<uint8> buffer;
+   for(int y=inY0;y<inY1;y++)
+   {
+      const uint8 *p = FloatsSourceRow(job,y,buffer);
+      for(int x=0;x<n;x++)
+         histo[p[x]]++;
+   }
+}
+
+static void SGetFloatsBand(int, int inY0, int inY1, void *inJob)
+{
+   GetFloatsJob &job = *(GetFloatsJob *)inJob;
+   const int ch = job.channels;
+   const int sub = job.sub;
+   const int ow = job.outWidth;
+   const int *map = job.channelMap;
+   const int n = ow*ch;
+
+   std::vector<uint8> buffer;
+   std::vector<uint8> bytes(n);
+   std::vector<int>   sums(sub>1 ? n : 0);
+   // Box sums are averaged by folding the area into the scale
+   float scale = job.scale/(sub*sub);
+
+   for(int y=inY0;y<inY1;y++)
    {
-      stride = w * pixelSize;
-      buffer.resize( stride * h );
-      PixelConvert(w, h,
-          mPixelFormat,  ptr, mStride, GetPlaneOffset(),
-          inFormat, &buffer[0], stride, 0 );
-      ptr = &buffer[0];
+      float *dest = (float *)(job.out + job.outStride*y);
+      if (sub==1)
+      {
+         const uint8 *p = FloatsSourceRow(job,y,buffer);
+         if (job.identity && !job.planar)
+         {
+            BytesToFloats(dest, p, n, job.scale, job.offset);
+            continue;
+         }
+         if (job.planar)
+            for(int c=0;c<ch;c++)
+            {
+               uint8 *b = &bytes[c*ow];
+               const uint8 *s = p + map[c];
+               for(int x=0;x<ow;x++)
+                  b[x] = s[x*ch];
+            }
+         else
+            for(int x=0;x<ow;x++)
+               for(int c=0;c<ch;c++)
+                  bytes[x*ch+c] = p[x*ch+map[c]];
+
+         if (job.planar)
+            for(int c=0;c<ch;c++)
+               BytesToFloats( (float *)((char *)dest + job.planeStride*c), &bytes[c*ow], ow, job.scale, job.offset);
+         else
+            BytesToFloats(dest, &bytes[0], n, job.scale, job.offset);
+      }
+      else
+      {
+         std::fill(sums.begin(), sums.end(), 0);
+         for(int sy=0;sy<sub;sy++)
+         {
+            const uint8 *p = FloatsSourceRow(job,y*sub+sy,buffer);
+            for(int x=0;x<ow;x++)
+               for(int sx=0;sx<sub;sx++)
+               {
+                  const uint8 *pixel = p + (x*sub+sx)*ch;
+                  if (job.planar)
+                     for(int c=0;c<ch;c++)
+                        sums[c*ow+x] += pixel[map[c]];
+                  else
+                     for(int c=0;c<ch;c++)
+                        sums[x*ch+c] += pixel[map[c]];
+               }
+         }
+
+         if (job.planar)
+            for(int c=0;c<ch;c++)
+               IntsToFloats( (float *)((char *)dest + job.planeStride*c), &sums[c*ow], ow, scale, job.offset);
+         else
+            IntsToFloats(dest, &sums[0], n, scale, job.offset);
+      }
    }
-   bool swizzleRgb = (inTransform & FloatSwizzeRgb );
+}
+
+
+// inSubsample averages boxes of inSubsample x inSubsample pixels.  The mean and
+//  standard deviation are measured over the full-resolution pixels that are used.
+void SimpleSurface::getFloats32(float *outData, int inStride, PixelFormat inFormat, int inTransform, int inSubsample,const Rect &bounds)
+{
+   Rect r = bounds.Intersect( Rect(mWidth,mHeight) );
+   int sub = std::max(inSubsample,1);
+   int ch = BytesPerPixel(inFormat);
+   int outW = r.w/sub;
+   int outH = r.h/sub;
+   if (!mBase || outW<1 || outH<1 || ch<1 || ch>FLOAT_MAX_CHANNELS)
+      return;
 
+   GetFloatsJob job;
+   job.src = mBase + mStride*r.y + r.x*BytesPerPixel(mPixelFormat);
+   job.srcStride = mStride;
+   job.srcFormat = mPixelFormat;
+   job.format = inFormat;
+   job.width = outW*sub;
+   job.channels = ch;
+   job.sub = sub;
+   job.outWidth = outW;
+   job.out = (char *)outData;
+   job.planar = inTransform & FloatPlanar;
+   job.outStride = inStride ? inStride : (job.planar ? outW : outW*ch)*(int)sizeof(float);
+   job.planeStride = job.outStride*outH;
+   job.identity = BuildFloatChannelMap(job.channelMap, ch, inFormat, inTransform);
+
+   int rows = outH*sub;
    int histo[256];
-   int ppr = w * pixelSize;
-   int count = ppr*h;
+   double count = (double)job.width*ch*rows;
 
    if ( inTransform & (FloatZeroMean | FloatStdScale) )
    {
+      int bands = BulkBandCount(rows);
+      job.histo.resize(bands*256);
+      RunBulkBands(0, rows, job.width, SFloatsHistogramBand, &job);
+
       memset(histo, 0, sizeof(histo));
-      for(int y=0;y<h;y++)
-      {
-         const Uint8 *p = ptr + y*stride;
-         for(int x=0;x<ppr;x++)
-            histo[p[x]]++;
-      }
+      for(int b=0;b<bands;b++)
+         for(int i=0;i<256;i++)
+            histo[i] += job.histo[b*256+i];
    }
-   float lut[256];
 
+   double mean = 0;
+   double scale = 1;
    if (!inTransform)
    {
-      for(int i=0;i<256;i++)
-         lut[i] = i;
    }
    else if ( (inTransform & FloatUnitScale) && !(inTransform & FloatZeroMean) )
    {
+      scale = 1.0/255.0;
       if (inTransform & Float128Mean)
-         for(int i=0;i<256;i++)
-            lut[i] = (double)(i-128)/255.0;
-      else
-         for(int i=0;i<256;i++)
-            lut[i] = (double)i/255.0;
+         mean = 128.0;
    }
    else
    {
-      double mean = 0;
       if (inTransform & Float128Mean)
       {
          mean = 128.0;
@@ -1967,11 +2963,10 @@ void SimpleSurface::getFloats32(float *outData, int inStride, PixelFormat inForm
       {
          double sum = 0;
          for(int i=0;i<256;i++)
-            sum+=histo[i]*i;
-         mean = (double)sum/count;
+            sum+=(double)histo[i]*i;
+         mean = sum/count;
       }
 
-      double scale = 1;
       if (inTransform & FloatUnitScale)
       {
          scale = 1.0/255;
@@ -1988,33 +2983,11 @@ void SimpleSurface::getFloats32(float *outData, int inStride, PixelFormat inForm
          if (sumSig2>0)
             scale = sqrt(count/sumSig2);
       }
-
-
-      for(int i=0;i<256;i++)
-         lut[i] = (i-mean)*scale;
    }
+   job.scale = scale;
+   job.offset = -mean*scale;
 
-   float *dest = outData;
-   for(int y=0;y<h;y++)
-   {
-      const Uint8 *src = ptr + y*stride;
-      if (inStride)
-         dest = (float *)( (char *)outData + inStride*y );
-
-      if (swizzleRgb && inFormat==pfRGB)
-      {
-        for(int x=0;x<w;x++)
-        {
-           *dest++ = lut[src[2]];
-           *dest++ = lut[src[1]];
-           *dest++ = lut[src[0]];
-           src+=3;
-        }
-      }
-      else
-        for(int x=0;x<ppr;x++)
-           *dest++ = lut[*src++];
-   }
+   RunBulkBands(0, outH, job.width*sub, SGetFloatsBand, &job);
 }
 
 
@@ -2046,6 +3019,7 @@ void SimpleSurface::getUInts8(uint8 *outData, int inStride, PixelFormat inFormat
 void SimpleSurface::setUInts8(const uint8 *inData, int inStride, PixelFormat inFormat, int inExpand)
 {
    // TODO - inExpand
+   mVersion++;
    int pixelSize = BytesPerPixel(inFormat);
    int stride = inStride==0 ? pixelSize*mWidth : inStride;
    if (inFormat!=mPixelFormat)
@@ -2068,66 +3042,112 @@ void SimpleSurface::setUInts8(const uint8 *inData, int inStride, PixelFormat inF
 
 
 
-void SimpleSurface::setFloats32(const float *inData, int inStride, PixelFormat inFormat, int inTransform, int inExpand,const Rect &bounds)
+struct SetFloatsJob
 {
-   Uint8 *ptr = mBase + mStride*bounds.y + bounds.x*BytesPerPixel(mPixelFormat);
-   int w = bounds.w;
-   int h = bounds.h;
+   uint8       *dest;
+   int          destStride;
+   PixelFormat  destFormat;
+   PixelFormat  format;
+   int          width;
+   int          channels;
+   int          expand;
+   int          inWidth;
+   const char  *in;
+   int          inStride;
+   int          planeStride;
+   bool         planar;
+   bool         identity;
+   int          channelMap[FLOAT_MAX_CHANNELS];
+   float        scale;
+   float        offset;
+};
 
-   std::vector<unsigned char> buffer;
-   // TODO - inExpand
+static void SSetFloatsBand(int, int inY0, int inY1, void *inJob)
+{
+   SetFloatsJob &job = *(SetFloatsJob *)inJob;
+   const int ch = job.channels;
+   const int expand = job.expand;
+   const int iw = job.inWidth;
+   const int *map = job.channelMap;
+   const bool direct = job.format==job.destFormat;
 
-   int stride = mStride;
-   int pixelSize = BytesPerPixel(inFormat);
+   std::vector<uint8> values(iw*ch);
+   std::vector<uint8> pixels(job.width*ch);
+   int builtRow = -1;
 
-   if (inFormat!=mPixelFormat)
+   for(int y=inY0;y<inY1;y++)
    {
-      stride = w * pixelSize;
-      buffer.resize( stride * h );
-      ptr = &buffer[0];
-   }
-   int ppr = w * pixelSize;
+      uint8 *row = job.dest + job.destStride*y;
+      int iy = y/expand;
+      const float *src = (const float *)(job.in + job.inStride*iy);
 
-   const float *src = inData;
-   #define GET_FLOAT( EXPR ) { \
-         for(int y=0;y<h;y++) \
-         { \
-            Uint8 *dest = ptr + y*stride; \
-            if (inStride) \
-               src = (const float *)( (char *)inData + y*inStride ); \
-            for(int x=0;x<ppr;x++) \
-            { \
-               float fval = EXPR ; \
-               *dest++ = fval < 0.0f ? 0 : fval>=255.0f ? 255 : (int)fval; \
-            } \
-         } \
+      if (direct && job.identity && !job.planar && expand==1)
+      {
+         FloatsToBytes(row, src, iw*ch, job.scale, job.offset);
+         continue;
       }
 
+      if (iy!=builtRow)
+      {
+         if (job.planar)
+            for(int c=0;c<ch;c++)
+               FloatsToBytes(&values[c*iw], (const float *)((const char *)src + job.planeStride*c), iw, job.scale, job.offset);
+         else
+            FloatsToBytes(&values[0], src, iw*ch, job.scale, job.offset);
 
+         for(int x=0;x<job.width;x++)
+         {
+            int ix = x/expand;
+            uint8 *pixel = &pixels[x*ch];
+            if (job.planar)
+               for(int c=0;c<ch;c++)
+                  pixel[map[c]] = values[c*iw+ix];
+            else
+               for(int c=0;c<ch;c++)
+                  pixel[map[c]] = values[ix*ch+c];
+         }
+         builtRow = iy;
+      }
 
-
-   if (inTransform & Float128Mean)
-   {
-      if (inTransform & FloatUnitScale)
-         GET_FLOAT( *src++ * 255.0f + 128.0f )
-      else
-         GET_FLOAT( *src++ + 128.0f )
-   }
-   else
-   {
-      if (inTransform & FloatUnitScale)
-         GET_FLOAT( *src++ * 255.0f  )
+      if (direct)
+         memcpy(row, &pixels[0], job.width*ch);
       else
-         GET_FLOAT( *src++  )
+         PixelConvert(job.width, 1,
+             job.format, &pixels[0], job.width*ch, 0,
+             job.destFormat, row, job.destStride, 0 );
    }
+}
 
 
-   if (inFormat!=mPixelFormat)
-   {
-      PixelConvert(w, h,
-          inFormat,  &buffer[0], stride, 0,
-          mPixelFormat, ptr, mStride, 0 );
-   }
+// inExpand writes each float pixel to a block of inExpand x inExpand pixels
+void SimpleSurface::setFloats32(const float *inData, int inStride, PixelFormat inFormat, int inTransform, int inExpand,const Rect &bounds)
+{
+   Rect r = bounds.Intersect( Rect(mWidth,mHeight) );
+   int expand = std::max(inExpand,1);
+   int ch = BytesPerPixel(inFormat);
+   if (!mBase || r.w<1 || r.h<1 || ch<1 || ch>FLOAT_MAX_CHANNELS)
+      return;
+   mVersion++;
+
+   SetFloatsJob job;
+   job.dest = mBase + mStride*r.y + r.x*BytesPerPixel(mPixelFormat);
+   job.destStride = mStride;
+   job.destFormat = mPixelFormat;
+   job.format = inFormat;
+   job.width = r.w;
+   job.channels = ch;
+   job.expand = expand;
+   job.inWidth = (r.w+expand-1)/expand;
+   job.in = (const char *)inData;
+   job.planar = inTransform & FloatPlanar;
+   job.inStride = inStride ? inStride : (job.planar ? job.inWidth : job.inWidth*ch)*(int)sizeof(float);
+   job.planeStride = job.inStride*((r.h+expand-1)/expand);
+   job.identity = BuildFloatChannelMap(job.channelMap, ch, inFormat, inTransform);
+
+   job.scale = (inTransform & FloatUnitScale) ? 255.0f : (inTransform & Float100Scale) ? 100.0f : 1.0f;
+   job.offset = (inTransform & Float128Mean) ? 128.0f : 0.0f;
+
+   RunBulkBands(0, r.h, r.w, SSetFloatsBand, &job, mPixelFormat!=pfAlpha);
 }
 
 
@@ -0,0 +1,203 @@
+#include <Surface.h>
+#include <vector>
+
+namespace nme
+{
+
+// Surfaces are grouped by power-of-2 byte size, and matched exactly on size and format,
+//  since the filters and caches use the surface dimensions directly.
+// The pool keeps one reference on each surface - a surface whose only reference is the
+//  pool's is free to be handed out again, along with its texture.
+enum { SURFACE_CLASS_COUNT = 32, SURFACE_MAX_IDLE_FRAMES = 120 };
+
+struct PooledSurface
+{
+   SimpleSurface *surface;
+   int bytes;
+   // Frame on which it was first seen free, or -1 while in use
+   int idleSince;
+};
+
+typedef std::vector<PooledSurface> PooledSurfaces;
+
+static PooledSurfaces sSurfaceClasses[SURFACE_CLASS_COUNT];
+static SurfacePoolStats sSurfaceStats;
+static int sSurfaceFrame = 0;
+static int sSurfaceBudget = 32<<20;
+// All pooled surfaces, free or in use
+static double sSurfaceBytes = 0;
+
+
+static int SurfaceClassOf(int inBytes)
+{
+   int c = 0;
+   while(c<SURFACE_CLASS_COUNT-1 && (1<<c)<inBytes)
+      c++;
+   return c;
+}
+
+static inline bool IsFree(const PooledSurface &inSurface) { return inSurface.surface->GetRefCount()<=1; }
+
+static void ReleasePooled(PooledSurfaces &ioPool, int inIndex)
+{
+   sSurfaceBytes -= ioPool[inIndex].bytes;
+   ioPool[inIndex].surface->DecRef();
+   ioPool[inIndex] = ioPool[ioPool.size()-1];
+   ioPool.resize(ioPool.size()-1);
+   sSurfaceStats.trimmed++;
+}
+
+
+// Releases the least recently freed surfaces until the free ones fit the budget
+static void TrimFreeToBudget(double inFreeBytes)
+{
+   double pooledBytes = inFreeBytes;
+   while(pooledBytes>sSurfaceBudget)
+   {
+      PooledSurfaces *oldestPool = 0;
+      int oldest = -1;
+      for(int c=0;c<SURFACE_CLASS_COUNT;c++)
+      {
+         PooledSurfaces &pool = sSurfaceClasses[c];
+         for(int i=0;i<pool.size();i++)
+            if (IsFree(pool[i]) && (!oldestPool || pool[i].idleSince<(*oldestPool)[oldest].idleSince))
+            {
+               oldestPool = &pool;
+               oldest = i;
+            }
+      }
+      if (!oldestPool)
+         break;
+      pooledBytes -= (*oldestPool)[oldest].bytes;
+      ReleasePooled(*oldestPool,oldest);
+   }
+}
+
+
+SimpleSurface *AcquireScratchSurface(int inWidth, int inHeight, PixelFormat inFormat, bool inClear)
+{
+   sSurfaceStats.acquires++;
+   int bytes = inWidth*inHeight*BytesPerPixel(inFormat);
+   PooledSurfaces &pool = sSurfaceClasses[SurfaceClassOf(bytes)];
+
+   // Prefer the most recently used match, since its texture is the most likely to be resident
+   int best = -1;
+   for(int i=0;i<pool.size();i++)
+   {
+      const PooledSurface &p = pool[i];
+      const SimpleSurface *s = p.surface;
+      if (IsFree(p) && s->Width()==inWidth && s->Height()==inHeight && s->Format()==inFormat &&
+            s->GetBase() && (best<0 || p.idleSince>pool[best].idleSince) )
+         best = i;
+   }
+
+   SimpleSurface *result = 0;
+   if (best>=0)
+   {
+      sSurfaceStats.reused++;
+      pool[best].idleSince = -1;
+      result = pool[best].surface;
+      result->IncRef();
+      // The new owner may not write every pixel (eg, power-of-2 padding), so the old
+      //  owner's texels must not survive in the texture or the mips
+      result->DirtyAll();
+   }
+   else
+   {
+      // Without a stage nothing trims the pool once a frame, so keep the free surfaces in budget here
+      if (sSurfaceBytes+bytes>sSurfaceBudget)
+      {
+         double freeBytes = 0;
+         for(int c=0;c<SURFACE_CLASS_COUNT;c++)
+         {
+            const PooledSurfaces &classPool = sSurfaceClasses[c];
+            for(int i=0;i<classPool.size();i++)
+               if (IsFree(classPool[i]))
+                  freeBytes += classPool[i].bytes;
+         }
+         TrimFreeToBudget(freeBytes);
+      }
+
+      sSurfaceStats.created++;
+      result = new SimpleSurface(inWidth, inHeight, inFormat);
+      // One for the pool, one for the caller
+      result->IncRef();
+      result->IncRef();
+      PooledSurface p = { result, bytes, -1 };
+      pool.push_back(p);
+      sSurfaceBytes += bytes;
+   }
+
+   if (inClear)
+      result->Zero();
+   return result;
+}
+
+
+// Called once a frame: surfaces that have not been wanted for SURFACE_MAX_IDLE_FRAMES are
+//  released, and then the least recently used ones until the free surfaces fit the budget.
+void TrimSurfacePool(bool inAll)
+{
+   sSurfaceFrame++;
+
+   double pooledBytes = 0;
+   for(int c=0;c<SURFACE_CLASS_COUNT;c++)
+   {
+      PooledSurfaces &pool = sSurfaceClasses[c];
+      for(int i=0;i<pool.size(); )
+      {
+         PooledSurface &p = pool[i];
+         if (!IsFree(p))
+         {
+            p.idleSince = -1;
+            i++;
+         }
+         else
+         {
+            if (p.idleSince<0)
+               p.idleSince = sSurfaceFrame;
+            if (inAll || sSurfaceFrame-p.idleSince > SURFACE_MAX_IDLE_FRAMES || !p.surface->GetBase())
+               ReleasePooled(pool,i);
+            else
+            {
+               pooledBytes += p.bytes;
+               i++;
+            }
+         }
+      }
+   }
+
+   TrimFreeToBudget(pooledBytes);
+}
+
+
+void SetSurfacePoolBudget(int inBytes)
+{
+   sSurfaceBudget = inBytes<0 ? 0 : inBytes;
+}
+
+
+void GetSurfacePoolStats(SurfacePoolStats &outStats, bool inReset)
+{
+   outStats = sSurfaceStats;
+   outStats.surfaces = 0;
+   outStats.bytesInUse = 0;
+   outStats.bytesPooled = 0;
+   for(int c=0;c<SURFACE_CLASS_COUNT;c++)
+   {
+      const PooledSurfaces &pool = sSurfaceClasses[c];
+      outStats.surfaces += pool.size();
+      for(int i=0;i<pool.size();i++)
+      {
+         if (IsFree(pool[i]))
+            outStats.bytesPooled += pool[i].bytes;
+         else
+            outStats.bytesInUse += pool[i].bytes;
+      }
+   }
+
+   if (inReset)
+      sSurfaceStats.acquires = sSurfaceStats.reused = sSurfaceStats.created = sSurfaceStats.trimmed = 0;
+}
+
+} // end namespace nme
@@ -72,7 +72,7 @@ TextField::TextField(bool inInitRef) : DisplayObject(inInitRef),
    fontScale = 1.0;
    fontToLocal = 1.0;
    mLastUpDownX = -1;
-   needsSoftKeyboard = true;
+   setNeedsSoftKeyboard(true);
    mHasCaret = false;
    screenGrid = false;
    mBlink0 = GetTimeStamp();
@@ -88,6 +88,7 @@ TextField::~TextField()
       mTiles->DecRef();
    defaultTextFormat->DecRef();
    mCharGroups.DeleteAll();
+   ClearHtmlFormats();
 }
 
 double TextField::getWidth()
@@ -153,6 +154,7 @@ void TextField::setDefaultTextFormat(TextFormat *inFmt)
    if (defaultTextFormat)
       defaultTextFormat->DecRef();
    defaultTextFormat = inFmt;
+   ClearHtmlFormats();
    textColor = defaultTextFormat->color;
    mLinesDirty = true;
    mGfxDirty = true;
@@ -1252,156 +1254,294 @@ int MySSCANHex(const wchar_t *inStr, int *outValue)
    #endif
 }
 
-void TextField::AddNode(const TiXmlNode *inNode, TextFormat *inFormat,int &ioCharCount)
+// --- HTML text ---------------------------------------------------------
+
+// Single pass reader for the tag subset setHTMLText understands (font, b, i, u,
+//  p, br, a and align).  Runs go straight into the char groups, and identical tags
+//  opened under the same format share one derived TextFormat.
+
+static inline bool IsHtmlSpace(wchar_t inCh)
+{
+   return inCh==' ' || inCh=='\t' || inCh=='\n' || inCh=='\r';
+}
+
+// ioP points at '&' - returns the decoded char, or '&' if it is not an entity
+static wchar_t ReadHtmlEntity(const wchar_t *&ioP, const wchar_t *inEnd)
 {
-   for(const TiXmlNode *child = inNode->FirstChild(); child; child = child->NextSibling() )
+   static const struct { const wchar_t *name; int len; wchar_t chr; } sEntities[] = {
+      { L"amp;", 4, '&' }, { L"lt;", 3, '<' }, { L"gt;", 3, '>' },
+      { L"quot;", 5, '"' }, { L"apos;", 5, '\'' }, { L"nbsp;", 5, 0xa0 } };
+
+   const wchar_t *p = ioP+1;
+   if (p<inEnd && *p=='#')
    {
-      const TiXmlText *text = child->ToText();
-      if (text)
+      p++;
+      int base = 10;
+      if (p<inEnd && (*p=='x' || *p=='X'))
       {
-         CharGroup *chars = new CharGroup;;
-         chars->mFormat = inFormat->IncRef();
-         chars->mFont = 0;
-         chars->mFontHeight = 0;
-         chars->mFlags = 0;
-         chars->mString.Set(text->Value(), wcslen( text->Value() ));
-         ioCharCount += chars->Chars();
-
-         mCharGroups.push_back(chars);
-         //printf("text: %s\n", text->Value());
+         base = 16;
+         p++;
       }
-      else
+      const wchar_t *digits = p;
+      unsigned int code = 0;
+      for(;p<inEnd;p++)
+      {
+         int d = -1;
+         if (*p>='0' && *p<='9') d = *p-'0';
+         else if (base==16 && *p>='a' && *p<='f') d = *p-'a'+10;
+         else if (base==16 && *p>='A' && *p<='F') d = *p-'A'+10;
+         if (d<0)
+            break;
+         code = code*base + d;
+      }
+      if (p>digits && p<inEnd && *p==';')
       {
-         const TiXmlElement *el = child->ToElement();
-         if (el)
+         ioP = p+1;
+         return (wchar_t)code;
+      }
+   }
+   else
+   {
+      for(int i=0;i<sizeof(sEntities)/sizeof(sEntities[0]);i++)
+         if (inEnd-p>=sEntities[i].len && !wcsncmp(p,sEntities[i].name,sEntities[i].len))
          {
-            TextFormat *fmt = inFormat->IncRef();
+            ioP = p + sEntities[i].len;
+            return sEntities[i].chr;
+         }
+   }
+   ioP++;
+   return '&';
+}
 
-            if (el->ValueTStr()==L"font")
-            {
-               for (const TiXmlAttribute *att = el->FirstAttribute(); att;
-                          att = att->Next())
-               {
-                  const wchar_t *val = att->Value();
-                  if (att->NameTStr()==L"color" && val[0]=='#')
-                  {
-                     int col;
-                     if (MySSCANHex(val+1,&col))
-                     {
-                        fmt = fmt->COW();
-                        fmt->color = col;
-                     }
-                  }
-                  else if (att->NameTStr()==L"face")
-                  {
-                     fmt = fmt->COW();
-                     fmt->font = val;
-                  }
-                  else if (att->NameTStr()==L"size")
-                  {
-                     int size=0;
-                     if (MySSCAND(val,&size))
-                     {
-                        fmt = fmt->COW();
-                        if (val[0]=='-' || val[0]=='+')
-                           fmt->size = std::max( (int)fmt->size + size, 0 );
-                        else
-                           fmt->size = size;
-                     }
-                  }
-               }
-            }
-            else if (el->ValueTStr()==L"b")
-            {
-               if (!fmt->bold)
-               {
-                  fmt = fmt->COW();
-                  fmt->bold = true;
-               }
-            }
-            else if (el->ValueTStr()==L"i")
-            {
-               if (!fmt->italic)
-               {
-                  fmt = fmt->COW();
-                  fmt->italic = true;
-               }
-            }
-            else if (el->ValueTStr()==L"u")
+struct HtmlTag
+{
+   enum { maxAttribs = 8 };
+
+   const wchar_t *start;
+   const wchar_t *end;
+   bool    close;
+   bool    selfClose;
+   WString name;
+   int     attribCount;
+   WString attribName[maxAttribs];
+   WString attribValue[maxAttribs];
+
+   const WString *get(const wchar_t *inName) const
+   {
+      for(int i=0;i<attribCount;i++)
+         if (attribName[i]==inName)
+            return &attribValue[i];
+      return 0;
+   }
+};
+
+static void ReadHtmlWord(const wchar_t *&ioP, const wchar_t *inEnd, WString &outWord)
+{
+   outWord.clear();
+   while(ioP<inEnd && !IsHtmlSpace(*ioP) && *ioP!='>' && *ioP!='/' && *ioP!='=')
+   {
+      wchar_t ch = *ioP++;
+      outWord += (ch>='A' && ch<='Z') ? ch-'A'+'a' : ch;
+   }
+}
+
+// Parses the tag starting at '<'.  Returns false if the tag is not terminated.
+static bool ReadHtmlTag(const wchar_t *inP, const wchar_t *inEnd, HtmlTag &outTag)
+{
+   const wchar_t *p = inP+1;
+   outTag.start = inP;
+   outTag.close = p<inEnd && *p=='/';
+   if (outTag.close)
+      p++;
+   outTag.selfClose = false;
+   outTag.attribCount = 0;
+   ReadHtmlWord(p,inEnd,outTag.name);
+
+   while(p<inEnd)
+   {
+      while(p<inEnd && IsHtmlSpace(*p))
+         p++;
+      if (p>=inEnd)
+         break;
+      if (*p=='>')
+      {
+         outTag.end = p+1;
+         return true;
+      }
+      if (*p=='/' || *p=='=')
+      {
+         outTag.selfClose = *p=='/';
+         p++;
+         continue;
+      }
+
+      WString dummyName, dummyValue;
+      bool keep = outTag.attribCount<HtmlTag::maxAttribs;
+      WString &name = keep ? outTag.attribName[outTag.attribCount] : dummyName;
+      WString &val = keep ? outTag.attribValue[outTag.attribCount] : dummyValue;
+      ReadHtmlWord(p,inEnd,name);
+      val.clear();
+      while(p<inEnd && IsHtmlSpace(*p))
+         p++;
+      if (p<inEnd && *p=='=')
+      {
+         p++;
+         while(p<inEnd && IsHtmlSpace(*p))
+            p++;
+         wchar_t quote = p<inEnd && (*p=='"' || *p=='\'') ? *p++ : 0;
+         while(p<inEnd && (quote ? *p!=quote : !IsHtmlSpace(*p) && *p!='>') )
+         {
+            if (*p=='&')
+               val += ReadHtmlEntity(p,inEnd);
+            else
+               val += *p++;
+         }
+         if (quote && p<inEnd)
+            p++;
+      }
+      if (keep)
+         outTag.attribCount++;
+   }
+   return false;
+}
+
+struct OpenHtmlTag
+{
+   WString    name;
+   TextFormat *format;
+};
+
+// Enough for the formats of any reasonable chat panel - beyond that, start again
+enum { HTML_FORMAT_CACHE_MAX = 256 };
+
+static TextFormat *ApplyHtmlTag(TextFormat *inBase, const HtmlTag &inTag)
+{
+   TextFormat *fmt = inBase->IncRef();
+   const WString &name = inTag.name;
+
+   if (name==L"font")
+   {
+      for(int a=0;a<inTag.attribCount;a++)
+      {
+         const WString &att = inTag.attribName[a];
+         const wchar_t *val = inTag.attribValue[a].c_str();
+         if (att==L"color" && val[0]=='#')
+         {
+            int col;
+            if (MySSCANHex(val+1,&col))
             {
-               if (!fmt->underline)
-               {
-                  fmt = fmt->COW();
-                  fmt->underline = true;
-               }
+               fmt = fmt->COW();
+               fmt->color = col;
             }
-            else if (el->ValueTStr()==L"br")
+         }
+         else if (att==L"face")
+         {
+            fmt = fmt->COW();
+            fmt->font = val;
+         }
+         else if (att==L"size")
+         {
+            int size=0;
+            if (MySSCAND(val,&size))
             {
-               if (mCharGroups.size())
-               {
-                  CharGroup &last = *mCharGroups[ mCharGroups.size()-1 ];
-                  last.mString.push_back('\n');
-                  ioCharCount++;
-               }
+               fmt = fmt->COW();
+               if (val[0]=='-' || val[0]=='+')
+                  fmt->size = std::max( (int)fmt->size + size, 0 );
                else
-               {
-                  CharGroup *chars = new CharGroup;
-                  chars->mFormat = inFormat->IncRef();
-                  chars->mFont = 0;
-                  chars->mFontHeight = 0;
-                  chars->mFlags = 0;
-                  chars->mString.push_back('\n');
-                  ioCharCount++;
-                  mCharGroups.push_back(chars);
-               }
-            }
-            else if (el->ValueTStr()==L"p")
-            {
-               if (ioCharCount > 0)
-               {
-                  if (mCharGroups.size())
-                  {
-                     CharGroup &last = *mCharGroups[ mCharGroups.size()-1 ];
-                     last.mString.push_back('\n');
-                     ioCharCount++;
-                  }
-                  else
-                  {
-                     CharGroup *chars = new CharGroup;
-                     chars->mFormat = inFormat->IncRef();
-                     chars->mFont = 0;
-                     chars->mFontHeight = 0;
-                     chars->mFlags = 0;
-                     chars->mString.push_back('\n');
-                     ioCharCount++;
-                     mCharGroups.push_back(chars);
-                  }
-               }
+                  fmt->size = size;
             }
+         }
+      }
+   }
+   else if (name==L"b")
+   {
+      if (!fmt->bold)
+      {
+         fmt = fmt->COW();
+         fmt->bold = true;
+      }
+   }
+   else if (name==L"i")
+   {
+      if (!fmt->italic)
+      {
+         fmt = fmt->COW();
+         fmt->italic = true;
+      }
+   }
+   else if (name==L"u")
+   {
+      if (!fmt->underline)
+      {
+         fmt = fmt->COW();
+         fmt->underline = true;
+      }
+   }
+   else if (name==L"a")
+   {
+      if (const WString *href = inTag.get(L"href"))
+      {
+         fmt = fmt->COW();
+         fmt->url = *href;
+      }
+      if (const WString *target = inTag.get(L"target"))
+      {
+         fmt = fmt->COW();
+         fmt->target = *target;
+      }
+   }
 
-            for (const TiXmlAttribute *att = el->FirstAttribute(); att; att = att->Next())
-            {
-               if (att->NameTStr()==L"align")
-               {
-                  fmt = fmt->COW();
-                  if (att->ValueStr()==L"left")
-                     fmt->align = tfaLeft;
-                  else if (att->ValueStr()==L"right")
-                     fmt->align = tfaRight;
-                  else if (att->ValueStr()==L"center")
-                     fmt->align = tfaCenter;
-                  else if (att->ValueStr()==L"justify")
-                     fmt->align = tfaJustify;
-               }
-            }
+   if (const WString *align = inTag.get(L"align"))
+   {
+      fmt = fmt->COW();
+      if (*align==L"left")
+         fmt->align = tfaLeft;
+      else if (*align==L"right")
+         fmt->align = tfaRight;
+      else if (*align==L"center")
+         fmt->align = tfaCenter;
+      else if (*align==L"justify")
+         fmt->align = tfaJustify;
+   }
 
+   return fmt;
+}
 
-            AddNode(child,fmt,ioCharCount);
+static void AddHtmlChars(CharGroups &ioGroups, TextFormat *inFormat, const wchar_t *inChars, int inLen)
+{
+   CharGroup *last = ioGroups.empty() ? 0 : ioGroups[ioGroups.size()-1];
+   if (last && last->mFormat==inFormat)
+   {
+      last->mString.append(inChars,inLen);
+      return;
+   }
+   CharGroup *chars = new CharGroup;
+   chars->mFormat = inFormat->IncRef();
+   chars->mFont = 0;
+   chars->mFontHeight = 0;
+   chars->mFlags = 0;
+   chars->mString.Set(inChars,inLen);
+   ioGroups.push_back(chars);
+}
 
-            fmt->DecRef();
-         }
-      }
+static void AddHtmlNewline(CharGroups &ioGroups, TextFormat *inFormat)
+{
+   static const wchar_t newline = '\n';
+   if (ioGroups.size())
+      ioGroups[ ioGroups.size()-1 ]->mString.push_back(newline);
+   else
+      AddHtmlChars(ioGroups,inFormat,&newline,1);
+}
+
+
+void TextField::ClearHtmlFormats()
+{
+   for(int i=0;i<mHtmlFormats.size();i++)
+   {
+      mHtmlFormats[i].base->DecRef();
+      mHtmlFormats[i].format->DecRef();
    }
+   mHtmlFormats.clear();
 }
 
 
@@ -1411,22 +1551,135 @@ void TextField::setHTMLText(const WString &inString)
    mLinesDirty = true;
    mFontsDirty = true;
 
-   WString str;
-   str += L"<top>";
-   str += inString;
-   str += L"</top>";
+   if (mHtmlFormats.size()>HTML_FORMAT_CACHE_MAX)
+      ClearHtmlFormats();
+
+   std::vector<OpenHtmlTag> stack;
+   HtmlTag tag;
+   WString text;
+   int chars = 0;
+
+   stack.push_back( OpenHtmlTag() );
+   stack[0].format = defaultTextFormat->IncRef();
 
-   TiXmlNode::SetCondenseWhiteSpace(condenseWhite);
-   TiXmlDocument doc;
-   const wchar_t *err = doc.Parse(str.c_str(),0,TIXML_ENCODING_LEGACY);
-   if (err != NULL)
-      ELOG("Error parsing HTML input");
-   const TiXmlNode *top =  doc.FirstChild();
-   if (top)
+   const wchar_t *p = inString.c_str();
+   const wchar_t *end = p + inString.size();
+   while(p<end)
    {
-      int chars = 0;
-         AddNode(top,defaultTextFormat,chars);
+      TextFormat *format = stack[stack.size()-1].format;
+
+      if (*p=='<' && end-p>=4 && !wcsncmp(p,L"<!--",4))
+      {
+         const wchar_t *close = wcsstr(p+4,L"-->");
+         p = close ? close+3 : end;
+         continue;
+      }
+
+      if (*p=='<' && end-p>=9 && !wcsncmp(p,L"<![CDATA[",9))
+      {
+         const wchar_t *data = p+9;
+         const wchar_t *close = wcsstr(data,L"]]>");
+         p = close ? close+3 : end;
+         int len = (close ? close : end) - data;
+         if (len)
+         {
+            AddHtmlChars(mCharGroups,format,data,len);
+            chars += len;
+         }
+         continue;
+      }
+
+      if (*p=='<' && p+1<end && (p[1]=='!' || p[1]=='?'))
+      {
+         const wchar_t *close = wcschr(p,'>');
+         p = close ? close+1 : end;
+         continue;
+      }
+
+      if (*p=='<' && ReadHtmlTag(p,end,tag))
+      {
+         p = tag.end;
+         if (tag.close)
+         {
+            for(int s=stack.size()-1;s>0;s--)
+               if (stack[s].name==tag.name)
+               {
+                  while(stack.size()>s)
+                  {
+                     stack[stack.size()-1].format->DecRef();
+                     stack.pop_back();
+                  }
+                  break;
+               }
+            continue;
+         }
+
+         if (tag.name==L"br" || (tag.name==L"p" && chars>0))
+         {
+            AddHtmlNewline(mCharGroups,format);
+            chars++;
+         }
+         if (tag.selfClose || tag.name==L"br")
+            continue;
+
+         WString key(tag.start, tag.end-tag.start);
+         TextFormat *fmt = 0;
+         for(int i=0;i<mHtmlFormats.size() && !fmt;i++)
+            if (mHtmlFormats[i].base==format && mHtmlFormats[i].key==key)
+               fmt = mHtmlFormats[i].format->IncRef();
+         if (!fmt)
+         {
+            fmt = ApplyHtmlTag(format,tag);
+            if (fmt!=format)
+            {
+               // The cache's references keep both formats from being changed in place
+               HtmlFormat s;
+               s.base = format->IncRef();
+               s.key = key;
+               s.format = fmt->IncRef();
+               mHtmlFormats.push_back(s);
+            }
+         }
+
+         stack.push_back( OpenHtmlTag() );
+         stack[stack.size()-1].name = tag.name;
+         stack[stack.size()-1].format = fmt;
+         continue;
+      }
+
+      // Text run, up to the next tag.  A run starting with '<' is an unterminated tag,
+      //  which is kept as text.
+      // As TinyXML did, condensing trims each run and collapses the whitespace inside it,
+      //  so whitespace only runs between tags disappear.
+      text.clear();
+      const wchar_t *run = p;
+      bool pendingSpace = false;
+      while(p<end && (p==run || *p!='<'))
+      {
+         wchar_t ch = *p;
+         if (condenseWhite && IsHtmlSpace(ch))
+         {
+            pendingSpace = !text.empty();
+            p++;
+            continue;
+         }
+         if (pendingSpace)
+         {
+            text += ' ';
+            pendingSpace = false;
+         }
+         text += ch=='&' ? ReadHtmlEntity(p,end) : *p++;
+      }
+      if (!text.empty())
+      {
+         AddHtmlChars(mCharGroups,format,text.c_str(),text.size());
+         chars += text.size();
+      }
    }
+
+   for(int i=0;i<stack.size();i++)
+      stack[i].format->DecRef();
+
    if (mCharGroups.empty())
       setText(L"");
 }
@@ -2549,7 +2802,7 @@ TextFormat *TextFormat::COW()
    if (mRefCount<2)
       return this;
    TextFormat *result = new TextFormat(*this);
-   mRefCount --;
+   DecRef();
    return result;
 }
 
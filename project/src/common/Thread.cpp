@@ -76,7 +76,7 @@ static THREAD_FUNC_TYPE SThreadLoop( void *inInfo )
       // Wait ....
       #ifdef NME_PTHREADS
       {
-         ThreadPoolAutoLock l(sThreadPoolLock);
+         NmeAutoMutex l(sThreadPoolLock);
          while( !sThreadActive[threadId] )
             WaitThreadLocked(sThreadWake[threadId]);
       }
@@ -117,7 +117,7 @@ void initWorkers()
    {
       sThreadActive[t] = false;
       #ifdef NME_PTHREADS
-      pthread_cond_init(&sThreadWake[inId],0);
+      pthread_cond_init(&sThreadWake[t],0);
       pthread_t result = 0;
       int created = pthread_create(&result,0,SThreadLoop, (void *)(size_t)(int)t);
       bool ok = created==0;
@@ -152,7 +152,7 @@ void RunWorkerTask( WorkerFunc inFunc, void *inData )
    for(int t=0;t<sWorkerCount;t++)
    {
       sThreadActive[t] = true;
-      #ifdef NME_PTHREADNME_PTHREADS
+      #ifdef NME_PTHREADS
       pthread_cond_signal(&sThreadWake[t]);
       #else
       sThreadWake[t].Set();
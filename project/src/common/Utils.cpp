@@ -311,6 +311,34 @@ double  GetTimeStamp()
 #endif
 }
 
+bool gNmeProfilePhases = false;
+static double sPhaseSeconds[ppSIZE];
+static int    sPhaseCounts[ppSIZE];
+
+void AddPhaseTime(ProfilePhase inPhase, double inSeconds)
+{
+   sPhaseSeconds[inPhase] += inSeconds;
+   sPhaseCounts[inPhase]++;
+}
+
+void GetPhaseTimes(double *outSeconds, int *outCounts)
+{
+   for(int i=0;i<ppSIZE;i++)
+   {
+      outSeconds[i] = sPhaseSeconds[i];
+      outCounts[i] = sPhaseCounts[i];
+   }
+}
+
+void ResetPhaseTimes()
+{
+   for(int i=0;i<ppSIZE;i++)
+   {
+      sPhaseSeconds[i] = 0;
+      sPhaseCounts[i] = 0;
+   }
+}
+
 #ifdef HX_MACOS
 std::string ToStdString(const HFSUniStr255 &inStr)
 {
@@ -1,4 +1,5 @@
 #include <vector>
+#include <algorithm>
 
 #include <Camera.h>
 #include <hx/Thread.h>
@@ -10,6 +11,7 @@
 #include <fcntl.h> /* low-level i/o */
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
@@ -17,43 +19,476 @@
 #include <sys/ioctl.h>
 #include <linux/videodev2.h>
 
+#include <NmeSimd.h>
+
 namespace nme
 {
 
 #define CLEAR(x) memset(&(x), 0, sizeof(x))
 
 
-class V4L : public Camera
+// --- YUV conversion ---------------------------------------------
+//
+// Both layouts share one U,V pair between two horizontally adjacent pixels:
+//  YUYV = Y0 U Y1 V, and NV12 = a Y plane followed by a plane of interleaved U V at half height.
+
+static inline int clamp(int x) { return (x & 0xffffff00) ? ~(x>>24) : x ; }
+
+static inline void YUVPairToPixels(int y1, int y2, int u, int v, unsigned char *outDest, bool inBGRA)
+{
+   u -= 128;
+   v -= 128;
+   int cr = (v*359) >> 8;
+   int cg = (u*88 + v*183) >> 8;
+   int cb = (u*454) >> 8;
+
+   if (inBGRA)
+   {
+      outDest[0] = clamp(y1 + cb);
+      outDest[1] = clamp(y1 - cg);
+      outDest[2] = clamp(y1 + cr);
+      outDest[3] = 0xff;
+      outDest[4] = clamp(y2 + cb);
+      outDest[5] = clamp(y2 - cg);
+      outDest[6] = clamp(y2 + cr);
+      outDest[7] = 0xff;
+   }
+   else
+   {
+      outDest[0] = clamp(y1 + cr);
+      outDest[1] = clamp(y1 - cg);
+      outDest[2] = clamp(y1 + cb);
+      outDest[3] = clamp(y2 + cr);
+      outDest[4] = clamp(y2 - cg);
+      outDest[5] = clamp(y2 + cb);
+   }
+}
+
+#if defined(NME_SSE2)
+// 8 pixels from 8 int16 luma values and 4 (U,V) int16 pairs
+static inline void StoreBGRA8(unsigned char *outDest, __m128i inY, __m128i inUV)
+{
+   const __m128i low16 = _mm_set1_epi32(0xffff);
+   __m128i uv = _mm_sub_epi16(inUV, _mm_set1_epi16(128));
+
+   // Exact 32-bit sums, as the scalar code
+   __m128i cr = _mm_srai_epi32( _mm_madd_epi16(uv, _mm_set1_epi32(359<<16)), 8);
+   __m128i cg = _mm_srai_epi32( _mm_madd_epi16(uv, _mm_set1_epi32((183<<16)|88)), 8);
+   __m128i cb = _mm_srai_epi32( _mm_madd_epi16(uv, _mm_set1_epi32(454)), 8);
+
+   // Each chroma value covers a pair of pixels
+   cr = _mm_or_si128( _mm_and_si128(cr,low16), _mm_slli_epi32(cr,16) );
+   cg = _mm_or_si128( _mm_and_si128(cg,low16), _mm_slli_epi32(cg,16) );
+   cb = _mm_or_si128( _mm_and_si128(cb,low16), _mm_slli_epi32(cb,16) );
+
+   __m128i r = _mm_packus_epi16( _mm_add_epi16(inY,cr), _mm_setzero_si128() );
+   __m128i g = _mm_packus_epi16( _mm_sub_epi16(inY,cg), _mm_setzero_si128() );
+   __m128i b = _mm_packus_epi16( _mm_add_epi16(inY,cb), _mm_setzero_si128() );
+
+   __m128i bg = _mm_unpacklo_epi8(b,g);
+   __m128i ra = _mm_unpacklo_epi8(r,_mm_set1_epi8(-1));
+   _mm_storeu_si128( (__m128i *)outDest, _mm_unpacklo_epi16(bg,ra) );
+   _mm_storeu_si128( (__m128i *)(outDest+16), _mm_unpackhi_epi16(bg,ra) );
+}
+#elif defined(NME_NEON)
+static inline int16x8_t ChromaTerm(int16x8_t inA, int inScaleA, int16x8_t inB, int inScaleB)
+{
+   int32x4_t lo = vmlal_n_s16( vmull_n_s16(vget_low_s16(inA),inScaleA), vget_low_s16(inB), inScaleB);
+   int32x4_t hi = vmlal_n_s16( vmull_n_s16(vget_high_s16(inA),inScaleA), vget_high_s16(inB), inScaleB);
+   return vcombine_s16( vshrn_n_s32(lo,8), vshrn_n_s32(hi,8) );
+}
+
+// 16 pixels from the even and odd luma values and 8 U,V values
+static inline void StoreBGRA16(unsigned char *outDest, uint8x8_t inY0, uint8x8_t inY1, uint8x8_t inU, uint8x8_t inV)
+{
+   int16x8_t bias = vdupq_n_s16(128);
+   int16x8_t u = vsubq_s16( vreinterpretq_s16_u16(vmovl_u8(inU)), bias );
+   int16x8_t v = vsubq_s16( vreinterpretq_s16_u16(vmovl_u8(inV)), bias );
+
+   int16x8_t cr = ChromaTerm(v,359,u,0);
+   int16x8_t cg = ChromaTerm(u,88,v,183);
+   int16x8_t cb = ChromaTerm(u,454,v,0);
+
+   int16x8_t y0 = vreinterpretq_s16_u16(vmovl_u8(inY0));
+   int16x8_t y1 = vreinterpretq_s16_u16(vmovl_u8(inY1));
+
+   uint8x8x2_t r = vzip_u8( vqmovun_s16(vaddq_s16(y0,cr)), vqmovun_s16(vaddq_s16(y1,cr)) );
+   uint8x8x2_t g = vzip_u8( vqmovun_s16(vsubq_s16(y0,cg)), vqmovun_s16(vsubq_s16(y1,cg)) );
+   uint8x8x2_t b = vzip_u8( vqmovun_s16(vaddq_s16(y0,cb)), vqmovun_s16(vaddq_s16(y1,cb)) );
+
+   uint8x16x4_t out;
+   out.val[0] = vcombine_u8(b.val[0],b.val[1]);
+   out.val[1] = vcombine_u8(g.val[0],g.val[1]);
+   out.val[2] = vcombine_u8(r.val[0],r.val[1]);
+   out.val[3] = vdupq_n_u8(0xff);
+   vst4q_u8(outDest,out);
+}
+#endif
+
+static void YUYVRowToPixels(const unsigned char *inSrc, unsigned char *outDest, int inWidth, bool inBGRA)
 {
+   int pairs = inWidth>>1;
+   int p = 0;
+   if (inBGRA)
+   {
+      #if defined(NME_SSE2)
+      const __m128i low8 = _mm_set1_epi16(0xff);
+      for(;p+4<=pairs;p+=4)
+      {
+         __m128i s = _mm_loadu_si128( (const __m128i *)(inSrc+p*4) );
+         StoreBGRA8(outDest+p*8, _mm_and_si128(s,low8), _mm_srli_epi16(s,8) );
+      }
+      #elif defined(NME_NEON)
+      for(;p+8<=pairs;p+=8)
+      {
+         uint8x8x4_t s = vld4_u8(inSrc+p*4);
+         StoreBGRA16(outDest+p*8, s.val[0], s.val[2], s.val[1], s.val[3]);
+      }
+      #endif
+   }
+
+   int pw = inBGRA ? 8 : 6;
+   for(;p<pairs;p++)
+   {
+      const unsigned char *s = inSrc + p*4;
+      YUVPairToPixels(s[0], s[2], s[1], s[3], outDest + p*pw, inBGRA);
+   }
+}
+
+static void NV12RowToPixels(const unsigned char *inY, const unsigned char *inUV, unsigned char *outDest,
+                            int inWidth, bool inBGRA)
+{
+   int pairs = inWidth>>1;
+   int p = 0;
+   if (inBGRA)
+   {
+      #if defined(NME_SSE2)
+      const __m128i zero = _mm_setzero_si128();
+      for(;p+4<=pairs;p+=4)
+      {
+         __m128i y = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i *)(inY+p*2) ), zero );
+         __m128i uv = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i *)(inUV+p*2) ), zero );
+         StoreBGRA8(outDest+p*8, y, uv);
+      }
+      #elif defined(NME_NEON)
+      for(;p+8<=pairs;p+=8)
+      {
+         uint8x8x2_t y = vld2_u8(inY+p*2);
+         uint8x8x2_t uv = vld2_u8(inUV+p*2);
+         StoreBGRA16(outDest+p*8, y.val[0], y.val[1], uv.val[0], uv.val[1]);
+      }
+      #endif
+   }
+
+   int pw = inBGRA ? 8 : 6;
+   for(;p<pairs;p++)
+      YUVPairToPixels(inY[p*2], inY[p*2+1], inUV[p*2], inUV[p*2+1], outDest + p*pw, inBGRA);
+}
+
+
+
+// --- Options ---------------------------------------------------
+//
+// The camera name may carry options, eg "/dev/video1?width=1280&height=720&format=nv12"
+//   width, height - requested capture size (default 640x480)
+//   format        - yuyv or nv12
+//   raw           - 1 = deliver the YUV bytes untouched, for conversion in a shader.
+//                   YUYV arrives as a LumaAlpha image, and NV12 as a Luma image of height*3/2
+//                   rows - the Y plane followed by the interleaved UV plane.
+// A name of the form "file:/path/frames.yuv?width=..&height=..&format=..&fps=.." plays raw
+//  frames from a file, looping, so capture can be tested without a device.
+
+struct CameraOptions
+{
+   CameraOptions() : width(640), height(480), format(V4L2_PIX_FMT_YUYV), raw(false), fps(30), isFile(false) { }
+
+   void parse(const char *inName)
+   {
+      if (!inName || !inName[0])
+         inName = "default";
+      std::string name(inName);
+      size_t query = name.find('?');
+      source = name.substr(0,query);
+      if (source.substr(0,5)=="file:")
+      {
+         isFile = true;
+         source = source.substr(5);
+      }
+      else if (source=="" || source=="default")
+         source = "/dev/video0";
+
+      while(query!=std::string::npos)
+      {
+         size_t next = name.find('&',query+1);
+         std::string option = name.substr(query+1, next==std::string::npos ? std::string::npos : next-query-1);
+         size_t eq = option.find('=');
+         std::string key = option.substr(0,eq);
+         std::string val = eq==std::string::npos ? "1" : option.substr(eq+1);
+
+         if (key=="width")
+            width = atoi(val.c_str());
+         else if (key=="height")
+            height = atoi(val.c_str());
+         else if (key=="fps")
+            fps = atof(val.c_str());
+         else if (key=="raw")
+            raw = val!="0";
+         else if (key=="format")
+            format = (val=="nv12" || val=="NV12") ? V4L2_PIX_FMT_NV12 : V4L2_PIX_FMT_YUYV;
+         query = next;
+      }
+   }
+
+   std::string source;
+   int    width;
+   int    height;
+   int    format;
+   bool   raw;
+   double fps;
+   bool   isFile;
+};
+
+
+
+// --- YUVCamera ---------------------------------------------------
+//
+// A capture thread blocks waiting for the source, and parks each new frame in one of the
+//  frameBuffers slots without copying it - the source buffer stays out of the queue
+//  until it is consumed.  onPoll converts the newest frame straight into the bitmap, and
+//  hands the source buffer back.  Frames that are overtaken before being polled are
+//  returned to the source at once, so it is never starved.
+
+class YUVCamera : public Camera
+{
+protected:
    HxMutex mutex;
-   bool ok;
+   pthread_t thread;
+   bool threadRunning;
+   volatile bool quit;
+
+   CameraOptions options;
+   int   videoFormat;
+   int   srcStride;
+   const unsigned char *slotData[3];
+   int   slotSource[3];
+   int   readSlot;
+
+   // Errors from the capture thread wait here for onPoll to apply, so status and error
+   //  only ever change on the main thread.  A separate mutex, since requeueFrame can fail
+   //  while the lock is held.
+   HxMutex errorMutex;
+   std::string threadError;
+   volatile bool threadFailed;
+
+   void setThreadError(const std::string &inError)
+   {
+      errorMutex.Lock();
+      if (!threadFailed)
+         threadError = inError;
+      threadFailed = true;
+      errorMutex.Unlock();
+   }
+
+   // Wait (for a while) for the next frame - false if there is none yet
+   virtual bool waitFrame(int &outSource, const unsigned char *&outData) = 0;
+   virtual void requeueFrame(int inSource) = 0;
+
+public:
+   YUVCamera(const CameraOptions &inOptions) : options(inOptions)
+   {
+      threadRunning = false;
+      quit = false;
+      threadFailed = false;
+      videoFormat = 0;
+      srcStride = 0;
+      readSlot = -1;
+      for(int i=0;i<3;i++)
+      {
+         slotData[i] = 0;
+         slotSource[i] = -1;
+      }
+   }
+
+   void lock() { mutex.Lock(); }
+   void unlock() {  mutex.Unlock(); }
+
+   bool startCapture()
+   {
+      if (status==camError)
+         return false;
+      if (videoFormat!=V4L2_PIX_FMT_YUYV && videoFormat!=V4L2_PIX_FMT_NV12)
+      {
+         int pf = videoFormat;
+         char fourcc[5] = { (char)(pf&0xff), (char)((pf>>8)&0xff), (char)((pf>>16)&0xff), (char)((pf>>24)&0xff), 0 };
+         return setError(std::string("Unsupported pixel format ") + fourcc);
+      }
+
+      if (options.raw)
+      {
+         pixelFormat = videoFormat==V4L2_PIX_FMT_NV12 ? pfLuma : pfLumaAlpha;
+         if (videoFormat==V4L2_PIX_FMT_NV12)
+            height = height*3/2;
+      }
+      else
+         pixelFormat = pfBGRA;
+
+      if (pthread_create(&thread,0,SThreadLoop,this)!=0)
+         return setError("Could not start capture thread");
+      threadRunning = true;
+      status = camRunning;
+      return true;
+   }
+
+   // Must be called from the derived destructor, before the source goes away
+   void stopCapture()
+   {
+      if (threadRunning)
+      {
+         quit = true;
+         pthread_join(thread,0);
+         threadRunning = false;
+      }
+   }
+
+   static void *SThreadLoop(void *inThis)
+   {
+      ((YUVCamera *)inThis)->threadLoop();
+      return 0;
+   }
+
+   void threadLoop()
+   {
+      while(!quit && !threadFailed)
+      {
+         int source = -1;
+         const unsigned char *data = 0;
+         if (!waitFrame(source,data))
+            continue;
+
+         lock();
+         // Keep only the newest frame, plus the one being read
+         int slot = -1;
+         for(int i=0;i<3;i++)
+         {
+            if (i==readSlot)
+               continue;
+            if (slotSource[i]>=0)
+            {
+               requeueFrame(slotSource[i]);
+               slotSource[i] = -1;
+               frameBuffers[i].age = -1;
+            }
+            if (slot<0)
+               slot = i;
+         }
+         slotSource[slot] = source;
+         slotData[slot] = data;
+         frameBuffers[slot].age = frameId++;
+         unlock();
+      }
+   }
+
+   void onPoll(value handler)
+   {
+      if (threadFailed && status!=camError)
+      {
+         errorMutex.Lock();
+         setError(threadError);
+         errorMutex.Unlock();
+      }
+
+      syncUpdate(handler);
+
+      if (status==camRunning && buffer)
+      {
+         lock();
+         int slot = -1;
+         for(int i=0;i<3;i++)
+            if (slotSource[i]>=0 && (slot<0 || frameBuffers[i].age>frameBuffers[slot].age))
+               slot = i;
+         readSlot = slot;
+         unlock();
+
+         if (slot>=0)
+         {
+            fillBuffer(slotData[slot]);
+
+            lock();
+            requeueFrame(slotSource[slot]);
+            slotSource[slot] = -1;
+            frameBuffers[slot].age = -1;
+            readSlot = -1;
+            unlock();
+
+            onFrame(handler);
+         }
+      }
+   }
+
+   void fillBuffer(const unsigned char *inData)
+   {
+      int stride = buffer->GetStride();
+      unsigned char *dest = buffer->Edit(0);
+      int rows = std::min(height, buffer->Height());
+
+      if (options.raw)
+      {
+         int bytes = std::min(width * BytesPerPixel(pixelFormat), stride);
+         for(int y=0;y<rows;y++)
+            memcpy(dest + y*stride, inData + y*srcStride, bytes);
+      }
+      else
+      {
+         PixelFormat fmt = buffer->Format();
+         bool bgra = fmt==pfBGRA || fmt==pfBGRPremA;
+         if (videoFormat==V4L2_PIX_FMT_YUYV)
+         {
+            for(int y=0;y<rows;y++)
+               YUYVRowToPixels(inData + y*srcStride, dest + y*stride, width, bgra);
+         }
+         else
+         {
+            const unsigned char *uvPlane = inData + srcStride*height;
+            for(int y=0;y<rows;y++)
+               NV12RowToPixels(inData + y*srcStride, uvPlane + (y>>1)*srcStride, dest + y*stride, width, bgra);
+         }
+      }
+      buffer->Commit();
+   }
+};
+
+
+
+// --- V4L ----------------------------------------------------------
+
+enum { V4L_BUFFER_COUNT = 4 };
+
+class V4L : public YUVCamera
+{
    int  fd;
    struct v4l2_format fmt;
-   void *bufferData[3];
-   int   bufferDataLen[3];
+   void *bufferData[V4L_BUFFER_COUNT];
+   int   bufferDataLen[V4L_BUFFER_COUNT];
    bool streamOn;
-   int   videoFormat;
 
 public:
-   V4L(const char *inName)
+   V4L(const CameraOptions &inOptions) : YUVCamera(inOptions)
    {
-      //printf("V4L %s\n", inName);
-      if (!inName || !inName[0] || !strcmp(inName,"default"))
-         inName = "/dev/video0";
-
+      //printf("V4L %s\n", options.source.c_str());
       streamOn = false;
-      for(int i=0;i<3;i++)
+      for(int i=0;i<V4L_BUFFER_COUNT;i++)
          bufferData[i] = 0;
 
       fd = -1;
-      videoFormat = 0;
-      openDevice(inName);
-      initDevice();
+      if (openDevice(options.source) && initDevice())
+         startCapture();
    }
 
 
    ~V4L()
    {
+      stopCapture();
+
       if (streamOn)
       {
          int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -63,7 +498,7 @@ public:
          }
       }
 
-      for(int i=0; i<3; i++)
+      for(int i=0; i<V4L_BUFFER_COUNT; i++)
       {
          if (bufferData[i])
          {
@@ -139,54 +574,49 @@ public:
          {
             /* Errors ignored. */
          }
+      }
 
+      CLEAR(fmt);
 
-         CLEAR(fmt);
+      fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      if (-1 == xioctl(fd, VIDIOC_G_FMT, &fmt))
+            setError("Could not get format");
 
-         fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-         if (-1 == xioctl(fd, VIDIOC_G_FMT, &fmt))
-               setError("Could not get format");
+      fmt.fmt.pix.width       = options.width;
+      fmt.fmt.pix.height      = options.height;
+      fmt.fmt.pix.pixelformat = options.format;
 
-         if (true)
-         {
-            fmt.fmt.pix.width       = 640; //replace
-            fmt.fmt.pix.height      = 480; //replace
-            fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+      if (-1 == xioctl(fd, VIDIOC_S_FMT, &fmt))
+         setError("Could not set format");
 
-            if (-1 == xioctl(fd, VIDIOC_S_FMT, &fmt))
-               setError("Could not set format");
-         }
+      // The driver may have chosen something else
+      videoFormat = fmt.fmt.pix.pixelformat;
 
-         int pf = fmt.fmt.pix.pixelformat;
-         if (pf!=V4L2_PIX_FMT_YUYV)
-         {
-            printf("Unknown pixel format %dx%d : %c%c%c%c\n", fmt.fmt.pix.width, fmt.fmt.pix.height, 
-                (pf>>24) & 0xff, (pf>>16) & 0xff, (pf>>8)& 0xff, (pf&0xff) );
-         }
-
-         videoFormat = pf;
-
-         /* Buggy driver paranoia. */
-         min = fmt.fmt.pix.width * 2;
-         if (fmt.fmt.pix.bytesperline < min)
-                fmt.fmt.pix.bytesperline = min;
-         min = fmt.fmt.pix.bytesperline * fmt.fmt.pix.height;
-         if (fmt.fmt.pix.sizeimage < min)
-                fmt.fmt.pix.sizeimage = min;
-      }
+      /* Buggy driver paranoia. */
+      min = fmt.fmt.pix.width * (videoFormat==V4L2_PIX_FMT_NV12 ? 1 : 2);
+      if (fmt.fmt.pix.bytesperline < min)
+             fmt.fmt.pix.bytesperline = min;
+      min = fmt.fmt.pix.bytesperline * fmt.fmt.pix.height;
+      if (videoFormat==V4L2_PIX_FMT_NV12)
+         min = min*3/2;
+      if (fmt.fmt.pix.sizeimage < min)
+             fmt.fmt.pix.sizeimage = min;
+      srcStride = fmt.fmt.pix.bytesperline;
 
 
       struct v4l2_requestbuffers req = {0};
-      req.count = 3;
+      req.count = V4L_BUFFER_COUNT;
       req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
       req.memory = V4L2_MEMORY_MMAP;
 
       if (-1 == xioctl(fd, VIDIOC_REQBUFS, &req))
          return setError("Could not request buffers\n");
+      if (req.count<2)
+         return setError("Not enough capture buffers");
 
 
       struct v4l2_buffer buf;
-      for(int i=0;i<req.count;i++)
+      for(int i=0;i<req.count && i<V4L_BUFFER_COUNT;i++)
       {
          CLEAR(buf);
          buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -201,128 +631,181 @@ public:
 
          bufferDataLen[i] = buf.length;
          bufferData[i] = mmap(0, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+         if (bufferData[i]==MAP_FAILED)
+         {
+            bufferData[i] = 0;
+            return setError("Could not map buffer");
+         }
       }
 
       if(-1 == xioctl(fd, VIDIOC_STREAMON, &buf.type))
          return setError("Could not start stream");
+      streamOn = true;
 
       width = fmt.fmt.pix.width;
       height = fmt.fmt.pix.height;
-      pixelFormat = pfRGB;
-      status = camRunning;
+      return true;
    }
 
 
-   void lock() { mutex.Lock(); }
-   void unlock() {  mutex.Unlock(); }
-
-   void onPoll(value handler)
+   bool waitFrame(int &outSource, const unsigned char *&outData)
    {
-      syncUpdate(handler);
+      fd_set fds;
+      FD_ZERO(&fds);
+      FD_SET(fd, &fds);
 
-      if (status==camRunning && buffer)
-      {
-         struct timeval tv;
-         int r;
+      // Block, but wake now and then to see if we should quit
+      struct timeval tv;
+      tv.tv_sec = 0;
+      tv.tv_usec = 100000;
 
-         fd_set fds;
-         FD_ZERO(&fds);
-         FD_SET(fd, &fds);
-
-         /* Timeout. */
-         tv.tv_sec = 0;
-         tv.tv_usec = 1;
+      int r = select(fd + 1, &fds, NULL, NULL, &tv);
+      if (-1 == r)
+      {
+         if (EINTR != errno)
+            setThreadError("Error in select");
+         return false;
+      }
+      if (0 == r)
+         return false;
 
-         r = select(fd + 1, &fds, NULL, NULL, &tv);
-         if (-1 == r)
-         {
-            if (EINTR != errno)
-               setError("Error in select");
-         }
-         else if (0 == r)
-         {
-            // ok
-         }
-         else
-         {
-            struct v4l2_buffer buf = {0};
-            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            buf.memory = V4L2_MEMORY_MMAP;
+      struct v4l2_buffer buf = {0};
+      buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buf.memory = V4L2_MEMORY_MMAP;
 
-            if(-1 == xioctl(fd, VIDIOC_DQBUF, &buf,true))
-            {
-               if (errno==EAGAIN)
-                  printf(" - again\n");
-               else
-                  setError("Retrieving Frame");
-            }
-            else
-            {
-               void *data = bufferData[buf.index];
-
-               fillBuffer(data);
+      if(-1 == xioctl(fd, VIDIOC_DQBUF, &buf,true))
+      {
+         if (errno!=EAGAIN)
+            setThreadError("Retrieving Frame");
+         return false;
+      }
 
-               onFrame(handler);
+      outSource = buf.index;
+      outData = (const unsigned char *)bufferData[buf.index];
+      return true;
+   }
 
-               if (-1 == xioctl(fd, VIDIOC_QBUF, &buf))
-                  setError("Could not requeue buffer");
-            }
-         }
-      }
+   void requeueFrame(int inSource)
+   {
+      struct v4l2_buffer buf = {0};
+      buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buf.memory = V4L2_MEMORY_MMAP;
+      buf.index = inSource;
+      if (-1 == xioctl(fd, VIDIOC_QBUF, &buf))
+         setThreadError("Could not requeue buffer");
    }
+};
 
-   inline int clamp(int x) { return (x & 0xffffff00) ? ~(x>>24) : x ; }
 
-   void fillBuffer(const void *inData)
-   {
-      // ImageBuffer  *buffer;
 
-     //printf("Fill %p (%dx%d, %d)\n", inData, buffer->Width(), buffer->Height(), buffer->GetStride() );
-     int stride = buffer->GetStride();
-     unsigned char *dest = buffer->Edit(0);
+// --- FileCamera -----------------------------------------------------
+//
+// Raw YUYV or NV12 frames, back-to-back in a file, played at options.fps
 
-     int pairs = width>>1;
-     for(int y=0;y<height;y++)
-     {
-         const unsigned char *s = (unsigned char *)inData + y*width*2;
-         unsigned char *rgb =  dest + y*stride;
+class FileCamera : public YUVCamera
+{
+   FILE *file;
+   int  frameBytes;
+   std::vector<unsigned char> frames[3];
+   bool inUse[3];
+   double nextFrameTime;
 
-         if (videoFormat==V4L2_PIX_FMT_YUYV)
-         {
-            for(int x=0;x<pairs;x++)
-            {
-               int y1 = s[0];
-               int u  = s[1]-128;
-               int y2 = s[2];
-               int v  = s[3]-128;
+   static double now()
+   {
+      struct timeval tv;
+      gettimeofday(&tv,0);
+      return tv.tv_sec + tv.tv_usec*0.000001;
+   }
 
-               int cr = (v*359) >> 8;
-               int cg = (u*88 + v*183) >> 8;
-               int cb = (u*454) >> 8;
+public:
+   FileCamera(const CameraOptions &inOptions) : YUVCamera(inOptions)
+   {
+      file = fopen(options.source.c_str(),"rb");
+      if (!file)
+      {
+         setError("Could not open:" + options.source + " " + strerror(errno));
+         return;
+      }
 
-               *rgb++ = clamp(y1 + cr);
-               *rgb++ = clamp(y1 - cg);
-               *rgb++ = clamp(y1 + cb);
+      width = options.width;
+      height = options.height;
+      videoFormat = options.format;
+      srcStride = videoFormat==V4L2_PIX_FMT_NV12 ? width : width*2;
+      frameBytes = videoFormat==V4L2_PIX_FMT_NV12 ? width*height*3/2 : width*height*2;
+      for(int i=0;i<3;i++)
+      {
+         frames[i].resize(frameBytes);
+         inUse[i] = false;
+      }
+      nextFrameTime = now();
+      startCapture();
+   }
 
-               *rgb++ = clamp(y2 + cr);
-               *rgb++ = clamp(y2 - cg);
-               *rgb++ = clamp(y2 + cb);
+   ~FileCamera()
+   {
+      stopCapture();
+      if (file)
+         fclose(file);
+   }
 
-               s+=4;
-            }
+   bool waitFrame(int &outSource, const unsigned char *&outData)
+   {
+      double wait = nextFrameTime - now();
+      if (wait>0)
+      {
+         usleep( (int)(std::min(wait,0.1)*1000000) );
+         return false;
+      }
+      nextFrameTime += options.fps>0 ? 1.0/options.fps : 1.0/30;
+
+      int source = -1;
+      lock();
+      for(int i=0;i<3 && source<0;i++)
+         if (!inUse[i])
+            source = i;
+      if (source>=0)
+         inUse[source] = true;
+      unlock();
+      // Nothing has been consumed - drop this frame
+      if (source<0)
+         return false;
+
+      unsigned char *data = &frames[source][0];
+      if (fread(data,1,frameBytes,file)!=frameBytes)
+      {
+         rewind(file);
+         if (fread(data,1,frameBytes,file)!=frameBytes)
+         {
+            setThreadError("File does not hold a whole frame:" + options.source);
+            lock();
+            inUse[source] = false;
+            unlock();
+            return false;
          }
       }
-      buffer->Commit();
+
+      outSource = source;
+      outData = data;
+      return true;
    }
 
+   // Called with the lock held
+   void requeueFrame(int inSource)
+   {
+      inUse[inSource] = false;
+   }
 };
 
 
+
 Camera *CreateCamera(const char *inName)
 {
-   return new V4L(inName);
+   CameraOptions options;
+   options.parse(inName);
+   if (options.isFile)
+      return new FileCamera(options);
+   return new V4L(options);
 }
 
 
 } // end namespace nme
-
@@ -170,6 +170,16 @@ typedef void *GLCtx;
 #define GL_LINE_SMOOTH  0x0B20
 #endif
 
+#ifndef GL_VERTEX_PROGRAM_POINT_SIZE
+#define GL_VERTEX_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+#endif
+
 #include <Graphics.h>
 #include <Surface.h>
 
@@ -199,8 +209,9 @@ enum
    PROG_RADIAL_FOCUS =      0x0020,
    PROG_TINT =              0x0040,
    PROG_COLOUR_OFFSET =     0x0080,
+   PROG_POINT_SIZE =        0x0100,
 
-   PROG_COUNT =             0x0100,
+   PROG_COUNT =             0x0200,
 };
 
 
@@ -220,6 +231,7 @@ public:
    virtual void setColourTransform(const ColorTransform *inTransform, unsigned int inColour,
                                     bool inPremultiplyAlpha) = 0;
    virtual void setGradientFocus(float inFocus) = 0;
+   virtual void setPointSize(float inSize) = 0;
 
    int vertexSlot;
    int textureSlot;
@@ -230,9 +242,19 @@ public:
 
 void InitOGL2Extensions();
 
+// Programs compiled when the context is created, rather than on first use
+void SetPrecompilePrograms(const int *inIds, int inCount);
+void GetPrecompilePrograms(QuickVec<int> &outIds);
+// Directory for linked program binaries - empty to disable
+void SetProgramCacheDir(const std::string &inDir);
+// Compiled, loaded-from-cache, total milliseconds, slowest milliseconds
+void GetProgramStats(int *outStats, int n);
+
 #define NME_GL_STATS_DRAW_ARRAYS 0x0
 #define NME_GL_STATS_DRAW_ELEMENTS 0x2
 #define NME_GL_STATS_GLVIEW 0x4
+#define NME_GL_STATS_BATCH 0x8
+#define NME_GL_STATS_BATCH_OBJECTS 0xa
 struct glStatsStruct
 {
     glStatsStruct(){
@@ -251,7 +273,7 @@ struct glStatsStruct
     }
     inline void get(int * arr, int n){
         #ifndef NME_NO_GL_STATS
-        n = (n>=8?8:n);
+        n = (n>=12?12:n);
         memcpy(arr, statsArray, sizeof(int)*n);
         #endif
     }
@@ -260,7 +282,7 @@ struct glStatsStruct
         memcpy(inStats->statsArray, statsArray, sizeof(statsArray));
         #endif
     }
-    int statsArray[8];
+    int statsArray[12];
 };
 
 } // end namespace nme
@@ -179,6 +179,9 @@ OGL_EXT(glRenderbufferStorageMultisample,void,(GLenum target, GLsizei samples, G
 OGL_EXT(glDrawArraysInstanced,void,(GLenum mode, GLint first, GLsizei count, GLsizei primcount) ); 
 OGL_EXT(glDrawElementsInstanced,void,(GLenum mode, GLsizei count, GLenum type, const void * indices, GLsizei primcount));
 OGL_EXT(glReadBuffer,void,(GLenum src));
+OGL_EXT(glGetProgramBinary,void,(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary));
+OGL_EXT(glProgramBinary,void,(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length));
+OGL_EXT(glProgramParameteri,void,(GLuint program, GLenum pname, GLint value));
 
 
 #ifdef DYNAMIC_OGL
@@ -10,6 +10,97 @@ namespace nme
 
 const float one_on_255 = 1.0/255.0;
 
+// --- Program registry ---------------------------------------------
+
+static int sgDefaultPrecompile[] =
+{
+   PROG_TINT,
+   PROG_TINT | PROG_NORMAL_DATA,
+   PROG_COLOUR_PER_VERTEX,
+   PROG_TEXTURE,
+   PROG_TEXTURE | PROG_TINT,
+   PROG_TEXTURE | PROG_ALPHA_TEXTURE | PROG_TINT,
+   PROG_TEXTURE | PROG_COLOUR_PER_VERTEX,
+};
+
+static bool          sgPrecompileSet = false;
+static QuickVec<int> sgPrecompileIds;
+static std::string   sgProgramCacheDir;
+
+static int    sgProgramsCompiled = 0;
+static int    sgProgramsLoaded = 0;
+static double sgProgramTotalTime = 0;
+static double sgProgramSlowestTime = 0;
+
+void SetPrecompilePrograms(const int *inIds, int inCount)
+{
+   sgPrecompileSet = true;
+   sgPrecompileIds.resize(0);
+   for(int i=0;i<inCount;i++)
+      if (inIds[i]>=0 && inIds[i]<PROG_COUNT)
+         sgPrecompileIds.push_back(inIds[i]);
+}
+
+void GetPrecompilePrograms(QuickVec<int> &outIds)
+{
+   if (sgPrecompileSet)
+      outIds = sgPrecompileIds;
+   else
+   {
+      outIds.resize(0);
+      for(int i=0;i<sizeof(sgDefaultPrecompile)/sizeof(int);i++)
+         outIds.push_back(sgDefaultPrecompile[i]);
+   }
+}
+
+void SetProgramCacheDir(const std::string &inDir)
+{
+   sgProgramCacheDir = inDir;
+}
+
+void GetProgramStats(int *outStats, int n)
+{
+   int stats[4] = { sgProgramsCompiled, sgProgramsLoaded,
+                    (int)(sgProgramTotalTime*1000), (int)(sgProgramSlowestTime*1000) };
+   for(int i=0;i<n && i<4;i++)
+      outStats[i] = stats[i];
+}
+
+static bool HasProgramBinary()
+{
+   #if NME_GL_LEVEL>=300
+   if (!CHECK_EXT(glGetProgramBinary) || !CHECK_EXT(glProgramBinary))
+      return false;
+   GLint formats = 0;
+   glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+   return formats>0;
+   #else
+   return false;
+   #endif
+}
+
+// Binaries are only valid for the driver that made them
+static const std::string &GetDriverString()
+{
+   static std::string driver;
+   static int driverContext = -1;
+   if (driverContext!=gTextureContextVersion)
+   {
+      driverContext = gTextureContextVersion;
+      driver = "";
+      const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+      for(int i=0;i<3;i++)
+      {
+         const char *str = (const char *)glGetString(names[i]);
+         if (str)
+            driver += str;
+         driver += "|";
+      }
+   }
+   return driver;
+}
+
+
 OGLProg::OGLProg(const std::string &inVertProg, const std::string &inFragProg)
 {
    mVertProg = inVertProg;
@@ -18,6 +109,7 @@ OGLProg::OGLProg(const std::string &inVertProg, const std::string &inFragProg)
    mFragId = 0;
 
    mImageSlot = -1;
+   mPointSizeSlot = -1;
    mColourTransform = 0;
 
    vertexSlot = -1;
@@ -69,25 +161,115 @@ GLuint OGLProg::createShader(GLuint inType, const char *inShader)
 }
 
 
-void OGLProg::recreate()
+std::string OGLProg::binaryFilename()
 {
-   mContextVersion = gTextureContextVersion;
-   mProgramId = 0;
+   // FNV-1a over the driver and the source
+   uint32 hash = 2166136261U;
+   std::string key = GetDriverString() + mVertProg + mFragProg;
+   for(int i=0;i<key.size();i++)
+      hash = (hash ^ (unsigned char)key[i]) * 16777619U;
+
+   char buf[32];
+   sprintf(buf,"/nmeprog-%08x.bin",hash);
+   return sgProgramCacheDir + buf;
+}
+
+
+bool OGLProg::loadBinary()
+{
+   #if NME_GL_LEVEL>=300
+   if (sgProgramCacheDir.empty() || !HasProgramBinary())
+      return false;
+
+   FILE *file = fopen(binaryFilename().c_str(),"rb");
+   if (!file)
+      return false;
+
+   GLenum format = 0;
+   std::vector<unsigned char> binary;
+   if (fread(&format,sizeof(format),1,file)==1)
+   {
+      fseek(file,0,SEEK_END);
+      long len = ftell(file) - (long)sizeof(format);
+      if (len>0)
+      {
+         binary.resize(len);
+         fseek(file,sizeof(format),SEEK_SET);
+         if (fread(&binary[0],1,len,file)!=len)
+            binary.clear();
+      }
+   }
+   fclose(file);
+   if (binary.empty())
+      return false;
 
+   mProgramId = glCreateProgram();
+   glProgramBinary(mProgramId, format, &binary[0], binary.size());
+
+   GLint linked = 0;
+   glGetProgramiv(mProgramId, GL_LINK_STATUS, &linked);
+   if (!linked)
+   {
+      // Stale binary (eg, driver update) - will be replaced after compiling
+      glDeleteProgram(mProgramId);
+      mProgramId = 0;
+      return false;
+   }
+   return true;
+   #else
+   return false;
+   #endif
+}
+
+
+void OGLProg::saveBinary()
+{
+   #if NME_GL_LEVEL>=300
+   if (sgProgramCacheDir.empty() || !HasProgramBinary())
+      return;
+
+   GLint len = 0;
+   glGetProgramiv(mProgramId, GL_PROGRAM_BINARY_LENGTH, &len);
+   if (len<=0)
+      return;
+
+   std::vector<unsigned char> binary(len);
+   GLenum format = 0;
+   GLsizei written = 0;
+   glGetProgramBinary(mProgramId, len, &written, &format, &binary[0]);
+   if (written<=0)
+      return;
+
+   FILE *file = fopen(binaryFilename().c_str(),"wb");
+   if (!file)
+      return;
+   fwrite(&format,sizeof(format),1,file);
+   fwrite(&binary[0],1,written,file);
+   fclose(file);
+   #endif
+}
+
+
+bool OGLProg::compileAndLink()
+{
    mVertId = createShader(GL_VERTEX_SHADER,mVertProg.c_str());
    if (!mVertId)
-      return;
+      return false;
    mFragId = createShader(GL_FRAGMENT_SHADER,mFragProg.c_str());
    if (!mFragId)
-      return;
+      return false;
 
    mProgramId = glCreateProgram();
 
    glAttachShader(mProgramId, mVertId);
    glAttachShader(mProgramId, mFragId);
 
-   glLinkProgram(mProgramId); 
+   #if NME_GL_LEVEL>=300
+   if (!sgProgramCacheDir.empty() && HasProgramBinary() && CHECK_EXT(glProgramParameteri))
+      glProgramParameteri(mProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+   #endif
 
+   glLinkProgram(mProgramId); 
 
    // Validate program
    glValidateProgram(mProgramId);
@@ -123,9 +305,37 @@ void OGLProg::recreate()
       glDeleteShader(mFragId);
       glDeleteProgram(mProgramId);
       mVertId = mFragId = mProgramId = 0;
+      return false;
    }
+   return true;
+}
 
 
+void OGLProg::recreate()
+{
+   mContextVersion = gTextureContextVersion;
+   mProgramId = 0;
+   mVertId = mFragId = 0;
+
+   double t0 = GetTimeStamp();
+   if (loadBinary())
+      sgProgramsLoaded++;
+   else if (compileAndLink())
+   {
+      sgProgramsCompiled++;
+      saveBinary();
+   }
+   else
+   {
+      vertexSlot = textureSlot = colourSlot = normalSlot = -1;
+      return;
+   }
+
+   double t = GetTimeStamp() - t0;
+   sgProgramTotalTime += t;
+   if (t>sgProgramSlowestTime)
+      sgProgramSlowestTime = t;
+
    vertexSlot = glGetAttribLocation(mProgramId, "aVertex");
    textureSlot = glGetAttribLocation(mProgramId, "aTexCoord");
    colourSlot = glGetAttribLocation(mProgramId, "aColourArray");
@@ -138,6 +348,7 @@ void OGLProg::recreate()
    mFXSlot = glGetUniformLocation(mProgramId, "mFX");
    mASlot = glGetUniformLocation(mProgramId, "mA");
    mOn2ASlot = glGetUniformLocation(mProgramId, "mOn2A");
+   mPointSizeSlot = glGetUniformLocation(mProgramId, "uPointSize");
 
    
    glUseProgram(mProgramId);
@@ -266,6 +477,13 @@ void OGLProg::setGradientFocus(float inFocus)
 }
 
 
+void OGLProg::setPointSize(float inSize)
+{
+   if (mPointSizeSlot>=0)
+      glUniform1f(mPointSizeSlot, inSize);
+}
+
+
 GPUProg *GPUProg::create(unsigned int inID)
 {
    std::string vertexVars =
@@ -368,6 +586,15 @@ GPUProg *GPUProg::create(unsigned int inID)
    }
 
 
+   if (inID & PROG_POINT_SIZE)
+   {
+      vertexVars +=
+        "uniform float uPointSize;\n";
+      vertexProg +=
+        "   gl_PointSize = uPointSize;\n";
+   }
+
+
    if (inID & PROG_NORMAL_DATA)
    {
       vertexVars +=
@@ -18,12 +18,17 @@ public:
 
    GLuint createShader(GLuint inType, const char *inShader);
    void recreate();
+   bool compileAndLink();
+   bool loadBinary();
+   void saveBinary();
+   std::string binaryFilename();
    virtual bool bind();
    void disableSlots();
    void setColourTransform(const ColorTransform *inTransform, uint32 inColor, bool inPremAlpha);
    int  getTextureSlot();
    void setTransform(const Trans4x4 &inTrans);
    virtual void setGradientFocus(float inFocus);
+   virtual void setPointSize(float inSize);
 
    std::string mVertProg;
    std::string mFragProg;
@@ -47,6 +52,7 @@ public:
    GLint     mASlot;
    GLint     mFXSlot;
    GLint     mOn2ASlot;
+   GLint     mPointSizeSlot;
 };
 
 
@@ -22,6 +22,25 @@ const double one_on_256 = 1.0/256.0;
 static GLuint sgOpenglType[] =
   { GL_TRIANGLE_FAN, GL_TRIANGLE_STRIP, GL_TRIANGLES, GL_LINE_STRIP, GL_POINTS, GL_LINES, 0, 0 /* Quads / Full */ };
 
+// Small objects are pre-transformed into a shared buffer and drawn together
+#ifdef NME_NO_RENDER_BATCH
+static bool sgRenderBatching = false;
+#else
+static bool sgRenderBatching = true;
+#endif
+static const int sgMaxBatchObjectVertices = 256;
+static const int sgMaxBatchVertices = 16384;
+// x,y, u,v, rgba
+static const int sgBatchStride = 4*sizeof(float) + 4;
+
+static bool SameColourTransform(const ColorTransform &a, const ColorTransform &b)
+{
+   return a.redMultiplier==b.redMultiplier && a.redOffset==b.redOffset &&
+          a.greenMultiplier==b.greenMultiplier && a.greenOffset==b.greenOffset &&
+          a.blueMultiplier==b.blueMultiplier && a.blueOffset==b.blueOffset &&
+          a.alphaMultiplier==b.alphaMultiplier && a.alphaOffset==b.alphaOffset;
+}
+
 
 void ReloadExtentions();
 
@@ -68,6 +87,12 @@ public:
       mQuadsBuffer = 0;
       mFullTexCoordsBuffer = 0;
       mQuality = sqBest;
+      mStencilBits = -1;
+      mMaskDepth = 0;
+      mBatchBuffer = 0;
+      mBatchVertices = 0;
+      mBatchSurface = 0;
+      mProgramsPrecompiled = false;
 
       for(int i=0;i<PROG_COUNT;i++)
          mProg[i] = 0;
@@ -231,6 +256,8 @@ public:
 
    void Clear(uint32 inColour, const Rect *inRect)
    {
+      FlushBatch();
+
       Rect r = inRect ? *inRect : Rect(mWidth,mHeight);
      
       glViewport(r.x,mHeight-r.y1(),r.w,r.h);
@@ -263,6 +290,7 @@ public:
    {
       if (inRect!=mViewport)
       {
+         FlushBatch();
          setOrtho(inRect.x,inRect.x1(), inRect.y1(),inRect.y);
          mViewport = inRect;
          glViewport(inRect.x, mHeight-inRect.y1(), inRect.w, inRect.h);
@@ -363,10 +391,28 @@ public:
 
          glEnable(GL_BLEND);
 
+         #ifndef NME_GLES
+         // Point programs set gl_PointSize themselves
+         glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+         #endif
+
         #ifdef WEBOS
          glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
          #endif
 
+         if (!mProgramsPrecompiled)
+            PrecompilePrograms();
+
+         if (mStencilBits<0)
+            glGetIntegerv(GL_STENCIL_BITS, &mStencilBits);
+         mMaskDepth = 0;
+         if (mStencilBits>0)
+         {
+            glDisable(GL_STENCIL_TEST);
+            glClearStencil(0);
+            glClear(GL_STENCIL_BUFFER_BIT);
+         }
+
          mLineWidth = 99999;
 
          // printf("DrawArrays: %d, DrawBitmaps:%d  Buffers:%d\n", sgDrawCount, sgDrawBitmap, sgBufferCount );
@@ -375,6 +421,7 @@ public:
    }
    void EndRender()
    {
+      FlushBatch();
       gCurrStats.get(&gStats);
    }
 
@@ -384,6 +431,9 @@ public:
       mThreadId = GetThreadId();
       mQuadsBuffer = 0;
       mFullTexCoordsBuffer = 0;
+      mStencilBits = -1;
+      mBatchBuffer = 0;
+      mProgramsPrecompiled = false;
       mHasZombie = false;
       mZombieTextures.resize(0);
       mZombieVbos.resize(0);
@@ -412,6 +462,7 @@ public:
 
    void BeginDirectRender()
    {
+      FlushBatch();
       gDirectMaxAttribArray = 0;
    }
 
@@ -422,6 +473,47 @@ public:
    }
 
 
+   bool CanStencilMask() const
+   {
+      return mStencilBits>0;
+   }
+
+   void BeginStencilMask(bool inPush)
+   {
+      FlushBatch();
+
+      if (inPush && mMaskDepth==0)
+         glEnable(GL_STENCIL_TEST);
+
+      // Only touch pixels inside the current mask, and count each pixel once
+      glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+      glStencilFunc(GL_EQUAL, mMaskDepth, 0xff);
+      glStencilOp(GL_KEEP, GL_KEEP, inPush ? GL_INCR : GL_DECR);
+   }
+
+   void EndStencilMask(bool inPush)
+   {
+      FlushBatch();
+
+      if (inPush)
+         mMaskDepth++;
+      else
+         mMaskDepth--;
+
+      #ifdef WEBOS
+      glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
+      #else
+      glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+      #endif
+
+      glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+      if (mMaskDepth==0)
+         glDisable(GL_STENCIL_TEST);
+      else
+         glStencilFunc(GL_EQUAL, mMaskDepth, 0xff);
+   }
+
+
    void Render(const RenderState &inState, const HardwareData &inData )
    {
       if (!inData.mArray.size())
@@ -429,6 +521,18 @@ public:
 
       SetViewport(inState.mClipRect);
 
+      if (sgRenderBatching && CanBatch(inData))
+      {
+         const ColorTransform *ctrans = inState.mColourTransform;
+         if (ctrans && ctrans->IsIdentity())
+            ctrans = 0;
+         AddToBatch(inData,ctrans,*inState.mTransform.mMatrix);
+         return;
+      }
+
+      // Flushing resets the model-view, so it must happen before ours is set
+      FlushBatch();
+
       if (mModelView!=*inState.mTransform.mMatrix)
       {
          mModelView=*inState.mTransform.mMatrix;
@@ -441,10 +545,290 @@ public:
       if (ctrans && ctrans->IsIdentity())
          ctrans = 0;
 
-      RenderData(inData,ctrans,mTrans);
+      DrawData(inData,ctrans,mTrans);
+   }
+
+   int GetProgId(const DrawElement &element, const ColorTransform *ctrans, bool &outPremAlpha)
+   {
+      int progId = 0;
+      outPremAlpha = false;
+      if ((element.mFlags & DRAW_HAS_TEX) && element.mSurface)
+      {
+         if (IsPremultipliedAlpha(element.mSurface->Format()))
+            outPremAlpha = true;
+         progId |= PROG_TEXTURE;
+         if (element.mSurface->BytesPP()==1)
+            progId |= PROG_ALPHA_TEXTURE;
+      }
+
+      if (element.mFlags & DRAW_HAS_COLOUR)
+         progId |= PROG_COLOUR_PER_VERTEX;
+
+      if (element.mFlags & DRAW_HAS_NORMAL)
+         progId |= PROG_NORMAL_DATA;
+
+      if (element.mPrimType==ptPoints)
+         progId |= PROG_POINT_SIZE;
+
+      if (element.mFlags & DRAW_RADIAL)
+      {
+         progId |= PROG_RADIAL;
+         if (element.mRadialPos!=0)
+            progId |= PROG_RADIAL_FOCUS;
+      }
+
+      if (ctrans || element.mColour != 0xffffffff)
+      {
+         progId |= PROG_TINT;
+         if (ctrans && ctrans->HasOffset())
+            progId |= PROG_COLOUR_OFFSET;
+      }
+      return progId;
+   }
+
+   GPUProg *GetProg(int inProgId)
+   {
+      GPUProg *prog = mProg[inProgId];
+      if (!prog)
+          mProg[inProgId] = prog = GPUProg::create(inProgId);
+      return prog;
+   }
+
+   // Compile the common programs up-front (or re-create them after a context loss),
+   //  rather than stalling the first frame that uses them.
+   void PrecompilePrograms()
+   {
+      mProgramsPrecompiled = true;
+
+      QuickVec<int> ids;
+      GetPrecompilePrograms(ids);
+      for(int i=0;i<ids.size();i++)
+      {
+         GPUProg *prog = mProg[ids[i]];
+         if (!prog)
+            GetProg(ids[i]);
+         else
+            prog->bind();
+      }
+   }
+
+   void SetBlendMode(int inBlendMode, bool inPremAlpha)
+   {
+      switch(inBlendMode)
+      {
+         case bmAdd:
+            glBlendFunc( GL_SRC_ALPHA, GL_ONE );
+            break;
+         case bmMultiply:
+            glBlendFunc( GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA);
+            break;
+         case bmScreen:
+            glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_COLOR);
+            break;
+         default:
+            glBlendFunc(inPremAlpha ? GL_ONE : GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+      }
+   }
+
+
+   // --- Batching -----------------------------------------------------------
+
+   bool CanBatch(const HardwareData &inData)
+   {
+      int total = 0;
+      for(int e=0;e<inData.mElements.size();e++)
+      {
+         const DrawElement &element = inData.mElements[e];
+         if (element.mPrimType!=ptTriangles && element.mPrimType!=ptQuads)
+            return false;
+         if (element.mFlags & (DRAW_HAS_NORMAL | DRAW_HAS_PERSPECTIVE | DRAW_RADIAL) )
+            return false;
+         total += element.mCount;
+      }
+      return total>0 && total<=sgMaxBatchObjectVertices;
+   }
+
+   bool BatchMatches(int inProgId, const DrawElement &element, const ColorTransform *ctrans)
+   {
+      if (!mBatchVertices)
+         return false;
+      if (inProgId!=mBatchProgId || element.mPrimType!=mBatchPrimType ||
+            element.mBlendMode!=mBatchBlendMode || element.mColour!=mBatchColour)
+         return false;
+      if (mBatchProgId & PROG_TEXTURE)
+      {
+         int texFlags = DRAW_BMP_REPEAT | DRAW_BMP_SMOOTH;
+         if (element.mSurface!=mBatchSurface || (element.mFlags & texFlags)!=(mBatchFlags & texFlags))
+            return false;
+      }
+      if ( (ctrans!=0) != mBatchHasTransform )
+         return false;
+      return !ctrans || SameColourTransform(*ctrans,mBatchTransform);
+   }
+
+   void AddToBatch(const HardwareData &inData, const ColorTransform *ctrans, const Matrix &inMatrix)
+   {
+      int batched = 0;
+      for(int e=0;e<inData.mElements.size();e++)
+      {
+         const DrawElement &element = inData.mElements[e];
+         int n = element.mCount;
+         if (!n)
+            continue;
+
+         bool premAlpha = false;
+         int progId = GetProgId(element,ctrans,premAlpha);
+
+         if (!BatchMatches(progId,element,ctrans) || mBatchVertices+n>sgMaxBatchVertices)
+         {
+            FlushBatch();
+            if (!GetProg(progId))
+               continue;
+
+            mBatchProgId = progId;
+            mBatchPrimType = element.mPrimType;
+            mBatchBlendMode = element.mBlendMode;
+            mBatchFlags = element.mFlags;
+            mBatchColour = element.mColour;
+            mBatchPremAlpha = premAlpha;
+            mBatchHasTransform = ctrans!=0;
+            if (ctrans)
+               mBatchTransform = *ctrans;
+            mBatchSurface = (progId & PROG_TEXTURE) ? element.mSurface : 0;
+            if (mBatchSurface)
+               mBatchSurface->IncRef();
+         }
+
+         int stride = element.mStride;
+         const uint8 *vert = &inData.mArray[element.mVertexOffset];
+         const uint8 *tex = (progId & PROG_TEXTURE) ? &inData.mArray[element.mTexOffset] : 0;
+         const uint8 *col = (progId & PROG_COLOUR_PER_VERTEX) ? &inData.mArray[element.mColourOffset] : 0;
+
+         int pos = mBatchData.size();
+         mBatchData.resize(pos + n*sgBatchStride);
+         uint8 *dest = &mBatchData[pos];
+         for(int v=0;v<n;v++)
+         {
+            const float *p = (const float *)vert;
+            float *d = (float *)dest;
+            d[0] = inMatrix.m00*p[0] + inMatrix.m01*p[1] + inMatrix.mtx;
+            d[1] = inMatrix.m10*p[0] + inMatrix.m11*p[1] + inMatrix.mty;
+            if (tex)
+            {
+               d[2] = ((const float *)tex)[0];
+               d[3] = ((const float *)tex)[1];
+               tex += stride;
+            }
+            if (col)
+            {
+               *(uint32 *)(d+4) = *(const uint32 *)col;
+               col += stride;
+            }
+            vert += stride;
+            dest += sgBatchStride;
+         }
+         mBatchVertices += n;
+         batched++;
+      }
+
+      if (batched)
+         gCurrStats.record(batched, NME_GL_STATS_BATCH_OBJECTS);
+   }
+
+   void FlushBatch()
+   {
+      if (!mBatchVertices)
+         return;
+
+      int n = mBatchVertices;
+      mBatchVertices = 0;
+
+      // Vertices are already in viewport coordinates
+      if (mModelView!=Matrix())
+      {
+         mModelView = Matrix();
+         CombineModelView(mModelView);
+         mLineScaleV = -1;
+         mLineScaleH = -1;
+         mLineScaleNormal = -1;
+      }
+
+      if (!mBatchBuffer)
+         glGenBuffers(1,&mBatchBuffer);
+      glBindBuffer(GL_ARRAY_BUFFER, mBatchBuffer);
+      glBufferData(GL_ARRAY_BUFFER, mBatchData.size(), &mBatchData[0], GL_STREAM_DRAW);
+      mBatchData.resize(0);
+
+      GPUProg *prog = mProg[mBatchProgId];
+      SetBlendMode(mBatchBlendMode,mBatchPremAlpha);
+      prog->bind();
+      prog->setTransform(mTrans);
+
+      const uint8 *data = 0;
+      if (prog->vertexSlot >= 0)
+      {
+         glVertexAttribPointer(prog->vertexSlot, 2, GL_FLOAT, GL_FALSE, sgBatchStride, data);
+         glEnableVertexAttribArray(prog->vertexSlot);
+      }
+
+      if (prog->colourSlot >= 0)
+      {
+         glVertexAttribPointer(prog->colourSlot, 4, GL_UNSIGNED_BYTE, GL_TRUE, sgBatchStride,
+             data + 4*sizeof(float));
+         glEnableVertexAttribArray(prog->colourSlot);
+      }
+
+      if (prog->textureSlot >= 0)
+      {
+         glVertexAttribPointer(prog->textureSlot, 2, GL_FLOAT, GL_FALSE, sgBatchStride,
+             data + 2*sizeof(float));
+         glEnableVertexAttribArray(prog->textureSlot);
+
+         if (mBatchSurface)
+         {
+            Texture *boundTexture = mBatchSurface->GetTexture(this);
+            mBatchSurface->Bind(*this,0);
+            boundTexture->BindFlags(mBatchFlags & DRAW_BMP_REPEAT,mBatchFlags & DRAW_BMP_SMOOTH);
+         }
+      }
+
+      if (mBatchProgId & (PROG_TINT | PROG_COLOUR_OFFSET) )
+         prog->setColourTransform(mBatchHasTransform ? &mBatchTransform : 0, mBatchColour, mBatchPremAlpha );
+
+      if (mBatchPrimType==ptQuads)
+      {
+         BindQuadsBufferIndices(n);
+         GLsizei nVerts = n*3/2;
+         glDrawElements(GL_TRIANGLES, nVerts, mQuadsBufferType, 0 );
+         gCurrStats.record(nVerts, NME_GL_STATS_DRAW_ELEMENTS);
+      }
+      else
+      {
+         glDrawArrays(GL_TRIANGLES, 0, n );
+         gCurrStats.record(n, NME_GL_STATS_DRAW_ARRAYS);
+      }
+      gCurrStats.record(n, NME_GL_STATS_BATCH);
+
+      prog->disableSlots();
+      glBindBuffer(GL_ARRAY_BUFFER,0);
+
+      if (mBatchSurface)
+      {
+         mBatchSurface->DecRef();
+         mBatchSurface = 0;
+      }
    }
 
+
    void RenderData(const HardwareData &inData, const ColorTransform *ctrans,const Trans4x4 &inTrans)
+   {
+      FlushBatch();
+      DrawData(inData,ctrans,inTrans);
+   }
+
+
+   // Draws with no pending batch - inTrans may be mTrans, which a flush would change
+   void DrawData(const HardwareData &inData, const ColorTransform *ctrans,const Trans4x4 &inTrans)
    {
       const uint8 *data = 0;
       if (inData.mVertexBo)
@@ -460,8 +844,15 @@ public:
             inData.mContextId = 0;
          }
          else
+         {
             glBindBuffer(GL_ARRAY_BUFFER, inData.mVertexBo);
+            // Points updated in place only need their bytes re-sent
+            if (inData.mDirtyEnd>inData.mDirtyBegin)
+               glBufferSubData(GL_ARRAY_BUFFER, inData.mDirtyBegin, inData.mDirtyEnd-inData.mDirtyBegin,
+                               &inData.mArray[inData.mDirtyBegin]);
+         }
       }
+      inData.mDirtyBegin = inData.mDirtyEnd = 0;
 
       if (!inData.mVertexBo)
       {
@@ -477,7 +868,8 @@ public:
             inData.mContextId = gTextureContextVersion;
             glBindBuffer(GL_ARRAY_BUFFER, inData.mVertexBo);
             // printf("VBO DATA %d\n", inData.mArray.size());
-            glBufferData(GL_ARRAY_BUFFER, inData.mArray.size(), data, GL_STATIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, inData.mArray.size(), data,
+                         inData.mDynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
             data = 0;
          }
       }
@@ -498,59 +890,16 @@ public:
             rebind = false;
          }
 
-         int progId = 0;
          bool premAlpha = false;
-         if ((element.mFlags & DRAW_HAS_TEX) && element.mSurface)
-         {
-            if (IsPremultipliedAlpha(element.mSurface->Format()))
-               premAlpha = true;
-            progId |= PROG_TEXTURE;
-            if (element.mSurface->BytesPP()==1)
-               progId |= PROG_ALPHA_TEXTURE;
-         }
-
-         if (element.mFlags & DRAW_HAS_COLOUR)
-            progId |= PROG_COLOUR_PER_VERTEX;
-
-         if (element.mFlags & DRAW_HAS_NORMAL)
-            progId |= PROG_NORMAL_DATA;
-
-         if (element.mFlags & DRAW_RADIAL)
-         {
-            progId |= PROG_RADIAL;
-            if (element.mRadialPos!=0)
-               progId |= PROG_RADIAL_FOCUS;
-         }
-
-         if (ctrans || element.mColour != 0xffffffff)
-         {
-            progId |= PROG_TINT;
-            if (ctrans && ctrans->HasOffset())
-               progId |= PROG_COLOUR_OFFSET;
-         }
+         int progId = GetProgId(element,ctrans,premAlpha);
 
          bool persp = element.mFlags & DRAW_HAS_PERSPECTIVE;
 
-         GPUProg *prog = mProg[progId];
-         if (!prog)
-             mProg[progId] = prog = GPUProg::create(progId);
+         GPUProg *prog = GetProg(progId);
          if (!prog)
             continue;
 
-         switch(element.mBlendMode)
-         {
-            case bmAdd:
-               glBlendFunc( GL_SRC_ALPHA, GL_ONE );
-               break;
-            case bmMultiply:
-               glBlendFunc( GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA);
-               break;
-            case bmScreen:
-               glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_COLOR);
-               break;
-            default:
-               glBlendFunc(premAlpha ? GL_ONE : GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-         }
+         SetBlendMode(element.mBlendMode,premAlpha);
 
 
          if (prog!=lastProg)
@@ -622,7 +971,11 @@ public:
             prog->setColourTransform(ctrans, element.mColour, premAlpha );
          }
 
-         if ( (element.mPrimType == ptLineStrip || element.mPrimType==ptPoints || element.mPrimType==ptLines)
+         if (element.mPrimType==ptPoints)
+         {
+            prog->setPointSize( element.mWidth>0 ? GetScaledWidth(element) : 1.0 );
+         }
+         else if ( (element.mPrimType == ptLineStrip || element.mPrimType==ptLines)
                  && element.mCount>1)
          {
             if (element.mWidth<0)
@@ -630,31 +983,7 @@ public:
             else if (element.mWidth==0)
                SetLineWidth(0.0);
             else
-               switch(element.mScaleMode)
-               {
-                  case ssmNone: SetLineWidth(element.mWidth); break;
-                  case ssmNormal:
-                  case ssmOpenGL:
-                     if (mLineScaleNormal<0)
-                        mLineScaleNormal =
-                           sqrt( 0.5*( mModelView.m00*mModelView.m00 + mModelView.m01*mModelView.m01 +
-                                          mModelView.m10*mModelView.m10 + mModelView.m11*mModelView.m11 ) );
-                     SetLineWidth(element.mWidth*mLineScaleNormal);
-                     break;
-                  case ssmVertical:
-                     if (mLineScaleV<0)
-                        mLineScaleV =
-                           sqrt( mModelView.m00*mModelView.m00 + mModelView.m01*mModelView.m01 );
-                     SetLineWidth(element.mWidth*mLineScaleV);
-                     break;
-
-                  case ssmHorizontal:
-                     if (mLineScaleH<0)
-                        mLineScaleH =
-                           sqrt( mModelView.m10*mModelView.m10 + mModelView.m11*mModelView.m11 );
-                     SetLineWidth(element.mWidth*mLineScaleH);
-                     break;
-               }
+               SetLineWidth(GetScaledWidth(element));
          }
    
             //printf("glDrawArrays %d : %d x %d\n", element.mPrimType, element.mFirst, element.mCount );
@@ -770,6 +1099,32 @@ public:
    }
 
 
+   double GetScaledWidth(const DrawElement &element)
+   {
+      switch(element.mScaleMode)
+      {
+         case ssmNormal:
+         case ssmOpenGL:
+            if (mLineScaleNormal<0)
+               mLineScaleNormal =
+                  sqrt( 0.5*( mModelView.m00*mModelView.m00 + mModelView.m01*mModelView.m01 +
+                                 mModelView.m10*mModelView.m10 + mModelView.m11*mModelView.m11 ) );
+            return element.mWidth*mLineScaleNormal;
+         case ssmVertical:
+            if (mLineScaleV<0)
+               mLineScaleV =
+                  sqrt( mModelView.m00*mModelView.m00 + mModelView.m01*mModelView.m01 );
+            return element.mWidth*mLineScaleV;
+         case ssmHorizontal:
+            if (mLineScaleH<0)
+               mLineScaleH =
+                  sqrt( mModelView.m10*mModelView.m10 + mModelView.m11*mModelView.m11 );
+            return element.mWidth*mLineScaleH;
+         default:
+            return element.mWidth;
+      }
+   }
+
    inline void SetLineWidth(double inWidth)
    {
       if (inWidth!=mLineWidth)
@@ -842,6 +1197,24 @@ public:
    //Texture *mBitmapTexture;
 
    double mLineWidth;
+
+   GLint mStencilBits;
+   int   mMaskDepth;
+   bool  mProgramsPrecompiled;
+
+   // Pending batch of pre-transformed vertices, and the state they share
+   GLuint          mBatchBuffer;
+   QuickVec<uint8> mBatchData;
+   int             mBatchVertices;
+   int             mBatchProgId;
+   uint8           mBatchPrimType;
+   uint8           mBatchBlendMode;
+   uint8           mBatchFlags;
+   uint32          mBatchColour;
+   bool            mBatchPremAlpha;
+   bool            mBatchHasTransform;
+   ColorTransform  mBatchTransform;
+   Surface         *mBatchSurface;
    
    // TODO - mutex in case finalizer is run from thread
    bool             mHasZombie;
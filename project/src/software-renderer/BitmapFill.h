@@ -2,6 +2,8 @@
 #include <Surface.h>
 #include "Render.h"
 
+#include <NmeSimd.h>
+
 namespace nme
 {
 
@@ -12,6 +14,72 @@ static inline bool IsPOW2(int inX)
 
 enum { EDGE_CLAMP, EDGE_REPEAT, EDGE_POW2 };
 
+// Perspective fills divide exactly at the start of each span, and step linearly within it.
+//  Spans are halved until the error from the linear step is below PERSP_SPAN_MAX_ERROR texels.
+enum { PERSP_SPAN_MAX = 16 };
+static const double PERSP_SPAN_MAX_ERROR = 0.25;
+
+
+// Same result as BilinearInterp, but with all the channels of a pixel interpolated together.
+template<typename SRC>
+inline SRC BilinearFetch(SRC s00, SRC s01, SRC s10, SRC s11, int x_frac, int y_frac)
+{
+   return BilinearInterp(s00, s01, s10, s11, x_frac, y_frac);
+}
+
+#if defined(NME_SSE2)
+// a + ((b-a)*f>>16) == (a*(65535-f) + a + b*f)>>16, which keeps everything unsigned
+static inline __m128i BilinearLerp16(__m128i a, __m128i b, __m128i f, __m128i g)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i alo = _mm_mullo_epi16(a,g);
+   __m128i ahi = _mm_mulhi_epu16(a,g);
+   __m128i blo = _mm_mullo_epi16(b,f);
+   __m128i bhi = _mm_mulhi_epu16(b,f);
+   __m128i lo = _mm_add_epi32( _mm_add_epi32(_mm_unpacklo_epi16(alo,ahi), _mm_unpacklo_epi16(blo,bhi)),
+                               _mm_unpacklo_epi16(a,zero) );
+   __m128i hi = _mm_add_epi32( _mm_add_epi32(_mm_unpackhi_epi16(alo,ahi), _mm_unpackhi_epi16(blo,bhi)),
+                               _mm_unpackhi_epi16(a,zero) );
+   return _mm_packs_epi32(_mm_srli_epi32(lo,16), _mm_srli_epi32(hi,16));
+}
+
+template<bool PREM>
+inline BGRA<PREM> BilinearFetch(BGRA<PREM> s00, BGRA<PREM> s01, BGRA<PREM> s10, BGRA<PREM> s11, int x_frac, int y_frac)
+{
+   __m128i zero = _mm_setzero_si128();
+   // Top row in the low half, bottom row in the high half
+   __m128i left = _mm_unpacklo_epi8( _mm_unpacklo_epi32(_mm_cvtsi32_si128(s00.ival), _mm_cvtsi32_si128(s10.ival)), zero);
+   __m128i right = _mm_unpacklo_epi8( _mm_unpacklo_epi32(_mm_cvtsi32_si128(s01.ival), _mm_cvtsi32_si128(s11.ival)), zero);
+   __m128i col = BilinearLerp16(left, right, _mm_set1_epi16((short)x_frac), _mm_set1_epi16((short)(65535-x_frac)));
+   __m128i s = BilinearLerp16(col, _mm_unpackhi_epi64(col,col), _mm_set1_epi16((short)y_frac),
+                                   _mm_set1_epi16((short)(65535-y_frac)));
+   BGRA<PREM> result;
+   result.ival = _mm_cvtsi128_si32( _mm_packus_epi16(s,s) );
+   return result;
+}
+#elif defined(NME_NEON)
+static inline uint16x4_t BilinearLerp16(uint16x4_t a, uint16x4_t b, int f)
+{
+   uint32x4_t sum = vmull_n_u16(a, (uint16_t)(65535-f));
+   sum = vmlal_n_u16(sum, b, (uint16_t)f);
+   sum = vaddw_u16(sum, a);
+   return vshrn_n_u32(sum,16);
+}
+
+template<bool PREM>
+inline BGRA<PREM> BilinearFetch(BGRA<PREM> s00, BGRA<PREM> s01, BGRA<PREM> s10, BGRA<PREM> s11, int x_frac, int y_frac)
+{
+   uint16x8_t left = vmovl_u8( vreinterpret_u8_u32( vset_lane_u32(s10.ival, vdup_n_u32(s00.ival), 1) ) );
+   uint16x8_t right = vmovl_u8( vreinterpret_u8_u32( vset_lane_u32(s11.ival, vdup_n_u32(s01.ival), 1) ) );
+   uint16x4_t top = BilinearLerp16(vget_low_u16(left), vget_low_u16(right), x_frac);
+   uint16x4_t bottom = BilinearLerp16(vget_high_u16(left), vget_high_u16(right), x_frac);
+   uint16x4_t s = BilinearLerp16(top, bottom, y_frac);
+   BGRA<PREM> result;
+   result.ival = vget_lane_u32( vreinterpret_u32_u8( vmovn_u16(vcombine_u16(s,s)) ), 0);
+   return result;
+}
+#endif
+
 enum FillAlphaMode
 {
    FillAlphaIgnore,
@@ -26,14 +94,10 @@ class BitmapFillerBase : public Filler
 public:
    BitmapFillerBase(GraphicsBitmapFill *inFill) : mBitmap(inFill)
    {
-      mWidth = mBitmap->bitmapData->Width();
-      mHeight = mBitmap->bitmapData->Height();
-      mW1 = mWidth-1;
-      mH1 = mHeight-1;
-      mBase = mBitmap->bitmapData->GetBase();
-      mStride = mBitmap->bitmapData->GetStride();
+      SetSource(mBitmap->bitmapData);
       mMapped = false;
       mPerspective = false;
+      mSpanLeft = 0;
       mBilinearAdjust = 0;
       mTint = ARGB(0xffffffff);
    }
@@ -47,6 +111,7 @@ public:
       Matrix mapper = inMatrix;
       mapper = mapper.Mult(mBitmap->matrix);
       mMapper = mapper.Inverse();
+      SelectMip();
       adjustSubpixelMapper();
 
       mDPxDX = (int)(mMapper.m00 * (1<<16)+ 0.5);
@@ -140,6 +205,8 @@ public:
          }
       }
 
+      if (!mPerspective || inComponents<3)
+         SelectMip();
       adjustSubpixelMapper();
 
       if (!mPerspective || inComponents<3)
@@ -149,6 +216,45 @@ public:
       }
    }
 
+   void SetSource(Surface *inSurface)
+   {
+      mWidth = inSurface->Width();
+      mHeight = inSurface->Height();
+      mW1 = mWidth-1;
+      mH1 = mHeight-1;
+      mBase = inSurface->GetBase();
+      mStride = inSurface->GetStride();
+   }
+
+   // Smooth fills that shrink the bitmap by 2x or more sample a mip level instead,
+   //  so they neither alias nor shimmer as they move.  Call before adjustSubpixelMapper.
+   void SelectMip()
+   {
+      Surface *surface = mBitmap->bitmapData;
+      SetSource(surface);
+      if (mBilinearAdjust==0 || !mBase)
+         return;
+
+      double texelsPerPixel = sqrt( fabs(mMapper.m00*mMapper.m11 - mMapper.m01*mMapper.m10) );
+      int level = 0;
+      while(texelsPerPixel>=2.0)
+      {
+         texelsPerPixel *= 0.5;
+         level++;
+      }
+      Surface *mip = 0;
+      while(level>0 && !(mip=surface->GetMip(level)))
+         level--;
+      if (!mip || mip==surface)
+         return;
+
+      double sx = (double)mip->Width()/mWidth;
+      double sy = (double)mip->Height()/mHeight;
+      mMapper.m00 *= sx; mMapper.m01 *= sx; mMapper.mtx *= sx;
+      mMapper.m10 *= sy; mMapper.m11 *= sy; mMapper.mty *= sy;
+      SetSource(mip);
+   }
+
    void adjustSubpixelMapper()
    {
       //  Tex =  mMapper * screen
@@ -179,6 +285,8 @@ public:
    bool mPerspective;
    double mWX, mWY, mW0;
    double mTX, mTY, mTW;
+   ImagePoint mSpanEnd;
+   int mSpanLeft;
    double mBilinearAdjust;
    Matrix mMapper;
    ARGB   mTint;
@@ -196,16 +304,54 @@ public:
       mBilinearAdjust = SMOOTH ? 0.5 : 0.0;
    }
 
+   // Texture position of the current (mTX,mTY,mTW), in 16.16
+   inline ImagePoint ProjectPersp() const
+   {
+      double w = 65536.0/mTW;
+      double x = mTX*w;
+      double y = mTY*w;
+      // Keep the steps from overflowing where w passes through 0
+      const double limit = (double)(1<<29);
+      return ImagePoint( (int)(x<-limit ? -limit : x>limit ? limit : x),
+                         (int)(y<-limit ? -limit : y>limit ? limit : y) );
+   }
+
+   // Starts a span at mSpanEnd, and finds where it ends exactly, so the steps can be linear.
+   void NextPerspSpan()
+   {
+      mPos = mSpanEnd;
+
+      int n = PERSP_SPAN_MAX;
+      double tw1 = mTW + mWX*n;
+      if (mTW*tw1 <= 0)
+         n = 1;
+      else
+      {
+         // Error from stepping linearly over n pixels ~ n*n/4 * |dw/dx / w| * |du/dx|
+         double w = fabs(mTW) < fabs(tw1) ? fabs(mTW) : fabs(tw1);
+         double u = mTX/mTW;
+         double v = mTY/mTW;
+         double err = 0.25*fabs(mWX)/w * (fabs(mMapper.m00 - u*mWX) + fabs(mMapper.m10 - v*mWX))/w;
+         while(n>1 && n*n*err>PERSP_SPAN_MAX_ERROR)
+            n>>=1;
+      }
+
+      mTX += mMapper.m00*n;
+      mTY += mMapper.m10*n;
+      mTW += mWX*n;
+      mSpanEnd = ProjectPersp();
+      mDPxDX = (mSpanEnd.x - mPos.x)/n;
+      mDPyDX = (mSpanEnd.y - mPos.y)/n;
+      mSpanLeft = n;
+   }
+
    SRC GetInc( )
    {
       if (PERSP)
       {
-         double w = 65536.0/mTW;
-         mPos.x = (int)(mTX*w);
-         mPos.y = (int)(mTY*w);
-         mTX += mMapper.m00;
-         mTY += mMapper.m10;
-         mTW += mWX;
+         if (!mSpanLeft)
+            NextPerspSpan();
+         mSpanLeft--;
       }
 
       int x = mPos.x >> 16;
@@ -216,11 +362,8 @@ public:
          int frac_x = (mPos.x & 0xffff);
          int frac_y = (mPos.y & 0xffff);
 
-         if (!PERSP)
-         {
-            mPos.x += mDPxDX;
-            mPos.y += mDPyDX;
-         }
+         mPos.x += mDPxDX;
+         mPos.y += mDPyDX;
 
          SRC p00,p01,p10,p11;
 
@@ -274,15 +417,12 @@ public:
             p11 = *(SRC *)(p+ x1);
          }
 
-         return BilinearInterp(p00, p01, p10, p11, frac_x, frac_y);
+         return BilinearFetch(p00, p01, p10, p11, frac_x, frac_y);
       }
       else
       {
-         if (!PERSP)
-         {
-            mPos.x += mDPxDX;
-            mPos.y += mDPyDX;
-         }
+         mPos.x += mDPxDX;
+         mPos.y += mDPyDX;
 
          if (EDGE == EDGE_CLAMP)
          {
@@ -316,6 +456,8 @@ public:
          mTX = mMapper.m00*x + mMapper.m01*y + mMapper.mtx;
          mTY = mMapper.m10*x + mMapper.m11*y + mMapper.mty;
          mTW =         mWX*x +         mWY*y +         mW0;
+         mSpanEnd = ProjectPersp();
+         mSpanLeft = 0;
       }
       else
       {
@@ -1,10 +1,200 @@
 #include <Graphics.h>
 #include "Render.h"
+#include <math.h>
+
+#include <NmeSimd.h>
 
 
 namespace nme
 {
 	
+	// Colours are generated a span at a time, and handed out by GetInc.  The positions
+	//  along the span are computed 4 at a time, and the spread is applied to the colour
+	//  index without branching.  Since most runs are short anti-aliased edges, the first
+	//  span after SetPos is only 4 pixels, and each following one doubles, up to GRADIENT_SPAN.
+	enum { GRADIENT_SPAN = 32, GRADIENT_FIRST_SPAN = 4 };
+	
+	
+	#if defined(NME_SSE2)
+	// Lanes of inValue outside [0,inMax] are clamped to the nearest end
+	static inline __m128i ClampIndex4(__m128i inValue, int inMax)
+	{
+		__m128i max = _mm_set1_epi32(inMax);
+		__m128i v = _mm_andnot_si128(_mm_cmplt_epi32(inValue, _mm_setzero_si128()), inValue);
+		__m128i over = _mm_cmpgt_epi32(v, max);
+		return _mm_or_si128(_mm_and_si128(over, max), _mm_andnot_si128(over, v));
+	}
+	
+	// Square root of non-negative lanes as x*rsqrt(x) with one Newton step - close
+	//  enough to pick the same colour as sqrt to within one step of the ramp
+	static inline __m128 SqrtApprox4(__m128 inX)
+	{
+		__m128 r = _mm_rsqrt_ps(inX);
+		__m128 halfX = _mm_mul_ps(inX, _mm_set1_ps(0.5f));
+		r = _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(halfX, _mm_mul_ps(r, r))));
+		// rsqrt(0) is infinite
+		return _mm_and_ps(_mm_mul_ps(inX, r), _mm_cmpgt_ps(inX, _mm_setzero_ps()));
+	}
+	#elif defined(NME_NEON)
+	static inline int32x4_t ClampIndex4(int32x4_t inValue, int inMax)
+	{
+		return vminq_s32(vmaxq_s32(inValue, vdupq_n_s32(0)), vdupq_n_s32(inMax));
+	}
+	
+	static inline float32x4_t SqrtApprox4(float32x4_t inX)
+	{
+		// The estimate is only 8 bits, so take two steps
+		float32x4_t r = vrsqrteq_f32(inX);
+		r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(inX, r), r));
+		r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(inX, r), r));
+		uint32x4_t positive = vcgtq_f32(inX, vdupq_n_f32(0.0f));
+		return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(inX, r)), positive));
+	}
+	#endif
+	
+	
+	// inCount is a multiple of 4, no more than GRADIENT_SPAN
+	// Linear positions are 24.8 in [0,255] when padding, otherwise 17.15, wrapped by the mask
+	template<bool PAD>
+	static void LinearGradientSpan(ARGB *outSpan, int inCount, const ARGB *inColours, int inPos, int inStep, int inMask)
+	{
+		int idx[GRADIENT_SPAN];
+		int i = 0;
+		#if defined(NME_SSE2)
+		__m128i pos = _mm_add_epi32(_mm_set1_epi32(inPos), _mm_set_epi32(3*inStep, 2*inStep, inStep, 0));
+		__m128i step = _mm_set1_epi32(4*inStep);
+		__m128i mask = _mm_set1_epi32(inMask);
+		for(; i<inCount; i+=4)
+		{
+			__m128i v = PAD ? ClampIndex4(_mm_srai_epi32(pos, 8), 255) :
+			                  _mm_and_si128(_mm_srai_epi32(pos, 15), mask);
+			_mm_storeu_si128((__m128i *)(idx + i), v);
+			pos = _mm_add_epi32(pos, step);
+		}
+		#elif defined(NME_NEON)
+		int32_t lanes[4] = { 0, inStep, 2*inStep, 3*inStep };
+		int32x4_t pos = vaddq_s32(vdupq_n_s32(inPos), vld1q_s32(lanes));
+		int32x4_t step = vdupq_n_s32(4*inStep);
+		int32x4_t mask = vdupq_n_s32(inMask);
+		for(; i<inCount; i+=4)
+		{
+			int32x4_t v = PAD ? ClampIndex4(vshrq_n_s32(pos, 8), 255) :
+			                    vandq_s32(vshrq_n_s32(pos, 15), mask);
+			vst1q_s32(idx + i, v);
+			pos = vaddq_s32(pos, step);
+		}
+		#else
+		for(; i<inCount; i++)
+		{
+			int p = inPos + i*inStep;
+			if (PAD)
+			{
+				p >>= 8;
+				idx[i] = p < 0 ? 0 : p > 255 ? 255 : p;
+			}
+			else
+				idx[i] = (p >> 15) & inMask;
+		}
+		#endif
+		for(i=0; i<inCount; i++)
+			outSpan[i] = inColours[idx[i]];
+	}
+	
+	
+	// See GradientRadialFiller for the derivation.  When there is no focus, the ratio
+	//  is the distance from the centre, otherwise it is the root of the quadratic.
+	template<bool PAD, bool FOCAL0>
+	static void RadialGradientSpan(ARGB *outSpan, int inCount, const ARGB *inColours, double inGX, double inGY,
+	                               double inDX, double inDY, double inFX, double inA, double inOn2A, int inMask)
+	{
+		int idx[GRADIENT_SPAN];
+		int i = 0;
+		#if defined(NME_SSE2)
+		__m128 ramp = _mm_set_ps(3, 2, 1, 0);
+		__m128 gx = _mm_add_ps(_mm_set1_ps((float)inGX), _mm_mul_ps(ramp, _mm_set1_ps((float)inDX)));
+		__m128 gy = _mm_add_ps(_mm_set1_ps((float)inGY), _mm_mul_ps(ramp, _mm_set1_ps((float)inDY)));
+		__m128 dx4 = _mm_set1_ps((float)(inDX*4));
+		__m128 dy4 = _mm_set1_ps((float)(inDY*4));
+		__m128 twoFX = _mm_set1_ps((float)(2.0*inFX));
+		__m128 a = _mm_set1_ps((float)inA);
+		__m128 on2A = _mm_set1_ps((float)inOn2A);
+		__m128 zero = _mm_setzero_ps();
+		__m128 scale = _mm_set1_ps((float)inMask);
+		__m128i mask = _mm_set1_epi32(inMask);
+		for(; i<inCount; i+=4)
+		{
+			__m128 C = _mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy));
+			__m128 alpha;
+			if (FOCAL0)
+				alpha = SqrtApprox4(C);
+			else
+			{
+				__m128 B = _mm_mul_ps(twoFX, gx);
+				__m128 det = _mm_max_ps(_mm_sub_ps(_mm_mul_ps(B, B), _mm_mul_ps(a, C)), zero);
+				alpha = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(zero, B), SqrtApprox4(det)), on2A);
+			}
+			__m128 pos = _mm_mul_ps(alpha, scale);
+			__m128i v = PAD ? _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(pos, zero), scale)) :
+			                  _mm_and_si128(_mm_cvttps_epi32(pos), mask);
+			_mm_storeu_si128((__m128i *)(idx + i), v);
+			gx = _mm_add_ps(gx, dx4);
+			gy = _mm_add_ps(gy, dy4);
+		}
+		#elif defined(NME_NEON)
+		float lanes[4] = { 0, 1, 2, 3 };
+		float32x4_t ramp = vld1q_f32(lanes);
+		float32x4_t gx = vmlaq_n_f32(vdupq_n_f32((float)inGX), ramp, (float)inDX);
+		float32x4_t gy = vmlaq_n_f32(vdupq_n_f32((float)inGY), ramp, (float)inDY);
+		float32x4_t dx4 = vdupq_n_f32((float)(inDX*4));
+		float32x4_t dy4 = vdupq_n_f32((float)(inDY*4));
+		float32x4_t zero = vdupq_n_f32(0.0f);
+		float32x4_t scale = vdupq_n_f32((float)inMask);
+		int32x4_t mask = vdupq_n_s32(inMask);
+		for(; i<inCount; i+=4)
+		{
+			float32x4_t C = vmlaq_f32(vmulq_f32(gx, gx), gy, gy);
+			float32x4_t alpha;
+			if (FOCAL0)
+				alpha = SqrtApprox4(C);
+			else
+			{
+				float32x4_t B = vmulq_n_f32(gx, (float)(2.0*inFX));
+				float32x4_t det = vmaxq_f32(vmlsq_n_f32(vmulq_f32(B, B), C, (float)inA), zero);
+				alpha = vmulq_n_f32(vsubq_f32(vnegq_f32(B), SqrtApprox4(det)), (float)inOn2A);
+			}
+			float32x4_t pos = vmulq_f32(alpha, scale);
+			int32x4_t v = PAD ? vcvtq_s32_f32(vminq_f32(vmaxq_f32(pos, zero), scale)) :
+			                    vandq_s32(vcvtq_s32_f32(pos), mask);
+			vst1q_s32(idx + i, v);
+			gx = vaddq_f32(gx, dx4);
+			gy = vaddq_f32(gy, dy4);
+		}
+		#else
+		for(; i<inCount; i++)
+		{
+			double gx = inGX + i*inDX;
+			double gy = inGY + i*inDY;
+			double C = gx * gx + gy * gy;
+			double alpha;
+			if (FOCAL0)
+				alpha = sqrt(C);
+			else
+			{
+				double B = 2.0 * (gx * inFX);
+				double det = B * B - inA * C;
+				alpha = det <= 0 ? -B * inOn2A : (-B - sqrt(det)) * inOn2A;
+			}
+			if (PAD)
+				idx[i] = alpha <= 0 ? 0 : alpha >= 1.0 ? inMask : (int)(alpha * inMask);
+			else
+				idx[i] = ((int)(alpha * inMask)) & inMask;
+		}
+		#endif
+		for(i=0; i<inCount; i++)
+			outSpan[i] = inColours[idx[i]];
+	}
+	
+	
 	class GradientFillerBase : public Filler
 	{
 	public:
@@ -22,6 +212,7 @@ namespace nme
 			mIsInit = false;
 			mPad =  inFill->spreadMethod == smPad;
 			mRadial = false;
+			ResetSpan();
 		}
 		
 		
@@ -69,6 +260,23 @@ namespace nme
 		
 		virtual void DoRender(const AlphaMask &inMask, const RenderTarget &inTarget, const RenderState &inState, int inTX, int inTY) = 0;
 		
+		inline void ResetSpan()
+		{
+			mSpanPos = mSpanEnd = 0;
+			mSpanNext = GRADIENT_FIRST_SPAN;
+		}
+		
+		// Size of the span to generate now, and grow the next one
+		inline int NextSpan()
+		{
+			int count = mSpanNext;
+			if (mSpanNext<GRADIENT_SPAN)
+				mSpanNext *= 2;
+			mSpanPos = 0;
+			mSpanEnd = count;
+			return count;
+		}
+		
 		int mPos;
 		int mDGXDX;
 		int mDGYDX;
@@ -80,6 +288,10 @@ namespace nme
 		Matrix mMapper;
 		ARGB *mColours;
 		GraphicsGradientFill *mGrad;
+		ARGB mSpan[GRADIENT_SPAN];
+		int mSpanPos;
+		int mSpanEnd;
+		int mSpanNext;
 		
 	};
 	
@@ -101,28 +313,20 @@ namespace nme
 				mPos = (int)((mMapper.m00 * cx + mMapper.m01 * cy + mMapper.mtx) * (1 << 16) + 0.5);
 			else
 				mPos = (int)((mMapper.m00 * cx + mMapper.m01 * cy + mMapper.mtx) * (1 << 23) + 0.5);
+			ResetSpan();
 		}
 		
 		
-		ARGB GetInc()
+		inline ARGB GetInc()
 		{
-			if (PAD)
+			if (mSpanPos == mSpanEnd)
 			{
-				int p = mPos >> 8;
-				mPos += mDGXDX;
-				
-				if (p < 0)
-					return mColours[0];
-				if (p > 255)
-					return mColours[255];
-				return mColours[p];
-			}
-			else
-			{
-				int p = mPos;
-				mPos += mDGXDX;
-				return mColours[(p >> 15) & mMask];
+				// Forward difference along the span
+				int count = NextSpan();
+				LinearGradientSpan<PAD>(mSpan, count, mColours, mPos, mDGXDX, mMask);
+				mPos += mDGXDX * count;
 			}
+			return mSpan[mSpanPos++];
 		}
 		
 		
@@ -169,6 +373,7 @@ namespace nme
 				mGX = mMapper.m00 * cx + mMapper.m01 * cy + mMapper.mtx - mFX;
 			
 			mGY = mMapper.m10 * cx + mMapper.m11 * cy + mMapper.mty;
+			ResetSpan();
 		}
 		
 		
@@ -227,45 +432,17 @@ namespace nme
 		//	 of 4.0 for the quadratic equation
 		
 		
-		ARGB GetInc()
+		inline ARGB GetInc()
 		{
-			double alpha;
-			double C = mGX * mGX + mGY * mGY;
-			
-			if (GRADIENT_FOCAL0)
-			{
-				alpha = sqrt(C);
-			}
-			else
-			{
-				double B = 2.0 * (mGX * mFX);
-				
-				double det = B * B - mA * C;
-				if (det <= 0)
-					alpha = -B * mOn2A;
-					// TODO: what exactly is this condition ?
-				else if (1)
-					alpha = (-B - sqrt(det)) * mOn2A;
-				else
-					alpha = (-B + sqrt(det)) * mOn2A;
-			}
-			
-			mGX += mMapper.m00;
-			mGY += mMapper.m10;
-			
-			if (PAD)
-			{
-				if (alpha <= 0)
-					return *mColours;
-				else if (alpha >= 1.0)
-					return mColours[mMask];
-				else
-				  return mColours[((int)(alpha * mMask))];
-			}
-			else
+			if (mSpanPos == mSpanEnd)
 			{
-				return mColours[((int)(alpha * (mMask))) & (mMask)];
+				int count = NextSpan();
+				RadialGradientSpan<PAD,GRADIENT_FOCAL0>(mSpan, count, mColours, mGX, mGY, mMapper.m00, mMapper.m10,
+				                                        mFX, mA, mOn2A, mMask);
+				mGX += mMapper.m00 * count;
+				mGY += mMapper.m10 * count;
 			}
+			return mSpan[mSpanPos++];
 		}
 		
 		
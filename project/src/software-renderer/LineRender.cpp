@@ -1,4 +1,6 @@
 #include "PolygonRender.h"
+#include <algorithm>
+#include <vector>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -9,6 +11,259 @@
 namespace nme
 {
 
+// --- AnalyticStroke ---------------------------------------------------
+//
+// Thin strokes are rasterized straight into coverage rows, rather than being turned
+//  into outlines and scan-converted.  Each row only stores the span that has been drawn on.  Each segment is a box, and a pixel's coverage is its
+//  overlap with the box across the line times its overlap along it.  Where segments join,
+//  the box ends are cut hard at the vertex so neighbours tile without a seam, and the gap
+//  on the outside of the turn is filled with a disk (round) or a triangle (bevel).
+// The pieces are combined with max, so overlaps do not build up.
+
+#define ANALYTIC_STROKE_MAX_HALF_WIDTH 2.0
+
+static inline double ClampCover(double inCover)
+{
+   return inCover<=0 ? 0 : inCover>=1 ? 1 : inCover;
+}
+
+// Narrow [ioX0,ioX1) to the pixels whose centres, on row centre inY, satisfy
+//  inA*x + inB*y + inC >= 0
+static inline void ClipRowToHalfPlane(double inA, double inB, double inC, double inY, int &ioX0, int &ioX1)
+{
+   double rest = inB*inY + inC;
+   if (fabs(inA)<1e-12)
+   {
+      if (rest<-1e-9)
+         ioX1 = ioX0;
+      return;
+   }
+   double x = -rest/inA - 0.5;
+   if (inA>0)
+   {
+      int x0 = (int)ceil(x-1e-6);
+      if (x0>ioX0) ioX0 = x0;
+   }
+   else
+   {
+      int x1 = (int)floor(x+1e-6) + 1;
+      if (x1<ioX1) ioX1 = x1;
+   }
+}
+
+
+class AnalyticStroke
+{
+public:
+   AnalyticStroke(const Rect &inRect, double inHalfWidth) :
+      mRect(inRect), mHalfWidth(inHalfWidth), mRows(inRect.h) { }
+
+   // Box along inP0->inP1.  Soft ends are anti-aliased, and extended by inExt (square caps),
+   //  hard ends stop exactly at the point.
+   void Segment(const UserPoint &inP0, const UserPoint &inP1, bool inSoft0, double inExt0, bool inSoft1, double inExt1)
+   {
+      UserPoint d = inP1-inP0;
+      double len = d.Norm();
+      if (len<=0)
+         return;
+      d = d * (1.0/len);
+      UserPoint n = d.Perp();
+      double hw = mHalfWidth;
+      double w = hw + 0.5;
+      double lo = inSoft0 ? -inExt0-0.5 : 0.0;
+      double hi = inSoft1 ? len+inExt1+0.5 : len;
+
+      double minY = 1e30, maxY = -1e30;
+      for(int c=0;c<4;c++)
+      {
+         UserPoint corner = inP0 + d*( c&1 ? hi : lo ) + n*( c&2 ? w : -w );
+         if (corner.y<minY) minY = corner.y;
+         if (corner.y>maxY) maxY = corner.y;
+      }
+
+      double nOff = n.Dot(inP0);
+      double dOff = d.Dot(inP0);
+      int y0,y1;
+      if (!GetRows(minY,maxY,y0,y1))
+         return;
+      for(int y=y0;y<y1;y++)
+      {
+         double yc = y+0.5;
+         int x0 = mRect.x;
+         int x1 = mRect.x1();
+         ClipRowToHalfPlane( n.x, n.y, w-nOff, yc, x0, x1);
+         ClipRowToHalfPlane(-n.x,-n.y, w+nOff, yc, x0, x1);
+         ClipRowToHalfPlane( d.x, d.y, -lo-dOff, yc, x0, x1);
+         ClipRowToHalfPlane(-d.x,-d.y, hi+dOff, yc, x0, x1);
+         if (x0>=x1)
+            continue;
+
+         double across = n.x*(x0+0.5) + n.y*yc - nOff;
+         double along = d.x*(x0+0.5) + d.y*yc - dOff;
+         unsigned short *cover = Row(y,x0,x1);
+         for(int x=x0;x<x1;x++)
+         {
+            double c = std::min(across+0.5,hw) - std::max(across-0.5,-hw);
+            double a0 = inSoft0 ? std::max(along-0.5,-inExt0) : along-0.5;
+            double a1 = inSoft1 ? std::min(along+0.5,len+inExt1) : along+0.5;
+            Cover(cover[x], ClampCover(c)*ClampCover(a1-a0));
+            across += n.x;
+            along += d.x;
+         }
+      }
+   }
+
+   // Round joint or cap
+   void Disk(const UserPoint &inCentre)
+   {
+      double r = mHalfWidth;
+      double w = r + 0.5;
+      int y0,y1;
+      if (!GetRows(inCentre.y-w, inCentre.y+w, y0, y1))
+         return;
+      for(int y=y0;y<y1;y++)
+      {
+         double dy = y+0.5-inCentre.y;
+         double h2 = w*w - dy*dy;
+         if (h2<=0)
+            continue;
+         double h = sqrt(h2);
+         int x0 = std::max( (int)ceil(inCentre.x-h-0.5), mRect.x );
+         int x1 = std::min( (int)floor(inCentre.x+h-0.5)+1, mRect.x1() );
+         if (x0>=x1)
+            continue;
+         unsigned short *cover = Row(y,x0,x1);
+         for(int x=x0;x<x1;x++)
+         {
+            double dx = x+0.5-inCentre.x;
+            double dist = sqrt(dx*dx+dy*dy);
+            // Hairlines (r<0.5) can not cover more than their width
+            Cover(cover[x], ClampCover( std::min(w-dist, r+r) ) );
+         }
+      }
+   }
+
+   // Bevel joint at inV, between unit directions inD0 (in) and inD1 (out).
+   // The triangle sits in the wedge past the end of the first box and before the start
+   //  of the second, which is always on the outside of the turn.
+   void Bevel(const UserPoint &inV, const UserPoint &inD0, const UserPoint &inD1)
+   {
+      UserPoint n0 = inD0.Perp();
+      UserPoint n1 = inD1.Perp();
+      double t0 = n0.Dot(inD1);
+      double t1 = n1.Dot(inD0);
+      if (fabs(t0)<1e-6)
+         return;
+      UserPoint a = inV + n0*( t0>0 ? -mHalfWidth : mHalfWidth );
+      UserPoint b = inV + n1*( t1<0 ? -mHalfWidth : mHalfWidth );
+      UserPoint m = (b-a).Perp().Normalized();
+      if (m.Dot(a-inV)<0)
+         m = -m;
+
+      double minY = std::min(inV.y, std::min(a.y,b.y)) - 0.5;
+      double maxY = std::max(inV.y, std::max(a.y,b.y)) + 0.5;
+      double vd0 = inD0.Dot(inV);
+      double vd1 = inD1.Dot(inV);
+      double am = m.Dot(a);
+      int y0,y1;
+      if (!GetRows(minY,maxY,y0,y1))
+         return;
+      for(int y=y0;y<y1;y++)
+      {
+         double yc = y+0.5;
+         int x0 = mRect.x;
+         int x1 = mRect.x1();
+         ClipRowToHalfPlane( inD0.x, inD0.y, -vd0, yc, x0, x1);
+         ClipRowToHalfPlane(-inD1.x,-inD1.y,  vd1, yc, x0, x1);
+         ClipRowToHalfPlane(-m.x, -m.y, am+0.5, yc, x0, x1);
+         if (x0>=x1)
+            continue;
+
+         double out = m.x*(x0+0.5) + m.y*yc - am;
+         unsigned short *cover = Row(y,x0,x1);
+         for(int x=x0;x<x1;x++)
+         {
+            Cover(cover[x], ClampCover(0.5-out));
+            out += m.x;
+         }
+      }
+   }
+
+   AlphaMask *CreateMask(const Transform &inTransform)
+   {
+      AlphaMask *mask = AlphaMask::Create(mRect, inTransform);
+      AlphaRuns &runs = mask->mAlphaRuns;
+      runs.resize(0);
+      for(int y=0;y<mRect.h;y++)
+      {
+         mask->mLineStarts[y] = runs.size();
+         const CoverRow &row = mRows[y];
+         const unsigned short *cover = row.cover.empty() ? 0 : &row.cover[0];
+         int w = row.cover.size();
+         for(int x=0;x<w; )
+         {
+            int alpha = cover[x];
+            int x0 = x++;
+            while(x<w && cover[x]==alpha)
+               x++;
+            if (alpha)
+               runs.push_back( AlphaRun(row.x0+x0, row.x0+x, alpha) );
+         }
+      }
+      mask->mLineStarts[mRect.h] = runs.size();
+      return mask;
+   }
+
+private:
+   bool GetRows(double inMinY, double inMaxY, int &outY0, int &outY1)
+   {
+      outY0 = std::max( (int)ceil(inMinY-0.5), mRect.y );
+      outY1 = std::min( (int)floor(inMaxY-0.5)+1, mRect.y1() );
+      return outY0<outY1;
+   }
+
+   struct CoverRow
+   {
+      int x0;
+      std::vector<unsigned short> cover;
+   };
+
+   // Indexed by absolute x, and valid over at least [inX0,inX1)
+   unsigned short *Row(int inY, int inX0, int inX1)
+   {
+      CoverRow &row = mRows[inY-mRect.y];
+      if (row.cover.empty())
+      {
+         row.x0 = inX0;
+         row.cover.resize(inX1-inX0,0);
+      }
+      else
+      {
+         int x1 = row.x0 + row.cover.size();
+         if (inX0<row.x0)
+         {
+            row.cover.insert(row.cover.begin(), row.x0-inX0, 0);
+            row.x0 = inX0;
+         }
+         if (inX1>x1)
+            row.cover.resize(row.cover.size() + inX1-x1, 0);
+      }
+      return &row.cover[0] - row.x0;
+   }
+
+   inline void Cover(unsigned short &ioCover, double inCover)
+   {
+      int alpha = (int)(inCover*256 + 0.5);
+      if (alpha>ioCover)
+         ioCover = alpha;
+   }
+
+   Rect mRect;
+   double mHalfWidth;
+   std::vector<CoverRow> mRows;
+};
+
+
 // --- LineRender ---------------------------------------------------
 
 class LineRender : public PolygonRender
@@ -199,6 +454,110 @@ public:
    }
    
    
+   // Thin solid strokes made of straight lines skip the outline and are drawn by
+   //  AnalyticStroke.  Miter joints and curves still go through the polygon path.
+   AlphaMask *CreateAnalyticMask(const Rect &inVisiblePixels)
+   {
+      if (mTransform.mAAFactor<2 || mStroke->joints==sjMiter || !mStroke->fill ||
+            mStroke->fill->GetType()!=gdtSolidFill)
+         return 0;
+
+      double perp_len = GetPerpLen(*mTransform.mMatrix,false);
+      if (perp_len<=0 || perp_len>ANALYTIC_STROKE_MAX_HALF_WIDTH)
+         return 0;
+
+      for(int i=0;i<mCommandCount;i++)
+         switch(mCommands[mCommand0 + i])
+         {
+            case pcMoveTo: case pcLineTo: case pcWideMoveTo: case pcWideLineTo: case pcBeginAt:
+               break;
+            default:
+               return 0;
+         }
+
+      AnalyticStroke stroke(inVisiblePixels, perp_len);
+
+      // Same sub-path and implicit loop-closing rules as Iterate
+      std::vector<UserPoint> path;
+      const UserPoint *point = &mTransformed[0];
+      for(int i=0;i<mCommandCount;i++)
+      {
+         switch(mCommands[mCommand0 + i])
+         {
+            case pcWideMoveTo:
+               point++;
+            case pcBeginAt:
+            case pcMoveTo:
+               if (path.size()==1 && path[0]==*point)
+               {
+                  point++;
+                  continue;
+               }
+               if (path.size()>1)
+                  AnalyticPath(stroke, path, false);
+               path.resize(0);
+               path.push_back(*point++);
+               break;
+
+            case pcWideLineTo:
+               point++;
+            case pcLineTo:
+               if (path.empty())
+                  return 0;
+               if (*point!=path.back())
+               {
+                  path.push_back(*point);
+                  if (path.size()>2 && *point==path[0])
+                  {
+                     AnalyticPath(stroke, path, true);
+                     path.resize(0);
+                     path.push_back(*point);
+                  }
+               }
+               point++;
+               break;
+         }
+      }
+      if (path.size()>1)
+         AnalyticPath(stroke, path, false);
+
+      return stroke.CreateMask(mTransform);
+   }
+
+
+   // A closed path repeats its first point at the end
+   void AnalyticPath(AnalyticStroke &ioStroke, const std::vector<UserPoint> &inPath, bool inClosed)
+   {
+      int segs = inPath.size()-1;
+      bool round = mStroke->joints==sjRound;
+      double ext = mStroke->caps==scSquare ? GetPerpLen(*mTransform.mMatrix,false) : 0.0;
+      UserPoint prev_dir = inClosed ? (inPath[segs]-inPath[segs-1]).Normalized() : UserPoint(0,0);
+      for(int s=0;s<segs;s++)
+      {
+         const UserPoint &p0 = inPath[s];
+         const UserPoint &p1 = inPath[s+1];
+         UserPoint dir = (p1-p0).Normalized();
+         if (s>0 || inClosed)
+         {
+            if (round)
+               ioStroke.Disk(p0);
+            else
+               ioStroke.Bevel(p0, prev_dir, dir);
+         }
+         bool cap0 = !inClosed && s==0;
+         bool cap1 = !inClosed && s==segs-1;
+         ioStroke.Segment(p0, p1, cap0, ext, cap1, ext);
+         prev_dir = dir;
+      }
+
+      if (!inClosed && mStroke->caps==scRound)
+      {
+         ioStroke.Disk(inPath[0]);
+         ioStroke.Disk(inPath[segs]);
+      }
+   }
+
+
    double GetPerpLen(const Matrix &m, bool inForExtent)
    {
       if (!mIncludeStrokeInExtent && inForExtent)
@@ -460,6 +819,10 @@ public:
    }
    
    
+   // The triangle edges are not in the path commands
+   AlphaMask *CreateAnalyticMask(const Rect &inVisiblePixels) { return 0; }
+
+
    bool Hits(const RenderState &inState)
    {
       if (mSolid && mSolid->Hits(inState))
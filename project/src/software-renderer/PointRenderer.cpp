@@ -1,52 +1,268 @@
 #include "PolygonRender.h"
+#include <Surface.h>
+#include <NMEThread.h>
+#include <algorithm>
+#include <vector>
+
+#include <NmeSimd.h>
 
 
 namespace nme
 {
 
+// Points are plotted straight from the path data, transformed a block at a time, rather
+//  than being kept in a transformed copy.  Large clouds are binned into bands of rows and
+//  the bands are plotted on the workers - a band keeps its points in order, and no pixel is
+//  in two bands, so the result is the same as plotting them one at a time.
+
+enum { POINT_BLOCK = 256, POINT_BAND_HEIGHT = 32, POINT_PARALLEL_MIN_POINTS = 1<<16 };
+
+// Keeps the pixel coordinates well inside a short
+#define POINT_COORD_LIMIT 16384.0f
+
+enum PointMode { pmStore, pmBlend, pmBlendColours };
+
+
+struct PointTransform
+{
+   PointTransform(const Transform &inTrans, int inOffset) : mTrans(inTrans), mOffset(inOffset)
+   {
+      const Matrix &m = *inTrans.mMatrix;
+      m00 = m.m00; m01 = m.m01; mtx = m.mtx;
+      m10 = m.m10; m11 = m.m11; mty = m.mty;
+      mAffine = !inTrans.mScale9->Active();
+   }
+
+   // Top-left pixel of each point's square
+   void Apply(const UserPoint *inP, int inN, int *outX, int *outY) const
+   {
+      int i = 0;
+      if (mAffine)
+      {
+         #if defined(NME_SSE2)
+         __m128 a00 = _mm_set1_ps(m00), a01 = _mm_set1_ps(m01), atx = _mm_set1_ps(mtx);
+         __m128 a10 = _mm_set1_ps(m10), a11 = _mm_set1_ps(m11), aty = _mm_set1_ps(mty);
+         __m128 lo = _mm_set1_ps(-POINT_COORD_LIMIT), hi = _mm_set1_ps(POINT_COORD_LIMIT);
+         __m128i offset = _mm_set1_epi32(mOffset);
+         for(;i+4<=inN;i+=4)
+         {
+            __m128 p01 = _mm_loadu_ps(&inP[i].x);
+            __m128 p23 = _mm_loadu_ps(&inP[i+2].x);
+            __m128 x = _mm_shuffle_ps(p01,p23,_MM_SHUFFLE(2,0,2,0));
+            __m128 y = _mm_shuffle_ps(p01,p23,_MM_SHUFFLE(3,1,3,1));
+            __m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a00,x),_mm_mul_ps(a01,y)),atx);
+            __m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a10,x),_mm_mul_ps(a11,y)),aty);
+            tx = _mm_min_ps(_mm_max_ps(tx,lo),hi);
+            ty = _mm_min_ps(_mm_max_ps(ty,lo),hi);
+            // Floor = truncate, minus one where that rounded up
+            __m128i ix = _mm_cvttps_epi32(tx);
+            __m128i iy = _mm_cvttps_epi32(ty);
+            ix = _mm_add_epi32(ix, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(ix),tx)));
+            iy = _mm_add_epi32(iy, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(iy),ty)));
+            _mm_storeu_si128((__m128i *)(outX+i), _mm_sub_epi32(ix,offset));
+            _mm_storeu_si128((__m128i *)(outY+i), _mm_sub_epi32(iy,offset));
+         }
+         #elif defined(NME_NEON)
+         float32x4_t lo = vdupq_n_f32(-POINT_COORD_LIMIT), hi = vdupq_n_f32(POINT_COORD_LIMIT);
+         int32x4_t offset = vdupq_n_s32(mOffset);
+         for(;i+4<=inN;i+=4)
+         {
+            float32x4x2_t p = vld2q_f32(&inP[i].x);
+            float32x4_t tx = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(mtx),p.val[0],m00),p.val[1],m01);
+            float32x4_t ty = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(mty),p.val[0],m10),p.val[1],m11);
+            tx = vminq_f32(vmaxq_f32(tx,lo),hi);
+            ty = vminq_f32(vmaxq_f32(ty,lo),hi);
+            int32x4_t ix = vcvtq_s32_f32(tx);
+            int32x4_t iy = vcvtq_s32_f32(ty);
+            ix = vaddq_s32(ix, vreinterpretq_s32_u32(vcgtq_f32(vcvtq_f32_s32(ix),tx)));
+            iy = vaddq_s32(iy, vreinterpretq_s32_u32(vcgtq_f32(vcvtq_f32_s32(iy),ty)));
+            vst1q_s32(outX+i, vsubq_s32(ix,offset));
+            vst1q_s32(outY+i, vsubq_s32(iy,offset));
+         }
+         #endif
+      }
+
+      for(;i<inN;i++)
+      {
+         UserPoint p = mAffine ? UserPoint(m00*inP[i].x + m01*inP[i].y + mtx, m10*inP[i].x + m11*inP[i].y + mty) :
+                                 mTrans.Apply(inP[i].x,inP[i].y);
+         outX[i] = (int)floorf( std::min(std::max(p.x,-POINT_COORD_LIMIT),POINT_COORD_LIMIT) ) - mOffset;
+         outY[i] = (int)floorf( std::min(std::max(p.y,-POINT_COORD_LIMIT),POINT_COORD_LIMIT) ) - mOffset;
+      }
+   }
+
+   const Transform &mTrans;
+   float m00, m01, mtx;
+   float m10, m11, mty;
+   int   mOffset;
+   bool  mAffine;
+};
+
+
+struct PointPlotter
+{
+   const RenderTarget *mTarget;
+   ARGB        mColour;
+   const ARGB *mColours;
+   int         mSize;
+
+   template<int MODE>
+   inline void PlotPixel(ARGB &ioDest, int inIndex) const
+   {
+      if (MODE==pmStore)
+         ioDest = mColour;
+      else
+         BlendPixel(ioDest, MODE==pmBlend ? mColour : mColours[inIndex]);
+   }
+
+   template<int MODE>
+   inline void Plot(int inX, int inY, int inIndex, const Rect &inClip) const
+   {
+      if (mSize==1)
+      {
+         if (inX>=inClip.x && inX<inClip.x1() && inY>=inClip.y && inY<inClip.y1())
+            PlotPixel<MODE>( ((ARGB *)mTarget->Row(inY))[inX], inIndex);
+         return;
+      }
+
+      int x0 = std::max(inX,inClip.x);
+      int x1 = std::min(inX+mSize,inClip.x1());
+      int y0 = std::max(inY,inClip.y);
+      int y1 = std::min(inY+mSize,inClip.y1());
+      for(int y=y0;y<y1;y++)
+      {
+         ARGB *row = (ARGB *)mTarget->Row(y);
+         for(int x=x0;x<x1;x++)
+            PlotPixel<MODE>(row[x], inIndex);
+      }
+   }
+};
+
+
+struct PointRef
+{
+   int   mIndex;
+   short mX;
+   short mY;
+};
+
+
+struct PointBandJob
+{
+   const PointPlotter *mPlotter;
+   int                 mMode;
+   Rect                mClip;
+   // Points touching each band
+   const BandBins<PointRef> *mBins;
+};
+
+
+template<int MODE>
+static void TPlotPointBand(const PointBandJob &inJob, int inBand)
+{
+   Rect clip = inJob.mClip;
+   clip.y = inJob.mBins->BandY0(inBand);
+   clip.h = inJob.mBins->BandY1(inBand) - clip.y;
+
+   const PointPlotter &plotter = *inJob.mPlotter;
+   const PointRef *ref = inJob.mBins->Begin(inBand);
+   const PointRef *end = inJob.mBins->End(inBand);
+   for(;ref<end;ref++)
+      plotter.Plot<MODE>(ref->mX, ref->mY, ref->mIndex, clip);
+}
+
+static void PlotPointBand(const PointBandJob &inJob, int inBand)
+{
+   switch(inJob.mMode)
+   {
+      case pmStore: TPlotPointBand<pmStore>(inJob, inBand); break;
+      case pmBlend: TPlotPointBand<pmBlend>(inJob, inBand); break;
+      default: TPlotPointBand<pmBlendColours>(inJob, inBand); break;
+   }
+}
+
+static void SPlotPointBand(int, int inBand, void *inJob)
+{
+   PlotPointBand(*(const PointBandJob *)inJob, inBand);
+}
+
+
+
 class PointRenderer : public CachedExtentRenderer
 {
 public:
-      
-   const QuickVec<float> &mData;
-      
+
+   const PathData  &mData;
+
    int             mData0;
    int             mCount;
    bool            mHasColours;
-      
+
    ARGB            mCol;
-      
-   Transform           mTransform;
-   QuickVec<UserPoint> mTransformed;
-      
-   
+   GraphicsStroke  *mStroke;
+
+   // Reused between frames
+   BandBins<PointRef> mBins;
+
+
    PointRenderer(const GraphicsJob &inJob, const GraphicsPath &inPath) :
        mData(inPath.data), mData0(inJob.mData0)
    {
       GraphicsSolidFill *fill = inJob.mFill ? inJob.mFill->AsSolidFill() : 0;
       if (fill)
          mCol = fill->mRGB;
-      
+
       mHasColours = fill == 0;
       mCount = inJob.mDataCount/(fill ? 2 : 3);
+      mStroke = inJob.mStroke;
    }
-   
-   
+
+
    void Destroy()
    {
       delete this;
    }
-   
-   
-   void GetExtent(CachedExtent &ioCache)
+
+
+   const UserPoint *Points() const { return (const UserPoint *)&mData[mData0]; }
+
+
+   // Side of the square plotted for each point, following the hardware line-width rules
+   int GetPointSize(const Matrix &m) const
    {
-      SetTransform(ioCache.mTransform);
+      if (!mStroke || mStroke->thickness<=0)
+         return 1;
+
+      double size = mStroke->thickness;
+      switch(mStroke->scaleMode)
+      {
+         case ssmNone:
+            break;
+         case ssmNormal:
+         case ssmOpenGL:
+            size *= sqrt( 0.5*(m.m00*m.m00 + m.m01*m.m01 + m.m10*m.m10 + m.m11*m.m11) );
+            break;
+         case ssmVertical:
+            size *= sqrt( m.m00*m.m00 + m.m01*m.m01 );
+            break;
+         case ssmHorizontal:
+            size *= sqrt( m.m10*m.m10 + m.m11*m.m11 );
+            break;
+      }
+      int result = (int)(size + 0.5);
+      return result<1 ? 1 : result>64 ? 64 : result;
+   }
+
 
-      for(int i=0;i<mTransformed.size();i++)
-         ioCache.mExtent.Add(mTransformed[i]);
+   void GetExtent(CachedExtent &ioCache)
+   {
+      const UserPoint *src = Points();
+      const Transform &trans = ioCache.mTransform;
+      for(int i=0;i<mCount;i++)
+         ioCache.mExtent.Add( trans.Apply(src[i].x,src[i].y) );
    }
-   
-   
+
+
    bool Hits(const RenderState &inState)
    {
       UserPoint screen(inState.mClipRect.x, inState.mClipRect.y);
@@ -56,126 +272,133 @@ public:
       if (!extent.Contains(screen))
           return false;
 
-      UserPoint hit_test = inState.mTransform.mMatrix->ApplyInverse(screen);
-      if (inState.mTransform.mScale9->Active())
+      double radius = std::max(1.0, GetPointSize(*inState.mTransform.mMatrix)*0.5);
+      const UserPoint *src = Points();
+      for(int i=0;i<mCount;i++)
       {
-         hit_test.x = inState.mTransform.mScale9->InvTransX(hit_test.x);
-         hit_test.y = inState.mTransform.mScale9->InvTransY(hit_test.y);
+         UserPoint point = inState.mTransform.Apply(src[i].x,src[i].y);
+         if ( fabs(point.x-screen.x) < radius && fabs(point.y-screen.y) < radius )
+            return true;
       }
+      return false;
+   }
+
 
-      for(int i=0;i<mTransformed.size();i++)
+   template<int MODE>
+   void PlotAll(const PointPlotter &inPlotter, const PointTransform &inTrans, const Rect &inClip)
+   {
+      const UserPoint *src = Points();
+      int xs[POINT_BLOCK];
+      int ys[POINT_BLOCK];
+      for(int i0=0;i0<mCount;i0+=POINT_BLOCK)
       {
-         const UserPoint &point = mTransformed[i];
-         if ( fabs(point.x-screen.x) < 1 && fabs(point.y-screen.y) < 1 )
-            return true;
+         int n = std::min((int)POINT_BLOCK, mCount-i0);
+         inTrans.Apply(src+i0, n, xs, ys);
+         for(int i=0;i<n;i++)
+            inPlotter.Plot<MODE>(xs[i], ys[i], i0+i, inClip);
       }
-      return false;
    }
-   
+
+
+   // Count the points touching each band, then place them in order
+   void BinPoints(const Rect &inClip, const PointTransform &inTrans, int inSize)
+   {
+      const UserPoint *src = Points();
+      int xs[POINT_BLOCK];
+      int ys[POINT_BLOCK];
+
+      mBins.Reset(inClip.y, inClip.h, POINT_BAND_HEIGHT);
+      for(int pass=0;pass<2;pass++)
+      {
+         for(int i0=0;i0<mCount;i0+=POINT_BLOCK)
+         {
+            int n = std::min((int)POINT_BLOCK, mCount-i0);
+            inTrans.Apply(src+i0, n, xs, ys);
+            for(int i=0;i<n;i++)
+            {
+               int x = xs[i];
+               int y = ys[i];
+               if (x+inSize<=inClip.x || x>=inClip.x1())
+                  continue;
+               if (pass==0)
+                  mBins.Count(y, y+inSize);
+               else
+               {
+                  PointRef ref;
+                  ref.mIndex = i0+i;
+                  ref.mX = x;
+                  ref.mY = y;
+                  mBins.Place(y, y+inSize, ref);
+               }
+            }
+         }
+
+         if (pass==0)
+            mBins.EndCount();
+      }
+   }
+
 
    bool Render( const RenderTarget &inTarget, const RenderState &inState )
    {
       Extent2DF extent;
       CachedExtentRenderer::GetExtent(inState.mTransform,extent,true);
 
-      if (!extent.Valid())
+      if (!extent.Valid() || !mCount)
          return true;
 
-      // Get bounding pixel rect
+      int size = GetPointSize(*inState.mTransform.mMatrix);
+
+      // Get bounding pixel rect, grown by the point size
       Rect rect = inState.mTransform.GetTargetRect(extent);
+      rect = Rect(rect.x-size, rect.y-size, rect.w+size*2, rect.h+size*2);
 
       // Intersect with clip rect ...
       Rect visible_pixels = rect.Intersect(inState.mClipRect);
-      int x0 = visible_pixels.x;
-      int y0 = visible_pixels.y;
-      int x1 = visible_pixels.x1();
-      int y1 = visible_pixels.y1();
+      if (!visible_pixels.HasPixels())
+         return true;
 
+      PointPlotter plotter;
+      plotter.mTarget = &inTarget;
+      plotter.mColour = mCol;
+      plotter.mColours = mHasColours ? (const ARGB *)&mData[mData0 + mCount*2] : 0;
+      plotter.mSize = size;
 
+      int mode = pmBlendColours;
       if (!mHasColours)
       {
-         int val =  mCol.ival;
          // 100% alpha...
-         if ( ( (val & 0xff000000) == 0xff000000 ) || HasAlphaChannel(inTarget.mPixelFormat) )
-         {
-            for(int i=0;i<mTransformed.size();i++)
-            {
-                const UserPoint &point = mTransformed[i];
-                int tx = point.x;
-                if (x0<=tx && tx<x1)
-                {
-                   int ty = point.y;
-                   if (y0<=ty && ty<y1)
-                      ((int *)inTarget.Row(ty))[tx] = val;
-                }
-             }
-         }
+         if ( ( (mCol.ival & 0xff000000) == 0xff000000 ) || HasAlphaChannel(inTarget.mPixelFormat) )
+            mode = pmStore;
          else
-         {
-            ARGB argb = mCol;
-
-            for(int i=0;i<mTransformed.size();i++)
-            {
-               const UserPoint &point = mTransformed[i];
-               int tx = point.x;
-               if (x0<=tx && tx<x1)
-               {
-                  int ty = point.y;
-                  if (y0<=ty && ty<y1)
-                     BlendPixel( ((ARGB *)inTarget.Row(ty))[tx],argb);
-               }
-            }
-         }
+            mode = pmBlend;
       }
-      else
+
+      PointTransform trans(inState.mTransform, (size-1)/2);
+
+      int bands = (visible_pixels.h + POINT_BAND_HEIGHT-1)/POINT_BAND_HEIGHT;
+      if (bands>1 && mCount>=POINT_PARALLEL_MIN_POINTS && GetWorkerCount()>1)
       {
-         ARGB *argb = (ARGB *) & mData[mData0 + mTransformed.size()*2];
-         if (HasAlphaChannel(inTarget.mPixelFormat))
-            for(int i=0;i<mTransformed.size();i++)
-            {
-               const UserPoint &point = mTransformed[i];
-               int tx = point.x;
-               if (x0<=tx && tx<x1)
-               {
-                  int ty = point.y;
-                  if (y0<=ty && ty<y1)
-                     BlendPixel( ((ARGB *)inTarget.Row(ty))[tx],argb[i]);
-               }
-            }
-         else
-            for(int i=0;i<mTransformed.size();i++)
-            {
-               const UserPoint &point = mTransformed[i];
-               int tx = point.x;
-               if (x0<=tx && tx<x1)
-               {
-                  int ty = point.y;
-                  if (y0<=ty && ty<y1)
-                     BlendPixel( ((ARGB *)inTarget.Row(ty))[tx], argb[i] );
-               }
-            }
+         PointBandJob job;
+         job.mPlotter = &plotter;
+         job.mMode = mode;
+         job.mClip = visible_pixels;
+         BinPoints(visible_pixels, trans, size);
+         job.mBins = &mBins;
+         RunRowBands(mBins.Bands(), SPlotPointBand, &job);
       }
-      
-      return true;
-   }
-   
-   
-   void SetTransform(const Transform &inTrans)
-   {
-      int points = mCount;
-      if (points!=mTransformed.size() || inTrans!=mTransform)
+      else
       {
-         mTransform = inTrans;
-         mTransformed.resize(points);
-         UserPoint *src= (UserPoint *)&mData[ mData0 ];
-         for(int i=0;i<points;i++)
+         switch(mode)
          {
-            mTransformed[i] = mTransform.Apply(src[i].x,src[i].y);
+            case pmStore: PlotAll<pmStore>(plotter, trans, visible_pixels); break;
+            case pmBlend: PlotAll<pmBlend>(plotter, trans, visible_pixels); break;
+            default: PlotAll<pmBlendColours>(plotter, trans, visible_pixels); break;
          }
       }
+
+      return true;
    }
-   
-   
 };
 
 Renderer *CreatePointRenderer(const GraphicsJob &inJob, const GraphicsPath &inPath)
@@ -186,4 +409,3 @@ Renderer *CreatePointRenderer(const GraphicsJob &inJob, const GraphicsPath &inPa
 } // end namespace nme
 
 
-
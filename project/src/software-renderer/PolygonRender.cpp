@@ -16,24 +16,26 @@ PolygonRender::PolygonRender(const GraphicsJob &inJob, const GraphicsPath &inPat
    mAlphaMask = 0;
    mIncludeStrokeInExtent = true;
    
+   mFiller = CreateFiller(inFill, inJob.mTriangles && inJob.mTriangles->mType == vtVertexUVT);
+}
+
+
+Filler *PolygonRender::CreateFiller(IGraphicsFill *inFill, bool inPerspective)
+{
    switch(inFill->GetType())
    {
       case gdtSolidFill:
-         mFiller = Filler::Create(inFill->AsSolidFill());
-         break;
+         return Filler::Create(inFill->AsSolidFill());
       case gdtGradientFill:
-         mFiller = Filler::Create(inFill->AsGradientFill());
-         break;
+         return Filler::Create(inFill->AsGradientFill());
       case gdtBitmapFill:
-         if (inJob.mTriangles && inJob.mTriangles->mType == vtVertexUVT )
-            mFiller = Filler::CreatePerspective(inFill->AsBitmapFill());
-         else
-            mFiller = Filler::Create(inFill->AsBitmapFill());
-         break;
+         if (inPerspective)
+            return Filler::CreatePerspective(inFill->AsBitmapFill());
+         return Filler::Create(inFill->AsBitmapFill());
       default:
          printf("Fill type not implemented\n");
-         mFiller = 0;
    }
+   return 0;
 }
 
 
@@ -364,7 +366,12 @@ bool PolygonRender::Render(const RenderTarget &inTarget, const RenderState &inSt
       if (!mAlphaMask)
       {
          SetTransform(inState.mTransform);
-         
+
+         mAlphaMask = CreateAnalyticMask(visible_pixels);
+      }
+
+      if (!mAlphaMask)
+      {
          // TODO: make visible_pixels a bit bigger ?
          SpanRect span(visible_pixels, inState.mTransform.mAAFactor);
          span.mWinding = GetWinding();
@@ -22,6 +22,7 @@ public:
 
    static PolygonRender *CreateLines(const GraphicsJob &inJob, const GraphicsPath &inPath);
    static PolygonRender *CreateTriangleLines(const GraphicsJob &inJob, const GraphicsPath &inPath, Renderer *inSolid);
+   static Filler *CreateFiller(IGraphicsFill *inFill, bool inPerspective);
    
    ~PolygonRender();
    void Destroy();
@@ -43,6 +44,8 @@ public:
    
    virtual int Iterate(IterateMode inMode,const Matrix &m) = 0;
    virtual void AlignOrthogonal() {}
+   // Build the mask directly, rather than by scan-converting outlines - return 0 to decline
+   virtual AlphaMask *CreateAnalyticMask(const Rect &inVisiblePixels) { return 0; }
    
    UserPoint mHitTest;
    int mHitsLeft;
@@ -55,8 +58,8 @@ public:
    struct SpanRect *mSpanRect;
    AlphaMask *mAlphaMask;
    
-   const QuickVec<uint8> &mCommands;
-   const QuickVec<float> &mData;
+   const PathCommands &mCommands;
+   const PathData     &mData;
    
    int mCommand0;
    int mData0;
@@ -12,6 +12,46 @@ public:
    SolidRender(const GraphicsJob &inJob, const GraphicsPath &inPath) : PolygonRender(inJob, inPath, inJob.mFill) { }
    
    int GetWinding() { return 0x0001; }
+
+   // Same points as itGetExtent, but in local space
+   bool GetExtentHull(ExtentHull &outHull)
+   {
+      int n = mCommandCount;
+      if (n<3)
+         return true;
+
+      const UserPoint *point = (const UserPoint *)&mData[ mData0 ];
+      UserPoint last;
+
+      for(int i=0;i<n;i++)
+      {
+         switch(mCommands[ mCommand0 + i])
+         {
+            case pcWideMoveTo:
+               point++;
+            case pcMoveTo:
+            case pcBeginAt:
+               last = *point;
+               point++;
+               break;
+
+            case pcWideLineTo:
+               point++;
+            case pcLineTo:
+               outHull.AddPoint(last);
+               last = *point;
+               outHull.AddPoint(last);
+               point++;
+               break;
+            case pcCurveTo:
+               outHull.AddCurve(last, point[0], point[1]);
+               last = point[1];
+               point += 2;
+               break;
+         }
+      }
+      return true;
+   }
    
    int Iterate(IterateMode inMode,const Matrix &)
    {
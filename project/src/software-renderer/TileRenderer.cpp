@@ -1,5 +1,9 @@
 #include "PolygonRender.h"
 #include <Surface.h>
+#include <NMEThread.h>
+#include <algorithm>
+
+#include <NmeSimd.h>
 
 
 namespace nme
@@ -55,6 +59,248 @@ struct TileData
 
 
 
+
+// --- Batched tiles ---------------------------------------------------------------
+//
+// When the bitmap and target are both 32-bit, and there is no colour transform or mask,
+//  tiles are drawn directly: unscaled tiles are row blends and everything else is walked
+//  in 16.16 source co-ordinates.  Tiles are binned into bands of target rows, and the
+//  bands are rasterized on the workers.  Each band draws its tiles in order.
+
+enum { TILE_BAND_HEIGHT = 64, TILE_PARALLEL_MIN_TILES = 256 };
+
+struct TileSpan
+{
+   // Part of the bitmap
+   Rect   mSrc;
+   // Target pixels that may be touched, clipped
+   Rect   mDest;
+   // Unscaled tiles are copied from mSrc.x-mCopyX, mSrc.y-mCopyY
+   bool   mCopy;
+   int    mCopyX;
+   int    mCopyY;
+   // Target pixel -> offset in mSrc
+   Matrix mInverse;
+   unsigned int mColour;
+   bool   mHasColour;
+};
+
+
+// Matches TintSource<false,true>, which the blitter uses for tinted tiles
+struct TileTint
+{
+   TileTint(unsigned int inCol)
+   {
+      ARGB col(inCol);
+      a0 = col.a; if (a0>127) a0++;
+      r = col.r; if (r>127) r++;
+      g = col.g; if (g>127) g++;
+      b = col.b; if (b>127) b++;
+   }
+   inline ARGB Apply(const ARGB &inPixel) const
+   {
+      ARGB result;
+      result.a = (a0*inPixel.a)>>8;
+      result.r = (r*inPixel.r)>>8;
+      result.g = (g*inPixel.g)>>8;
+      result.b = (b*inPixel.b)>>8;
+      return result;
+   }
+   int a0, r, g, b;
+};
+
+
+// Matches AddHandler - the colours are summed and the target alpha is kept
+template<bool PREM, typename SRC>
+inline void AddTilePixel(BGRA<PREM> &ioDest, const SRC &inSrc)
+{
+   BGRA<PREM> sum;
+   sum.r = std::min(ioDest.r + (PREM ? inSrc.getRAlpha() : inSrc.getR()), 255);
+   sum.g = std::min(ioDest.g + (PREM ? inSrc.getGAlpha() : inSrc.getG()), 255);
+   sum.b = std::min(ioDest.b + (PREM ? inSrc.getBAlpha() : inSrc.getB()), 255);
+   sum.a = ioDest.a;
+   BlendPixel(ioDest, sum);
+}
+
+template<bool ADD, bool TINT, typename DEST, typename SRC>
+inline void TilePixel(DEST &ioDest, const SRC &inSrc, const TileTint &inTint)
+{
+   if (TINT)
+   {
+      // Tinting reads the raw components, like the blitter does
+      ARGB tinted = inTint.Apply( *(const ARGB *)&inSrc );
+      if (ADD)
+         AddTilePixel(ioDest, tinted);
+      else
+         BlendPixel(ioDest, tinted);
+   }
+   else if (ADD)
+      AddTilePixel(ioDest, inSrc);
+   else
+      BlendPixel(ioDest, inSrc);
+}
+
+
+// Returns the number of pixels blended - only premultiplied onto premultiplied has an
+//  exact vector form, the others go through the alpha tables
+template<typename DEST, typename SRC>
+inline int BlendTileRowFast(DEST *, const SRC *, int) { return 0; }
+
+inline int BlendTileRowFast(BGRPremA *outDest, const BGRPremA *inSrc, int inN)
+{
+   int x = 0;
+   #if defined(NME_SSE2)
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i all = _mm_set1_epi32(255);
+   for(;x+4<=inN;x+=4)
+   {
+      __m128i s = _mm_loadu_si128( (const __m128i *)(inSrc+x) );
+      __m128i d = _mm_loadu_si128( (const __m128i *)(outDest+x) );
+      __m128i a = _mm_srli_epi32(s,24);
+      __m128i notA = _mm_sub_epi32(all,a);
+      notA = _mm_or_si128(notA, _mm_slli_epi32(notA,16));
+      __m128i lo = _mm_srli_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8(d,zero), _mm_unpacklo_epi32(notA,notA) ), 8);
+      __m128i hi = _mm_srli_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8(d,zero), _mm_unpackhi_epi32(notA,notA) ), 8);
+      __m128i blended = _mm_add_epi8(s, _mm_packus_epi16(lo,hi));
+      // Fully transparent pixels leave the target untouched
+      __m128i keep = _mm_cmpeq_epi32(a,zero);
+      _mm_storeu_si128( (__m128i *)(outDest+x),
+                        _mm_or_si128( _mm_and_si128(keep,d), _mm_andnot_si128(keep,blended) ) );
+   }
+   #elif defined(NME_NEON)
+   for(;x+4<=inN;x+=4)
+   {
+      uint8x16_t s = vld1q_u8( (const uint8_t *)(inSrc+x) );
+      uint8x16_t d = vld1q_u8( (const uint8_t *)(outDest+x) );
+      uint32x4_t a = vshrq_n_u32( vreinterpretq_u32_u8(s), 24 );
+      uint8x16_t notA = vmvnq_u8( vreinterpretq_u8_u32( vmulq_n_u32(a,0x01010101) ) );
+      uint16x8_t lo = vshrq_n_u16( vmull_u8( vget_low_u8(d), vget_low_u8(notA) ), 8);
+      uint16x8_t hi = vshrq_n_u16( vmull_u8( vget_high_u8(d), vget_high_u8(notA) ), 8);
+      uint8x16_t blended = vaddq_u8(s, vcombine_u8( vmovn_u16(lo), vmovn_u16(hi) ) );
+      uint8x16_t keep = vreinterpretq_u8_u32( vceqq_u32(a, vdupq_n_u32(0)) );
+      vst1q_u8( (uint8_t *)(outDest+x), vbslq_u8(keep, d, blended) );
+   }
+   #endif
+   return x;
+}
+
+
+struct TileBandJob
+{
+   const RenderTarget *mTarget;
+   const uint8        *mSrcBase;
+   int                mSrcStride;
+   PixelFormat        mSrcFormat;
+   bool               mSmooth;
+   bool               mAdd;
+   const TileSpan     *mTiles;
+   // Indices of the tiles touching each band
+   BandBins<int>      mBins;
+};
+
+
+// Rows of the tile's source rect, for TAffineRows
+struct TileSource
+{
+   const uint8 *mBase;
+   int         mStride;
+
+   inline const uint8 *Row(int inY) const { return mBase + mStride*inY; }
+};
+
+template<bool ADD, bool TINT>
+struct TileOutput
+{
+   const TileTint &mTint;
+
+   TileOutput(const TileTint &inTint) : mTint(inTint) { }
+   template<typename DEST, typename SRC>
+   inline void operator()(DEST &outDest, const SRC &inSrc) const { TilePixel<ADD,TINT>(outDest, inSrc, mTint); }
+};
+
+
+template<bool ADD, bool TINT, typename DEST, typename SRC>
+void TDrawTileRows(const TileBandJob &inJob, const TileSpan &inTile, int inY0, int inY1)
+{
+   const TileTint tint(inTile.mColour);
+   const Rect &src = inTile.mSrc;
+   const Rect &dest = inTile.mDest;
+
+   if (inTile.mCopy)
+   {
+      for(int y=inY0;y<inY1;y++)
+      {
+         DEST *d = (DEST *)inJob.mTarget->Row(y) + dest.x;
+         const SRC *s = (const SRC *)(inJob.mSrcBase + inJob.mSrcStride*(y-inTile.mCopyY)) + dest.x-inTile.mCopyX;
+         int x = (ADD || TINT) ? 0 : BlendTileRowFast(d, s, dest.w);
+         for(;x<dest.w;x++)
+            TilePixel<ADD,TINT>(d[x], s[x], tint);
+      }
+      return;
+   }
+
+   TileSource source = { inJob.mSrcBase + inJob.mSrcStride*src.y + src.x*sizeof(SRC), inJob.mSrcStride };
+   TileOutput<ADD,TINT> output(tint);
+   TAffineRows<DEST,SRC>(*inJob.mTarget, source, src.w, src.h, inTile.mInverse, dest.x, dest.w, inY0, inY1,
+                         inJob.mSmooth, output);
+}
+
+
+template<typename DEST, typename SRC>
+void TDrawTileBand(const TileBandJob &inJob, int inBand)
+{
+   int y0 = inJob.mBins.BandY0(inBand);
+   int y1 = inJob.mBins.BandY1(inBand);
+   for(const int *i=inJob.mBins.Begin(inBand); i<inJob.mBins.End(inBand); i++)
+   {
+      const TileSpan &tile = inJob.mTiles[*i];
+      int ty0 = std::max(y0, tile.mDest.y);
+      int ty1 = std::min(y1, tile.mDest.y1());
+
+      if (inJob.mAdd)
+      {
+         if (tile.mHasColour)
+            TDrawTileRows<true,true,DEST,SRC>(inJob, tile, ty0, ty1);
+         else
+            TDrawTileRows<true,false,DEST,SRC>(inJob, tile, ty0, ty1);
+      }
+      else
+      {
+         if (tile.mHasColour)
+            TDrawTileRows<false,true,DEST,SRC>(inJob, tile, ty0, ty1);
+         else
+            TDrawTileRows<false,false,DEST,SRC>(inJob, tile, ty0, ty1);
+      }
+   }
+}
+
+
+static void DrawTileBand(const TileBandJob &inJob, int inBand)
+{
+   bool srcPrem = inJob.mSrcFormat==pfBGRPremA;
+   if (inJob.mTarget->Format()==pfBGRPremA)
+   {
+      if (srcPrem)
+         TDrawTileBand<BGRPremA,BGRPremA>(inJob, inBand);
+      else
+         TDrawTileBand<BGRPremA,ARGB>(inJob, inBand);
+   }
+   else
+   {
+      if (srcPrem)
+         TDrawTileBand<ARGB,BGRPremA>(inJob, inBand);
+      else
+         TDrawTileBand<ARGB,ARGB>(inJob, inBand);
+   }
+}
+
+static void SDrawTileBand(int, int inBand, void *inJob)
+{
+   DrawTileBand(*(const TileBandJob *)inJob, inBand);
+}
+
+
+
 class TileRenderer : public Renderer
 {
 public:
@@ -62,6 +308,7 @@ public:
    GraphicsBitmapFill *mFill;
    Filler             *mFiller;
    QuickVec<TileData> mTileData;
+   QuickVec<TileSpan> mSpans;
    BlendMode          mBlendMode;
    unsigned int       mFlags;
 
@@ -143,10 +390,122 @@ public:
    }
    
    
-   bool Render(const RenderTarget &inTarget, const RenderState &inState)
+   bool CanBatch(const RenderTarget &inTarget, const RenderState &inState) const
+   {
+      Surface *s = mFill->bitmapData;
+      PixelFormat src = s->Format();
+      PixelFormat dest = inTarget.Format();
+      return !inTarget.IsHardware() && s->GetBase() &&
+             (src==pfBGRA || src==pfBGRPremA) && (dest==pfBGRA || dest==pfBGRPremA) &&
+             (mBlendMode==bmNormal || mBlendMode==bmAdd) && !inState.mMask &&
+             (!inState.mColourTransform || inState.mColourTransform->IsIdentity());
+   }
+
+
+   void RenderBatched(const RenderTarget &inTarget, const RenderState &inState)
    {
       #define orthoTol 1e-6
 
+      Surface *s = mFill->bitmapData;
+      Rect clip = inState.mClipRect.Intersect(inTarget.mRect);
+      if (!clip.HasPixels())
+         return;
+
+      const Matrix &m = *inState.mTransform.mMatrix;
+      bool is_base_ortho = fabs(m.m01)< orthoTol  && fabs(m.m10)< orthoTol;
+      bool is_base_identity = is_base_ortho && fabs(m.m00-1.0)<orthoTol && fabs(m.m11-1.0)<orthoTol;
+      Rect bitmap(s->Width(), s->Height());
+
+      mSpans.resize(0);
+      for(int i=0;i<mTileData.size();i++)
+      {
+         const TileData &data= mTileData[i];
+         TileSpan span;
+         span.mSrc = data.mRect.Intersect(bitmap);
+         if (!span.mSrc.HasPixels())
+            continue;
+         // Offset of the used part of the rect
+         int dx = span.mSrc.x - data.mRect.x;
+         int dy = span.mSrc.y - data.mRect.y;
+
+         bool is_identity = data.mHasTrans ?
+                 is_base_ortho && fabs(data.mTransX.y)<orthoTol && fabs(data.mTransY.x)<orthoTol &&
+                    fabs(m.m00*data.mTransX.x-1.0)<orthoTol && fabs(m.m11*data.mTransY.y-1)<orthoTol :
+                 is_base_identity;
+
+         if (is_identity)
+         {
+            // Same rounding as the blitter
+            UserPoint pos = m.Apply(data.mPos.x,data.mPos.y);
+            int px = (int)(pos.x) + dx;
+            int py = (int)(pos.y) + dy;
+            span.mCopy = true;
+            span.mCopyX = px - span.mSrc.x;
+            span.mCopyY = py - span.mSrc.y;
+            span.mDest = Rect(px, py, span.mSrc.w, span.mSrc.h).Intersect(clip);
+         }
+         else
+         {
+            Matrix tile;
+            if (data.mHasTrans)
+            {
+               tile.m00 = data.mTransX.x;
+               tile.m01 = data.mTransX.y;
+               tile.m10 = data.mTransY.x;
+               tile.m11 = data.mTransY.y;
+            }
+            tile.mtx = data.mPos.x + tile.m00*dx + tile.m01*dy;
+            tile.mty = data.mPos.y + tile.m10*dx + tile.m11*dy;
+            Matrix full = m.Mult(tile);
+            if (full.m00*full.m11 == full.m01*full.m10)
+               continue;
+
+            Extent2DF extent;
+            for(int c=0;c<4;c++)
+               extent.Add( full.Apply( (c&1) ? span.mSrc.w : 0, (c&2) ? span.mSrc.h : 0 ) );
+            span.mCopy = false;
+            span.mDest = Rect(floor(extent.minX), floor(extent.minY), ceil(extent.maxX), ceil(extent.maxY), true)
+                             .Intersect(clip);
+            span.mInverse = full.Inverse();
+         }
+         if (!span.mDest.HasPixels())
+            continue;
+
+         span.mHasColour = data.mHasColour;
+         span.mColour = data.mColour;
+         mSpans.push_back(span);
+      }
+      if (!mSpans.size())
+         return;
+
+      TileBandJob job;
+      job.mTarget = &inTarget;
+      job.mSrcBase = s->GetBase();
+      job.mSrcStride = s->GetStride();
+      job.mSrcFormat = s->Format();
+      job.mSmooth = mFill->smooth;
+      job.mAdd = mBlendMode==bmAdd;
+      job.mTiles = &mSpans[0];
+
+      job.mBins.Reset(clip.y, clip.h, TILE_BAND_HEIGHT);
+      for(int i=0;i<mSpans.size();i++)
+         job.mBins.Count(mSpans[i].mDest.y, mSpans[i].mDest.y1());
+      job.mBins.EndCount();
+      for(int i=0;i<mSpans.size();i++)
+         job.mBins.Place(mSpans[i].mDest.y, mSpans[i].mDest.y1(), i);
+
+      RunRowBands(job.mBins.Bands(), SDrawTileBand, &job, mSpans.size()>=TILE_PARALLEL_MIN_TILES);
+   }
+
+
+   bool Render(const RenderTarget &inTarget, const RenderState &inState)
+   {
+      if (CanBatch(inTarget, inState))
+      {
+         RenderBatched(inTarget, inState);
+         return true;
+      }
+
       Surface *s = mFill->bitmapData;
       double bmp_scale_x = 1.0/s->Width();
       double bmp_scale_y = 1.0/s->Height();
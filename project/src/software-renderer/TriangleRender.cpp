@@ -1,10 +1,46 @@
 #include "PolygonRender.h"
+#include <Surface.h>
+#include <NMEThread.h>
 
 #include <map>
 
 namespace nme
 {
 
+// Large perspective meshes are filled in bands of rows, one filler per worker.
+//  Each band draws its triangles in order, so overlaps come out as they do serially.
+enum { TRIANGLE_BAND_HEIGHT = 32, TRIANGLE_PARALLEL_MIN_TRIS = 64 };
+
+struct TriangleBandJob
+{
+   const RenderTarget *mTarget;
+   const RenderState  *mState;
+   Filler             **mFillers;
+   AlphaMask          **mMasks;
+   const ImagePoint   *mOffsets;
+   const UserPoint    *mPoints;
+   const float        *mUVT;
+   Rect               mClip;
+   // Indices of the triangles touching each band
+   BandBins<int>      mBins;
+};
+
+static void STriangleBand(int inThreadId, int inBand, void *inJob)
+{
+   const TriangleBandJob &job = *(const TriangleBandJob *)inJob;
+   Filler *filler = job.mFillers[inThreadId];
+
+   RenderState state(*job.mState);
+   int y0 = job.mBins.BandY0(inBand);
+   state.mClipRect = Rect(job.mClip.x, y0, job.mClip.w, job.mBins.BandY1(inBand)-y0);
+
+   for(const int *t=job.mBins.Begin(inBand); t<job.mBins.End(inBand); t++)
+   {
+      filler->SetMapping(job.mPoints + *t*3, job.mUVT + *t*9, 3);
+      filler->Fill(*job.mMasks[*t], job.mOffsets[*t].x, job.mOffsets[*t].y, *job.mTarget, state);
+   }
+}
+
 struct Edge
 {
    UserPoint p0,p1;
@@ -28,14 +64,18 @@ class TriangleRender : public PolygonRender
 public:
    bool                  mMappingDirty;
    QuickVec<AlphaMask *> mAlphaMasks;
+   QuickVec<ImagePoint>  mMaskOffsets;
    QuickVec<bool>        mEdgeAA;
    GraphicsTrianglePath *mTriangles;
+   IGraphicsFill        *mFill;
+   QuickVec<Filler *>    mBandFillers;
 
    
    TriangleRender(const GraphicsJob &inJob, const GraphicsPath &inPath):
        PolygonRender(inJob, inPath, inJob.mFill)
    {
       mTriangles = inJob.mTriangles;
+      mFill = inJob.mFill;
       mAlphaMasks.resize(mTriangles->mTriangleCount);
       mAlphaMasks.Zero();
 
@@ -70,6 +110,8 @@ public:
       for(int i=0;i<mAlphaMasks.size();i++)
          if (mAlphaMasks[i])
            mAlphaMasks[i]->Dispose();
+      for(int i=0;i<mBandFillers.size();i++)
+         delete mBandFillers[i];
    }
    
    
@@ -133,6 +175,14 @@ public:
       int tex_components = mTriangles->mType == vtVertex ? 0 : mTriangles->mType==vtVertexUV ? 2 : 3;
       int  aa = inState.mTransform.mAAFactor;
       bool aa1 = aa==1;
+
+      // Build the masks here, and fill them in bands afterwards
+      bool banded = tex_components==3 && inTarget.mPixelFormat!=pfAlpha && mFiller &&
+                    tris>=TRIANGLE_PARALLEL_MIN_TRIS && visible_pixels.h>TRIANGLE_BAND_HEIGHT &&
+                    GetWorkerCount()>1;
+      if (banded)
+         mMaskOffsets.resize(tris);
+
       for(int i=0;i<tris;i++)
       {
          // For each alpha mask ...
@@ -173,7 +223,11 @@ public:
 
 
    
-         if (inTarget.mPixelFormat==pfAlpha)
+         if (banded)
+         {
+            mMaskOffsets[i] = ImagePoint(tx,ty);
+         }
+         else if (inTarget.mPixelFormat==pfAlpha)
          {
             alpha->RenderBitmap(tx,ty,inTarget,inState);
          }
@@ -190,10 +244,52 @@ public:
          edge_aa += 3;
       }
 
+      if (banded)
+         RenderBands(inTarget, inState, visible_pixels);
+
       mMappingDirty = false;
 
       return true;
    }
+
+
+   void RenderBands(const RenderTarget &inTarget, const RenderState &inState, const Rect &inClip)
+   {
+      int workers = GetWorkerCount();
+      while(mBandFillers.size()<workers)
+         mBandFillers.push_back( CreateFiller(mFill,true) );
+
+      TriangleBandJob job;
+      job.mTarget = &inTarget;
+      job.mState = &inState;
+      job.mFillers = &mBandFillers[0];
+      job.mMasks = &mAlphaMasks[0];
+      job.mOffsets = &mMaskOffsets[0];
+      job.mPoints = &mTransformed[0];
+      job.mUVT = &mTriangles->mUVT[0];
+      job.mClip = inClip;
+
+      // Count the triangles touching each band, then place them in order
+      int tris = mTriangles->mTriangleCount;
+      job.mBins.Reset(inClip.y, inClip.h, TRIANGLE_BAND_HEIGHT);
+      for(int pass=0;pass<2;pass++)
+      {
+         for(int t=0;t<tris;t++)
+         {
+            const Rect &rect = mAlphaMasks[t]->mRect;
+            int y0 = rect.y + mMaskOffsets[t].y;
+            int y1 = rect.y1() + mMaskOffsets[t].y;
+            if (pass==0)
+               job.mBins.Count(y0, y1);
+            else
+               job.mBins.Place(y0, y1, t);
+         }
+         if (pass==0)
+            job.mBins.EndCount();
+      }
+
+      RunRowBands(job.mBins.Bands(), STriangleBand, &job);
+   }
    
    
    void SetTransform(const Transform &inTransform)
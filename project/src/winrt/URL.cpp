@@ -45,6 +45,11 @@ public:
       return ByteArray();
    }
 
+   ByteArray takeChunk()
+   {
+      return ByteArray();
+   }
+
    void  getCookies( std::vector<std::string> &outCookies )
    {
    }
@@ -65,5 +70,9 @@ void URLLoader::initialize(const char *inCACertFilePath)
 {
 }
 
+void URLLoader::setCacheDir(const char *inDir, int inMaxBytes)
+{
+}
+
 
 }
@@ -24,6 +24,10 @@ class Surface
    public static var FLAG_NOREPEAT_NONPOT = 0x0001;
    public static var FLAG_FIXED_FORMAT = 0x0002;
 
+   public static inline var RESAMPLE_BOX      = 0;
+   public static inline var RESAMPLE_BILINEAR = 1;
+   public static inline var RESAMPLE_LANCZOS  = 2;
+
    public static inline var CHANNEL_RED   = 0x0001;
    public static inline var CHANNEL_GREEN = 0x0002;
    public static inline var CHANNEL_BLUE  = 0x0004;
@@ -36,6 +40,8 @@ class Surface
    public static inline var FLOAT_STD_SCALE    = 0x0008;
    public static inline var FLOAT_SWIZZLE_RGB  = 0x0010;
    public static inline var FLOAT_100_SCALE    = 0x0020;
+   // One plane per channel (CHW) rather than interleaved pixels (HWC)
+   public static inline var FLOAT_PLANAR       = 0x0040;
 
    // zero mean, std scale
    public static inline var FLOAT_NORM       = 0x0009;
@@ -233,6 +239,12 @@ class Surface
       nme_bitmap_data_set_flags(nmeHandle, inFlags);
    }
 
+   // Filter for smooth software scaling when shrinking (and always for RESAMPLE_LANCZOS)
+   public static function setResampleFilter(inFilter:Int):Void 
+   {
+      nme_bitmap_data_set_resample_filter(inFilter);
+   }
+
    public function getFlags():Int 
    {
       return nme_bitmap_data_get_flags(nmeHandle);
@@ -329,6 +341,23 @@ class Surface
       nme_bitmap_data_noise(nmeHandle, randomSeed, low, high, channelOptions, grayScale);
    }
 
+   public function perlinNoise(baseX:Float, baseY:Float, numOctaves:Int, randomSeed:Int, stitch:Bool, fractalNoise:Bool,
+                               channelOptions:Int = 7, grayScale:Bool = false, offsets:Array<Point> = null) 
+   {
+      var offsetXY:Array<Float> = null;
+      if (offsets!=null)
+      {
+         offsetXY = [];
+         for(o in offsets)
+         {
+            offsetXY.push(o.x);
+            offsetXY.push(o.y);
+         }
+      }
+      nme_bitmap_data_perlin_noise(nmeHandle, baseX, baseY, numOctaves, randomSeed, stitch, fractalNoise,
+                                   channelOptions, grayScale, offsetXY);
+   }
+
    // Getters & Setters
    private function get_rect():Rectangle { return new Rectangle(0, 0, width, height); }
    private function get_width():Int { return nme_bitmap_data_width(nmeHandle); }
@@ -378,10 +407,12 @@ class Surface
    private static var nme_bitmap_data_get_transparent = PrimeLoader.load("nme_bitmap_data_get_transparent", "ob");
    private static var nme_bitmap_data_set_flags = PrimeLoader.load("nme_bitmap_data_set_flags", "oiv");
    private static var nme_bitmap_data_get_flags = PrimeLoader.load("nme_bitmap_data_get_flags", "oi");
+   private static var nme_bitmap_data_set_resample_filter = PrimeLoader.load("nme_bitmap_data_set_resample_filter", "iv");
    private static var nme_bitmap_data_encode = nme.Loader.load("nme_bitmap_data_encode", 3);
    private static var nme_bitmap_data_dump_bits = PrimeLoader.load("nme_bitmap_data_dump_bits", "ov");
    private static var nme_bitmap_data_dispose = PrimeLoader.load("nme_bitmap_data_dispose", "ov");
    private static var nme_bitmap_data_noise = PrimeLoader.load("nme_bitmap_data_noise", "oiiiibv");
+   private static var nme_bitmap_data_perlin_noise = PrimeLoader.load("nme_bitmap_data_perlin_noise", "oddiibbibov");
    private static var nme_bitmap_data_flood_fill = PrimeLoader.load("nme_bitmap_data_flood_fill", "oiiiv");
    private static var nme_bitmap_data_get_prem_alpha = PrimeLoader.load("nme_bitmap_data_get_prem_alpha", "ob");
    private static var nme_bitmap_data_set_prem_alpha = PrimeLoader.load("nme_bitmap_data_set_prem_alpha", "obv");
@@ -22,6 +22,11 @@ class DisplayObject extends EventDispatcher implements IBitmapDrawable
    public var blendMode(get, set):BlendMode;
    public var cacheAsBitmap(get, set):Bool;
    public var pedanticBitmapCaching(get, set):Bool;
+   // When > 0, the cacheAsBitmap pixels are kept under rotation, sub-pixel moves and scaling
+   //  by up to a factor of (1+cacheAsBitmapTolerance), rendered at cacheAsBitmapResolution.
+   //  Objects with filters, masks, a blend mode or a scale9Grid are cached in screen space.
+   public var cacheAsBitmapTolerance(get, set):Float;
+   public var cacheAsBitmapResolution(get, set):Float;
    public var pixelSnapping(get, set):PixelSnapping;
    public var filters(get, set):Array<Dynamic>;
    public var graphics(get, null):Graphics;
@@ -150,6 +155,41 @@ class DisplayObject extends EventDispatcher implements IBitmapDrawable
       return nme_display_object_encode(nmeHandle, inFlags);
    }
 
+   // Fields for setTransforms
+   public static inline var TRANSFORM_X        = 0x0001;
+   public static inline var TRANSFORM_Y        = 0x0002;
+   public static inline var TRANSFORM_SCALE_X  = 0x0004;
+   public static inline var TRANSFORM_SCALE_Y  = 0x0008;
+   public static inline var TRANSFORM_SCALE    = 0x0010;
+   public static inline var TRANSFORM_ROTATION = 0x0020;
+   public static inline var TRANSFORM_ALPHA    = 0x0040;
+   public static inline var TRANSFORM_MATRIX   = 0x0080;
+
+   // Collect the handles once, and reuse them with setTransforms each frame
+   public static function getHandles(objects:Array<DisplayObject>) : Array<NativeHandle>
+   {
+      return [ for(o in objects) o.nmeHandle ];
+   }
+
+   // Update many objects in one native call.  'data' is an Array<Float> or Float32Array
+   //  holding one block of handles.length values per field, in bit order.
+   //  TRANSFORM_MATRIX is six blocks: a,b,c,d,tx,ty.
+   public static function setTransforms(handles:Array<NativeHandle>, fields:Int, data:Dynamic)
+   {
+      nme_display_object_set_transforms(handles, fields, data);
+   }
+
+   // Native display-list footprint:
+   //  { objects, objectsWithExtra, bytesPerObject, bytesPerExtra, bytesPerNode }
+   public static function getMemoryReport() : Dynamic
+   {
+      var r:Array<Int> = nme_display_object_get_memory_report();
+      var objects = r[0];
+      var extras = r[1];
+      return { objects:objects, objectsWithExtra:extras, bytesPerObject:r[2], bytesPerExtra:r[3],
+               bytesPerNode: objects==0 ? 0.0 : r[2] + extras*r[3]/objects };
+   }
+
    // By default, fresh IDs will be allocated to avoid conflicts in display list
    static inline var DISPLAY_KEEP_ID = 0x0001;
    public static function decodeDisplay(inBytes:ByteArray,inFlags=0) : DisplayObject
@@ -411,6 +451,20 @@ class DisplayObject extends EventDispatcher implements IBitmapDrawable
       return inVal;
    }
 
+   private function get_cacheAsBitmapTolerance():Float { return nme_display_object_get_bitmap_cache_tolerance(nmeHandle); }
+   private function set_cacheAsBitmapTolerance(inVal:Float):Float 
+   {
+      nme_display_object_set_bitmap_cache_tolerance(nmeHandle, inVal);
+      return inVal;
+   }
+
+   private function get_cacheAsBitmapResolution():Float { return nme_display_object_get_bitmap_cache_resolution(nmeHandle); }
+   private function set_cacheAsBitmapResolution(inVal:Float):Float 
+   {
+      nme_display_object_set_bitmap_cache_resolution(nmeHandle, inVal);
+      return inVal;
+   }
+
    private function get_pixelSnapping():PixelSnapping 
    {
       var val:Int = nme_display_object_get_pixel_snapping(nmeHandle);
@@ -607,12 +661,18 @@ class DisplayObject extends EventDispatcher implements IBitmapDrawable
    private static var nme_display_object_set_height = PrimeLoader.load("nme_display_object_set_height", "odv");
    private static var nme_display_object_get_alpha = PrimeLoader.load("nme_display_object_get_alpha", "od");
    private static var nme_display_object_set_alpha = PrimeLoader.load("nme_display_object_set_alpha", "odv");
+   private static var nme_display_object_set_transforms = PrimeLoader.load("nme_display_object_set_transforms", "oiov");
+   private static var nme_display_object_get_memory_report = PrimeLoader.load("nme_display_object_get_memory_report", "o");
    private static var nme_display_object_get_blend_mode = PrimeLoader.load("nme_display_object_get_blend_mode", "oi");
    private static var nme_display_object_set_blend_mode = PrimeLoader.load("nme_display_object_set_blend_mode", "oiv");
    private static var nme_display_object_get_cache_as_bitmap = PrimeLoader.load("nme_display_object_get_cache_as_bitmap", "ob");
    private static var nme_display_object_set_cache_as_bitmap = PrimeLoader.load("nme_display_object_set_cache_as_bitmap", "obv");
    private static var nme_display_object_get_pedantic_bitmap_caching = PrimeLoader.load("nme_display_object_get_pedantic_bitmap_caching", "ob");
    private static var nme_display_object_set_pedantic_bitmap_caching = PrimeLoader.load("nme_display_object_set_pedantic_bitmap_caching", "obv");
+   private static var nme_display_object_get_bitmap_cache_tolerance = PrimeLoader.load("nme_display_object_get_bitmap_cache_tolerance", "od");
+   private static var nme_display_object_set_bitmap_cache_tolerance = PrimeLoader.load("nme_display_object_set_bitmap_cache_tolerance", "odv");
+   private static var nme_display_object_get_bitmap_cache_resolution = PrimeLoader.load("nme_display_object_get_bitmap_cache_resolution", "od");
+   private static var nme_display_object_set_bitmap_cache_resolution = PrimeLoader.load("nme_display_object_set_bitmap_cache_resolution", "odv");
    private static var nme_display_object_get_pixel_snapping = PrimeLoader.load("nme_display_object_get_pixel_snapping", "oi");
    private static var nme_display_object_set_pixel_snapping = PrimeLoader.load("nme_display_object_set_pixel_snapping", "oiv");
    private static var nme_display_object_get_visible = PrimeLoader.load("nme_display_object_get_visible", "ob");
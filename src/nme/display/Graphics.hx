@@ -93,6 +93,12 @@ class Graphics
       nme_gfx_draw_points(nmeHandle, inXY, inPointRGBA, inDefaultRGBA, #if (neko && (!haxe3 || neko_v1)) true #else false #end, inSize);
    }
 
+   // Overwrite the points of the last drawPoints, starting at inFirst, without rebuilding it
+   public function updatePoints(inFirst:Int, inXY:Array<Float>, inPointRGBA:Array<Int> = null) 
+   {
+      nme_gfx_update_points(nmeHandle, inFirst, inXY, inPointRGBA, #if (neko && (!haxe3 || neko_v1)) true #else false #end);
+   }
+
    public function drawRect(inX:Float, inY:Float, inWidth:Float, inHeight:Float) 
    {
       nme_gfx_draw_rect(nmeHandle, inX, inY, inWidth, inHeight);
@@ -201,6 +207,7 @@ class Graphics
    private static var nme_gfx_draw_path = PrimeLoader.load("nme_gfx_draw_path", "ooobv");
    private static var nme_gfx_draw_tiles = PrimeLoader.load("nme_gfx_draw_tiles", "oooiiv");
    private static var nme_gfx_draw_points = PrimeLoader.load("nme_gfx_draw_points", "oooibdv");
+   private static var nme_gfx_update_points = PrimeLoader.load("nme_gfx_update_points", "oioobv");
    private static var nme_gfx_draw_round_rect = nme.PrimeLoader.load("nme_gfx_draw_round_rect", "oddddddv");
    private static var nme_gfx_draw_triangles = nme.PrimeLoader.load("nme_gfx_draw_triangles","ooooioiv");
 }
@@ -41,6 +41,8 @@ class URLLoader extends EventDispatcher
 
    private var state:Int;
    public var nmeOnComplete:Dynamic -> Bool;
+   // If set, the body is delivered in pieces as it arrives rather than buffered into 'data'
+   public var onChunk:ByteArray -> Void;
 
    public function new(?request:URLRequest) 
    {
@@ -75,6 +77,12 @@ class URLLoader extends EventDispatcher
       nme_curl_initialize(inCACertFilePath);
    }
 
+   // Keep GET responses with an ETag or Last-Modified in 'dir', up to maxBytes. null disables.
+   public static function setCache(dir:String, maxBytes:Int) 
+   {
+      nme_curl_set_cache(dir, maxBytes);
+   }
+
    public function load(request:URLRequest) 
    {
       state = urlInit;
@@ -206,11 +214,23 @@ class URLLoader extends EventDispatcher
 
          var code:Int = nme_curl_get_code(nmeHandle);
 
+         if (onChunk != null && code < 400 && (bytesLoaded != old_loaded || state == urlComplete))
+         {
+            var chunk:ByteArray = nme_curl_take_chunk(nmeHandle);
+            if (chunk != null)
+               onChunk(chunk);
+         }
+
          if (state == urlComplete) 
          {
             dispatchHTTPStatus(code);
 
-            if (code < 400) 
+            if (onChunk != null && code < 400)
+            {
+               data = null;
+               nmeDataComplete();
+            }
+            else if (code < 400) 
             {
                var bytes:ByteArray = nme_curl_get_data(nmeHandle);
 
@@ -251,6 +271,8 @@ class URLLoader extends EventDispatcher
    private static var nme_curl_get_code = Loader.load("nme_curl_get_code", 1);
    private static var nme_curl_get_error_message = Loader.load("nme_curl_get_error_message", 1);
    private static var nme_curl_get_data = Loader.load("nme_curl_get_data", 1);
+   private static var nme_curl_take_chunk = Loader.load("nme_curl_take_chunk", 1);
+   private static var nme_curl_set_cache = Loader.load("nme_curl_set_cache", 2);
    private static var nme_curl_get_cookies = Loader.load("nme_curl_get_cookies", 1);
    private static var nme_curl_get_headers = Loader.load("nme_curl_get_headers", 1);
    private static var nme_curl_initialize = Loader.load("nme_curl_initialize", 1);
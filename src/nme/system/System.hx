@@ -163,6 +163,84 @@ class System
       nme_get_glstats(statsArray);
    }
 
+   // Shader program ids (combinations of the renderer PROG_ flags) to compile when
+   //  the context is created.  Call before the stage is created.
+   public static function setPrecompileShaders(programIds:Array<Int>) : Void
+   {
+      nme_set_precompile_shaders(programIds);
+   }
+
+   // Directory to store linked shader binaries, where the driver supports it
+   public static function setShaderCacheDir(dir:String) : Void
+   {
+      nme_set_shader_cache_dir(dir==null ? "" : dir);
+   }
+
+   // 0 Compiled, 1 Loaded from cache, 2 Total ms, 3 Slowest ms
+   public static function getShaderStats(statsArray:Array<Int>) : Void
+   {
+      nme_get_shader_stats(statsArray);
+   }
+
+   // Phases for getPhaseTimes.  Times are inclusive, so filters and blits are
+   //  also counted in the bitmap or render phase that triggered them.
+   public static inline var PHASE_BITMAP = 0;
+   public static inline var PHASE_RENDER = 1;
+   public static inline var PHASE_TESSELLATE = 2;
+   public static inline var PHASE_FILTER = 3;
+   public static inline var PHASE_BLIT = 4;
+   public static inline var PHASE_COUNT = 5;
+
+   // Start (or stop) gathering native phase timings, clearing the totals
+   public static function setProfilePhases(profile:Bool) : Void
+   {
+      nme_set_profile_phases(profile);
+   }
+
+   // Returns [seconds, calls] for each PHASE_ value
+   public static function getPhaseTimes(reset:Bool = false) : Array<Float>
+   {
+      return nme_get_phase_times(reset);
+   }
+
+   // Spread the destruction of released bitmaps, graphics, tilesheets and fonts over
+   //  frames, spending at most maxMs at the end of each frame.  0 frees them immediately.
+   public static function setDeferredRelease(maxMs:Float) : Void
+   {
+      nme_set_deferred_release(maxMs);
+   }
+
+   // Number of released objects still waiting to be destroyed
+   public static function getDeferredReleaseCount() : Int
+   {
+      return nme_get_deferred_release_count();
+   }
+
+   // Pooled native buffers used for graphics paths, jobs and vertex data:
+   //  { allocs, reused, frees, trimmed, bytesInUse, bytesPooled, highWater }
+   // Counters and the high-water mark restart when reset is true.
+   public static function getBufferPoolStats(reset:Bool = false) : Dynamic
+   {
+      var s:Array<Float> = nme_get_buffer_pool_stats(reset);
+      return { allocs:Std.int(s[0]), reused:Std.int(s[1]), frees:Std.int(s[2]), trimmed:Std.int(s[3]),
+               bytesInUse:s[4], bytesPooled:s[5], highWater:s[6] };
+   }
+
+   // Memory kept for reuse by the pool of bitmap-cache, mask and filter surfaces, once
+   //  idle surfaces have been trimmed at the end of a frame
+   public static function setSurfacePoolBudget(bytes:Int) : Void
+   {
+      nme_set_surface_pool_budget(bytes);
+   }
+
+   //  { acquires, reused, created, trimmed, surfaces, bytesInUse, bytesPooled }
+   public static function getSurfacePoolStats(reset:Bool = false) : Dynamic
+   {
+      var s:Array<Float> = nme_get_surface_pool_stats(reset);
+      return { acquires:Std.int(s[0]), reused:Std.int(s[1]), created:Std.int(s[2]), trimmed:Std.int(s[3]),
+               surfaces:Std.int(s[4]), bytesInUse:s[5], bytesPooled:s[6] };
+   }
+
 
    // Native Methods
    private static var nme_get_unique_device_identifier = Loader.load("nme_get_unique_device_identifier", 0);
@@ -170,6 +248,16 @@ class System
    private static var nme_get_local_ip_address = Loader.load("nme_get_local_ip_address", 0);
    #end
    private static var nme_get_glstats = nme.PrimeLoader.load("nme_get_glstats", "ov");
+   private static var nme_set_precompile_shaders = nme.PrimeLoader.load("nme_set_precompile_shaders", "ov");
+   private static var nme_set_shader_cache_dir = nme.PrimeLoader.load("nme_set_shader_cache_dir", "sv");
+   private static var nme_get_shader_stats = nme.PrimeLoader.load("nme_get_shader_stats", "ov");
+   private static var nme_set_profile_phases = nme.PrimeLoader.load("nme_set_profile_phases", "bv");
+   private static var nme_get_phase_times = nme.PrimeLoader.load("nme_get_phase_times", "bo");
+   private static var nme_set_deferred_release = nme.PrimeLoader.load("nme_set_deferred_release", "dv");
+   private static var nme_get_deferred_release_count = nme.PrimeLoader.load("nme_get_deferred_release_count", "i");
+   private static var nme_get_buffer_pool_stats = nme.PrimeLoader.load("nme_get_buffer_pool_stats", "bo");
+   private static var nme_set_surface_pool_budget = nme.PrimeLoader.load("nme_set_surface_pool_budget", "iv");
+   private static var nme_get_surface_pool_stats = nme.PrimeLoader.load("nme_get_surface_pool_stats", "bo");
 }
 
 #else
@@ -0,0 +1,136 @@
+import nme.display.BitmapData;
+import nme.system.System;
+import haxe.Timer;
+
+// Headless benchmark runner.  Each scene is drawn into a BitmapData with the software
+//  renderer for a fixed number of frames, and the timings are written as JSON so
+//  runs from two builds can be diffed.
+//
+//  bin/Benchmark [-frames N] [-warmup N] [-scale S] [-only name,name] [-out file.json]
+class Benchmark
+{
+   public static inline var WIDTH = 1024;
+   public static inline var HEIGHT = 768;
+
+   static var phaseNames = ["bitmap", "render", "tessellate", "filter", "blit"];
+
+   static function createScenes(scale:Float, only:Array<String>) : Array<Void->Scene>
+   {
+      function n(count:Int) return Std.int(Math.max(1, count*scale));
+      var factories = new Array<{ name:String, create:Void->Scene }>();
+      factories.push( { name:"bunnies", create:function() return new BunnyScene(n(5000)) } );
+      factories.push( { name:"points", create:function() return new PointsScene(n(200000)) } );
+      factories.push( { name:"filters", create:function() return new FilterScene(n(48)) } );
+      factories.push( { name:"triangles", create:function() return new TriangleScene(n(20000)) } );
+      factories.push( { name:"masks", create:function() return new MaskScene(n(50)) } );
+      factories.push( { name:"tiles-10k", create:function() return new TileScene("tiles-10k", n(10000)) } );
+      factories.push( { name:"tiles-100k", create:function() return new TileScene("tiles-100k", n(100000)) } );
+      factories.push( { name:"tiles-1m", create:function() return new TileScene("tiles-1m", n(1000000)) } );
+      factories.push( { name:"tree-deep", create:function() return new DeepTreeScene("tree-deep", 2, 12) } );
+      factories.push( { name:"tree-wide", create:function() return new DeepTreeScene("tree-wide", 8, 5) } );
+      factories.push( { name:"text", create:function() return new TextScene(n(400)) } );
+
+      return [ for(f in factories) if (only==null || only.indexOf(f.name)>=0) f.create ];
+   }
+
+   static function main()
+   {
+      var frames = 100;
+      var warmup = 5;
+      var scale = 1.0;
+      var only:Array<String> = null;
+      var out:String = null;
+
+      var args = Sys.args();
+      var i = 0;
+      while(i<args.length)
+      {
+         var arg = args[i++];
+         var val = i<args.length ? args[i++] : "";
+         switch(arg)
+         {
+            case "-frames": frames = Std.parseInt(val);
+            case "-warmup": warmup = Std.parseInt(val);
+            case "-scale": scale = Std.parseFloat(val);
+            case "-only": only = val.split(",");
+            case "-out": out = val;
+            default:
+               Sys.println("Usage: Benchmark [-frames N] [-warmup N] [-scale S] [-only name,name] [-out file.json]");
+               Sys.exit(1);
+         }
+      }
+
+      var target = new BitmapData(WIDTH, HEIGHT, true, 0);
+      var results = new Array<String>();
+
+      for(create in createScenes(scale, only))
+      {
+         var t0 = Timer.stamp();
+         var scene = create();
+         var setupMs = (Timer.stamp()-t0)*1000;
+         Sys.println('${scene.sceneName} (${scene.count})...');
+
+         for(f in 0...warmup)
+            drawFrame(scene, target, f);
+
+         System.setProfilePhases(true);
+         var times = new Array<Float>();
+         for(f in 0...frames)
+         {
+            var t = Timer.stamp();
+            drawFrame(scene, target, warmup+f);
+            times.push( (Timer.stamp()-t)*1000 );
+         }
+         var phases = System.getPhaseTimes(true);
+         System.setProfilePhases(false);
+
+         results.push( sceneJson(scene, setupMs, times, phases) );
+      }
+
+      var json = '{\n  "frames": $frames,\n  "width": $WIDTH,\n  "height": $HEIGHT,\n  "scale": $scale,\n' +
+                 '  "scenes": [\n' + results.join(",\n") + '\n  ]\n}\n';
+      if (out!=null)
+         sys.io.File.saveContent(out, json);
+      else
+         Sys.print(json);
+   }
+
+   static function drawFrame(scene:Scene, target:BitmapData, frame:Int)
+   {
+      scene.update(frame);
+      target.fillRect(target.rect, 0xff000000);
+      target.draw(scene);
+   }
+
+   static function ms(value:Float) : String
+   {
+      return Std.string( Math.round(value*1000)/1000 );
+   }
+
+   static function sceneJson(scene:Scene, setupMs:Float, times:Array<Float>, phases:Array<Float>) : String
+   {
+      var sorted = times.copy();
+      sorted.sort(Reflect.compare);
+      var total = 0.0;
+      for(t in times)
+         total += t;
+      var n = times.length;
+
+      var lines = new Array<String>();
+      lines.push('      "name": "${scene.sceneName}"');
+      lines.push('      "count": ${scene.count}');
+      lines.push('      "setupMs": ${ms(setupMs)}');
+      lines.push('      "totalMs": ${ms(total)}');
+      lines.push('      "meanMs": ${ms(n>0 ? total/n : 0)}');
+      lines.push('      "medianMs": ${ms(n>0 ? sorted[n>>1] : 0)}');
+      lines.push('      "minMs": ${ms(n>0 ? sorted[0] : 0)}');
+      lines.push('      "maxMs": ${ms(n>0 ? sorted[n-1] : 0)}');
+
+      var phaseLines = new Array<String>();
+      for(p in 0...phaseNames.length)
+         phaseLines.push('        "${phaseNames[p]}": { "ms": ${ms(phases[p*2]*1000)}, "calls": ${Std.int(phases[p*2+1])} }');
+      lines.push('      "phases": {\n' + phaseLines.join(",\n") + '\n      }');
+
+      return '    {\n' + lines.join(",\n") + '\n    }';
+   }
+}
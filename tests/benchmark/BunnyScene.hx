@@ -0,0 +1,54 @@
+import nme.display.Bitmap;
+import nme.display.BitmapData;
+
+// samples/BunnyMark - many bitmaps bouncing under gravity
+class BunnyScene extends Scene
+{
+   var bunnies:Array<Bitmap>;
+   var speedX:Array<Float>;
+   var speedY:Array<Float>;
+
+   public function new(inCount:Int)
+   {
+      super("bunnies", inCount);
+
+      var bunny = new BitmapData(26,37,true,0);
+      bunny.fillRect(new nme.geom.Rectangle(4,10,18,27), 0xffe0e0e0);
+      bunny.fillRect(new nme.geom.Rectangle(6,0,4,12), 0xffe0e0e0);
+      bunny.fillRect(new nme.geom.Rectangle(16,0,4,12), 0xffe0e0e0);
+      bunny.fillRect(new nme.geom.Rectangle(8,16,3,3), 0xff000000);
+
+      bunnies = [];
+      speedX = [];
+      speedY = [];
+      for(i in 0...inCount)
+      {
+         var b = new Bitmap(bunny);
+         b.x = rand()*Benchmark.WIDTH;
+         b.y = rand()*Benchmark.HEIGHT*0.5;
+         bunnies.push(b);
+         speedX.push(rand()*5);
+         speedY.push(rand()*5-2.5);
+         addChild(b);
+      }
+   }
+
+   override public function update(frame:Int)
+   {
+      var maxX = Benchmark.WIDTH - 26;
+      var maxY = Benchmark.HEIGHT - 37;
+      for(i in 0...bunnies.length)
+      {
+         var b = bunnies[i];
+         var x = b.x + speedX[i];
+         var y = b.y + speedY[i];
+         speedY[i] += 0.75;
+         if (x>maxX) { speedX[i] *= -1; x = maxX; }
+         else if (x<0) { speedX[i] *= -1; x = 0; }
+         if (y>maxY) { speedY[i] *= -0.8; y = maxY; }
+         else if (y<0) { speedY[i] = 0; y = 0; }
+         b.x = x;
+         b.y = y;
+      }
+   }
+}
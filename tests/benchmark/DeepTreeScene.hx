@@ -0,0 +1,40 @@
+import nme.display.Sprite;
+
+// Nested containers, 'fan' children per node - stresses traversal and matrix concatenation
+class DeepTreeScene extends Scene
+{
+   var nodes:Array<Sprite>;
+
+   public function new(inName:String, inFan:Int, inDepth:Int)
+   {
+      super(inName, 0);
+      nodes = [];
+      build(this, inFan, inDepth, 200.0);
+      count = nodes.length;
+      x = Benchmark.WIDTH*0.5;
+      y = Benchmark.HEIGHT*0.5;
+   }
+
+   function build(parent:Sprite, fan:Int, depth:Int, radius:Float)
+   {
+      for(i in 0...fan)
+      {
+         var node = new Sprite();
+         var a = Math.PI*2*i/fan;
+         node.x = Math.cos(a)*radius;
+         node.y = Math.sin(a)*radius;
+         node.graphics.beginFill(0xff000000 | Std.int(rand()*0xffffff));
+         node.graphics.drawRect(-2,-2,4,4);
+         parent.addChild(node);
+         nodes.push(node);
+         if (depth>1)
+            build(node, fan, depth-1, radius*0.6);
+      }
+   }
+
+   override public function update(frame:Int)
+   {
+      for(i in 0...nodes.length)
+         nodes[i].rotation = (frame + i) % 360;
+   }
+}
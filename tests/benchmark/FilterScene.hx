@@ -0,0 +1,43 @@
+import nme.display.Shape;
+import nme.filters.BitmapFilter;
+import nme.filters.BlurFilter;
+import nme.filters.DropShadowFilter;
+import nme.filters.GlowFilter;
+
+// samples/08-Filters - filtered shapes that change every frame, so the caches are rebuilt
+class FilterScene extends Scene
+{
+   var shapes:Array<Shape>;
+
+   public function new(inCount:Int)
+   {
+      super("filters", inCount);
+      shapes = [];
+      var cols = Std.int(Math.sqrt(inCount)+0.99);
+      for(i in 0...inCount)
+      {
+         var shape = new Shape();
+         var gfx = shape.graphics;
+         gfx.beginFill(0xff000000 | Std.int(rand()*0xffffff));
+         gfx.drawCircle(0,0,30);
+         gfx.drawRect(-10,-40,20,80);
+         shape.x = 50 + (i%cols) * (Benchmark.WIDTH-100) / cols;
+         shape.y = 50 + Std.int(i/cols) * (Benchmark.HEIGHT-100) / cols;
+         var filters:Array<BitmapFilter> = switch(i%3)
+         {
+            case 0: [ new BlurFilter(8,8,2) ];
+            case 1: [ new GlowFilter(0xffff00,1,12,12,2,2) ];
+            default: [ new DropShadowFilter(6,45,0,0.8,8,8,1,2) ];
+         }
+         shape.filters = filters;
+         shapes.push(shape);
+         addChild(shape);
+      }
+   }
+
+   override public function update(frame:Int)
+   {
+      for(i in 0...shapes.length)
+         shapes[i].rotation = (frame*3 + i*17) % 360;
+   }
+}
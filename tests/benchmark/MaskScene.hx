@@ -0,0 +1,44 @@
+import nme.display.Shape;
+import nme.display.Sprite;
+
+// samples/10-Masks - striped panels seen through moving circular masks
+class MaskScene extends Scene
+{
+   var masks:Array<Shape>;
+
+   public function new(inCount:Int)
+   {
+      super("masks", inCount);
+      masks = [];
+      for(i in 0...inCount)
+      {
+         var panel = new Sprite();
+         var gfx = panel.graphics;
+         for(s in 0...10)
+         {
+            gfx.beginFill(s%2==0 ? 0xff2080ff : 0xffffffff);
+            gfx.drawRect(0,s*20,200,20);
+         }
+         panel.x = rand()*(Benchmark.WIDTH-200);
+         panel.y = rand()*(Benchmark.HEIGHT-200);
+         addChild(panel);
+
+         var mask = new Shape();
+         mask.graphics.beginFill(0xff0000);
+         mask.graphics.drawCircle(0,0,60);
+         panel.addChild(mask);
+         panel.mask = mask;
+         masks.push(mask);
+      }
+   }
+
+   override public function update(frame:Int)
+   {
+      for(i in 0...masks.length)
+      {
+         var a = frame*0.05 + i;
+         masks[i].x = 100 + Math.cos(a)*60;
+         masks[i].y = 100 + Math.sin(a)*60;
+      }
+   }
+}
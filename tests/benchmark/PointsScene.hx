@@ -0,0 +1,44 @@
+// samples/07-Points - a rotating point cloud, rebuilt every frame
+class PointsScene extends Scene
+{
+   var points:Array<Float>;
+   var cols:Array<Int>;
+   var xy:Array<Float>;
+
+   public function new(inCount:Int)
+   {
+      super("points", inCount);
+      points = [];
+      cols = [];
+      xy = [];
+      for(i in 0...inCount)
+      {
+         var theta = rand()*Math.PI*2;
+         var r = 150 + rand()*150;
+         points.push(Math.cos(theta)*r);
+         points.push((rand()-0.5)*200);
+         points.push(Math.sin(theta)*r);
+         cols.push(0xff000000 | Std.int(rand()*0xffffff));
+      }
+   }
+
+   override public function update(frame:Int)
+   {
+      var a = frame*0.02;
+      var c = Math.cos(a);
+      var s = Math.sin(a);
+      var cx = Benchmark.WIDTH*0.5;
+      var cy = Benchmark.HEIGHT*0.5;
+      var idx = 0;
+      for(i in 0...count)
+      {
+         var x = points[i*3];
+         var y = points[i*3+1];
+         var z = points[i*3+2];
+         xy[idx++] = x*c - z*s + cx;
+         xy[idx++] = y + (x*s + z*c)*0.2 + cy;
+      }
+      graphics.clear();
+      graphics.drawPoints(xy,cols,0,2);
+   }
+}
@@ -0,0 +1,26 @@
+import nme.display.Sprite;
+
+// A repeatable workload - 'update' is called once before each frame is drawn
+class Scene extends Sprite
+{
+   public var sceneName(default,null):String;
+   public var count(default,null):Int;
+   var seed:Int;
+
+   public function new(inName:String, inCount:Int)
+   {
+      super();
+      sceneName = inName;
+      count = inCount;
+      seed = 1;
+   }
+
+   public function update(frame:Int) { }
+
+   // Fixed sequence, so every run draws the same thing
+   function rand() : Float
+   {
+      seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+      return seed / 2147483648.0;
+   }
+}
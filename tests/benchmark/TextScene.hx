@@ -0,0 +1,38 @@
+import nme.text.TextField;
+import nme.text.TextFormat;
+
+// A large html text field, re-set every frame like a busy chat log
+class TextScene extends Scene
+{
+   var field:TextField;
+   var lines:Array<String>;
+
+   public function new(inLines:Int)
+   {
+      super("text", inLines);
+      field = new TextField();
+      field.defaultTextFormat = new TextFormat("_sans", 12, 0xffffff);
+      field.width = Benchmark.WIDTH;
+      field.height = Benchmark.HEIGHT;
+      field.multiline = true;
+      field.wordWrap = true;
+      addChild(field);
+
+      var words = ["alpha", "<b>bravo</b>", "charlie", "<i>delta</i>", "echo",
+                   "<font color='#ff8000'>foxtrot</font>", "golf", "<u>hotel</u>"];
+      lines = [];
+      for(i in 0...inLines)
+      {
+         var line = '<font color="#80c0ff">user$i</font>: ';
+         for(w in 0...12)
+            line += words[Std.int(rand()*words.length)] + " ";
+         lines.push(line);
+      }
+   }
+
+   override public function update(frame:Int)
+   {
+      var first = frame % lines.length;
+      field.htmlText = lines.slice(first).concat(lines.slice(0,first)).join("<br/>");
+   }
+}
@@ -0,0 +1,46 @@
+import nme.display.BitmapData;
+import nme.display.Graphics;
+import nme.display.Tilesheet;
+
+// samples/20-Tiles - scaled, rotated, tinted tiles in a single drawTiles call
+class TileScene extends Scene
+{
+   var tilesheet:Tilesheet;
+   var data:Array<Float>;
+   var angles:Array<Float>;
+
+   public function new(inName:String, inCount:Int)
+   {
+      super(inName, inCount);
+      var bmp = new BitmapData(64,64,true,0);
+      bmp.fillRect(new nme.geom.Rectangle(16,16,32,32), 0xffffffff);
+      bmp.fillRect(new nme.geom.Rectangle(0,0,16,16), 0x80ff8000);
+      tilesheet = new Tilesheet(bmp);
+      tilesheet.addTileRect(new nme.geom.Rectangle(0,0,64,64));
+
+      data = [];
+      angles = [];
+      for(i in 0...inCount)
+      {
+         data.push(rand()*Benchmark.WIDTH);
+         data.push(rand()*Benchmark.HEIGHT);
+         data.push(0);
+         data.push(0.1 + rand()*0.4);
+         data.push(0);
+         data.push(rand());
+         data.push(rand());
+         data.push(rand());
+         data.push(0.25 + rand()*0.75);
+         angles.push(rand()*0.2-0.1);
+      }
+   }
+
+   override public function update(frame:Int)
+   {
+      for(i in 0...count)
+         data[i*9+4] += angles[i];
+      graphics.clear();
+      tilesheet.drawTiles(graphics, data, true,
+         Graphics.TILE_SCALE | Graphics.TILE_ROTATION | Graphics.TILE_RGB | Graphics.TILE_ALPHA);
+   }
+}
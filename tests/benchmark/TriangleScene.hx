@@ -0,0 +1,63 @@
+import nme.display.BitmapData;
+import nme.display.TriangleCulling;
+
+// samples/09-Triangles - a textured, waving mesh
+class TriangleScene extends Scene
+{
+   var texture:BitmapData;
+   var grid:Int;
+   var vertices:Array<Float>;
+   var indices:Array<Int>;
+   var uvs:Array<Float>;
+
+   public function new(inCount:Int)
+   {
+      super("triangles", inCount);
+      // inCount is the number of triangles
+      grid = Std.int(Math.sqrt(inCount/2)+0.99);
+      if (grid<1)
+         grid = 1;
+
+      texture = new BitmapData(256,256,false,0);
+      for(y in 0...8)
+         for(x in 0...8)
+            texture.fillRect(new nme.geom.Rectangle(x*32,y*32,32,32), ((x+y)&1)==0 ? 0xff3060c0 : 0xffe0e0e0);
+
+      vertices = [];
+      indices = [];
+      uvs = [];
+      for(y in 0...grid+1)
+         for(x in 0...grid+1)
+         {
+            vertices.push(0);
+            vertices.push(0);
+            uvs.push(x/grid);
+            uvs.push(y/grid);
+         }
+      for(y in 0...grid)
+         for(x in 0...grid)
+         {
+            var i0 = y*(grid+1) + x;
+            var i1 = i0 + grid + 1;
+            indices.push(i0); indices.push(i0+1); indices.push(i1);
+            indices.push(i0+1); indices.push(i1+1); indices.push(i1);
+         }
+   }
+
+   override public function update(frame:Int)
+   {
+      var sx = (Benchmark.WIDTH-100)/grid;
+      var sy = (Benchmark.HEIGHT-100)/grid;
+      var idx = 0;
+      for(y in 0...grid+1)
+         for(x in 0...grid+1)
+         {
+            vertices[idx++] = 50 + x*sx + Math.sin(frame*0.1 + y*0.3)*10;
+            vertices[idx++] = 50 + y*sy + Math.cos(frame*0.1 + x*0.3)*10;
+         }
+      graphics.clear();
+      graphics.beginBitmapFill(texture,null,false,true);
+      graphics.drawTriangles(vertices, indices, uvs, TriangleCulling.NONE);
+      graphics.endFill();
+   }
+}
@@ -0,0 +1,9 @@
+set -e
+cd ../../tools/nme
+haxe compile.hxml
+cd ../../project
+neko Build.n mac
+cd ../
+cd tests/benchmark
+haxe compile.hxml
+bin/Benchmark "$@"
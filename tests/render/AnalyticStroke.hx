@@ -0,0 +1,96 @@
+import nme.display.BitmapData;
+import nme.display.Bitmap;
+import nme.display.Shape;
+import nme.display.CapsStyle;
+import nme.display.JointStyle;
+import nme.display.LineScaleMode;
+
+// Thin solid strokes without miter joints are rasterized analytically, while miter ones still
+//  go through the polygon (SpanRect) path.  Isolated segments have no joints, so the two should
+//  agree to within the anti-aliasing error of the polygon path: no pixel's alpha more than
+//  25% apart, and under 3% apart on average over the pixels either one touches.
+class AnalyticStroke extends TestBase
+{
+   static inline var CELLS = 8;
+   static inline var CELL_SIZE = 24;
+   static inline var MAX_ERROR = 64;
+   static inline var MEAN_ERROR = 8;
+
+   public function new()
+   {
+      super();
+      scaleX = scaleY = 2;
+
+      var analytic = render(JointStyle.BEVEL);
+      var polygon = render(JointStyle.MITER);
+      var size = CELLS*CELL_SIZE;
+      var diff = new BitmapData(size, size, false, 0x000000);
+
+      var maxError = 0;
+      var total = 0;
+      var touched = 0;
+      for(y in 0...size)
+         for(x in 0...size)
+         {
+            var a0 = analytic.getPixel32(x,y)>>>24;
+            var a1 = polygon.getPixel32(x,y)>>>24;
+            if (a0!=0 || a1!=0)
+            {
+               var error = a0>a1 ? a0-a1 : a1-a0;
+               if (error>maxError)
+                  maxError = error;
+               total += error;
+               touched++;
+               diff.setPixel32(x,y, 0xff000000 | (error*4>255 ? 255 : error*4)<<16 );
+            }
+         }
+      var meanError = touched>0 ? total/touched : 0.0;
+      var pass = maxError<=MAX_ERROR && meanError<=MEAN_ERROR;
+
+      addBitmap(analytic, 0, "Analytic");
+      addBitmap(polygon, size+10, "SpanRect");
+      addBitmap(diff, (size+10)*2, "Difference x4");
+      label( (pass ? "PASS" : "FAIL") + " max " + maxError + "/" + MAX_ERROR +
+             ", mean " + Std.int(meanError*100)/100 + "/" + MEAN_ERROR, 0, size+24 );
+   }
+
+   function render(joints:JointStyle):BitmapData
+   {
+      var shape = new Shape();
+      var gfx = shape.graphics;
+      // One segment per cell, so the strokes never overlap
+      for(cy in 0...CELLS)
+         for(cx in 0...CELLS)
+         {
+            var idx = cx + cy*CELLS;
+            var thickness = 1.0 + (idx % 7)*0.5;
+            gfx.lineStyle(thickness, 0xffffff, 1.0, false, LineScaleMode.NORMAL, CapsStyle.NONE, joints);
+            var angle = idx*0.37;
+            var r = CELL_SIZE*0.4;
+            var mx = (cx+0.5)*CELL_SIZE + (idx%5)*0.2;
+            var my = (cy+0.5)*CELL_SIZE + (idx%3)*0.3;
+            gfx.moveTo(mx - Math.cos(angle)*r, my - Math.sin(angle)*r);
+            gfx.lineTo(mx + Math.cos(angle)*r, my + Math.sin(angle)*r);
+         }
+
+      var bmp = new BitmapData(CELLS*CELL_SIZE, CELLS*CELL_SIZE, true, 0x00000000);
+      bmp.draw(shape);
+      return bmp;
+   }
+
+   function addBitmap(inData:BitmapData, inX:Float, inName:String)
+   {
+      var bitmap = new Bitmap(inData);
+      bitmap.x = inX;
+      addChild(bitmap);
+      label(inName, inX, CELLS*CELL_SIZE+4);
+   }
+
+   override public function resize()
+   {
+      var gfx = graphics;
+      gfx.clear();
+      gfx.beginFill(0x404040);
+      gfx.drawRect(0,0,stage.stageWidth/2+1, stage.stageHeight/2+1);
+   }
+}
@@ -14,6 +14,7 @@ class RenderTest extends Sprite
       super();
       factories.push( BitmapBlend.new );
       factories.push( ColourTransform.new );
+      factories.push( AnalyticStroke.new );
       nextScreen();
 
       nextButton = new TextField();